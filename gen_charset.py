@@ -0,0 +1,242 @@
+#!/usr/bin/env python3
+"""
+Generates lookup tables of the translator (main/charset.c and main/charset.h).
+
+Letters of messages are passed through the pipeline as one byte codes. ASCII characters are their own codes,
+other symbols (prosigns, letters of alternate alphabets) get codes from CHARSET_EXT_BASE. Symbols with the same
+morse code share one code. Code points of other scripts are mapped to codes by directly indexed tables.
+
+Usage: ./gen_charset.py (run it from the root of the repository after changing the tables below)
+
+Author: Vojtěch Dvořák (xdvora3o)
+Date: 2022-12-12
+"""
+
+import unicodedata
+
+# ASCII characters (upper case letters are converted to lower case by the decoder)
+ASCII = {
+    ' ': '/', '.': '//',
+    'a': '.-', 'b': '-...', 'c': '-.-.', 'd': '-..', 'e': '.', 'f': '..-.', 'g': '--.', 'h': '....', 'i': '..',
+    'j': '.---', 'k': '-.-', 'l': '.-..', 'm': '--', 'n': '-.', 'o': '---', 'p': '.--.', 'q': '--.-', 'r': '.-.',
+    's': '...', 't': '-', 'u': '..-', 'v': '...-', 'w': '.--', 'x': '-..-', 'y': '-.--', 'z': '--..',
+    '1': '.----', '2': '..---', '3': '...--', '4': '....-', '5': '.....',
+    '6': '-....', '7': '--...', '8': '---..', '9': '----.', '0': '-----',
+    # ITU punctuation
+    ',': '--..--', '?': '..--..', '\'': '.----.', '!': '-.-.--', '/': '-..-.', '(': '-.--.', ')': '-.--.-',
+    '&': '.-...', ':': '---...', ';': '-.-.-.', '=': '-...-', '+': '.-.-.', '-': '-....-', '_': '..--.-',
+    '"': '.-..-.', '$': '...-..-', '@': '.--.-.',
+}
+
+# Prosigns (written as <NAME> in the message)
+PROSIGNS = {
+    'AR': '.-.-.', 'AS': '.-...', 'BK': '-...-.-', 'BT': '-...-', 'CL': '-.-..-..', 'CT': '-.-.-',
+    'DO': '-..---', 'HH': '........', 'KN': '-.--.', 'SK': '...-.-', 'SN': '...-.', 'SOS': '...---...',
+}
+
+# Russian (and Ukrainian) alphabet
+CYRILLIC = {
+    'а': '.-', 'б': '-...', 'в': '.--', 'г': '--.', 'д': '-..', 'е': '.', 'ё': '.', 'ж': '...-', 'з': '--..',
+    'и': '..', 'й': '.---', 'к': '-.-', 'л': '.-..', 'м': '--', 'н': '-.', 'о': '---', 'п': '.--.', 'р': '.-.',
+    'с': '...', 'т': '-', 'у': '..-', 'ф': '..-.', 'х': '....', 'ц': '-.-.', 'ч': '---.', 'ш': '----',
+    'щ': '--.-', 'ъ': '--.--', 'ы': '-.--', 'ь': '-..-', 'э': '..-..', 'ю': '..--', 'я': '.-.-',
+    'і': '..', 'ї': '.---.', 'є': '..-..', 'ґ': '--.',
+}
+
+# Wabun code (katakana, hiragana are mapped to the same codes)
+WABUN = {
+    'イ': '.-', 'ロ': '.-.-', 'ハ': '-...', 'ニ': '-.-.', 'ホ': '-..', 'ヘ': '.', 'ト': '..-..', 'チ': '..-.',
+    'リ': '--.', 'ヌ': '....', 'ル': '-.--.', 'ヲ': '.---', 'ワ': '-.-', 'カ': '.-..', 'ヨ': '--', 'タ': '-.',
+    'レ': '---', 'ソ': '---.', 'ツ': '.--.', 'ネ': '--.-', 'ナ': '.-.', 'ラ': '...', 'ム': '-', 'ウ': '..-',
+    'ヰ': '.-..-', 'ノ': '..--', 'オ': '.-...', 'ク': '...-', 'ヤ': '.--', 'マ': '-..-', 'ケ': '-.--', 'フ': '--..',
+    'コ': '----', 'エ': '-.---', 'テ': '.-.--', 'ア': '--.--', 'サ': '-.-.-', 'キ': '-.-..', 'ユ': '-..--',
+    'メ': '-...-', 'ミ': '..-.-', 'シ': '--.-.', 'ヱ': '.--..', 'ヒ': '--..-', 'モ': '-..-.', 'セ': '.---.',
+    'ス': '---.-', 'ン': '.-.-.', '゛': '..', '゜': '..--.', 'ー': '.--.-', '、': '.-.-.-', '」': '.-.-..',
+}
+
+# Letters, that are not decomposed by NFKD
+LATIN_EXTRA = {
+    'ß': 'ss', 'æ': 'ae', 'Æ': 'ae', 'œ': 'oe', 'Œ': 'oe', 'ø': 'o', 'Ø': 'o', 'đ': 'd', 'Đ': 'd', 'ł': 'l',
+    'Ł': 'l', 'þ': 'th', 'Þ': 'th', 'ð': 'd', 'Ð': 'd', 'ı': 'i', 'ħ': 'h', 'Ħ': 'h', 'ŀ': 'l', 'Ŀ': 'l',
+}
+
+# Typographic punctuation
+PUNCTUATION = {
+    '‐': '-', '‑': '-', '‒': '-', '–': '-', '—': '-', '‘': '\'', '’': '\'', '‚': ',', '“': '"', '”': '"',
+    '„': '"', '…': '.',
+}
+
+EXT_BASE = 0x80
+PROSIGN_MAX_LEN = 3
+
+LATIN_RANGE = (0x0080, 0x0180)
+CYRILLIC_RANGE = (0x0400, 0x0492)
+KANA_RANGE = (0x3000, 0x3100)
+PUNCTUATION_RANGE = (0x2010, 0x2028)
+
+
+codes = {} # Morse code -> code
+morse = [None] * 256 # Code -> morse code
+
+for ch, mc in ASCII.items():
+    morse[ord(ch)] = mc
+    codes.setdefault(mc, ord(ch))
+
+
+def code_of(mc):
+    """Returns the code of the morse code (new code is assigned if there is none)"""
+    if mc not in codes:
+        free = [c for c in range(EXT_BASE, 256) if morse[c] is None]
+        if not free:
+            raise SystemExit('There are no free codes!')
+
+        codes[mc] = free[0]
+        morse[free[0]] = mc
+
+    return codes[mc]
+
+
+def entry(seq):
+    """Packs up to two codes to the entry of the mapping table"""
+    assert 1 <= len(seq) <= 2, seq
+    return seq[0] | ((seq[1] if len(seq) > 1 else 0) << 8)
+
+
+prosigns = {name: code_of(mc) for name, mc in PROSIGNS.items()}
+assert all(len(name) <= PROSIGN_MAX_LEN for name in prosigns)
+
+latin = [0] * (LATIN_RANGE[1] - LATIN_RANGE[0])
+for cp in range(*LATIN_RANGE):
+    ch = chr(cp)
+    if ch in LATIN_EXTRA:
+        text = LATIN_EXTRA[ch]
+    else: #Diacritics are removed
+        text = ''.join(c for c in unicodedata.normalize('NFKD', ch) if c.isascii()).lower()
+
+    letters = [ord(c) for c in text if morse[ord(c)]]
+    if 1 <= len(letters) <= 2 and text.isalpha():
+        latin[cp - LATIN_RANGE[0]] = entry(letters)
+
+cyrillic = [0] * (CYRILLIC_RANGE[1] - CYRILLIC_RANGE[0])
+for ch, mc in CYRILLIC.items():
+    for variant in (ch, ch.upper()):
+        cyrillic[ord(variant) - CYRILLIC_RANGE[0]] = entry([code_of(mc)])
+
+kana = [0] * (KANA_RANGE[1] - KANA_RANGE[0])
+for cp in range(*KANA_RANGE):
+    ch = chr(cp)
+    if 0x3041 <= cp <= 0x3096: #Hiragana has the same order as katakana
+        ch = chr(cp + 0x60)
+
+    seq = []
+    if ch in WABUN:
+        seq = [WABUN[ch]]
+    else:
+        decomposed = unicodedata.normalize('NFKD', ch)
+        name = unicodedata.name(decomposed[0], '').replace('SMALL ', '') #Small kana are played as normal ones
+        base = unicodedata.lookup(name) if name else ''
+        if base in WABUN:
+            seq = [WABUN[base]]
+            if '\u3099' in decomposed: #Combining dakuten
+                seq.append(WABUN['゛'])
+            elif '\u309a' in decomposed: #Combining handakuten
+                seq.append(WABUN['゜'])
+
+    if seq:
+        kana[cp - KANA_RANGE[0]] = entry([code_of(mc) for mc in seq])
+
+punctuation = [0] * (PUNCTUATION_RANGE[1] - PUNCTUATION_RANGE[0])
+for ch, ascii_ch in PUNCTUATION.items():
+    punctuation[ord(ch) - PUNCTUATION_RANGE[0]] = entry([ord(ascii_ch)])
+
+
+def c_table(values, per_line=16):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append('    ' + ' '.join('0x%04x,' % v for v in values[i:i + per_line]))
+    return '\n'.join(lines)
+
+
+def c_string(value):
+    return '"%s"' % value if value else 'NULL'
+
+
+HEADER_COMMENT = """/**
+ * @file %s
+ *
+ * @brief Lookup tables of the translator (GENERATED by gen_charset.py, do not edit it manually!)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+"""
+
+with open('main/charset.h', 'w') as f:
+    f.write(HEADER_COMMENT % 'charset.h')
+    f.write("""
+#ifndef __CHARSET__
+#define __CHARSET__
+
+#include <stdint.h>
+
+
+#define CHARSET_EXT_BASE 0x%02x //< The first code of symbols, that are not in ASCII
+#define CHARSET_PROSIGN_MAX_LEN %d //< Maximum length of the name of the prosign
+
+#define CHARSET_CODE_DO 0x%02x //< Prosign, that switches to Wabun code
+#define CHARSET_CODE_SN 0x%02x //< Prosign, that returns from Wabun code
+
+//Ranges of code points covered by mapping tables (entry contains up to two codes, the first one is in the lower byte)
+#define CHARSET_LATIN_FIRST 0x%04x
+#define CHARSET_LATIN_LAST 0x%04x
+#define CHARSET_CYRILLIC_FIRST 0x%04x
+#define CHARSET_CYRILLIC_LAST 0x%04x
+#define CHARSET_KANA_FIRST 0x%04x
+#define CHARSET_KANA_LAST 0x%04x
+#define CHARSET_PUNCTUATION_FIRST 0x%04x
+#define CHARSET_PUNCTUATION_LAST 0x%04x
+
+
+/**
+ * @brief Prosign, that can be written as <NAME> in the message
+ *
+ */
+typedef struct charset_prosign {
+    char name[CHARSET_PROSIGN_MAX_LEN + 1];
+    uint8_t code;
+} charset_prosign_t;
+
+
+extern const char *const charset_morse[256]; //< Morse codes of codes (NULL if code cannot be played)
+
+extern const uint16_t charset_latin[]; //< Latin letters with diacritics (transliterated)
+extern const uint16_t charset_cyrillic[]; //< Cyrillic letters
+extern const uint16_t charset_kana[]; //< Katakana and hiragana (Wabun code)
+extern const uint16_t charset_punctuation[]; //< Typographic punctuation
+
+extern const charset_prosign_t charset_prosigns[];
+extern const unsigned charset_prosign_num;
+
+#endif
+""" % (EXT_BASE, PROSIGN_MAX_LEN, prosigns['DO'], prosigns['SN'],
+       LATIN_RANGE[0], LATIN_RANGE[1] - 1, CYRILLIC_RANGE[0], CYRILLIC_RANGE[1] - 1,
+       KANA_RANGE[0], KANA_RANGE[1] - 1, PUNCTUATION_RANGE[0], PUNCTUATION_RANGE[1] - 1))
+
+with open('main/charset.c', 'w') as f:
+    f.write(HEADER_COMMENT % 'charset.c')
+    f.write('\n#include "charset.h"\n#include <stddef.h>\n\n\n')
+
+    f.write('const char *const charset_morse[256] = {\n')
+    for c in range(256):
+        if morse[c]:
+            f.write('    [0x%02x] = %s,\n' % (c, c_string(morse[c])))
+    f.write('};\n\n\n')
+
+    for name, table in (('latin', latin), ('cyrillic', cyrillic), ('kana', kana), ('punctuation', punctuation)):
+        f.write('const uint16_t charset_%s[] = {\n%s\n};\n\n\n' % (name, c_table(table)))
+
+    f.write('const charset_prosign_t charset_prosigns[] = {\n')
+    for name, code in prosigns.items():
+        f.write('    { .name = "%s", .code = 0x%02x },\n' % (name, code))
+    f.write('};\n\n')
+    f.write('const unsigned charset_prosign_num = sizeof(charset_prosigns) / sizeof(charset_prosigns[0]);\n')
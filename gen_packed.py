@@ -0,0 +1,222 @@
+#!/usr/bin/env python3
+"""
+Generates tables of the compressed text of the letter command (main/packed.c, main/packed.h and transmitter/packed.js).
+
+The compressed text is the stream of Huffman codes of 64 symbols: playable ASCII characters (the receiver converts upper
+case letters to lower case, so only lower case letters are in the alphabet), brackets of prosigns, words of the static
+dictionary and the escape, which is followed by one raw byte (other characters are escaped byte by byte in UTF-8).
+Lengths of codes are computed from frequencies of symbols in the training text below. Codes are canonical, so the
+receiver needs only the number of codes of every length and symbols sorted by codes.
+
+Usage: ./gen_packed.py (run it from the root of the repository after changing the alphabet or the training text)
+
+Author: Vojtěch Dvořák (xdvora3o)
+Date: 2022-12-12
+"""
+
+import heapq
+from collections import Counter
+
+SYMBOL_NUM = 64 #< Size of the alphabet (including words of the dictionary and the escape)
+MAX_CODE_LEN = 16 #< Codes must fit to uint16_t of the decoder
+MIN_LONGEST_CODE_LEN = 8 #< Padding (up to 7 bits of ones) must not complete any code
+
+# Playable ASCII characters (see ASCII in gen_charset.py) and brackets of prosigns
+ALPHABET = ' etaoinshrdlcumwfgypbvkjxqz0123456789.,?/=+-\'()":;@!&_$<>'
+
+DICTIONARY_LEN = (2, 5) #< Minimum and maximum length of words in the dictionary (with the following space)
+
+# Typical traffic of the receiver (CW contacts, short messages and plain English text)
+TRAINING = """
+cq cq cq de ok1abc ok1abc k
+ok1abc de dl2xyz dl2xyz k
+dl2xyz de ok1abc ge om tnx fer call ur rst 599 599 name is jan jan qth brno brno hw? dl2xyz de ok1abc k
+ok1abc de dl2xyz r r ge jan tnx fer rprt ur rst 579 579 name is hans hans qth berlin berlin <bk>
+rig here is ic7300 pwr 100w ant is dipole wx here is sunny temp 20c
+tnx fer nice qso jan hpe cuagn 73 es gl <sk> ok1abc de dl2xyz tu ee
+73 tu <sk>
+cq test cq test de ok1abc ok1abc test
+dl2xyz 5nn 14 tu ok1abc test
+ok1abc de g3xyz ur 5nn 599 tu 73
+qrz? de ok1abc k
+qsl via bureau pse qsl tnx
+the quick brown fox jumps over the lazy dog.
+meet me at the station at 10:30, bring the radio and the spare batteries.
+the weather is fine, the wind is calm and the sky is clear.
+we will start the test at noon, please be ready and listen on the frequency.
+all stations, this is the net control station. please check in now.
+message received, will call you back in five minutes.
+the meeting is moved to friday at 18:00 in the club room.
+sos sos sos de ok1abc position 49.19n 16.61e <ar>
+qth is near the river, antenna is on the roof of the house.
+i am going to the hills this weekend, i will be qrv on 7.030 mhz.
+thank you for the contact and see you again on the band.
+the signal is weak, please send it again and use the second frequency.
+there is no traffic for the net tonight, the next net is on monday.
+"""
+
+
+def tokenize(text, dictionary):
+    """Splits the text to symbols (the longest word of the dictionary is preferred), yields pairs of the symbol and
+    its text (the symbol is None, if the character is escaped)"""
+    i = 0
+    while i < len(text):
+        word = next((w for w in sorted(dictionary, key=len, reverse=True) if text.startswith(w, i)), None)
+        if word:
+            yield word, word
+            i += len(word)
+        elif text[i] in ALPHABET:
+            yield text[i], text[i]
+            i += 1
+        else:
+            yield None, text[i]
+            i += 1
+
+
+def train_dictionary(text, size):
+    """Selects words, that save the most bits (words with the following space are preferred)"""
+    candidates = Counter()
+    for word in text.split():
+        for w in (word + ' ', word):
+            if DICTIONARY_LEN[0] <= len(w) <= DICTIONARY_LEN[1] and all(c in ALPHABET for c in w):
+                candidates[w] += text.count(w) * (len(w) - 1)
+                break
+
+    return [w for w, _ in candidates.most_common(size)]
+
+
+def code_lengths(freqs):
+    """Computes lengths of Huffman codes of symbols"""
+    heap = [(f, i, [i]) for i, f in enumerate(freqs)]
+    heapq.heapify(heap)
+    lengths = [0] * len(freqs)
+    order = len(freqs)
+
+    while len(heap) > 1:
+        f1, _, s1 = heapq.heappop(heap)
+        f2, _, s2 = heapq.heappop(heap)
+        for s in s1 + s2:
+            lengths[s] += 1
+
+        heapq.heappush(heap, (f1 + f2, order, s1 + s2))
+        order += 1
+
+    return lengths
+
+
+text = TRAINING.lower()
+dictionary = train_dictionary(text, SYMBOL_NUM - len(ALPHABET) - 1)
+symbols = list(ALPHABET) + dictionary + [None] #< None is the escape
+
+counts = Counter(s for s, _ in tokenize(text, dictionary))
+lengths = code_lengths([counts[s] + 1 for s in symbols]) #< Every symbol needs a code
+assert len(symbols) == SYMBOL_NUM
+assert MIN_LONGEST_CODE_LEN <= max(lengths) <= MAX_CODE_LEN, max(lengths)
+
+# Canonical codes (sorted by length and then by the order in the alphabet)
+order = sorted(range(SYMBOL_NUM), key=lambda s: (lengths[s], s))
+codes = [0] * SYMBOL_NUM
+code, prev_len = 0, 0
+for s in order:
+    code <<= lengths[s] - prev_len
+    codes[s] = code
+    prev_len = lengths[s]
+    code += 1
+
+count = [0] * (MAX_CODE_LEN + 1)
+for s in range(SYMBOL_NUM):
+    count[lengths[s]] += 1
+
+first = [0] * (MAX_CODE_LEN + 1) #< The first code of every length
+offset = [0] * (MAX_CODE_LEN + 1) #< Index of the first symbol of every length in sorted symbols
+code = index = 0
+for length in range(1, MAX_CODE_LEN + 1):
+    code <<= 1
+    first[length], offset[length] = code, index
+    code += count[length]
+    index += count[length]
+
+escape = order.index(symbols.index(None))
+max_symbol_len = max(len(s) for s in symbols if s)
+
+plain_bits = len(text.encode()) * 8
+packed_bits = sum((lengths[-1] + 8) * len(t.encode()) if s is None else lengths[symbols.index(s)]
+                  for s, t in tokenize(text, dictionary))
+print('Dictionary: %s' % dictionary)
+print('Training text: %d B plain, approximately %d B packed' % (plain_bits // 8, packed_bits // 8))
+
+
+def c_string(value):
+    return '"%s"' % value.replace('\\', '\\\\').replace('"', '\\"') if value is not None else 'NULL'
+
+
+def js_string(value):
+    return "'%s'" % value.replace('\\', '\\\\').replace("'", "\\'") if value is not None else 'null'
+
+
+def c_table(values, per_line=16):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append('    ' + ' '.join('%d,' % v for v in values[i:i + per_line]))
+    return '\n'.join(lines)
+
+
+HEADER_COMMENT = """/**
+ * @file %s
+ *
+ * @brief Tables of the compressed text of the letter command (GENERATED by gen_packed.py, do not edit it manually!)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+"""
+
+with open('main/packed.h', 'w') as f:
+    f.write(HEADER_COMMENT % 'packed.h')
+    f.write("""
+#ifndef __PACKED__
+#define __PACKED__
+
+#include <stdint.h>
+
+
+#define PACKED_SYMBOL_NUM %d //< Number of symbols (characters, words of the dictionary and the escape)
+#define PACKED_MAX_CODE_LEN %d //< Maximum length of the code in bits
+#define PACKED_MAX_SYMBOL_LEN %d //< Maximum number of characters of one symbol
+#define PACKED_ESCAPE %d //< Index of the escape in sorted symbols (it is followed by one raw byte)
+#define PACKED_RAW_BITS 8 //< Length of the escaped byte
+
+
+extern const uint8_t packed_count[PACKED_MAX_CODE_LEN + 1]; //< Number of codes of every length
+extern const uint16_t packed_first[PACKED_MAX_CODE_LEN + 1]; //< The first code of every length
+extern const uint8_t packed_offset[PACKED_MAX_CODE_LEN + 1]; //< Index of the first symbol of every length in packed_symbols
+extern const char *const packed_symbols[PACKED_SYMBOL_NUM]; //< Symbols sorted by codes (NULL is the escape)
+
+#endif
+""" % (SYMBOL_NUM, max(lengths), max_symbol_len, escape))
+
+with open('main/packed.c', 'w') as f:
+    f.write(HEADER_COMMENT % 'packed.c')
+    f.write('\n#include "packed.h"\n#include <stddef.h>\n\n\n')
+
+    for name, ctype, table in (('count', 'uint8_t', count), ('first', 'uint16_t', first), ('offset', 'uint8_t', offset)):
+        f.write('const %s packed_%s[PACKED_MAX_CODE_LEN + 1] = {\n%s\n};\n\n\n' % (ctype, name, c_table(table[:max(lengths) + 1])))
+
+    f.write('const char *const packed_symbols[PACKED_SYMBOL_NUM] = {\n')
+    for s in order:
+        f.write('    %s, //< %s\n' % (c_string(symbols[s]), format(codes[s], '0%db' % lengths[s])))
+    f.write('};\n')
+
+with open('transmitter/packed.js', 'w', newline='\r\n') as f:
+    f.write("""/**
+ * Tables of the compressed text of the letter command (GENERATED by gen_packed.py, do not edit it manually!)
+ * @author Vojtech Dvorak (xdvora3o)
+ */
+
+const packedMaxSymbolLen = %d; //Words of the dictionary are matched up to this length
+
+//Codes of symbols [code, length in bits], null is the escape (it is followed by one raw byte of UTF-8)
+const packedCodes = new Map([
+%s
+]);
+""" % (max_symbol_len, '\n'.join('    [%s, [0x%04x, %d]],' % (js_string(symbols[s]), codes[s], lengths[s]) for s in order)))
@@ -0,0 +1,227 @@
+/**
+ * @file beacon.c
+ *
+ * @brief Beacon mode (the stored macro is repeated autonomously with given interval)
+ *
+ * Macro is compiled when it is stored, so the beacon only passes one item to the letter queue for every transmission.
+ * Out control timer is paused after the transmission and between transmissions the task sleeps (with POWER_MANAGEMENT
+ * the chip enters automatic light sleep meanwhile).
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "beacon.h"
+#include "dlog.h"
+
+
+static nvs_handle_t beacon_nvs;
+static bool (*push_item)(const char *) = NULL;
+
+static beacon_config_t config = { .macro_id = BEACON_OFF };
+static portMUX_TYPE config_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t config_version = 0; //< Incremented by every change of the configuration (notifications come also from the pipeline)
+
+static TaskHandle_t beacon_handle = NULL;
+
+
+/**
+ * @brief Stores the configuration of the beacon to NVS
+ *
+ * @param cfg Configuration
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+static esp_err_t beacon_store(const beacon_config_t *cfg) {
+    esp_err_t err = nvs_set_blob(beacon_nvs, BEACON_NVS_KEY, cfg, sizeof(beacon_config_t));
+    if(err == ESP_OK) {
+        err = nvs_commit(beacon_nvs);
+    }
+
+    if(err != ESP_OK) {
+        ESP_LOGE(BEACON_TAG, "Storing of beacon configuration failed! (0x%x)", err);
+    }
+
+    return err;
+}
+
+
+esp_err_t beacon_configure(uint8_t macro_id, uint16_t interval_s, uint16_t count) {
+    beacon_config_t new_config = {
+        .macro_id = macro_id,
+        .interval_s = interval_s,
+        .count = count,
+        .sent = 0,
+    };
+
+    if(macro_id != BEACON_OFF && !macro_exists(macro_id)) {
+        ESP_LOGE(BEACON_TAG, "Macro %u does not exist!", macro_id);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    portENTER_CRITICAL(&config_lock);
+    config = new_config;
+    config_version++;
+    portEXIT_CRITICAL(&config_lock);
+
+    ESP_LOGI(BEACON_TAG, "Beacon configured (macro %u, interval %u s, count %u)", macro_id, interval_s, count);
+
+    if(beacon_handle) {
+        xTaskNotifyGive(beacon_handle);
+    }
+
+    return beacon_store(&new_config);
+}
+
+
+void beacon_macro_deleted(uint8_t macro_id) {
+    portENTER_CRITICAL(&config_lock);
+    bool used = config.macro_id == macro_id;
+    portEXIT_CRITICAL(&config_lock);
+
+    if(used) { //Beacon would push the missing macro again and again
+        ESP_LOGI(BEACON_TAG, "Macro %u of the beacon was deleted, turning the beacon off", macro_id);
+        beacon_configure(BEACON_OFF, 0, 0);
+    }
+}
+
+
+/**
+ * @brief Checks if the configuration was changed
+ *
+ * @param version Version of the configuration known by the task
+ * @return true if configuration was changed
+ */
+static bool beacon_changed(uint32_t version) {
+    portENTER_CRITICAL(&config_lock);
+    bool changed = config_version != version;
+    portEXIT_CRITICAL(&config_lock);
+
+    return changed;
+}
+
+
+/**
+ * @brief Waits for the given time (the task is blocked, so the chip can enter automatic light sleep with
+ * POWER_MANAGEMENT), configuration change interrupts waiting
+ *
+ * @param ms Time to wait
+ * @param version Version of the configuration known by the task
+ * @return true if configuration was changed
+ */
+static bool beacon_wait(uint32_t ms, uint32_t version) {
+    TickType_t start = xTaskGetTickCount();
+    TickType_t ticks = pdMS_TO_TICKS(ms);
+
+    while(!beacon_changed(version)) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if(elapsed >= ticks) {
+            return false;
+        }
+
+        ulTaskNotifyTake(pdTRUE, ticks - elapsed); //Notifications of the idle pipeline only check the configuration
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Waits for the end of the transmission, the task is notified by the translator and the output ISR when they
+ * become idle (configuration change interrupts waiting)
+ *
+ * @param version Version of the configuration known by the task
+ * @return true if configuration was changed
+ */
+static bool beacon_wait_idle(uint32_t version) {
+    while(!beacon_changed(version)) {
+        //Translator is checked first, it passes the item to the output before it becomes idle
+        if(translator_is_idle() && output_is_idle()) {
+            return false;
+        }
+
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Task that passes the macro to the letter queue, waits for the end of the transmission and then waits
+ * for the interval
+ *
+ * @param arg
+ */
+static void beacon_task(void *arg) {
+    char item[LETTER_ITEM_SIZE] = { 0 };
+    beacon_config_t cfg;
+    uint32_t version;
+
+    output_idle_waiter = xTaskGetCurrentTaskHandle(); //The end of every transmission is notified
+
+    while(1) {
+        portENTER_CRITICAL(&config_lock);
+        cfg = config;
+        version = config_version;
+        portEXIT_CRITICAL(&config_lock);
+
+        if(cfg.macro_id == BEACON_OFF || (cfg.count && cfg.sent >= cfg.count)) { //Wait for the new configuration
+            while(!beacon_changed(version)) {
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            }
+            continue;
+        }
+
+        item[0] = MACRO_ITEM(cfg.macro_id);
+        if(!push_item(item)) { //Queue is full, try it later
+            beacon_wait(BEACON_RETRY_MS, version);
+            continue;
+        }
+
+        DLOGI(BEACON_TAG, "Transmission %u started", cfg.sent + 1);
+
+        if(cfg.count) { //Remaining count must survive reset
+            bool changed;
+
+            portENTER_CRITICAL(&config_lock);
+            changed = config.macro_id != cfg.macro_id;
+            if(!changed) {
+                config.sent = ++cfg.sent;
+            }
+            portEXIT_CRITICAL(&config_lock);
+
+            if(!changed) {
+                beacon_store(&cfg);
+            }
+        }
+
+        if(!beacon_wait_idle(version)) { //New configuration is applied immediately
+            beacon_wait((uint32_t)cfg.interval_s * 1000, version);
+        }
+    }
+}
+
+
+esp_err_t beacon_init(nvs_handle_t nvs, bool (*push)(const char *)) {
+    beacon_config_t stored;
+    size_t size = sizeof(stored);
+
+    beacon_nvs = nvs;
+    push_item = push;
+
+    if(nvs_get_blob(beacon_nvs, BEACON_NVS_KEY, &stored, &size) == ESP_OK && size == sizeof(stored)) {
+        config = stored;
+
+        if(config.macro_id != BEACON_OFF && !macro_exists(config.macro_id)) {
+            ESP_LOGE(BEACON_TAG, "Macro %u of the beacon does not exist!", config.macro_id);
+            config.macro_id = BEACON_OFF;
+        }
+    }
+
+    ESP_LOGI(BEACON_TAG, "Beacon %s (macro %u, interval %u s, sent %u/%u)", config.macro_id == BEACON_OFF ? "off" : "on",
+        config.macro_id, config.interval_s, config.sent, config.count);
+
+    xTaskCreatePinnedToCore(beacon_task, "beacon", 3072, NULL, 3, &beacon_handle, 0);
+
+    return ESP_OK;
+}
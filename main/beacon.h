@@ -0,0 +1,76 @@
+/**
+ * @file beacon.h
+ *
+ * @brief Beacon mode (the stored macro is repeated autonomously with given interval)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __BEACON__
+#define __BEACON__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "translator.h"
+#include "output.h"
+#include "macro.h"
+
+
+#define BEACON_TAG "BEACON" //< Module name
+
+#define BEACON_NVS_KEY "beacon" //< Configuration of the beacon is stored in settings NVS
+#define BEACON_OFF 0xff //< Id of macro that turns the beacon off
+
+#define BEACON_RETRY_MS 1000 //< Delay of the next attempt when the letter queue is full
+
+
+/**
+ * @brief Configuration of the beacon (stored in NVS)
+ *
+ */
+typedef struct beacon_config {
+    uint8_t macro_id; //< Repeated macro or BEACON_OFF
+    uint16_t interval_s; //< Pause between the end of the transmission and the start of the next one
+    uint16_t count; //< Number of transmissions (0 means forever)
+    uint16_t sent; //< Number of already sent transmissions
+} beacon_config_t;
+
+
+/**
+ * @brief Changes the configuration of the beacon (and stores it)
+ *
+ * @param macro_id Repeated macro or BEACON_OFF
+ * @param interval_s Pause between transmissions in seconds
+ * @param count Number of transmissions (0 means forever)
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t beacon_configure(uint8_t macro_id, uint16_t interval_s, uint16_t count);
+
+
+/**
+ * @brief Turns the beacon off (and stores it) if it repeats the deleted macro
+ *
+ * @param macro_id Deleted macro
+ */
+void beacon_macro_deleted(uint8_t macro_id);
+
+
+/**
+ * @brief Restores the configuration of the beacon and starts its task
+ *
+ * @param nvs Handle of NVS, where the configuration is stored
+ * @param push Function that passes the item to the letter queue
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t beacon_init(nvs_handle_t nvs, bool (*push)(const char *));
+
+#endif
@@ -0,0 +1,230 @@
+/**
+ * @file bench.c
+ *
+ * @brief Benchmark of the timing accuracy of the output engine (edges of the primary buzzer are timestamped in the
+ * output ISR and compared with the ideal timing of PARIS words at the configured speed)
+ *
+ * Every interval between two edges should take whole number of dots, so the deviation of the interval is its distance
+ * from the nearest multiple of the length of the dot. Effective WPM is computed from the sum of these multiples
+ * (PARIS word has 50 dots) and the measured duration of the intervals.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "bench.h"
+#include "esp_timer.h"
+#include "output.h"
+
+
+#define BENCH_PARIS_UNITS 50 //< Length of PARIS word in dots (including the space between words)
+
+
+static transport_cmd_handler_t handler = NULL;
+static transport_t bench_transport = { .queue_wait = portMAX_DELAY }; //< State of the stream of generated commands
+
+static volatile uint32_t edges[BENCH_EDGE_NUM]; //< Timestamps (in us) of edges of the buzzer
+static volatile size_t edge_num = 0;
+static volatile bool capturing = false;
+static bool buzzer_state = false; //< State of the buzzer after the last edge
+
+static int32_t deviations[BENCH_EDGE_NUM]; //< Absolute deviations of intervals (used only by the benchmark task)
+
+static volatile bool load = false; //< Write storm and CPU hogs run
+static portMUX_TYPE hog_locks[portNUM_PROCESSORS];
+
+
+/**
+ * @brief Phases of the benchmark
+ *
+ */
+static const struct {
+    const char *name;
+    bool load;
+} phases[] = {
+    { "idle", false },
+    { "load", true },
+};
+
+
+void IRAM_ATTR bench_edge(uint8_t ch, bool on) {
+    if(ch != 0 || on == buzzer_state) {
+        return;
+    }
+
+    buzzer_state = on;
+    if(capturing && edge_num < BENCH_EDGE_NUM) {
+        edges[edge_num++] = (uint32_t)esp_timer_get_time();
+    }
+}
+
+
+/**
+ * @brief Comparison of deviations for qsort
+ *
+ * @param a
+ * @param b
+ * @return int
+ */
+static int bench_compare(const void *a, const void *b) {
+    int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+
+/**
+ * @brief Returns the percentile of sorted deviations
+ *
+ * @param n Number of deviations
+ * @param p Percentile (0-100)
+ * @return int32_t Deviation in us
+ */
+static int32_t bench_percentile(size_t n, unsigned p) {
+    return n ? deviations[(n - 1) * p / 100] : 0;
+}
+
+
+/**
+ * @brief Evaluates captured edges and prints the report of the phase
+ *
+ * @param phase Name of the phase
+ */
+static void bench_report(const char *phase) {
+    uint32_t unit_us = output_unit_ms() * 1000;
+    uint64_t units = 0, measured_us = 0;
+    int64_t deviation_sum = 0;
+    size_t n = 0;
+
+    for(size_t i = 1; i < edge_num; i++) {
+        uint32_t interval = edges[i] - edges[i - 1];
+        uint32_t interval_units = (interval + unit_us / 2) / unit_us;
+        if(!interval_units) {
+            interval_units = 1;
+        }
+
+        if(interval_units > BENCH_MAX_INTERVAL_UNITS) { //Nothing was played (e. g. letters were rejected)
+            continue;
+        }
+
+        int32_t deviation = (int32_t)interval - (int32_t)(interval_units * unit_us);
+        deviations[n++] = deviation < 0 ? -deviation : deviation;
+        deviation_sum += deviation;
+
+        units += interval_units;
+        measured_us += interval;
+    }
+
+    qsort(deviations, n, sizeof(deviations[0]), bench_compare);
+
+    double effective_wpm = measured_us ? (double)units / BENCH_PARIS_UNITS * 60e6 / measured_us : 0;
+
+    printf(BENCH_REPORT_PREFIX "{\"phase\":\"%s\",\"wpm\":%u,\"unit_us\":%lu,\"edges\":%u,\"intervals\":%u,"
+        "\"dev_mean_us\":%ld,\"dev_p50_us\":%ld,\"dev_p90_us\":%ld,\"dev_p99_us\":%ld,\"dev_max_us\":%ld,"
+        "\"effective_wpm\":%.2f}\n",
+        phase, output_get_wpm(), (unsigned long)unit_us, (unsigned)edge_num, (unsigned)n,
+        (long)(n ? deviation_sum / (int64_t)n : 0), (long)bench_percentile(n, 50), (long)bench_percentile(n, 90),
+        (long)bench_percentile(n, 99), (long)bench_percentile(n, 100), effective_wpm
+    );
+}
+
+
+/**
+ * @brief Writes PARIS words (with the load every letter is written separately as fast as backpressure allows)
+ *
+ * @param arg
+ */
+static void bench_feed(void *arg) {
+    static const uint8_t word[] = "PARIS ";
+    size_t letter = 0;
+
+    while(1) {
+        uint32_t backlog_ms = output_backlog_ms();
+
+        //Translator has higher priority, so the yield passes the written letters to the output before the next check
+        if(load && backlog_ms < BENCH_STORM_BACKLOG_MS) { //Write storm
+            handler(&bench_transport, LETTER_CMD, &word[letter], 1);
+            letter = (letter + 1) % (sizeof(word) - 1);
+            taskYIELD();
+        }
+        else if(!load && backlog_ms < BENCH_BACKLOG_MS) {
+            handler(&bench_transport, LETTER_CMD, word, sizeof(word) - 1);
+            taskYIELD();
+        }
+        else {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+    }
+}
+
+
+/**
+ * @brief Occupies the core (also with disabled interrupts for a while) during the load phase
+ *
+ * @param arg Index of the core
+ */
+static void bench_hog(void *arg) {
+    portMUX_TYPE *lock = &hog_locks[(uintptr_t)arg];
+
+    while(1) {
+        if(!load) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        int64_t end = esp_timer_get_time() + BENCH_HOG_BUSY_MS * 1000;
+
+        portENTER_CRITICAL(lock);
+        int64_t critical_end = esp_timer_get_time() + BENCH_HOG_CRITICAL_US;
+        while(esp_timer_get_time() < critical_end);
+        portEXIT_CRITICAL(lock);
+
+        while(esp_timer_get_time() < end);
+
+        vTaskDelay(1);
+    }
+}
+
+
+/**
+ * @brief Runs phases of the benchmark and reports their results
+ *
+ * @param arg
+ */
+static void bench_task(void *arg) {
+    while(1) {
+        for(size_t i = 0; i < sizeof(phases) / sizeof(phases[0]); i++) {
+            DLOGI(BENCH_TAG, "Phase %s started", phases[i].name);
+
+            edge_num = 0;
+            capturing = true;
+            load = phases[i].load;
+
+            vTaskDelay(pdMS_TO_TICKS(BENCH_PHASE_MS));
+
+            load = false;
+            capturing = false;
+
+            handler(&bench_transport, ABORT_CMD, NULL, 0); //Backlog of the phase is not played in the next one
+
+            bench_report(phases[i].name);
+        }
+    }
+}
+
+
+esp_err_t bench_init(transport_cmd_handler_t cmd_handler) {
+    handler = cmd_handler;
+
+    for(int core = 0; core < BENCH_HOG_CORES; core++) {
+        portMUX_INITIALIZE(&hog_locks[core]);
+        xTaskCreatePinnedToCore(bench_hog, "bench_hog", 2048, (void *)(uintptr_t)core, BENCH_HOG_PRIORITY, NULL, core);
+    }
+
+    xTaskCreatePinnedToCore(bench_feed, "bench_feed", 3072, NULL, 5, NULL, 0);
+    xTaskCreatePinnedToCore(bench_task, "bench", 4096, NULL, 6, NULL, 1);
+
+    ESP_LOGI(BENCH_TAG, "Timing benchmark started (%d ms per phase)", BENCH_PHASE_MS);
+
+    return ESP_OK;
+}
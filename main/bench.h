@@ -0,0 +1,69 @@
+/**
+ * @file bench.h
+ *
+ * @brief Benchmark of the timing accuracy of the output engine (edges of the primary buzzer are timestamped in the
+ * output ISR and compared with the ideal timing of PARIS words at the configured speed)
+ *
+ * Every phase plays PARIS words for BENCH_PHASE_MS, the second phase runs with the write storm (every letter is one
+ * write of the letter command) and CPU hogs on both cores. Result of every phase is printed to the console as one line
+ * "BENCH_REPORT {...}" with JSON object, so results of different builds can be compared by scripts.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __BENCH__
+#define __BENCH__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+
+#include "dlog.h"
+#include "transport.h"
+
+
+#define BENCH_TAG "BENCH" //< Module name
+
+// #define TIMING_BENCH //< Builds the benchmark firmware (messages are generated by the benchmark itself)
+
+#define BENCH_PHASE_MS 60000 //< Duration of one phase of the benchmark
+#define BENCH_EDGE_NUM 2048 //< Maximum number of captured edges in one phase
+#define BENCH_MAX_INTERVAL_UNITS 10 //< Longer intervals (the queue was empty) are not measured
+#define BENCH_BACKLOG_MS 2000 //< Words are written only when backlog is shorter (without the write storm)
+#define BENCH_STORM_BACKLOG_MS 10000 //< Write storm pauses when backlog is longer (spool would only reject the letters)
+
+#define BENCH_HOG_PRIORITY 4 //< Priority of CPU hogs (lower than translator and transports)
+#define BENCH_HOG_BUSY_MS 8 //< Hog spins for this time and then it yields for one tick (so watchdog is fed)
+#define BENCH_HOG_CRITICAL_US 200 //< Part of spinning is done in critical section (as flash writes or radio do)
+
+#ifndef BENCH_HOG_CORES
+#define BENCH_HOG_CORES portNUM_PROCESSORS //< Hogs run on cores below this number (the host build has none, it has no real cores)
+#endif
+
+#define BENCH_REPORT_PREFIX "BENCH_REPORT " //< Prefix of lines with results
+
+
+/**
+ * @brief Stores the edge of the buzzer of the channel (it is called by the output ISR for every played interval)
+ *
+ * @param ch Index of the channel (only the primary channel is measured)
+ * @param on New state of the buzzer
+ */
+void bench_edge(uint8_t ch, bool on);
+
+
+/**
+ * @brief Starts the task of the benchmark, its feeder of messages and CPU hogs
+ *
+ * @param cmd_handler Handler of commands, that is used for writing of messages (as by transports)
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t bench_init(transport_cmd_handler_t cmd_handler);
+
+#endif
@@ -0,0 +1,99 @@
+/**
+ * @file ble_common.c
+ *
+ * @brief Part of the bluetooth (BLE) module that is shared by all BLE host backends
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "ble_receiver.h"
+#include "esp_timer.h"
+
+
+/**
+ * @brief Tab with charcteric handles
+ *
+ */
+uint16_t morse_code_char_handle_tab[MORSE_CODE_REC_CHAR_NUM];
+
+
+ble_stats_t ble_stats = { 0 };
+
+
+static void (*write_event_handler)(ble_write_evt_t *) = NULL;
+static void (*add_char_cb)(uint16_t) = NULL;
+
+
+void ble_register_callbacks(void (*write_event_handler_func)(ble_write_evt_t *), void (*add_char_cb_func)(uint16_t)) {
+    write_event_handler = write_event_handler_func;
+    add_char_cb = add_char_cb_func;
+}
+
+
+void ble_dispatch_write(ble_write_evt_t *evt) {
+    int64_t now = esp_timer_get_time();
+
+    if(ble_stats.writes == 0) {
+        ble_stats.first_write_us = now;
+    }
+
+    ble_stats.writes++;
+    ble_stats.bytes_written += evt->len;
+    ble_stats.last_write_us = now;
+
+    if(write_event_handler) {
+        write_event_handler(evt);
+    }
+}
+
+
+void ble_dispatch_add_char(uint16_t char_handle) {
+    if(add_char_cb != NULL) { //Calling custom add_char callback (e. g. for initialization of the char val)
+        add_char_cb(char_handle);
+    }
+}
+
+
+void ble_stats_reset_throughput() {
+    ble_stats.writes = 0;
+    ble_stats.bytes_written = 0;
+    ble_stats.first_write_us = 0;
+    ble_stats.last_write_us = 0;
+    ble_stats.mtu = 23;
+    ble_stats.tx_octets = 27;
+    ble_stats.rx_octets = 27;
+    ble_stats.tx_phy = 1;
+    ble_stats.rx_phy = 1;
+}
+
+
+void ble_log_stats() {
+    ESP_LOGI(MODULE_TAG, "%s: init=%lld us, adv_ready=%lld us, heap_used=%lu B",
+        BLE_BACKEND_NAME,
+        ble_stats.init_done_us - ble_stats.init_start_us,
+        ble_stats.adv_ready_us ? ble_stats.adv_ready_us - ble_stats.init_start_us : -1,
+        (unsigned long)(ble_stats.heap_before - ble_stats.heap_after)
+    );
+
+    int64_t write_time_us = ble_stats.last_write_us - ble_stats.first_write_us;
+    if(ble_stats.writes > 1 && write_time_us > 0) {
+        ESP_LOGI(MODULE_TAG, "%s: writes=%lu, bytes=%lu, throughput=%lld B/s",
+            BLE_BACKEND_NAME,
+            (unsigned long)ble_stats.writes,
+            (unsigned long)ble_stats.bytes_written,
+            (int64_t)ble_stats.bytes_written * 1000000 / write_time_us
+        );
+    }
+
+    if(ble_stats.mtu) { //< There was at least one connection
+        ESP_LOGI(MODULE_TAG, "%s: mtu=%u, data_len tx=%u rx=%u B, phy tx=%u rx=%u",
+            BLE_BACKEND_NAME,
+            ble_stats.mtu,
+            ble_stats.tx_octets,
+            ble_stats.rx_octets,
+            ble_stats.tx_phy,
+            ble_stats.rx_phy
+        );
+    }
+}
@@ -8,23 +8,63 @@
  */
 
 #include "ble_receiver.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "esp_bt_device.h"
+#include "esp_gap_ble_api.h"
+#include "esp_gattc_api.h"
+#include "esp_gatts_api.h"
+#include "esp_gatt_common_api.h"
+
+
+/**
+ * @brief Profile indexes
+ *
+ */
+enum profiles {
+    MORSE_CODE_RECEIVER_ID,
+    PROFILE_NUM,
+};
 
 
 /**
- * @brief Tab with charcteric handles
+ * @brief Element of GATT profile table
  *
  */
-uint16_t morse_code_char_handle_tab[MORSE_CODE_REC_CHAR_NUM];
+struct gatts_profile_inst {
+    esp_gatts_cb_t gatts_cb;
+    uint16_t gatts_if;
+    uint16_t app_id;
+    uint16_t conn_id;
+    uint16_t service_handle;
+    esp_gatt_srvc_id_t service_id;
+    uint16_t char_handle;
+    uint16_t *char_handle_tab;
+    esp_bt_uuid_t char_uuid;
+    esp_gatt_perm_t perm;
+    esp_gatt_char_prop_t property;
+    uint16_t descr_handle;
+    esp_bt_uuid_t descr_uuid;
+};
 
 
-static void (*write_event_handler)(esp_ble_gatts_cb_param_t *) = NULL;
-static void (*add_char_cb)(uint16_t) = NULL;
+/**
+ * @brief Handling function of morse code app that operates on this GATT server
+ *
+ * @param evt incoming event
+ * @param gatts_if GATTS interface
+ * @param param event parameters
+ */
+void gatts_profile_morse_code_event_handler(esp_gatts_cb_event_t evt, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
 
 
 //Based on https://github.com/espressif/esp-idf/blob/master/examples/bluetooth/bluedroid/ble/gatt_server/tutorial/Gatt_Server_Example_Walkthrough.md
 
-static esp_gatt_char_prop_t morse_code_letter_properties = ESP_GATT_CHAR_PROP_BIT_WRITE; //< Just hint for client what actions he is able to do with characteristic
-static esp_gatt_perm_t morse_code_letter_permissions = ESP_GATT_PERM_WRITE; //< The GATT server will reject read event of morse code message characteristic
+static esp_gatt_char_prop_t morse_code_letter_properties = ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_READ; //< Just hint for client what actions he is able to do with characteristic
+static esp_gatt_perm_t morse_code_letter_permissions = ESP_GATT_PERM_WRITE | ESP_GATT_PERM_READ; //< Client reads capability flags of the receiver from morse code message characteristic
 
 
 static esp_gatt_char_prop_t morse_code_vol_properties = ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_READ; //< Just hint for client what actions he is able to do with characteristic
@@ -33,8 +73,27 @@ static esp_gatt_perm_t morse_code_vol_permissions = ESP_GATT_PERM_WRITE | ESP_GA
 static esp_gatt_char_prop_t morse_code_abort_properties = ESP_GATT_CHAR_PROP_BIT_WRITE; //< Just hint for client what actions he is able to do with characteristic
 static esp_gatt_perm_t morse_code_abort_permissions = ESP_GATT_PERM_WRITE; //< The GATT server will reject read event of morse code message characteristic
 
+static esp_gatt_char_prop_t morse_code_decoded_properties = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_NOTIFY; //< Just hint for client what actions he is able to do with characteristic
+static esp_gatt_perm_t morse_code_decoded_permissions = ESP_GATT_PERM_READ; //< The GATT server will reject write event of decoded text characteristic
+static esp_gatt_char_prop_t morse_code_macro_properties = ESP_GATT_CHAR_PROP_BIT_WRITE; //< Just hint for client what actions he is able to do with characteristic
+static esp_gatt_perm_t morse_code_macro_permissions = ESP_GATT_PERM_WRITE; //< The GATT server will reject read event of macro characteristic
+static esp_gatt_char_prop_t morse_code_speed_properties = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_NOTIFY; //< Just hint for client what actions he is able to do with characteristic
+static esp_gatt_perm_t morse_code_speed_permissions = ESP_GATT_PERM_READ; //< The GATT server will reject write event of speed characteristic
+static esp_gatt_char_prop_t morse_code_dropped_properties = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_NOTIFY; //< Just hint for client what actions he is able to do with characteristic
+static esp_gatt_perm_t morse_code_dropped_permissions = ESP_GATT_PERM_READ; //< The GATT server will reject write event of dropped characteristic
+
+static esp_gatt_perm_t morse_code_cccd_permissions = ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE; //< Client must be able to subscribe to notifications
+
+
+static bool is_connected = false; //< Is there any connected client?
+static bool notify_enabled[MORSE_CODE_REC_CHAR_NUM]; //< Is the client subscribed to notifications of the characteristic?
+static uint16_t cccd_handle_tab[MORSE_CODE_REC_CHAR_NUM]; //< Handles of client configuration descriptors (0 if characteristic does not have it)
 
-struct gatts_profile_inst profile_tab[PROFILE_NUM] = { //< Table with all provided profiles of this GATT server
+static enum morse_code_rec_chars descr_owner_tab[MORSE_CODE_REC_CHAR_NUM]; //< Characteristics in order in which their descriptors were requested
+static int descr_requested = 0, descr_added = 0;
+
+
+static struct gatts_profile_inst profile_tab[PROFILE_NUM] = { //< Table with all provided profiles of this GATT server
     [MORSE_CODE_RECEIVER_ID] = {
         .gatts_cb = gatts_profile_morse_code_event_handler,
         .gatts_if = ESP_GATT_IF_NONE,
@@ -43,10 +102,10 @@ struct gatts_profile_inst profile_tab[PROFILE_NUM] = { //< Table with all provid
 };
 
 
-//Following attribute value is not used - there is queue instead
+//Following attribute value is not used for letters - there is queue instead, client reads capability flags from it
 
 /**
- * @brief Value of letter to be beeped
+ * @brief Capability flags of the receiver (see LETTER_CAP_PACKED)
  *
  */
 uint8_t morse_code_letter_val[] = { 0x00 };
@@ -97,6 +156,68 @@ esp_attr_value_t morse_code_beep_char_val = {
 };
 
 
+/**
+ * @brief Characteristic value with the last decoded character
+ *
+ */
+uint8_t morse_code_decoded_val[] = { 0x00 };
+
+esp_attr_value_t morse_code_decoded_char_val = {
+    .attr_max_len = 1,
+    .attr_len = 1,
+    .attr_value = morse_code_decoded_val,
+};
+
+
+/**
+ * @brief Characteristic value for operations with macros
+ *
+ */
+uint8_t morse_code_macro_val[] = { 0x00 };
+
+esp_attr_value_t morse_code_macro_char_val = {
+    .attr_max_len = 1,
+    .attr_len = 1,
+    .attr_value = morse_code_macro_val,
+};
+
+
+/**
+ * @brief Characteristic value with the effective speed of playback
+ *
+ */
+uint8_t morse_code_speed_val[] = { 0x00 };
+
+esp_attr_value_t morse_code_speed_char_val = {
+    .attr_max_len = 1,
+    .attr_len = 1,
+    .attr_value = morse_code_speed_val,
+};
+
+
+/**
+ * @brief Characteristic value with counters of dropped messages and letters (LE16 both)
+ *
+ */
+uint8_t morse_code_dropped_val[] = { 0x00, 0x00, 0x00, 0x00 };
+
+esp_attr_value_t morse_code_dropped_char_val = {
+    .attr_max_len = 4,
+    .attr_len = 4,
+    .attr_value = morse_code_dropped_val,
+};
+
+
+
+/**
+ * @brief UUID of the morse code service in advertising data (16-bit UUID 0xabcd in the base UUID, little endian)
+ *
+ */
+static uint8_t adv_service_uuid128[ESP_UUID_LEN_128] = {
+    0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00,
+    GATTS_SERVICE_UUID_MORSE_CODE_RECEIVER & 0xff, GATTS_SERVICE_UUID_MORSE_CODE_RECEIVER >> 8, 0x00, 0x00,
+};
+
 
 /**
  * @brief Initialized structure for creating advertise packets (=advertising data content)
@@ -104,7 +225,7 @@ esp_attr_value_t morse_code_beep_char_val = {
  */
 static esp_ble_adv_data_t adv_data = {
     .set_scan_rsp = false, //< Are this data for scan response?
-    .include_name = true, //< Does this data contain the device name?
+    .include_name = false, //< Does this data contain the device name? (it is in the scan response, there is no space for it)
     .include_txpower = true, //< TX power = the worst-case transmit power
     .min_interval = 0x0006, //< 0x006*1.25 ms = 7.5 ms - Preffered minimal interval between each connection
     .max_interval = 0x0010, //< 0x0010*1.25 ms = 20 ms
@@ -113,8 +234,8 @@ static esp_ble_adv_data_t adv_data = {
     .p_manufacturer_data = NULL,
     .service_data_len = 0,
     .p_service_data = NULL, //< Service data point
-    .service_uuid_len = 0, //< Service UUID - there is no need to add it to advertising packets
-    .p_service_uuid = NULL,
+    .service_uuid_len = sizeof(adv_service_uuid128), //< Service UUID - clients can filter devices by it (it is sent as 16-bit UUID)
+    .p_service_uuid = adv_service_uuid128,
     .flag = (ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT),
 };
 
@@ -159,6 +280,55 @@ static uint8_t adv_config_done = 0; //<
 #define SCAN_RESPONSE_CONFIG_FLAG 2 //< Flag signalizing, that adv scan response is not done yet
 
 
+static bool peer_bonded = false; //< Is the current (or the last) central bonded?
+static esp_bd_addr_t peer_addr; //< Address of the current (or the last) central
+static esp_ble_addr_type_t peer_addr_type = BLE_ADDR_TYPE_PUBLIC;
+
+#ifdef BLE_DIRECTED_ADV
+static esp_timer_handle_t directed_adv_timer = NULL;
+static bool directed_adv = false; //< Is directed advertising running?
+#endif
+
+
+/**
+ * @brief Starts advertising (directed to the last central if it is required and the central is bonded)
+ *
+ * @param directed Should be advertising directed to the last central?
+ */
+static void start_advertising(bool directed) {
+#ifdef BLE_DIRECTED_ADV
+    if(directed && peer_bonded) {
+        esp_ble_adv_params_t directed_params = adv_params;
+        directed_params.adv_type = ADV_TYPE_DIRECT_IND_LOW; //< Only the last central can connect
+        memcpy(directed_params.peer_addr, peer_addr, sizeof(esp_bd_addr_t));
+        directed_params.peer_addr_type = peer_addr_type;
+
+        if(esp_ble_gap_start_advertising(&directed_params) == ESP_OK) {
+            directed_adv = true;
+            esp_timer_start_once(directed_adv_timer, BLE_DIRECTED_ADV_MS * 1000); //< Then undirected advertising starts
+            return;
+        }
+    }
+#endif
+
+    esp_ble_gap_start_advertising(&adv_params);
+}
+
+
+#ifdef BLE_DIRECTED_ADV
+/**
+ * @brief Stops directed advertising (undirected advertising is started, when the stop is completed)
+ *
+ * @param arg
+ */
+static void directed_adv_timeout(void *arg) {
+    if(directed_adv) {
+        esp_ble_gap_stop_advertising();
+    }
+}
+#endif
+
+
 
 /**
  * @brief Prints bluetooth addres to the informational log
@@ -287,6 +457,74 @@ void gatts_profile_morse_code_event_handler(esp_gatts_cb_event_t evt, esp_gatt_i
             ESP_LOGI(MODULE_TAG, "%s beep characteristic is adding!", __func__);
         }
 
+        profile_tab[MORSE_CODE_RECEIVER_ID].char_uuid.len = ESP_UUID_LEN_16;
+        profile_tab[MORSE_CODE_RECEIVER_ID].char_uuid.uuid.uuid16 = GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_DECODED; //< Setting the UUID of characteristic
+        err = esp_ble_gatts_add_char( //< Adding characteristic for notifying text decoded from local key
+            profile_tab[MORSE_CODE_RECEIVER_ID].service_handle,
+            &profile_tab[MORSE_CODE_RECEIVER_ID].char_uuid,
+            morse_code_decoded_permissions,
+            morse_code_decoded_properties,
+            &morse_code_decoded_char_val, //< Buffer to store the last decoded char
+            NULL
+        );
+        if(err != ESP_OK) {
+            ESP_LOGE(MODULE_TAG, "%s: esp_ble_gatts_add_char failed (%s)", __func__, esp_err_to_name(err));
+        }
+        else {
+            ESP_LOGI(MODULE_TAG, "%s decoded characteristic is adding!", __func__);
+        }
+
+        profile_tab[MORSE_CODE_RECEIVER_ID].char_uuid.len = ESP_UUID_LEN_16;
+        profile_tab[MORSE_CODE_RECEIVER_ID].char_uuid.uuid.uuid16 = GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_MACRO; //< Setting the UUID of characteristic
+        err = esp_ble_gatts_add_char( //< Adding characteristic for storing and playing macros
+            profile_tab[MORSE_CODE_RECEIVER_ID].service_handle,
+            &profile_tab[MORSE_CODE_RECEIVER_ID].char_uuid,
+            morse_code_macro_permissions,
+            morse_code_macro_properties,
+            &morse_code_macro_char_val,
+            NULL
+        );
+        if(err != ESP_OK) {
+            ESP_LOGE(MODULE_TAG, "%s: esp_ble_gatts_add_char failed (%s)", __func__, esp_err_to_name(err));
+        }
+        else {
+            ESP_LOGI(MODULE_TAG, "%s macro characteristic is adding!", __func__);
+        }
+
+        profile_tab[MORSE_CODE_RECEIVER_ID].char_uuid.len = ESP_UUID_LEN_16;
+        profile_tab[MORSE_CODE_RECEIVER_ID].char_uuid.uuid.uuid16 = GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_SPEED; //< Setting the UUID of characteristic
+        err = esp_ble_gatts_add_char( //< Adding characteristic for notifying effective speed
+            profile_tab[MORSE_CODE_RECEIVER_ID].service_handle,
+            &profile_tab[MORSE_CODE_RECEIVER_ID].char_uuid,
+            morse_code_speed_permissions,
+            morse_code_speed_properties,
+            &morse_code_speed_char_val,
+            NULL
+        );
+        if(err != ESP_OK) {
+            ESP_LOGE(MODULE_TAG, "%s: esp_ble_gatts_add_char failed (%s)", __func__, esp_err_to_name(err));
+        }
+        else {
+            ESP_LOGI(MODULE_TAG, "%s speed characteristic is adding!", __func__);
+        }
+
+        profile_tab[MORSE_CODE_RECEIVER_ID].char_uuid.len = ESP_UUID_LEN_16;
+        profile_tab[MORSE_CODE_RECEIVER_ID].char_uuid.uuid.uuid16 = GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_DROPPED; //< Setting the UUID of characteristic
+        err = esp_ble_gatts_add_char( //< Adding characteristic for notifying dropped messages
+            profile_tab[MORSE_CODE_RECEIVER_ID].service_handle,
+            &profile_tab[MORSE_CODE_RECEIVER_ID].char_uuid,
+            morse_code_dropped_permissions,
+            morse_code_dropped_properties,
+            &morse_code_dropped_char_val,
+            NULL
+        );
+        if(err != ESP_OK) {
+            ESP_LOGE(MODULE_TAG, "%s: esp_ble_gatts_add_char failed (%s)", __func__, esp_err_to_name(err));
+        }
+        else {
+            ESP_LOGI(MODULE_TAG, "%s dropped characteristic is adding!", __func__);
+        }
+
         break;
 
     case ESP_GATTS_START_EVT: //< Service started
@@ -315,33 +553,60 @@ void gatts_profile_morse_code_event_handler(esp_gatts_cb_event_t evt, esp_gatt_i
         }
 
         profile_tab[MORSE_CODE_RECEIVER_ID].descr_uuid.len = ESP_UUID_LEN_16;
+        enum morse_code_rec_chars char_idx;
 
         //Choose the right descriptor uuid
         if(params->add_char.char_uuid.uuid.uuid16 == GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_LETTER) {
             profile_tab[MORSE_CODE_RECEIVER_ID].descr_uuid.uuid.uuid16 = GATTS_DESCR_UIID_MORSE_CODE_RECEIVER_LETTER;
             profile_tab[MORSE_CODE_RECEIVER_ID].char_handle_tab[LETTER_CHAR] = params->add_char.attr_handle;
+            char_idx = LETTER_CHAR;
         }
         else if(params->add_char.char_uuid.uuid.uuid16 == GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_ABORT) {
             profile_tab[MORSE_CODE_RECEIVER_ID].descr_uuid.uuid.uuid16 = GATTS_DESCR_UIID_MORSE_CODE_RECEIVER_ABORT;
             profile_tab[MORSE_CODE_RECEIVER_ID].char_handle_tab[ABORT_CHAR] = params->add_char.attr_handle;
+            char_idx = ABORT_CHAR;
         }
         else if(params->add_char.char_uuid.uuid.uuid16 == GATTS_DESCR_UIID_MORSE_CODE_RECEIVER_BEEP) {
             profile_tab[MORSE_CODE_RECEIVER_ID].descr_uuid.uuid.uuid16 = GATTS_DESCR_UIID_MORSE_CODE_RECEIVER_BEEP;
             profile_tab[MORSE_CODE_RECEIVER_ID].char_handle_tab[BEEP_CHAR] = params->add_char.attr_handle;
+            char_idx = BEEP_CHAR;
+        }
+        else if(params->add_char.char_uuid.uuid.uuid16 == GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_DECODED) {
+            profile_tab[MORSE_CODE_RECEIVER_ID].descr_uuid.uuid.uuid16 = GATTS_DESCR_UIID_MORSE_CODE_RECEIVER_DECODED;
+            profile_tab[MORSE_CODE_RECEIVER_ID].char_handle_tab[DECODED_CHAR] = params->add_char.attr_handle;
+            char_idx = DECODED_CHAR;
+        }
+        else if(params->add_char.char_uuid.uuid.uuid16 == GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_MACRO) {
+            profile_tab[MORSE_CODE_RECEIVER_ID].descr_uuid.uuid.uuid16 = GATTS_DESCR_UIID_MORSE_CODE_RECEIVER_MACRO;
+            profile_tab[MORSE_CODE_RECEIVER_ID].char_handle_tab[MACRO_CHAR] = params->add_char.attr_handle;
+            char_idx = MACRO_CHAR;
+        }
+        else if(params->add_char.char_uuid.uuid.uuid16 == GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_SPEED) {
+            profile_tab[MORSE_CODE_RECEIVER_ID].descr_uuid.uuid.uuid16 = GATTS_DESCR_UIID_MORSE_CODE_RECEIVER_SPEED;
+            profile_tab[MORSE_CODE_RECEIVER_ID].char_handle_tab[SPEED_CHAR] = params->add_char.attr_handle;
+            char_idx = SPEED_CHAR;
+        }
+        else if(params->add_char.char_uuid.uuid.uuid16 == GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_DROPPED) {
+            profile_tab[MORSE_CODE_RECEIVER_ID].descr_uuid.uuid.uuid16 = GATTS_DESCR_UIID_MORSE_CODE_RECEIVER_DROPPED;
+            profile_tab[MORSE_CODE_RECEIVER_ID].char_handle_tab[DROPPED_CHAR] = params->add_char.attr_handle;
+            char_idx = DROPPED_CHAR;
         }
         else {
             profile_tab[MORSE_CODE_RECEIVER_ID].descr_uuid.uuid.uuid16 = GATTS_DESCR_UIID_MORSE_CODE_RECEIVER_VOL;
             profile_tab[MORSE_CODE_RECEIVER_ID].char_handle_tab[VOLUME_CHAR] = params->add_char.attr_handle;
+            char_idx = VOLUME_CHAR;
         }
 
-        if(add_char_cb != NULL) { //Calling custom add_char callback (e. g. for initialization of the char val)
-            add_char_cb(params->add_char.attr_handle);
+        ble_dispatch_add_char(params->add_char.attr_handle);
+
+        if(descr_requested < MORSE_CODE_REC_CHAR_NUM) { //Descriptors are added in the same order as they are requested
+            descr_owner_tab[descr_requested++] = char_idx;
         }
 
         err = esp_ble_gatts_add_char_descr( //< Adding the characteristic descriptor event
             profile_tab[MORSE_CODE_RECEIVER_ID].service_handle,
             &profile_tab[MORSE_CODE_RECEIVER_ID].descr_uuid,
-            morse_code_letter_permissions,
+            profile_tab[MORSE_CODE_RECEIVER_ID].descr_uuid.uuid.uuid16 == ESP_GATT_UUID_CHAR_CLIENT_CONFIG ? morse_code_cccd_permissions : morse_code_letter_permissions,
             NULL,
             NULL
         );
@@ -357,6 +622,14 @@ void gatts_profile_morse_code_event_handler(esp_gatts_cb_event_t evt, esp_gatt_i
             params->add_char_descr.attr_handle,
             params->add_char_descr.service_handle
         );
+
+        if(descr_added < descr_requested) {
+            enum morse_code_rec_chars owner = descr_owner_tab[descr_added++];
+
+            if(params->add_char_descr.descr_uuid.uuid.uuid16 == ESP_GATT_UUID_CHAR_CLIENT_CONFIG) {
+                cccd_handle_tab[owner] = params->add_char_descr.attr_handle; //< Client configuration of notifications
+            }
+        }
         break;
 
     case ESP_GATTS_CONNECT_EVT: //< Client connected
@@ -365,6 +638,41 @@ void gatts_profile_morse_code_event_handler(esp_gatts_cb_event_t evt, esp_gatt_i
             ESP_BD_ADDR_HEX(params->connect.remote_bda)
         );
         profile_tab[MORSE_CODE_RECEIVER_ID].conn_id = params->connect.conn_id; //< Save client conn id to profile tab
+        is_connected = true;
+        peer_bonded = false;
+        memcpy(peer_addr, params->connect.remote_bda, sizeof(esp_bd_addr_t));
+
+#ifdef BLE_DIRECTED_ADV
+        directed_adv = false;
+        esp_timer_stop(directed_adv_timer);
+#endif
+
+        err = esp_ble_gap_set_pkt_data_len(params->connect.remote_bda, BLE_DATA_LEN_OCTETS); //< Longer link-layer packets
+        if(err != ESP_OK) {
+            ESP_LOGE(MODULE_TAG, "%s: esp_ble_gap_set_pkt_data_len failed (%s)", __func__, esp_err_to_name(err));
+        }
+
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+        err = esp_ble_gap_set_preferred_phy( //< 2M PHY is preferred (it is supported only by BLE 5 controllers)
+            params->connect.remote_bda,
+            0,
+            ESP_BLE_GAP_PHY_2M_PREF_MASK,
+            ESP_BLE_GAP_PHY_2M_PREF_MASK,
+            ESP_BLE_GAP_PHY_OPTIONS_NO_PREF
+        );
+        if(err != ESP_OK) {
+            ESP_LOGE(MODULE_TAG, "%s: esp_ble_gap_set_preferred_phy failed (%s)", __func__, esp_err_to_name(err));
+        }
+#endif
+
+#ifdef BLE_BONDING
+        err = esp_ble_set_encryption(params->connect.remote_bda, ESP_BLE_SEC_ENCRYPT_NO_MITM); //< Pairs new central or only encrypts the link with stored keys
+        if(err != ESP_OK) {
+            ESP_LOGE(MODULE_TAG, "%s: esp_ble_set_encryption failed (%s)", __func__, esp_err_to_name(err));
+        }
+#endif
+        memset(notify_enabled, 0, sizeof(notify_enabled));
+        ble_stats_reset_throughput();
 
         err = gpio_set_level(CONNECTION_GPIO, 1);
         ESP_ERROR_CHECK(err);
@@ -372,10 +680,7 @@ void gatts_profile_morse_code_event_handler(esp_gatts_cb_event_t evt, esp_gatt_i
         break;
 
     case ESP_GATTS_READ_EVT: //< Clien wants to read char
-        ESP_LOGI(MODULE_TAG, "READ_EVT, remote=" ESP_BD_ADDR_STR " read_handle=%d",
-            ESP_BD_ADDR_HEX(params->read.bda),
-            params->read.handle
-        );
+        DLOGD(MODULE_TAG, "READ_EVT, conn_id=%d, read_handle=%d", params->read.conn_id, params->read.handle);
 
         esp_gatt_rsp_t response;
         memset(&response, 0, sizeof(esp_gatt_rsp_t)); //< Initialize the structure for the response
@@ -387,16 +692,17 @@ void gatts_profile_morse_code_event_handler(esp_gatts_cb_event_t evt, esp_gatt_i
 
         err = esp_ble_gatts_get_attr_value(params->read.handle, &length, &char_byte); //< Read the attribute value of characteristic
         if(err != ESP_OK) {
-            ESP_LOGE(MODULE_TAG, "%s: esp_ble_gatts_get_attr_value failed (%d)", __func__, err);
+            DLOGE(MODULE_TAG, "esp_ble_gatts_get_attr_value failed (%d)", err);
         }
 
-        ESP_LOGI(MODULE_TAG, "The char length=%x", length);
-        for(int i = 0; i < length; i++) {
-            ESP_LOGI(MODULE_TAG, "char[%d]=%x", i, char_byte[i]);
+        DLOGD(MODULE_TAG, "The char length=%d, char[0]=%x", length, length ? char_byte[0] : 0);
+
+        if(length > ESP_GATT_MAX_ATTR_LEN) { //Value cannot be longer than the response
+            length = ESP_GATT_MAX_ATTR_LEN;
         }
 
         response.attr_value.len = length;
-        response.attr_value.value[0] = char_byte[0];
+        memcpy(response.attr_value.value, char_byte, length);
 
         esp_ble_gatts_send_response( //< Send the  response
             gatts_if,
@@ -409,46 +715,61 @@ void gatts_profile_morse_code_event_handler(esp_gatts_cb_event_t evt, esp_gatt_i
         break;
 
     case ESP_GATTS_WRITE_EVT:
-        ESP_LOGI(MODULE_TAG, "WRITE_EVT, status=%d", params->rsp.status);
-        ESP_LOGI(MODULE_TAG, "WRITE_EVT, handle=%d, conn_id=%d, trans_id=%ld", params->write.handle, params->write.conn_id, params->write.trans_id);
-        esp_log_buffer_hex(MODULE_TAG, params->write.value, params->write.len);
-
-        if(!params->write.is_prep) {
-            if(profile_tab[MORSE_CODE_RECEIVER_ID].descr_handle == params->write.handle && params->write.len == 2) {
-                uint16_t descr_val = params->write.value[1] << 8 | params->write.value[0];
-                if(descr_val == 0x0001) {
-                    ESP_LOGI(MODULE_TAG, "Sending notification");
-                    if(morse_code_vol_properties & ESP_GATT_CHAR_PROP_BIT_NOTIFY) {
-                        //Only needed if it support notify
-                    }
-                }
-                else if(descr_val == 0x0002) {
-                    ESP_LOGI(MODULE_TAG, "Sending indication");
-                    if(morse_code_vol_properties & ESP_GATT_CHAR_PROP_BIT_INDICATE) {
-                        //Only needed if it support indication
-                    }
-                }
-                else if(descr_val == 0x0000) {
-                    ESP_LOGI(MODULE_TAG, "Sending notification and indication is disabled");
-                }
-                else {
-                    ESP_LOGI(MODULE_TAG, "Unexpected value!");
-                }
+        DLOGD(MODULE_TAG, "WRITE_EVT, handle=%d, conn_id=%d, trans_id=%lu, len=%d",
+            params->write.handle, params->write.conn_id, params->write.trans_id, params->write.len);
+
+        if(params->write.is_prep) { //Long writes are not supported (every command fits to one write)
+            DLOGW(MODULE_TAG, "Long write is not supported!");
+            if(params->write.need_rsp) {
+                esp_ble_gatts_send_response(gatts_if, params->write.conn_id, params->write.trans_id, ESP_GATT_REQ_NOT_SUPPORTED, NULL);
             }
+
+            break;
         }
-        if(params->write.need_rsp) { //Response is needed
-            if(params->write.is_prep) {
-                ESP_LOGI(MODULE_TAG, "Long write");
-                //Only needed if long write is supported
+
+        bool is_cccd = false;
+        for(int i = 0; i < MORSE_CODE_REC_CHAR_NUM; i++) { //Find the characteristic that owns written client configuration
+            if(!cccd_handle_tab[i] || cccd_handle_tab[i] != params->write.handle) {
+                continue;
+            }
+
+            is_cccd = true;
+            if(params->write.len != 2) {
+                DLOGW(MODULE_TAG, "Invalid length of client configuration!");
+                break;
+            }
+
+            uint16_t descr_val = params->write.value[1] << 8 | params->write.value[0];
+            if(descr_val == 0x0001) {
+                DLOGI(MODULE_TAG, "Sending notification");
+                notify_enabled[i] = true;
+            }
+            else if(descr_val == 0x0002) {
+                DLOGI(MODULE_TAG, "Sending indication");
+                //Only needed if it support indication
+            }
+            else if(descr_val == 0x0000) {
+                DLOGI(MODULE_TAG, "Sending notification and indication is disabled");
+                notify_enabled[i] = false;
             }
             else {
-                ESP_LOGI(MODULE_TAG, "Short write");
-                esp_ble_gatts_send_response(gatts_if, params->write.conn_id, params->write.trans_id, ESP_GATT_OK, NULL);
+                DLOGW(MODULE_TAG, "Unexpected value!");
             }
         }
-        else {
-            if(write_event_handler)
-                write_event_handler(params);
+
+        if(params->write.need_rsp) { //Response is needed (write request is answered before the command is processed)
+            DLOGD(MODULE_TAG, "Short write");
+            esp_ble_gatts_send_response(gatts_if, params->write.conn_id, params->write.trans_id, ESP_GATT_OK, NULL);
+        }
+
+        if(!is_cccd) { //Commands are accepted by write request as well as by write command (as in NimBLE backend)
+            ble_write_evt_t write_evt = {
+                .handle = params->write.handle,
+                .len = params->write.len,
+                .value = params->write.value,
+            };
+
+            ble_dispatch_write(&write_evt);
         }
 
         break;
@@ -470,14 +791,20 @@ void gatts_profile_morse_code_event_handler(esp_gatts_cb_event_t evt, esp_gatt_i
             ESP_BD_ADDR_HEX(params->disconnect.remote_bda)
         );
 
+        is_connected = false;
+        memset(notify_enabled, 0, sizeof(notify_enabled));
+
         err = gpio_set_level(CONNECTION_GPIO, 0);
         ESP_ERROR_CHECK(err);
 
-        esp_ble_gap_start_advertising(&adv_params);
+        ble_log_stats();
+
+        start_advertising(true);
         break;
 
     case ESP_GATTS_MTU_EVT: //< MTU was set
         ESP_LOGI(MODULE_TAG, "MTU_EVT, mtu=%d", params->mtu.mtu);
+        ble_stats.mtu = params->mtu.mtu;
         break;
 
     default:
@@ -500,14 +827,14 @@ void gap_event_handler(esp_gap_ble_cb_event_t evt, esp_ble_gap_cb_param_t *param
     case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
         adv_config_done &= (~ADV_CONFIG_FLAG); //< Advertising data setting is complete, so set the corresponding flag to 0
         if(adv_config_done == 0) { //< But check other flags in adv_config_done, if there is something that is not done yet
-            esp_ble_gap_start_advertising(&adv_params); //< Start advertising with predefined parameters
+            start_advertising(false); //< Start advertising with predefined parameters
         }
         break;
 
     case ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT:
         adv_config_done &= (~SCAN_RESPONSE_CONFIG_FLAG); //< Advertising data setting is complete, so set the corresponding flag to 0
         if(adv_config_done == 0) { //< But check other flags in adv_config_done
-            esp_ble_gap_start_advertising(&adv_params);
+            start_advertising(false);
         }
         break;
 
@@ -515,6 +842,10 @@ void gap_event_handler(esp_gap_ble_cb_event_t evt, esp_ble_gap_cb_param_t *param
         if(params->adv_start_cmpl.status != ESP_BT_STATUS_SUCCESS) {
             ESP_LOGE(MODULE_TAG, "%s: The starting of advertising failed", __func__);
         }
+        else if(!ble_stats.adv_ready_us) { //< The first advertising after boot (the stack is fully ready)
+            ble_stats.adv_ready_us = esp_timer_get_time();
+            ble_log_stats();
+        }
         break;
 
     case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT: //< Advertising was requested to stop and it is done
@@ -524,6 +855,61 @@ void gap_event_handler(esp_gap_ble_cb_event_t evt, esp_ble_gap_cb_param_t *param
         else {
             ESP_LOGI(MODULE_TAG, "%s: The advertising was succesfully stopped", __func__);
         }
+
+#ifdef BLE_DIRECTED_ADV
+        if(directed_adv) { //< Directed advertising timed out
+            directed_adv = false;
+            start_advertising(false);
+        }
+#endif
+        break;
+
+    case ESP_GAP_BLE_SET_PKT_LENGTH_COMPLETE_EVT: //< Data Length Extension was negotiated
+        ESP_LOGI(MODULE_TAG, "Data length set, status=%d, tx_len=%d, rx_len=%d",
+            params->pkt_data_length_cmpl.status,
+            params->pkt_data_length_cmpl.params.tx_len,
+            params->pkt_data_length_cmpl.params.rx_len
+        );
+
+        if(params->pkt_data_length_cmpl.status == ESP_BT_STATUS_SUCCESS) {
+            ble_stats.tx_octets = params->pkt_data_length_cmpl.params.tx_len;
+            ble_stats.rx_octets = params->pkt_data_length_cmpl.params.rx_len;
+        }
+        break;
+
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    case ESP_GAP_BLE_PHY_UPDATE_COMPLETE_EVT: //< PHY of the connection was changed
+        ESP_LOGI(MODULE_TAG, "PHY updated, status=%d, tx_phy=%d, rx_phy=%d",
+            params->phy_update.status,
+            params->phy_update.tx_phy,
+            params->phy_update.rx_phy
+        );
+
+        if(params->phy_update.status == ESP_BT_STATUS_SUCCESS) {
+            ble_stats.tx_phy = params->phy_update.tx_phy;
+            ble_stats.rx_phy = params->phy_update.rx_phy;
+        }
+        break;
+#endif
+
+    case ESP_GAP_BLE_SEC_REQ_EVT: //< Central requests the encryption (or pairing)
+        esp_ble_gap_security_rsp(params->ble_security.ble_req.bd_addr, true);
+        break;
+
+    case ESP_GAP_BLE_AUTH_CMPL_EVT: //< Pairing or encryption with stored keys is done
+        if(!params->ble_security.auth_cmpl.success) {
+            ESP_LOGE(MODULE_TAG, "%s: Authentication failed (reason: 0x%x)", __func__, params->ble_security.auth_cmpl.fail_reason);
+            break;
+        }
+
+        ESP_LOGI(MODULE_TAG, "Link encrypted, remote=" ESP_BD_ADDR_STR ", auth_mode=%d",
+            ESP_BD_ADDR_HEX(params->ble_security.auth_cmpl.bd_addr),
+            params->ble_security.auth_cmpl.auth_mode
+        );
+
+        peer_bonded = true;
+        memcpy(peer_addr, params->ble_security.auth_cmpl.bd_addr, sizeof(esp_bd_addr_t)); //< Identity address of the central
+        peer_addr_type = params->ble_security.auth_cmpl.addr_type;
         break;
 
     case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
@@ -569,19 +955,80 @@ void gatts_event_handler(esp_gatts_cb_event_t evt, esp_gatt_if_t gatts_if, esp_b
     }
 }
 
-void register_write_event_handler(void (*write_event_handler_func)(esp_ble_gatts_cb_param_t *)) {
-    write_event_handler = write_event_handler_func;
+esp_err_t ble_set_char_value(enum morse_code_rec_chars char_idx, const uint8_t *value, uint16_t len) {
+    return esp_ble_gatts_set_attr_value(morse_code_char_handle_tab[char_idx], len, value);
+}
+
+
+bool ble_is_connected() {
+    return is_connected;
+}
+
+
+esp_err_t ble_notify(enum morse_code_rec_chars char_idx, const uint8_t *value, uint16_t len) {
+    if(!is_connected || !notify_enabled[char_idx]) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    return esp_ble_gatts_send_indicate( //< Send notification (without confirmation)
+        profile_tab[MORSE_CODE_RECEIVER_ID].gatts_if,
+        profile_tab[MORSE_CODE_RECEIVER_ID].conn_id,
+        morse_code_char_handle_tab[char_idx],
+        len,
+        (uint8_t *)value,
+        false
+    );
 }
 
 
-void register_add_char_cb(void (*add_char_cb_func)(uint16_t)) {
-    add_char_cb = add_char_cb_func;
+#ifdef BLE_BONDING
+/**
+ * @brief Sets parameters of the security manager (Just Works pairing with bonding, there is no display or keyboard)
+ *
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+static esp_err_t ble_security_init() {
+    esp_err_t err;
+
+    esp_ble_auth_req_t auth_req = ESP_LE_AUTH_REQ_SC_BOND;
+    esp_ble_io_cap_t io_cap = ESP_IO_CAP_NONE;
+    uint8_t key_size = 16;
+    uint8_t init_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK; //< LTK and IRK (so the central can be recognized by its identity address)
+    uint8_t rsp_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+
+    const struct {
+        esp_ble_sm_param_t param;
+        void *value;
+        uint8_t len;
+    } sm_params[] = {
+        { ESP_BLE_SM_AUTHEN_REQ_MODE, &auth_req, sizeof(auth_req) },
+        { ESP_BLE_SM_IOCAP_MODE, &io_cap, sizeof(io_cap) },
+        { ESP_BLE_SM_MAX_KEY_SIZE, &key_size, sizeof(key_size) },
+        { ESP_BLE_SM_SET_INIT_KEY, &init_key, sizeof(init_key) },
+        { ESP_BLE_SM_SET_RSP_KEY, &rsp_key, sizeof(rsp_key) },
+    };
+
+    for(int i = 0; i < sizeof(sm_params) / sizeof(sm_params[0]); i++) {
+        err = esp_ble_gap_set_security_param(sm_params[i].param, sm_params[i].value, sm_params[i].len);
+        if(err != ESP_OK) {
+            ESP_LOGE(MODULE_TAG, "%s: esp_ble_gap_set_security_param failed (%s)", __func__, esp_err_to_name(err));
+            return err;
+        }
+    }
+
+    ESP_LOGI(MODULE_TAG, "Bonded centrals: %d", esp_ble_get_bond_device_num());
+
+    return ESP_OK;
 }
+#endif
 
 
-esp_err_t bluetooth_init(void (*write_event_handler_func)(esp_ble_gatts_cb_param_t *), void (*add_char_cb_func)(uint16_t)) {
+esp_err_t bluetooth_init(void (*write_event_handler_func)(ble_write_evt_t *), void (*add_char_cb_func)(uint16_t)) {
     esp_err_t err;
 
+    ble_stats.init_start_us = esp_timer_get_time();
+    ble_stats.heap_before = esp_get_free_heap_size();
+
     esp_rom_gpio_pad_select_gpio(CONNECTION_GPIO);
     err = gpio_set_direction(CONNECTION_GPIO, GPIO_MODE_OUTPUT);
     ESP_ERROR_CHECK(err);
@@ -615,8 +1062,7 @@ esp_err_t bluetooth_init(void (*write_event_handler_func)(esp_ble_gatts_cb_param
     }
 
     //Bluetooth stack should be up now
-    register_write_event_handler(write_event_handler_func);
-    register_add_char_cb(add_char_cb_func);
+    ble_register_callbacks(write_event_handler_func, add_char_cb_func);
 
     err = esp_ble_gatts_register_callback(gatts_event_handler); //< Registering handling function for events, that come from GATT server
     if(err != ESP_OK) {
@@ -630,12 +1076,41 @@ esp_err_t bluetooth_init(void (*write_event_handler_func)(esp_ble_gatts_cb_param
         return err;
     }
 
+    err = esp_ble_gatt_set_local_mtu(BLE_LOCAL_MTU);
+    if(err != ESP_OK) {
+        ESP_LOGE(MODULE_TAG, "%s: esp_ble_gatt_set_local_mtu failed (%s)", __func__, esp_err_to_name(err));
+        return err;
+    }
+
+#ifdef BLE_BONDING
+    err = ble_security_init();
+    if(err != ESP_OK) {
+        return err;
+    }
+#endif
+
+#ifdef BLE_DIRECTED_ADV
+    esp_timer_create_args_t directed_adv_timer_args = {
+        .callback = directed_adv_timeout,
+        .name = "directed_adv",
+    };
+
+    err = esp_timer_create(&directed_adv_timer_args, &directed_adv_timer);
+    if(err != ESP_OK) {
+        ESP_LOGE(MODULE_TAG, "%s: esp_timer_create failed (%s)", __func__, esp_err_to_name(err));
+        return err;
+    }
+#endif
+
     err = esp_ble_gatts_app_register(MORSE_CODE_RECEIVER_ID); //Registering application
     if(err != ESP_OK) {
         ESP_LOGE(MODULE_TAG, "%s: esp_ble_gatts_app_register failed (%s)", __func__, esp_err_to_name(err));
         return err;
     }
 
+    ble_stats.init_done_us = esp_timer_get_time();
+    ble_stats.heap_after = esp_get_free_heap_size();
+
     return ESP_OK;
 }
 
@@ -10,17 +10,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "driver/gpio.h"
+#include "esp_err.h"
+#include "sdkconfig.h"
 
-#include "esp_bt.h"
-#include "esp_bt_main.h"
-#include "esp_bt_device.h"
-#include "esp_gap_ble_api.h"
-#include "esp_gattc_api.h"
-#include "esp_gatts_api.h"
-#include "esp_gatt_common_api.h"
+#include "dlog.h"
 
 
 /**
@@ -37,6 +34,18 @@
 #define DEVICE_NAME "Morse code - receiver"
 
 
+/**
+ * @brief The name of the BLE host stack the module was built with (selected by sdkconfig,
+ * see sdkconfig.nimble)
+ *
+ */
+#if CONFIG_BT_NIMBLE_ENABLED
+#define BLE_BACKEND_NAME "NimBLE"
+#else
+#define BLE_BACKEND_NAME "Bluedroid"
+#endif
+
+
 /**
  * @brief UUIDs
  *
@@ -55,27 +64,39 @@
 #define GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_BEEP 0x0003
 #define GATTS_DESCR_UIID_MORSE_CODE_RECEIVER_BEEP 0x0003
 
-#define GATTS_NUM_HANDLE_MORSE_CODE 10 //< The number of addresable attributes on a GATT server (service, characteristic, char_val, char_descriptor)
-//1 service + 3 characteristics + 3 characteristic values + 3 characteristic descriptors
+#define GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_DECODED 0x0004
+#define GATTS_DESCR_UIID_MORSE_CODE_RECEIVER_DECODED 0x2902 //< Client characteristic configuration (for notifications)
+
+#define GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_MACRO 0x0005
+#define GATTS_DESCR_UIID_MORSE_CODE_RECEIVER_MACRO 0x0005
+
+#define GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_SPEED 0x0006
+#define GATTS_DESCR_UIID_MORSE_CODE_RECEIVER_SPEED 0x2902 //< Client characteristic configuration (for notifications)
+
+#define GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_DROPPED 0x0007
+#define GATTS_DESCR_UIID_MORSE_CODE_RECEIVER_DROPPED 0x2902 //< Client characteristic configuration (for notifications)
+
+#define GATTS_NUM_HANDLE_MORSE_CODE 25 //< The number of addresable attributes on a GATT server (service, characteristic, char_val, char_descriptor)
+//1 service + 8 characteristics + 8 characteristic values + 8 characteristic descriptors
 
 #define FAST_BLE //< Enables fast configuration of the BT receiver (but it is more power-demanding)
 
+#define BLE_BONDING //< Centrals are bonded (keys are stored in NVS), so the reconnection is only encrypted and clients can cache handles
+
+// #define BLE_DIRECTED_ADV //< After the link drop advertising is directed to the bonded central for BLE_DIRECTED_ADV_MS
+
+#define BLE_DIRECTED_ADV_MS 2000 //< Duration of directed advertising, then undirected advertising starts
+
+#define BLE_LOCAL_MTU 517 //< Maximal ATT MTU accepted by the receiver (the client requests the exchange)
+#define BLE_DATA_LEN_OCTETS 251 //< Requested payload of link-layer packets (Data Length Extension, 27 B without it)
+#define BLE_DATA_LEN_TIME_US 2120 //< Transmission time of the packet with BLE_DATA_LEN_OCTETS on 1M PHY
+
 /**
  * @brief Led pin for
  *
  */
 #define CONNECTION_GPIO GPIO_NUM_2
 
-/**
- * @brief Profile indexes
- *
- */
-enum profiles {
-    MORSE_CODE_RECEIVER_ID,
-    PROFILE_NUM,
-};
-
-
 /**
  * @brief Indexes of characteristics
  *
@@ -85,46 +106,59 @@ enum morse_code_rec_chars {
     VOLUME_CHAR, //< Characteristic for writing and reading volume
     ABORT_CHAR,  //< Characteristic for aborting beeping
     BEEP_CHAR,
+    DECODED_CHAR, //< Characteristic for notifying text decoded from local key
+    MACRO_CHAR, //< Characteristic for storing and playing macros
+    SPEED_CHAR, //< Characteristic for notifying effective speed of playback (in WPM)
+    DROPPED_CHAR, //< Characteristic for notifying counters of expired messages
     MORSE_CODE_REC_CHAR_NUM,
 };
 
 
+/**
+ * @brief Backend independent description of the write to the characteristic
+ *
+ */
+typedef struct ble_write_evt {
+    uint16_t handle; //< Attribute handle of the written characteristic value
+    uint16_t len; //< Length of the written data
+    const uint8_t *value; //< Written data (valid only during the callback)
+} ble_write_evt_t;
+
 
 /**
- * @brief Element of GATT profile table
+ * @brief Statistics used for comparing BLE backends (boot time, used heap and write throughput)
  *
  */
-struct gatts_profile_inst {
-    esp_gatts_cb_t gatts_cb;
-    uint16_t gatts_if;
-    uint16_t app_id;
-    uint16_t conn_id;
-    uint16_t service_handle;
-    esp_gatt_srvc_id_t service_id;
-    uint16_t char_handle;
-    uint16_t *char_handle_tab;
-    esp_bt_uuid_t char_uuid;
-    esp_gatt_perm_t perm;
-    esp_gatt_char_prop_t property;
-    uint16_t descr_handle;
-    esp_bt_uuid_t descr_uuid;
-};
+typedef struct ble_stats {
+    int64_t init_start_us; //< Timestamp when bluetooth_init was called
+    int64_t init_done_us; //< Timestamp when bluetooth_init returned
+    int64_t adv_ready_us; //< Timestamp when the device started advertising for the first time
+    uint32_t heap_before; //< Free heap before the initialization of the stack
+    uint32_t heap_after; //< Free heap after the initialization of the stack
+    uint32_t writes; //< Number of writes to characteristics since the last connection
+    uint32_t bytes_written; //< Number of written bytes since the last connection
+    int64_t first_write_us; //< Timestamp of the first write since the last connection
+    int64_t last_write_us; //< Timestamp of the last write since the last connection
+    uint16_t mtu; //< Negotiated ATT MTU of the last connection
+    uint16_t tx_octets; //< Negotiated payload of transmitted link-layer packets
+    uint16_t rx_octets; //< Negotiated payload of received link-layer packets
+    uint8_t tx_phy; //< PHY of the last connection in the direction to the client (1 = 1M, 2 = 2M, 3 = Coded)
+    uint8_t rx_phy; //< PHY of the last connection in the direction from the client
+} ble_stats_t;
+
 
 /**
- * @brief Handling function of morse code app that operates on this GATT server
+ * @brief Tab with characteristic value handles (filled by the backend when the GATT database is created)
  *
- * @param evt incoming event
- * @param gatts_if GATTS interface
- * @param param event parameters
  */
-void gatts_profile_morse_code_event_handler(esp_gatts_cb_event_t evt, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
+extern uint16_t morse_code_char_handle_tab[];
 
 
 /**
- * @brief Tabs with BLE profiles (we have only one service)
+ * @brief Statistics of the BLE module
  *
  */
-extern struct gatts_profile_inst profile_tab[];
+extern ble_stats_t ble_stats;
 
 
 /**
@@ -134,7 +168,75 @@ extern struct gatts_profile_inst profile_tab[];
  * @param add_char_cb_func Callback for add char GATT event (can be used for initialization of characteristics values)
  * @return esp_err_t ESP_OK if eferything went OK
  */
-esp_err_t bluetooth_init(void (*write_event_handler_func)(esp_ble_gatts_cb_param_t *), void (*add_char_cb_func)(uint16_t));
+esp_err_t bluetooth_init(void (*write_event_handler_func)(ble_write_evt_t *), void (*add_char_cb_func)(uint16_t));
+
+
+/**
+ * @brief Sets the value of the characteristic (it is returned to the client when it reads the characteristic)
+ *
+ * @param char_idx Index of the characteristic
+ * @param value New value
+ * @param len Length of the new value
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t ble_set_char_value(enum morse_code_rec_chars char_idx, const uint8_t *value, uint16_t len);
+
+
+/**
+ * @brief Sends notification with the value of the characteristic to the connected client
+ *
+ * @param char_idx Index of the characteristic
+ * @param value Notified value
+ * @param len Length of the notified value
+ * @return esp_err_t ESP_OK if notification was sent, ESP_ERR_INVALID_STATE if nobody is subscribed
+ */
+esp_err_t ble_notify(enum morse_code_rec_chars char_idx, const uint8_t *value, uint16_t len);
+
+
+/**
+ * @brief Checks if any client is connected
+ *
+ * @return true if client is connected
+ */
+bool ble_is_connected();
+
+
+/**
+ * @brief Passes the write event to the registered write handler (common for all backends)
+ *
+ * @param evt Write event
+ */
+void ble_dispatch_write(ble_write_evt_t *evt);
+
+
+/**
+ * @brief Passes the add char event to the registered callback (common for all backends)
+ *
+ * @param char_handle Handle of the added characteristic value
+ */
+void ble_dispatch_add_char(uint16_t char_handle);
+
+
+/**
+ * @brief Registers callbacks that are passed to bluetooth_init (common for all backends)
+ *
+ */
+void ble_register_callbacks(void (*write_event_handler_func)(ble_write_evt_t *), void (*add_char_cb_func)(uint16_t));
+
+
+/**
+ * @brief Resets throughput counters and link parameters to defaults of BLE (should be called by backend when
+ * the client connects)
+ *
+ */
+void ble_stats_reset_throughput();
+
+
+/**
+ * @brief Prints statistics of the BLE module (boot time, heap consumption, write throughput and link parameters)
+ *
+ */
+void ble_log_stats();
 
 
 #endif
@@ -0,0 +1,547 @@
+/**
+ * @file ble_receiver_nimble.c
+ *
+ * @brief Implementation of bluetooth (BLE) module for morse code receiver built on NimBLE host
+ * (lighter alternative to Bluedroid backend in ble_receiver.c, selected by sdkconfig)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "ble_receiver.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "host/ble_hs.h"
+#include "host/util/util.h"
+#include "services/gap/ble_svc_gap.h"
+#include "services/gatt/ble_svc_gatt.h"
+#include "host/ble_store.h"
+
+
+void ble_store_config_init(void); //< Persistent storage of bonds in NVS (NimBLE does not declare it in any header)
+
+
+//Based on https://github.com/espressif/esp-idf/tree/master/examples/bluetooth/nimble/bleprph
+
+#define CHAR_VALUE_MAX_LEN 4 //< Maximum length of the readable characteristic value
+
+
+/**
+ * @brief Values of characteristics returned to the client when it reads them
+ *
+ */
+static uint8_t char_value_tab[MORSE_CODE_REC_CHAR_NUM][CHAR_VALUE_MAX_LEN];
+static uint16_t char_value_len_tab[MORSE_CODE_REC_CHAR_NUM];
+
+
+static uint8_t own_addr_type; //< Address type inferred after the host and controller are synced
+
+static bool is_connected = false; //< Is there any connected client?
+static uint16_t conn_handle_cur = 0; //< Handle of the current connection
+static bool notify_enabled[MORSE_CODE_REC_CHAR_NUM]; //< Is the client subscribed to notifications of the characteristic?
+
+
+static int char_access_cb(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg);
+
+
+/**
+ * @brief GATT database of the morse code service (characteristics must be in the same order as in Bluedroid backend,
+ * older clients assign them by position and the database must be stable, so clients can cache handles)
+ *
+ */
+static const struct ble_gatt_svc_def gatt_svcs[] = {
+    {
+        .type = BLE_GATT_SVC_TYPE_PRIMARY,
+        .uuid = BLE_UUID16_DECLARE(GATTS_SERVICE_UUID_MORSE_CODE_RECEIVER),
+        .characteristics = (struct ble_gatt_chr_def[]) {
+            {
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_LETTER),
+                .access_cb = char_access_cb,
+                .arg = (void *)LETTER_CHAR,
+                .flags = BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP | BLE_GATT_CHR_F_READ, //< Read returns capability flags
+                .val_handle = &morse_code_char_handle_tab[LETTER_CHAR],
+            },
+            {
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_VOL),
+                .access_cb = char_access_cb,
+                .arg = (void *)VOLUME_CHAR,
+                .flags = BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP | BLE_GATT_CHR_F_READ,
+                .val_handle = &morse_code_char_handle_tab[VOLUME_CHAR],
+            },
+            {
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_ABORT),
+                .access_cb = char_access_cb,
+                .arg = (void *)ABORT_CHAR,
+                .flags = BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP,
+                .val_handle = &morse_code_char_handle_tab[ABORT_CHAR],
+            },
+            {
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_BEEP),
+                .access_cb = char_access_cb,
+                .arg = (void *)BEEP_CHAR,
+                .flags = BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP,
+                .val_handle = &morse_code_char_handle_tab[BEEP_CHAR],
+            },
+            {
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_DECODED),
+                .access_cb = char_access_cb,
+                .arg = (void *)DECODED_CHAR,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY, //< Client configuration descriptor is added by the host
+                .val_handle = &morse_code_char_handle_tab[DECODED_CHAR],
+            },
+            {
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_MACRO),
+                .access_cb = char_access_cb,
+                .arg = (void *)MACRO_CHAR,
+                .flags = BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP,
+                .val_handle = &morse_code_char_handle_tab[MACRO_CHAR],
+            },
+            {
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_SPEED),
+                .access_cb = char_access_cb,
+                .arg = (void *)SPEED_CHAR,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+                .val_handle = &morse_code_char_handle_tab[SPEED_CHAR],
+            },
+            {
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_MORSE_CODE_RECEIVER_DROPPED),
+                .access_cb = char_access_cb,
+                .arg = (void *)DROPPED_CHAR,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+                .val_handle = &morse_code_char_handle_tab[DROPPED_CHAR],
+            },
+            { 0 }, //< No more characteristics
+        },
+    },
+    { 0 }, //< No more services
+};
+
+
+/**
+ * @brief Access callback for all characteristics of morse code service
+ *
+ * @param conn_handle
+ * @param attr_handle
+ * @param ctxt
+ * @param arg Index of the characteristic
+ * @return int 0 if access was successful, otherwise ATT error code
+ */
+static int char_access_cb(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg) {
+    static uint8_t buffer[BLE_ATT_ATTR_MAX_LEN]; //< Host task is the only caller so static buffer is fine
+    enum morse_code_rec_chars char_idx = (enum morse_code_rec_chars)(uintptr_t)arg;
+    uint16_t length = 0;
+    int rc;
+
+    switch(ctxt->op)
+    {
+    case BLE_GATT_ACCESS_OP_READ_CHR: //< Client wants to read char
+        rc = os_mbuf_append(ctxt->om, char_value_tab[char_idx], char_value_len_tab[char_idx]);
+        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+
+    case BLE_GATT_ACCESS_OP_WRITE_CHR:
+        if(OS_MBUF_PKTLEN(ctxt->om) > sizeof(buffer)) { //Longer writes would be truncated
+            DLOGE(MODULE_TAG, "Too long write (%d)!", OS_MBUF_PKTLEN(ctxt->om));
+            return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+        }
+
+        rc = ble_hs_mbuf_to_flat(ctxt->om, buffer, sizeof(buffer), &length);
+        if(rc != 0) {
+            DLOGE(MODULE_TAG, "ble_hs_mbuf_to_flat failed (%d)", rc);
+            return BLE_ATT_ERR_UNLIKELY;
+        }
+
+        DLOGD(MODULE_TAG, "WRITE, handle=%d, conn_handle=%d, len=%d", attr_handle, conn_handle, length);
+
+        ble_write_evt_t write_evt = {
+            .handle = attr_handle,
+            .len = length,
+            .value = buffer,
+        };
+
+        ble_dispatch_write(&write_evt);
+
+        return 0;
+
+    default:
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+}
+
+
+/**
+ * @brief Called by host for every registered attribute (used for initialization of characteristic values)
+ *
+ * @param ctxt
+ * @param arg
+ */
+static void gatt_register_cb(struct ble_gatt_register_ctxt *ctxt, void *arg) {
+    if(ctxt->op == BLE_GATT_REGISTER_OP_CHR) {
+        ESP_LOGI(MODULE_TAG, "ADD_CHAR, def_handle=%d, val_handle=%d", ctxt->chr.def_handle, ctxt->chr.val_handle);
+
+        ble_dispatch_add_char(ctxt->chr.val_handle);
+    }
+}
+
+
+static int gap_event_handler(struct ble_gap_event *event, void *arg);
+
+
+/**
+ * @brief Starts advertising (with the same content as Bluedroid backend)
+ *
+ * @param peer Bonded central, to which advertising is directed for BLE_DIRECTED_ADV_MS (or NULL)
+ */
+static void start_advertising(const ble_addr_t *peer) {
+    static const ble_uuid16_t service_uuid = BLE_UUID16_INIT(GATTS_SERVICE_UUID_MORSE_CODE_RECEIVER);
+    struct ble_hs_adv_fields fields;
+    struct ble_gap_adv_params adv_params;
+    int rc;
+
+    memset(&fields, 0, sizeof(fields));
+    fields.flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
+    fields.tx_pwr_lvl_is_present = 1;
+    fields.tx_pwr_lvl = BLE_HS_ADV_TX_PWR_LVL_AUTO;
+    fields.uuids16 = &service_uuid; //< Clients can filter devices by the service
+    fields.num_uuids16 = 1;
+    fields.uuids16_is_complete = 1;
+
+    rc = ble_gap_adv_set_fields(&fields);
+    if(rc != 0) {
+        ESP_LOGE(MODULE_TAG, "%s: ble_gap_adv_set_fields failed (%d)", __func__, rc);
+        return;
+    }
+
+    memset(&fields, 0, sizeof(fields)); //< The name is in the scan response (there is no space for it)
+    fields.tx_pwr_lvl_is_present = 1;
+    fields.tx_pwr_lvl = BLE_HS_ADV_TX_PWR_LVL_AUTO;
+    fields.name = (uint8_t *)DEVICE_NAME;
+    fields.name_len = strlen(DEVICE_NAME);
+    fields.name_is_complete = 1;
+
+    rc = ble_gap_adv_rsp_set_fields(&fields);
+    if(rc != 0) {
+        ESP_LOGE(MODULE_TAG, "%s: ble_gap_adv_rsp_set_fields failed (%d)", __func__, rc);
+        return;
+    }
+
+    memset(&adv_params, 0, sizeof(adv_params));
+#ifdef BLE_DIRECTED_ADV
+    if(peer) {
+        adv_params.conn_mode = BLE_GAP_CONN_MODE_DIR; //< Only the last central can connect
+        adv_params.itvl_min = 0x20;
+        adv_params.itvl_max = 0x40;
+
+        rc = ble_gap_adv_start(own_addr_type, peer, BLE_DIRECTED_ADV_MS, &adv_params, gap_event_handler, NULL);
+        if(rc == 0) {
+            return; //< BLE_GAP_EVENT_ADV_COMPLETE comes after the timeout and undirected advertising starts
+        }
+
+        memset(&adv_params, 0, sizeof(adv_params));
+    }
+#endif
+
+    adv_params.conn_mode = BLE_GAP_CONN_MODE_UND; //< Accept connection from any central device
+    adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
+    adv_params.itvl_min = 0x20; //< 0x20 * 0.625 ms
+    adv_params.itvl_max = 0x40; //< 0x40 * 0.625 ms
+
+    rc = ble_gap_adv_start(own_addr_type, NULL, BLE_HS_FOREVER, &adv_params, gap_event_handler, NULL);
+    if(rc != 0) {
+        ESP_LOGE(MODULE_TAG, "%s: The starting of advertising failed (%d)", __func__, rc);
+        return;
+    }
+
+    if(!ble_stats.adv_ready_us) { //< The first advertising after boot (the stack is fully ready)
+        ble_stats.adv_ready_us = esp_timer_get_time();
+        ble_log_stats();
+    }
+}
+
+
+/**
+ * @brief Handling function for events that occurs on the GAP layer
+ *
+ * @param event
+ * @param arg
+ * @return int
+ */
+static int gap_event_handler(struct ble_gap_event *event, void *arg) {
+    struct ble_gap_conn_desc desc;
+    esp_err_t err;
+    int rc;
+
+    switch(event->type)
+    {
+    case BLE_GAP_EVENT_CONNECT:
+        ESP_LOGI(MODULE_TAG, "CONNECT_EVT, status=%d, conn_handle=%d", event->connect.status, event->connect.conn_handle);
+        if(event->connect.status != 0) { //< Connection failed -> advertise again
+            start_advertising(NULL);
+            break;
+        }
+
+        is_connected = true;
+        conn_handle_cur = event->connect.conn_handle;
+        memset(notify_enabled, 0, sizeof(notify_enabled));
+        ble_stats_reset_throughput();
+
+        err = gpio_set_level(CONNECTION_GPIO, 1);
+        ESP_ERROR_CHECK(err);
+
+        rc = ble_gap_set_data_len(conn_handle_cur, BLE_DATA_LEN_OCTETS, BLE_DATA_LEN_TIME_US); //< Longer link-layer packets
+        if(rc != 0) {
+            ESP_LOGE(MODULE_TAG, "%s: ble_gap_set_data_len failed (%d)", __func__, rc);
+        }
+
+#if CONFIG_BT_NIMBLE_50_FEATURE_SUPPORT
+        rc = ble_gap_set_prefered_le_phy( //< 2M PHY is preferred (it is supported only by BLE 5 controllers)
+            conn_handle_cur,
+            BLE_GAP_LE_PHY_2M_MASK,
+            BLE_GAP_LE_PHY_2M_MASK,
+            BLE_GAP_LE_PHY_CODED_ANY
+        );
+        if(rc != 0) {
+            ESP_LOGE(MODULE_TAG, "%s: ble_gap_set_prefered_le_phy failed (%d)", __func__, rc);
+        }
+#endif
+
+#ifdef BLE_BONDING
+        rc = ble_gap_security_initiate(conn_handle_cur); //< Pairs new central or only encrypts the link with stored keys
+        if(rc != 0) {
+            ESP_LOGE(MODULE_TAG, "%s: ble_gap_security_initiate failed (%d)", __func__, rc);
+        }
+#endif
+        break;
+
+    case BLE_GAP_EVENT_DISCONNECT: //< Remote disconnects -> start advertising again
+        ESP_LOGI(MODULE_TAG, "DISCONNECT_EVT, reason=%d", event->disconnect.reason);
+
+        is_connected = false;
+        memset(notify_enabled, 0, sizeof(notify_enabled));
+
+        err = gpio_set_level(CONNECTION_GPIO, 0);
+        ESP_ERROR_CHECK(err);
+
+        ble_log_stats();
+
+        start_advertising(event->disconnect.conn.sec_state.bonded ? &event->disconnect.conn.peer_id_addr : NULL);
+        break;
+
+    case BLE_GAP_EVENT_ADV_COMPLETE: //< Directed advertising timed out
+        start_advertising(NULL);
+        break;
+
+    case BLE_GAP_EVENT_ENC_CHANGE: //< Pairing or encryption with stored keys is done
+        if(event->enc_change.status != 0) {
+            ESP_LOGE(MODULE_TAG, "%s: Encryption failed (%d)", __func__, event->enc_change.status);
+            break;
+        }
+
+        ESP_LOGI(MODULE_TAG, "Link encrypted, conn_handle=%d", event->enc_change.conn_handle);
+        break;
+
+    case BLE_GAP_EVENT_REPEAT_PAIRING: //< Central lost its keys -> forget the old bond and pair again
+        rc = ble_gap_conn_find(event->repeat_pairing.conn_handle, &desc);
+        if(rc == 0) {
+            ble_store_util_delete_peer(&desc.peer_id_addr);
+        }
+
+        return BLE_GAP_REPEAT_PAIRING_RETRY;
+
+    case BLE_GAP_EVENT_CONN_UPDATE:
+        ESP_LOGI(MODULE_TAG, "Update of the connection parameters, status=%d", event->conn_update.status);
+        break;
+
+    case BLE_GAP_EVENT_SUBSCRIBE: //< Client changed configuration of notifications
+        ESP_LOGI(MODULE_TAG, "SUBSCRIBE_EVT, attr_handle=%d, notify=%d", event->subscribe.attr_handle, event->subscribe.cur_notify);
+        for(int i = 0; i < MORSE_CODE_REC_CHAR_NUM; i++) {
+            if(event->subscribe.attr_handle == morse_code_char_handle_tab[i]) {
+                notify_enabled[i] = event->subscribe.cur_notify;
+            }
+        }
+        break;
+
+    case BLE_GAP_EVENT_MTU: //< MTU was set
+        ESP_LOGI(MODULE_TAG, "MTU_EVT, mtu=%d", event->mtu.value);
+        ble_stats.mtu = event->mtu.value;
+        break;
+
+#ifdef BLE_GAP_EVENT_DATA_LEN_CHG
+    case BLE_GAP_EVENT_DATA_LEN_CHG: //< Data Length Extension was negotiated
+        ESP_LOGI(MODULE_TAG, "Data length set, tx_len=%d, rx_len=%d",
+            event->data_len_chg.max_tx_octets,
+            event->data_len_chg.max_rx_octets
+        );
+
+        ble_stats.tx_octets = event->data_len_chg.max_tx_octets;
+        ble_stats.rx_octets = event->data_len_chg.max_rx_octets;
+        break;
+#endif
+
+    case BLE_GAP_EVENT_PHY_UPDATE_COMPLETE: //< PHY of the connection was changed
+        ESP_LOGI(MODULE_TAG, "PHY updated, status=%d, tx_phy=%d, rx_phy=%d",
+            event->phy_updated.status,
+            event->phy_updated.tx_phy,
+            event->phy_updated.rx_phy
+        );
+
+        if(event->phy_updated.status == 0) {
+            ble_stats.tx_phy = event->phy_updated.tx_phy;
+            ble_stats.rx_phy = event->phy_updated.rx_phy;
+        }
+        break;
+
+    default:
+        ESP_LOGI(MODULE_TAG, "%s: Not handled GAP event came (code: %d)", __func__, event->type);
+        break;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Called when host and controller are synced (stack is ready)
+ *
+ */
+static void on_sync() {
+    int rc = ble_hs_util_ensure_addr(0);
+    if(rc != 0) {
+        ESP_LOGE(MODULE_TAG, "%s: ble_hs_util_ensure_addr failed (%d)", __func__, rc);
+        return;
+    }
+
+    rc = ble_hs_id_infer_auto(0, &own_addr_type);
+    if(rc != 0) {
+        ESP_LOGE(MODULE_TAG, "%s: ble_hs_id_infer_auto failed (%d)", __func__, rc);
+        return;
+    }
+
+    start_advertising(NULL);
+}
+
+
+static void on_reset(int reason) {
+    ESP_LOGE(MODULE_TAG, "Resetting state, reason=%d", reason);
+}
+
+
+/**
+ * @brief Task in which runs NimBLE host
+ *
+ * @param arg
+ */
+static void host_task(void *arg) {
+    nimble_port_run(); //< Returns only when nimble_port_stop is called
+
+    nimble_port_freertos_deinit();
+}
+
+
+esp_err_t ble_set_char_value(enum morse_code_rec_chars char_idx, const uint8_t *value, uint16_t len) {
+    if(len > CHAR_VALUE_MAX_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memcpy(char_value_tab[char_idx], value, len);
+    char_value_len_tab[char_idx] = len;
+
+    return ESP_OK;
+}
+
+
+bool ble_is_connected() {
+    return is_connected;
+}
+
+
+esp_err_t ble_notify(enum morse_code_rec_chars char_idx, const uint8_t *value, uint16_t len) {
+    if(!is_connected || !notify_enabled[char_idx]) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    struct os_mbuf *om = ble_hs_mbuf_from_flat(value, len);
+    if(!om) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    int rc = ble_gatts_notify_custom(conn_handle_cur, morse_code_char_handle_tab[char_idx], om); //< Consumes the mbuf
+    return rc == 0 ? ESP_OK : ESP_FAIL;
+}
+
+
+esp_err_t bluetooth_init(void (*write_event_handler_func)(ble_write_evt_t *), void (*add_char_cb_func)(uint16_t)) {
+    esp_err_t err;
+    int rc;
+
+    ble_stats.init_start_us = esp_timer_get_time();
+    ble_stats.heap_before = esp_get_free_heap_size();
+
+    esp_rom_gpio_pad_select_gpio(CONNECTION_GPIO);
+    err = gpio_set_direction(CONNECTION_GPIO, GPIO_MODE_OUTPUT);
+    ESP_ERROR_CHECK(err);
+
+    err = gpio_set_level(CONNECTION_GPIO, 0);
+    ESP_ERROR_CHECK(err);
+
+    err = nimble_port_init(); //< Initializes controller and NimBLE host
+    if(err != ESP_OK) {
+        ESP_LOGE(MODULE_TAG, "%s: nimble_port_init failed (%s)", __func__, esp_err_to_name(err));
+        return err;
+    }
+
+    ble_register_callbacks(write_event_handler_func, add_char_cb_func);
+
+    ble_hs_cfg.sync_cb = on_sync;
+    ble_hs_cfg.reset_cb = on_reset;
+    ble_hs_cfg.gatts_register_cb = gatt_register_cb;
+    ble_hs_cfg.store_status_cb = ble_store_util_status_rr; //< The oldest bond is deleted, when the storage is full
+
+#ifdef BLE_BONDING
+    ble_hs_cfg.sm_io_cap = BLE_SM_IO_CAP_NO_IO; //< Just Works pairing (there is no display or keyboard)
+    ble_hs_cfg.sm_bonding = 1;
+    ble_hs_cfg.sm_sc = 1;
+    ble_hs_cfg.sm_our_key_dist = BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID; //< LTK and IRK
+    ble_hs_cfg.sm_their_key_dist = BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID;
+#endif
+
+    ble_svc_gap_init();
+    ble_svc_gatt_init();
+
+    rc = ble_gatts_count_cfg(gatt_svcs);
+    if(rc != 0) {
+        ESP_LOGE(MODULE_TAG, "%s: ble_gatts_count_cfg failed (%d)", __func__, rc);
+        return ESP_FAIL;
+    }
+
+    rc = ble_gatts_add_svcs(gatt_svcs);
+    if(rc != 0) {
+        ESP_LOGE(MODULE_TAG, "%s: ble_gatts_add_svcs failed (%d)", __func__, rc);
+        return ESP_FAIL;
+    }
+
+    rc = ble_svc_gap_device_name_set(DEVICE_NAME); //Set the name of this device
+    if(rc != 0) {
+        ESP_LOGE(MODULE_TAG, "%s: ble_svc_gap_device_name_set failed (%d)", __func__, rc);
+        return ESP_FAIL;
+    }
+
+    ble_store_config_init();
+
+    rc = ble_att_set_preferred_mtu(BLE_LOCAL_MTU);
+    if(rc != 0) {
+        ESP_LOGE(MODULE_TAG, "%s: ble_att_set_preferred_mtu failed (%d)", __func__, rc);
+        return ESP_FAIL;
+    }
+
+    nimble_port_freertos_init(host_task);
+
+    ble_stats.init_done_us = esp_timer_get_time();
+    ble_stats.heap_after = esp_get_free_heap_size();
+
+    return ESP_OK;
+}
+
+//End of the part based on https://github.com/espressif/esp-idf/tree/master/examples/bluetooth/nimble/bleprph
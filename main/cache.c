@@ -0,0 +1,290 @@
+/**
+ * @file cache.c
+ *
+ * @brief Cache of compiled messages (repeated message is played without translation)
+ *
+ * Messages are compiled to out controls (the last out control of every letter is marked by OUT_ITEM_END, so the spool
+ * counts played letters as for translated messages). When the cache is full, the least recently used message that
+ * is not waiting in the letter queue is removed.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "cache.h"
+#include "dlog.h"
+
+
+/**
+ * @brief Cached message
+ *
+ */
+typedef struct cache_entry {
+    bool used; //< Slot contains the message
+    uint32_t hash; //< Hash of letters of the message
+    uint16_t len; //< Number of letters
+    uint16_t records; //< Number of out controls
+    uint16_t queued; //< Number of items of this message in the letter queue (message cannot be removed if it is not 0)
+    uint32_t last_used; //< Value of the use clock, when the message was used for the last time
+    out_control_t *out_c; //< Compiled message (followed by letters in the same allocation)
+} cache_entry_t;
+
+
+static SemaphoreHandle_t cache_mutex = NULL;
+
+static cache_entry_t entries[CACHE_SLOTS];
+static int playing_slot = -1; //< Slot of the message that is just played by translator
+static uint32_t use_clock = 0;
+
+static cache_stats_t stats = { 0 };
+
+
+/**
+ * @brief Computes FNV-1a hash of the letters
+ *
+ * @param letters Letters
+ * @param len Number of letters
+ * @return uint32_t Hash
+ */
+static uint32_t cache_hash(const char *letters, size_t len) {
+    uint32_t hash = 2166136261UL;
+
+    for(size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)letters[i];
+        hash *= 16777619UL;
+    }
+
+    return hash;
+}
+
+
+/**
+ * @brief Returns the size of the message in the cache
+ *
+ * @param e Cached message
+ * @return size_t Size in bytes
+ */
+static inline size_t cache_entry_size(const cache_entry_t *e) {
+    return e->records * sizeof(out_control_t) + e->len;
+}
+
+
+/**
+ * @brief Removes the message from the cache (mutex must be taken)
+ *
+ * @param e Cached message
+ */
+static void cache_evict(cache_entry_t *e) {
+    stats.bytes -= cache_entry_size(e);
+    stats.evictions++;
+
+    free(e->out_c);
+    e->out_c = NULL;
+    e->used = false;
+}
+
+
+/**
+ * @brief Finds free slot for the message of given size, removes least recently used messages if it is necessary
+ * (mutex must be taken)
+ *
+ * @param size Size of the new message
+ * @return int Free slot or -1 if there is not enough space
+ */
+static int cache_make_room(size_t size) {
+    while(1) {
+        int free_slot = -1, lru_slot = -1;
+
+        for(int i = 0; i < CACHE_SLOTS; i++) {
+            if(!entries[i].used) {
+                free_slot = i;
+            }
+            else if(!entries[i].queued && i != playing_slot &&
+                    (lru_slot < 0 || entries[i].last_used - entries[lru_slot].last_used > UINT32_MAX / 2)) {
+                lru_slot = i; //Difference is used because the clock can overflow
+            }
+        }
+
+        if(free_slot >= 0 && stats.bytes + size <= CACHE_BUDGET_BYTES) {
+            return free_slot;
+        }
+
+        if(lru_slot < 0) { //Everything is waiting for playback
+            return -1;
+        }
+
+        cache_evict(&entries[lru_slot]);
+    }
+}
+
+
+/**
+ * @brief Compiles the message and stores it to the cache (mutex must be taken)
+ *
+ * @param letters Letters of the message
+ * @param len Number of letters
+ * @param hash Hash of letters
+ * @return int Slot of the message or -1 if the message was not stored
+ */
+static int cache_insert(const char *letters, size_t len, uint32_t hash) {
+    size_t records = 0;
+    for(size_t i = 0; i < len; i++) {
+        const char *morse_code = char_lookup(do_char_correction(letters[i]));
+        records += morse_code ? strlen(morse_code) : 0;
+    }
+
+    size_t size = records * sizeof(out_control_t) + len;
+    if(!records || size > CACHE_BUDGET_BYTES) {
+        return -1;
+    }
+
+    int slot = cache_make_room(size);
+    if(slot < 0) {
+        return -1;
+    }
+
+    out_control_t *out_c = malloc(size);
+    if(!out_c) {
+        DLOGE(CACHE_TAG, "Unable to allocate %u bytes for the message!", (unsigned)size);
+        return -1;
+    }
+
+    size_t r = 0;
+    for(size_t i = 0; i < len; i++) {
+        size_t letter_len = compile_letter(letters[i], &out_c[r], records - r);
+        if(letter_len) {
+            r += letter_len;
+            out_c[r - 1].flags |= OUT_ITEM_END; //Every letter is counted as played separately
+        }
+    }
+
+    memcpy(&out_c[records], letters, len);
+
+    entries[slot] = (cache_entry_t){
+        .used = true,
+        .hash = hash,
+        .len = len,
+        .records = records,
+        .queued = 0,
+        .out_c = out_c,
+    };
+
+    stats.bytes += size;
+
+    return slot;
+}
+
+
+int cache_acquire(const char *letters, size_t len) {
+    int slot = -1;
+
+    if(len < CACHE_MIN_LEN || len > CACHE_MAX_LEN) {
+        return -1;
+    }
+
+    uint32_t hash = cache_hash(letters, len);
+
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+
+    for(int i = 0; i < CACHE_SLOTS; i++) {
+        cache_entry_t *e = &entries[i];
+        if(e->used && e->hash == hash && e->len == len && !memcmp(&e->out_c[e->records], letters, len)) {
+            slot = i;
+            break;
+        }
+    }
+
+    if(slot >= 0) {
+        stats.hits++;
+    }
+    else {
+        stats.misses++;
+        slot = cache_insert(letters, len, hash);
+    }
+
+    if(slot >= 0) {
+        entries[slot].queued++;
+        entries[slot].last_used = ++use_clock;
+    }
+
+    cache_stats_t cur = stats;
+
+    xSemaphoreGive(cache_mutex);
+
+    if((cur.hits + cur.misses) % CACHE_STATS_PERIOD == 0) {
+        DLOGI(CACHE_TAG, "Hits %lu, misses %lu, evictions %lu, %lu bytes",
+            (unsigned long)cur.hits, (unsigned long)cur.misses, (unsigned long)cur.evictions, (unsigned long)cur.bytes);
+    }
+
+    return slot;
+}
+
+
+void cache_release(int slot) {
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+
+    if(entries[slot].queued) {
+        entries[slot].queued--;
+    }
+
+    xSemaphoreGive(cache_mutex);
+}
+
+
+esp_err_t cache_play(int slot) {
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+
+    cache_entry_t *e = &entries[slot];
+    if(!e->used) { //It can happen only after abort
+        xSemaphoreGive(cache_mutex);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if(e->queued) {
+        e->queued--;
+    }
+
+    playing_slot = slot; //Message cannot be removed during playback
+    uint16_t records = e->records;
+
+    xSemaphoreGive(cache_mutex);
+
+    send_compiled(e->out_c, records);
+
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    playing_slot = -1;
+    xSemaphoreGive(cache_mutex);
+
+    DLOGD(CACHE_TAG, "Message %d played (%u out controls)", slot, records);
+
+    return ESP_OK;
+}
+
+
+void cache_abort() {
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+
+    for(int i = 0; i < CACHE_SLOTS; i++) {
+        entries[i].queued = 0;
+    }
+
+    xSemaphoreGive(cache_mutex);
+}
+
+
+void cache_get_stats(cache_stats_t *out) {
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    *out = stats;
+    xSemaphoreGive(cache_mutex);
+}
+
+
+esp_err_t cache_init() {
+    cache_mutex = xSemaphoreCreateMutex();
+    if(!cache_mutex) {
+        ESP_LOGE(CACHE_TAG, "Unable to create mutex for cache!");
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
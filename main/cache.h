@@ -0,0 +1,106 @@
+/**
+ * @file cache.h
+ *
+ * @brief Cache of compiled messages (repeated message is played without translation)
+ *
+ * Message is looked up by hash of its letters, compiled message is played by one item in the letter queue
+ * (control character CACHE_ITEM(slot)) as macros are.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __CACHE__
+#define __CACHE__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_log.h"
+
+#include "translator.h"
+
+
+#define CACHE_TAG "CACHE" //< Module name
+
+#define MESSAGE_CACHE //< Enables cache of compiled messages
+
+#define CACHE_SLOTS 8 //< Maximum number of cached messages
+#define CACHE_BUDGET_BYTES 8192 //< Maximum size of all cached messages (out controls and letters)
+#define CACHE_MIN_LEN 4 //< Shorter messages are not cached (translation of them is cheap)
+#define CACHE_MAX_LEN 256 //< Longer messages are not cached (they are translated letter by letter)
+#define CACHE_STATS_PERIOD 64 //< Statistics are printed after every CACHE_STATS_PERIOD lookups
+
+#define CACHE_ITEM_BASE 0x01 //< Items 0x01 - 0x08 in the letter queue are cached messages
+#define CACHE_ITEM(slot) ((char)(CACHE_ITEM_BASE + (slot)))
+#define CACHE_IS_ITEM(ch) ((uint8_t)(ch) >= CACHE_ITEM_BASE && (uint8_t)(ch) < CACHE_ITEM_BASE + CACHE_SLOTS)
+#define CACHE_ITEM_SLOT(ch) ((uint8_t)(ch) - CACHE_ITEM_BASE)
+
+
+/**
+ * @brief Statistics of the cache (for tuning of its size)
+ *
+ */
+typedef struct cache_stats {
+    uint32_t hits; //< Messages found in the cache
+    uint32_t misses; //< Messages that had to be compiled
+    uint32_t evictions; //< Messages removed from the cache because of its size
+    uint32_t bytes; //< Current size of cached messages
+} cache_stats_t;
+
+
+/**
+ * @brief Finds the message in the cache (or compiles it and adds it to the cache), the slot is reserved until
+ * its item is played or cache_release is called
+ *
+ * @param letters Letters of the message (only letters that can be translated)
+ * @param len Number of letters
+ * @return int Slot with the compiled message or -1 if message cannot be cached
+ */
+int cache_acquire(const char *letters, size_t len);
+
+
+/**
+ * @brief Releases the slot reserved by cache_acquire (when its item was not passed to the letter queue)
+ *
+ * @param slot Slot of the message
+ */
+void cache_release(int slot);
+
+
+/**
+ * @brief Passes out controls of the cached message to the out control queue (it should be called only by translator)
+ *
+ * @param slot Slot of the message
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t cache_play(int slot);
+
+
+/**
+ * @brief Releases all reserved slots (when the letter queue is reset)
+ *
+ */
+void cache_abort();
+
+
+/**
+ * @brief Returns the statistics of the cache
+ *
+ * @param stats Output argument
+ */
+void cache_get_stats(cache_stats_t *stats);
+
+
+/**
+ * @brief Initializes the cache
+ *
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t cache_init();
+
+#endif
@@ -0,0 +1,177 @@
+/**
+ * @file charset.c
+ *
+ * @brief Lookup tables of the translator (GENERATED by gen_charset.py, do not edit it manually!)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "charset.h"
+#include <stddef.h>
+
+
+const char *const charset_morse[256] = {
+    [0x20] = "/",
+    [0x21] = "-.-.--",
+    [0x22] = ".-..-.",
+    [0x24] = "...-..-",
+    [0x26] = ".-...",
+    [0x27] = ".----.",
+    [0x28] = "-.--.",
+    [0x29] = "-.--.-",
+    [0x2b] = ".-.-.",
+    [0x2c] = "--..--",
+    [0x2d] = "-....-",
+    [0x2e] = "//",
+    [0x2f] = "-..-.",
+    [0x30] = "-----",
+    [0x31] = ".----",
+    [0x32] = "..---",
+    [0x33] = "...--",
+    [0x34] = "....-",
+    [0x35] = ".....",
+    [0x36] = "-....",
+    [0x37] = "--...",
+    [0x38] = "---..",
+    [0x39] = "----.",
+    [0x3a] = "---...",
+    [0x3b] = "-.-.-.",
+    [0x3d] = "-...-",
+    [0x3f] = "..--..",
+    [0x40] = ".--.-.",
+    [0x5f] = "..--.-",
+    [0x61] = ".-",
+    [0x62] = "-...",
+    [0x63] = "-.-.",
+    [0x64] = "-..",
+    [0x65] = ".",
+    [0x66] = "..-.",
+    [0x67] = "--.",
+    [0x68] = "....",
+    [0x69] = "..",
+    [0x6a] = ".---",
+    [0x6b] = "-.-",
+    [0x6c] = ".-..",
+    [0x6d] = "--",
+    [0x6e] = "-.",
+    [0x6f] = "---",
+    [0x70] = ".--.",
+    [0x71] = "--.-",
+    [0x72] = ".-.",
+    [0x73] = "...",
+    [0x74] = "-",
+    [0x75] = "..-",
+    [0x76] = "...-",
+    [0x77] = ".--",
+    [0x78] = "-..-",
+    [0x79] = "-.--",
+    [0x7a] = "--..",
+    [0x80] = "-...-.-",
+    [0x81] = "-.-..-..",
+    [0x82] = "-.-.-",
+    [0x83] = "-..---",
+    [0x84] = "........",
+    [0x85] = "...-.-",
+    [0x86] = "...-.",
+    [0x87] = "...---...",
+    [0x88] = "---.",
+    [0x89] = "----",
+    [0x8a] = "--.--",
+    [0x8b] = "..-..",
+    [0x8c] = "..--",
+    [0x8d] = ".-.-",
+    [0x8e] = ".---.",
+    [0x8f] = ".-.-.-",
+    [0x90] = ".-.-..",
+    [0x91] = "-.---",
+    [0x92] = "-.-..",
+    [0x93] = "--.-.",
+    [0x94] = "---.-",
+    [0x95] = ".-.--",
+    [0x96] = "..--.",
+    [0x97] = "--..-",
+    [0x98] = "..-.-",
+    [0x99] = "-..--",
+    [0x9a] = ".-..-",
+    [0x9b] = ".--..",
+    [0x9c] = ".--.-",
+};
+
+
+const uint16_t charset_latin[] = {
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0061, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x006f, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0061, 0x0061, 0x0061, 0x0061, 0x0061, 0x0061, 0x6561, 0x0063, 0x0065, 0x0065, 0x0065, 0x0065, 0x0069, 0x0069, 0x0069, 0x0069,
+    0x0064, 0x006e, 0x006f, 0x006f, 0x006f, 0x006f, 0x006f, 0x0000, 0x006f, 0x0075, 0x0075, 0x0075, 0x0075, 0x0079, 0x6874, 0x7373,
+    0x0061, 0x0061, 0x0061, 0x0061, 0x0061, 0x0061, 0x6561, 0x0063, 0x0065, 0x0065, 0x0065, 0x0065, 0x0069, 0x0069, 0x0069, 0x0069,
+    0x0064, 0x006e, 0x006f, 0x006f, 0x006f, 0x006f, 0x006f, 0x0000, 0x006f, 0x0075, 0x0075, 0x0075, 0x0075, 0x0079, 0x6874, 0x0079,
+    0x0061, 0x0061, 0x0061, 0x0061, 0x0061, 0x0061, 0x0063, 0x0063, 0x0063, 0x0063, 0x0063, 0x0063, 0x0063, 0x0063, 0x0064, 0x0064,
+    0x0064, 0x0064, 0x0065, 0x0065, 0x0065, 0x0065, 0x0065, 0x0065, 0x0065, 0x0065, 0x0065, 0x0065, 0x0067, 0x0067, 0x0067, 0x0067,
+    0x0067, 0x0067, 0x0067, 0x0067, 0x0068, 0x0068, 0x0068, 0x0068, 0x0069, 0x0069, 0x0069, 0x0069, 0x0069, 0x0069, 0x0069, 0x0069,
+    0x0069, 0x0069, 0x6a69, 0x6a69, 0x006a, 0x006a, 0x006b, 0x006b, 0x0000, 0x006c, 0x006c, 0x006c, 0x006c, 0x006c, 0x006c, 0x006c,
+    0x006c, 0x006c, 0x006c, 0x006e, 0x006e, 0x006e, 0x006e, 0x006e, 0x006e, 0x006e, 0x0000, 0x0000, 0x006f, 0x006f, 0x006f, 0x006f,
+    0x006f, 0x006f, 0x656f, 0x656f, 0x0072, 0x0072, 0x0072, 0x0072, 0x0072, 0x0072, 0x0073, 0x0073, 0x0073, 0x0073, 0x0073, 0x0073,
+    0x0073, 0x0073, 0x0074, 0x0074, 0x0074, 0x0074, 0x0000, 0x0000, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075,
+    0x0075, 0x0075, 0x0075, 0x0075, 0x0077, 0x0077, 0x0079, 0x0079, 0x0079, 0x007a, 0x007a, 0x007a, 0x007a, 0x007a, 0x007a, 0x0073,
+};
+
+
+const uint16_t charset_cyrillic[] = {
+    0x0000, 0x0065, 0x0000, 0x0000, 0x008b, 0x0000, 0x0069, 0x008e, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0061, 0x0062, 0x0077, 0x0067, 0x0064, 0x0065, 0x0076, 0x007a, 0x0069, 0x006a, 0x006b, 0x006c, 0x006d, 0x006e, 0x006f, 0x0070,
+    0x0072, 0x0073, 0x0074, 0x0075, 0x0066, 0x0068, 0x0063, 0x0088, 0x0089, 0x0071, 0x008a, 0x0079, 0x0078, 0x008b, 0x008c, 0x008d,
+    0x0061, 0x0062, 0x0077, 0x0067, 0x0064, 0x0065, 0x0076, 0x007a, 0x0069, 0x006a, 0x006b, 0x006c, 0x006d, 0x006e, 0x006f, 0x0070,
+    0x0072, 0x0073, 0x0074, 0x0075, 0x0066, 0x0068, 0x0063, 0x0088, 0x0089, 0x0071, 0x008a, 0x0079, 0x0078, 0x008b, 0x008c, 0x008d,
+    0x0000, 0x0065, 0x0000, 0x0000, 0x008b, 0x0000, 0x0069, 0x008e, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0067, 0x0067,
+};
+
+
+const uint16_t charset_kana[] = {
+    0x0000, 0x008f, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0090, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x008a, 0x008a, 0x0061, 0x0061, 0x0075, 0x0075, 0x0091, 0x0091, 0x0026, 0x0026, 0x006c, 0x696c, 0x0092, 0x6992, 0x0076,
+    0x6976, 0x0079, 0x6979, 0x0089, 0x6989, 0x0082, 0x6982, 0x0093, 0x6993, 0x0094, 0x6994, 0x008e, 0x698e, 0x0088, 0x6988, 0x006e,
+    0x696e, 0x0066, 0x6966, 0x0070, 0x0070, 0x6970, 0x0095, 0x6995, 0x008b, 0x698b, 0x0072, 0x0063, 0x0068, 0x0071, 0x008c, 0x0062,
+    0x6962, 0x9662, 0x0097, 0x6997, 0x9697, 0x007a, 0x697a, 0x967a, 0x0065, 0x6965, 0x9665, 0x0064, 0x6964, 0x9664, 0x0078, 0x0098,
+    0x0074, 0x003d, 0x002f, 0x0077, 0x0077, 0x0099, 0x0099, 0x006d, 0x006d, 0x0073, 0x0067, 0x0028, 0x006f, 0x008d, 0x006b, 0x006b,
+    0x009a, 0x009b, 0x006a, 0x002b, 0x6975, 0x006c, 0x0079, 0x0000, 0x0000, 0x0000, 0x0000, 0x0069, 0x0096, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x008a, 0x008a, 0x0061, 0x0061, 0x0075, 0x0075, 0x0091, 0x0091, 0x0026, 0x0026, 0x006c, 0x696c, 0x0092, 0x6992, 0x0076,
+    0x6976, 0x0079, 0x6979, 0x0089, 0x6989, 0x0082, 0x6982, 0x0093, 0x6993, 0x0094, 0x6994, 0x008e, 0x698e, 0x0088, 0x6988, 0x006e,
+    0x696e, 0x0066, 0x6966, 0x0070, 0x0070, 0x6970, 0x0095, 0x6995, 0x008b, 0x698b, 0x0072, 0x0063, 0x0068, 0x0071, 0x008c, 0x0062,
+    0x6962, 0x9662, 0x0097, 0x6997, 0x9697, 0x007a, 0x697a, 0x967a, 0x0065, 0x6965, 0x9665, 0x0064, 0x6964, 0x9664, 0x0078, 0x0098,
+    0x0074, 0x003d, 0x002f, 0x0077, 0x0077, 0x0099, 0x0099, 0x006d, 0x006d, 0x0073, 0x0067, 0x0028, 0x006f, 0x008d, 0x006b, 0x006b,
+    0x009a, 0x009b, 0x006a, 0x002b, 0x6975, 0x006c, 0x0079, 0x696b, 0x699a, 0x699b, 0x696a, 0x0000, 0x009c, 0x0000, 0x0000, 0x0089,
+};
+
+
+const uint16_t charset_punctuation[] = {
+    0x002d, 0x002d, 0x002d, 0x002d, 0x002d, 0x0000, 0x0000, 0x0000, 0x0027, 0x0027, 0x002c, 0x0000, 0x0022, 0x0022, 0x0022, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x002e, 0x0000,
+};
+
+
+const charset_prosign_t charset_prosigns[] = {
+    { .name = "AR", .code = 0x2b },
+    { .name = "AS", .code = 0x26 },
+    { .name = "BK", .code = 0x80 },
+    { .name = "BT", .code = 0x3d },
+    { .name = "CL", .code = 0x81 },
+    { .name = "CT", .code = 0x82 },
+    { .name = "DO", .code = 0x83 },
+    { .name = "HH", .code = 0x84 },
+    { .name = "KN", .code = 0x28 },
+    { .name = "SK", .code = 0x85 },
+    { .name = "SN", .code = 0x86 },
+    { .name = "SOS", .code = 0x87 },
+};
+
+const unsigned charset_prosign_num = sizeof(charset_prosigns) / sizeof(charset_prosigns[0]);
@@ -0,0 +1,53 @@
+/**
+ * @file charset.h
+ *
+ * @brief Lookup tables of the translator (GENERATED by gen_charset.py, do not edit it manually!)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __CHARSET__
+#define __CHARSET__
+
+#include <stdint.h>
+
+
+#define CHARSET_EXT_BASE 0x80 //< The first code of symbols, that are not in ASCII
+#define CHARSET_PROSIGN_MAX_LEN 3 //< Maximum length of the name of the prosign
+
+#define CHARSET_CODE_DO 0x83 //< Prosign, that switches to Wabun code
+#define CHARSET_CODE_SN 0x86 //< Prosign, that returns from Wabun code
+
+//Ranges of code points covered by mapping tables (entry contains up to two codes, the first one is in the lower byte)
+#define CHARSET_LATIN_FIRST 0x0080
+#define CHARSET_LATIN_LAST 0x017f
+#define CHARSET_CYRILLIC_FIRST 0x0400
+#define CHARSET_CYRILLIC_LAST 0x0491
+#define CHARSET_KANA_FIRST 0x3000
+#define CHARSET_KANA_LAST 0x30ff
+#define CHARSET_PUNCTUATION_FIRST 0x2010
+#define CHARSET_PUNCTUATION_LAST 0x2027
+
+
+/**
+ * @brief Prosign, that can be written as <NAME> in the message
+ *
+ */
+typedef struct charset_prosign {
+    char name[CHARSET_PROSIGN_MAX_LEN + 1];
+    uint8_t code;
+} charset_prosign_t;
+
+
+extern const char *const charset_morse[256]; //< Morse codes of codes (NULL if code cannot be played)
+
+extern const uint16_t charset_latin[]; //< Latin letters with diacritics (transliterated)
+extern const uint16_t charset_cyrillic[]; //< Cyrillic letters
+extern const uint16_t charset_kana[]; //< Katakana and hiragana (Wabun code)
+extern const uint16_t charset_punctuation[]; //< Typographic punctuation
+
+extern const charset_prosign_t charset_prosigns[];
+extern const unsigned charset_prosign_num;
+
+#endif
@@ -0,0 +1,339 @@
+/**
+ * @file decoder.c
+ *
+ * @brief Decoder of morse code from audio (ADC input, tone detection by Goertzel filter)
+ *
+ * Samples are read from ADC in continuous (DMA) mode and processed block by block by fixed-point Goertzel filter.
+ * Powers of the blocks are compared with adaptive threshold (between noise and signal level), the lengths of tones
+ * and gaps are compared with adaptive estimation of the dot length and decoded symbols are translated
+ * by the morse code tree. Nothing is allocated during the processing.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "decoder.h"
+#include <math.h>
+#include "esp_cpu.h"
+
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define DECODER_OUTPUT_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define DECODER_GET_DATA(p) ((p)->type1.data)
+#else
+#define DECODER_OUTPUT_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define DECODER_GET_DATA(p) ((p)->type2.data)
+#endif
+
+#define BLOCK_US ((uint32_t)((uint64_t)DECODER_BLOCK_LEN * 1000000 / DECODER_SAMPLE_FREQ)) //< Length of one block
+
+
+/**
+ * @brief State of the Goertzel filter and tone detector
+ *
+ */
+typedef struct goertzel {
+    int32_t coeff; //< 2*cos(2*pi*f/fs) in Q14
+    int32_t s1, s2; //< Delayed outputs of the filter
+    int32_t dc; //< Estimation of the DC offset of the input (Q8)
+    uint16_t n; //< Number of samples in the current block
+    uint32_t noise; //< Adaptive level of noise power
+    uint32_t signal; //< Adaptive level of tone power
+} goertzel_t;
+
+
+/**
+ * @brief State of the timing decoder
+ *
+ */
+typedef struct timing {
+    bool key_down; //< Is tone present?
+    uint32_t run_us; //< Duration of the current state (tone or gap)
+    uint32_t dot_us; //< Adaptive estimation of the dot length
+    unsigned symbol_idx; //< Currently decoded symbol (index to the morse code tree)
+    bool word_pending; //< Letter was emitted, but the gap between words was not
+} timing_t;
+
+
+static goertzel_t goertzel;
+static timing_t timing;
+
+static adc_continuous_handle_t adc_handle = NULL;
+static TaskHandle_t decoder_handle = NULL;
+
+static uint8_t adc_frame[DECODER_FRAME_LEN * SOC_ADC_DIGI_RESULT_BYTES]; //< Buffer for samples from ADC
+
+static uint64_t consumed_cycles = 0; //< CPU cycles spent by processing since the last statistics
+static uint32_t processed_samples = 0; //< Processed samples since the last statistics
+
+
+/**
+ * @brief Passes the decoded character to the client
+ *
+ * @param ch Decoded character
+ */
+static void decoder_emit(char ch) {
+    DLOGI(DECODER_TAG, "Decoded '%c'", ch);
+
+    ble_set_char_value(DECODED_CHAR, (uint8_t *)&ch, 1);
+    ble_notify(DECODED_CHAR, (uint8_t *)&ch, 1);
+}
+
+
+/**
+ * @brief Processes the end of the tone (classifies it as dot or dash and adapts the speed estimation)
+ *
+ * @param t Timing decoder
+ */
+static void timing_tone_end(timing_t *t) {
+    uint32_t d = t->run_us;
+
+    if(d < DECODER_MIN_DOT_MS * 1000) { //Too short to be a dot, it is probably a glitch
+        return;
+    }
+
+    bool is_dash = d > 2 * t->dot_us;
+    uint32_t dot_sample = is_dash ? d / DASH_BUZZER_INT : d;
+
+    //Dot is the shortest element, so the estimation follows shorter elements faster (otherwise dashes classified as dots
+    //after the change of speed keep the estimation above the half of the dash and it never recovers)
+    if(dot_sample < t->dot_us) {
+        t->dot_us = (t->dot_us + dot_sample) / 2;
+    }
+    else {
+        t->dot_us = (7 * t->dot_us + dot_sample) / 8;
+    }
+
+    if(t->dot_us < DECODER_MIN_DOT_MS * 1000) {
+        t->dot_us = DECODER_MIN_DOT_MS * 1000;
+    }
+    else if(t->dot_us > DECODER_MAX_DOT_MS * 1000) {
+        t->dot_us = DECODER_MAX_DOT_MS * 1000;
+    }
+
+    if(t->symbol_idx < MORSE_TREE_SIZE) {
+        t->symbol_idx = MORSE_TREE_NEXT(t->symbol_idx, is_dash);
+    }
+}
+
+
+/**
+ * @brief Checks the length of the current gap and emits finished letters and words
+ *
+ * @param t Timing decoder
+ */
+static void timing_gap(timing_t *t) {
+    if(t->symbol_idx != MORSE_TREE_ROOT && t->run_us >= 2 * t->dot_us) { //Gap is closer to the letter gap than to element gap
+        char ch = morse_tree_lookup(t->symbol_idx);
+        if(ch) {
+            decoder_emit(ch);
+        }
+
+        t->symbol_idx = MORSE_TREE_ROOT;
+        t->word_pending = true;
+    }
+    else if(t->word_pending && t->run_us >= 5 * t->dot_us) { //Gap is closer to the word gap than to the letter gap
+        decoder_emit(' ');
+
+        t->word_pending = false;
+    }
+}
+
+
+/**
+ * @brief Processes the result of one block (presence of the tone)
+ *
+ * @param t Timing decoder
+ * @param tone Is the tone present in the block?
+ */
+static void timing_block(timing_t *t, bool tone) {
+    if(tone == t->key_down) {
+        t->run_us += BLOCK_US;
+
+        if(!tone) {
+            timing_gap(t);
+        }
+
+        return;
+    }
+
+    if(t->key_down) {
+        timing_tone_end(t);
+    }
+
+    t->key_down = tone;
+    t->run_us = BLOCK_US;
+}
+
+
+/**
+ * @brief Decides if the tone is present in the block by adaptive threshold
+ *
+ * @param g Goertzel filter
+ * @param power Power of the block
+ * @param key_down Was the tone present in the previous block? (for hysteresis)
+ * @return true if tone is present
+ */
+static bool goertzel_detect(goertzel_t *g, uint32_t power, bool key_down) {
+    uint32_t span = g->signal > g->noise ? g->signal - g->noise : 0;
+    uint32_t threshold = g->noise + (key_down ? span / 3 : span / 2);
+
+    bool tone = power > threshold && (uint64_t)power > (uint64_t)g->noise * DECODER_MIN_SNR;
+
+    if(tone) { //Fast attack of the signal level
+        g->signal = (uint32_t)(((int64_t)g->signal * 3 + power) / 4);
+    }
+    else { //Slow adaptation of the noise level, signal level slowly decays to detect weaker signals
+        g->noise = (uint32_t)(((int64_t)g->noise * 15 + power) / 16);
+        if(g->signal > g->noise) { //Noise can rise above the signal (it is clamped below)
+            g->signal -= (g->signal - g->noise) / 256;
+        }
+    }
+
+    if(g->noise == 0) {
+        g->noise = 1;
+    }
+
+    if(g->signal < g->noise) {
+        g->signal = g->noise;
+    }
+
+    return tone;
+}
+
+
+/**
+ * @brief Processes one sample by Goertzel filter
+ *
+ * @param g Goertzel filter
+ * @param sample Raw sample from ADC
+ * @param power Output argument, power of the block if it is finished
+ * @return true if block is finished
+ */
+static inline bool goertzel_sample(goertzel_t *g, int32_t sample, uint32_t *power) {
+    g->dc += ((sample << 8) - g->dc) >> 6; //Remove DC offset of the input
+    int32_t x = sample - (g->dc >> 8);
+
+    int32_t s0 = x + (int32_t)(((int64_t)g->coeff * g->s1) >> 14) - g->s2;
+    g->s2 = g->s1;
+    g->s1 = s0;
+
+    if(++g->n < DECODER_BLOCK_LEN) {
+        return false;
+    }
+
+    int64_t s1 = g->s1, s2 = g->s2;
+    int64_t p = s1 * s1 + s2 * s2 - ((g->coeff * s1 >> 14) * s2);
+
+    *power = (uint32_t)((p < 0 ? 0 : p) >> 16);
+
+    g->s1 = g->s2 = 0;
+    g->n = 0;
+
+    return true;
+}
+
+
+/**
+ * @brief Processes the frame with samples from ADC
+ *
+ * @param frame Buffer with samples
+ * @param len Length of the buffer in bytes
+ */
+static void decoder_process(const uint8_t *frame, uint32_t len) {
+    uint32_t power;
+
+    for(uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= len; i += SOC_ADC_DIGI_RESULT_BYTES) {
+        const adc_digi_output_data_t *p = (const adc_digi_output_data_t *)&frame[i];
+
+        if(goertzel_sample(&goertzel, DECODER_GET_DATA(p), &power)) {
+            timing_block(&timing, goertzel_detect(&goertzel, power, timing.key_down));
+        }
+    }
+}
+
+
+/**
+ * @brief Task that reads samples from ADC and decodes them
+ *
+ * @param arg
+ */
+static void decode(void *arg) {
+    uint32_t len = 0;
+
+    while(1) {
+        esp_err_t err = adc_continuous_read(adc_handle, adc_frame, sizeof(adc_frame), &len, portMAX_DELAY);
+        if(err != ESP_OK) {
+            continue;
+        }
+
+        uint32_t start = esp_cpu_get_cycle_count();
+        decoder_process(adc_frame, len);
+        consumed_cycles += esp_cpu_get_cycle_count() - start;
+        processed_samples += len / SOC_ADC_DIGI_RESULT_BYTES;
+
+        if(processed_samples >= DECODER_STATS_PERIOD_S * DECODER_SAMPLE_FREQ) {
+            ESP_LOGI(DECODER_TAG, "%llu cycles per second of audio, speed %lu WPM",
+                (unsigned long long)(consumed_cycles * DECODER_SAMPLE_FREQ / processed_samples),
+                (unsigned long)(1200000 / timing.dot_us)
+            );
+
+            consumed_cycles = 0;
+            processed_samples = 0;
+        }
+    }
+}
+
+
+esp_err_t decoder_init() {
+    esp_err_t err;
+
+    goertzel.coeff = (int32_t)(2.0f * cosf(2.0f * (float)M_PI * DECODER_TONE_FREQ / DECODER_SAMPLE_FREQ) * (1 << 14));
+    goertzel.noise = 1;
+    goertzel.signal = 1;
+
+    timing.dot_us = DECODER_INITIAL_DOT_MS * 1000;
+    timing.symbol_idx = MORSE_TREE_ROOT;
+
+    adc_continuous_handle_cfg_t handle_config = {
+        .max_store_buf_size = 4 * sizeof(adc_frame),
+        .conv_frame_size = sizeof(adc_frame),
+    };
+
+    err = adc_continuous_new_handle(&handle_config, &adc_handle);
+    if(err != ESP_OK) {
+        ESP_LOGE(DECODER_TAG, "adc_continuous_new_handle failed!");
+        return err;
+    }
+
+    adc_digi_pattern_config_t pattern = {
+        .atten = DECODER_ADC_ATTEN,
+        .channel = DECODER_ADC_CHANNEL,
+        .unit = DECODER_ADC_UNIT,
+        .bit_width = SOC_ADC_DIGI_MAX_BITWIDTH,
+    };
+
+    adc_continuous_config_t adc_config = {
+        .pattern_num = 1,
+        .adc_pattern = &pattern,
+        .sample_freq_hz = DECODER_SAMPLE_FREQ,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = DECODER_OUTPUT_FORMAT,
+    };
+
+    err = adc_continuous_config(adc_handle, &adc_config);
+    if(err != ESP_OK) {
+        ESP_LOGE(DECODER_TAG, "adc_continuous_config failed!");
+        return err;
+    }
+
+    err = adc_continuous_start(adc_handle);
+    if(err != ESP_OK) {
+        ESP_LOGE(DECODER_TAG, "adc_continuous_start failed!");
+        return err;
+    }
+
+    xTaskCreatePinnedToCore(decode, "decoder", 3072, NULL, 6, &decoder_handle, 0);
+
+    return ESP_OK;
+}
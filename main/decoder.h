@@ -0,0 +1,60 @@
+/**
+ * @file decoder.h
+ *
+ * @brief Decoder of morse code from audio (ADC input, tone detection by Goertzel filter)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __DECODER__
+#define __DECODER__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_adc/adc_continuous.h"
+
+#include "translator.h"
+#include "ble_receiver.h"
+
+
+#define DECODER_TAG "DECODER" //< Module name
+
+#ifndef CONFIG_PM_ENABLE
+#define AUDIO_DECODER //< Enables decoder of morse code from audio input (ADC DMA holds its own PM lock, so it is disabled by sdkconfig.pm)
+#endif
+
+#define DECODER_ADC_UNIT ADC_UNIT_1
+#define DECODER_ADC_CHANNEL ADC_CHANNEL_6 //< GPIO34 on ESP32
+#define DECODER_ADC_ATTEN ADC_ATTEN_DB_12
+
+#define DECODER_SAMPLE_FREQ 20000 //< Sampling frequency of the audio in Hz (the lowest possible on ESP32)
+#define DECODER_TONE_FREQ 700 //< Frequency of the detected tone in Hz
+#define DECODER_BLOCK_LEN 160 //< Number of samples processed by Goertzel filter at once (8 ms, bandwidth ~125 Hz)
+
+#define DECODER_FRAME_LEN 256 //< Number of samples read from ADC at once
+
+#define DECODER_MIN_SNR 4 //< Minimal ratio between tone and noise power (for ignoring of not connected input)
+
+#define DECODER_INITIAL_DOT_MS 200 //< Initial estimation of the dot length (it is adapted to the incoming signal)
+#define DECODER_MIN_DOT_MS 20 //< The shortest accepted dot (60 WPM)
+#define DECODER_MAX_DOT_MS 400 //< The longest accepted dot (3 WPM)
+
+#define DECODER_STATS_PERIOD_S 10 //< Period of printing the statistics (estimated speed and consumed CPU)
+
+
+/**
+ * @brief Initializes the ADC in continuous mode and starts the decoding task
+ *
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t decoder_init();
+
+#endif
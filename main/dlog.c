@@ -0,0 +1,176 @@
+/**
+ * @file dlog.c
+ *
+ * @brief Deferred logging for hot paths (callbacks, translator, ISRs)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "dlog.h"
+#include <stdarg.h>
+#include "esp_timer.h"
+#include "stats.h"
+
+
+/**
+ * @brief Recorded message
+ *
+ */
+typedef struct dlog_record {
+    const char *tag;
+    const char *format;
+    uint32_t args[DLOG_MAX_ARGS];
+    uint32_t time_ms; //< Time of recording
+    uint16_t suppressed; //< Number of messages from the same place suppressed before this one
+    uint8_t level;
+} dlog_record_t;
+
+
+static dlog_record_t ring[DLOG_RING_LEN];
+static unsigned ring_head = 0; //< Index of the next written record
+static unsigned ring_tail = 0; //< Index of the next printed record
+static uint32_t dropped = 0; //< Number of records dropped because the ring was full
+
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static TaskHandle_t dlog_handle = NULL;
+
+
+void IRAM_ATTR dlog_write(dlog_site_t *site, esp_log_level_t level, const char *tag, const char *format, unsigned argc, ...) {
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    uint16_t suppressed = 0;
+
+    portENTER_CRITICAL_SAFE(&ring_lock);
+
+    if(now_ms - site->window_start_ms >= DLOG_RATE_WINDOW_MS) { //New window
+        suppressed = site->suppressed;
+
+        site->window_start_ms = now_ms;
+        site->count = 0;
+        site->suppressed = 0;
+    }
+
+    if(site->count >= DLOG_RATE_BURST) {
+        if(site->suppressed < UINT16_MAX) {
+            site->suppressed++;
+        }
+
+        portEXIT_CRITICAL_SAFE(&ring_lock);
+        return;
+    }
+
+    site->count++;
+
+    unsigned next_head = (ring_head + 1) % DLOG_RING_LEN;
+    if(next_head == ring_tail) {
+        dropped++;
+
+        portEXIT_CRITICAL_SAFE(&ring_lock);
+        return;
+    }
+
+    bool was_empty = ring_head == ring_tail;
+
+    dlog_record_t *record = &ring[ring_head];
+    record->tag = tag;
+    record->format = format;
+    record->time_ms = now_ms;
+    record->suppressed = suppressed;
+    record->level = (uint8_t)level;
+
+    va_list args;
+    va_start(args, argc);
+    for(unsigned i = 0; i < DLOG_MAX_ARGS; i++) {
+        record->args[i] = i < argc ? va_arg(args, uint32_t) : 0;
+    }
+    va_end(args);
+
+    ring_head = next_head;
+
+    portEXIT_CRITICAL_SAFE(&ring_lock);
+
+    if(was_empty && dlog_handle) { //Drain task sleeps until there is something to print
+        if(xPortInIsrContext()) {
+            vTaskNotifyGiveFromISR(dlog_handle, NULL); //Drain task has low priority, so there is no need to yield
+        }
+        else {
+            xTaskNotifyGive(dlog_handle);
+        }
+    }
+}
+
+
+/**
+ * @brief Formats and prints one record
+ *
+ * @param record Record to be printed
+ */
+static void dlog_print(const dlog_record_t *record) {
+    static char line[DLOG_LINE_LEN];
+
+    snprintf(line, sizeof(line), record->format, record->args[0], record->args[1], record->args[2], record->args[3]);
+
+    if(record->suppressed) {
+        ESP_LOG_LEVEL((esp_log_level_t)record->level, record->tag, "(%lu ms) %s (%u similar suppressed)",
+            (unsigned long)record->time_ms, line, record->suppressed);
+    }
+    else {
+        ESP_LOG_LEVEL((esp_log_level_t)record->level, record->tag, "(%lu ms) %s", (unsigned long)record->time_ms, line);
+    }
+}
+
+
+/**
+ * @brief Task that prints recorded messages
+ *
+ * @param arg
+ */
+static void dlog_drain(void *arg) {
+    dlog_record_t record;
+
+    while(1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(DLOG_DRAIN_PERIOD_MS));
+
+#ifdef RUNTIME_STATS
+        stats_count(STATS_DLOG_WAKEUPS);
+#endif
+
+        while(1) {
+            uint32_t dropped_now;
+            bool empty;
+
+            portENTER_CRITICAL(&ring_lock);
+            empty = ring_tail == ring_head;
+            if(!empty) {
+                record = ring[ring_tail];
+                ring_tail = (ring_tail + 1) % DLOG_RING_LEN;
+            }
+
+            dropped_now = dropped;
+            dropped = 0;
+            portEXIT_CRITICAL(&ring_lock);
+
+            if(dropped_now) {
+                ESP_LOGW(DLOG_TAG, "%lu messages dropped (ring is full)", (unsigned long)dropped_now);
+            }
+
+            if(empty) {
+                break;
+            }
+
+            dlog_print(&record);
+        }
+    }
+}
+
+
+esp_err_t dlog_init() {
+    if(xTaskCreatePinnedToCore(dlog_drain, "dlog", 3072, NULL, 1, &dlog_handle, 0) != pdPASS) {
+        ESP_LOGE(DLOG_TAG, "Unable to create task for deferred logs!");
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,108 @@
+/**
+ * @file dlog.h
+ *
+ * @brief Deferred logging for hot paths (callbacks, translator, ISRs)
+ *
+ * Only the pointer to the format, the tag and up to DLOG_MAX_ARGS integer arguments are recorded to the ring
+ * buffer, formatting and printing is done later by the background task. Arguments must be integers, characters
+ * or pointers to strings that live forever (string literals, lookup tables), because they are read later.
+ * Messages from the same place are rate limited (DLOG_RATE_BURST per DLOG_RATE_WINDOW_MS).
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __DLOG__
+#define __DLOG__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+
+
+#define DLOG_TAG "DLOG" //< Module name
+
+#ifndef CONFIG_MORSE_DLOG_LEVEL
+#define CONFIG_MORSE_DLOG_LEVEL 3 //< Info (when Kconfig of the project is not used)
+#endif
+
+#define DLOG_RING_LEN 64 //< Maximum number of records waiting for printing
+#define DLOG_MAX_ARGS 4 //< Maximum number of arguments of one message
+#define DLOG_LINE_LEN 160 //< Maximum length of formatted message
+#define DLOG_DRAIN_PERIOD_MS 50 //< Records are printed in batches (the first record wakes the task up after this time)
+
+#define DLOG_RATE_WINDOW_MS 1000 //< Window for rate limiting
+#define DLOG_RATE_BURST 5 //< Maximum number of messages from one place in one window
+
+
+/**
+ * @brief State of rate limiting of one place, where the message is logged
+ *
+ */
+typedef struct dlog_site {
+    uint32_t window_start_ms; //< Start of the current window
+    uint16_t count; //< Number of messages in the current window
+    uint16_t suppressed; //< Number of suppressed messages in the current window
+} dlog_site_t;
+
+
+//Counting of arguments (0 - DLOG_MAX_ARGS)
+#define DLOG_NARGS(...) DLOG_NARGS_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define DLOG_NARGS_(_0, _1, _2, _3, _4, N, ...) N
+
+#define DLOG_AT(level, tag, format, ...) do { \
+        static dlog_site_t dlog_site_ = { 0 }; \
+        dlog_write(&dlog_site_, level, tag, format, DLOG_NARGS(__VA_ARGS__), ##__VA_ARGS__); \
+    } while(0)
+
+#if CONFIG_MORSE_DLOG_LEVEL >= 1
+#define DLOGE(tag, format, ...) DLOG_AT(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#else
+#define DLOGE(tag, format, ...) do { } while(0)
+#endif
+
+#if CONFIG_MORSE_DLOG_LEVEL >= 2
+#define DLOGW(tag, format, ...) DLOG_AT(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#else
+#define DLOGW(tag, format, ...) do { } while(0)
+#endif
+
+#if CONFIG_MORSE_DLOG_LEVEL >= 3
+#define DLOGI(tag, format, ...) DLOG_AT(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#else
+#define DLOGI(tag, format, ...) do { } while(0)
+#endif
+
+#if CONFIG_MORSE_DLOG_LEVEL >= 4
+#define DLOGD(tag, format, ...) DLOG_AT(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#else
+#define DLOGD(tag, format, ...) do { } while(0)
+#endif
+
+
+/**
+ * @brief Records the message to the ring buffer (it can be called from ISR), use DLOGx macros instead
+ *
+ * @param site State of rate limiting of the place
+ * @param level Level of the message
+ * @param tag Tag of the module
+ * @param format Format of the message
+ * @param argc Number of arguments
+ */
+void dlog_write(dlog_site_t *site, esp_log_level_t level, const char *tag, const char *format, unsigned argc, ...);
+
+
+/**
+ * @brief Starts the task that prints recorded messages
+ *
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t dlog_init();
+
+#endif
@@ -0,0 +1,554 @@
+/**
+ * @file keyer.c
+ *
+ * @brief Local keying input (straight key or iambic paddle) that drives the same outputs as received messages
+ *
+ * Edges of the key are handled directly in GPIO ISR (so the tone starts immediately), the lengths of elements
+ * and gaps are measured by the separate hardware timer.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "keyer.h"
+#include "esp_timer.h"
+#include "power.h"
+
+
+/**
+ * @brief States of the keyer
+ *
+ */
+typedef enum keyer_state {
+    KEYER_IDLE, //< Nothing is keyed, outputs are released
+    KEYER_ELEMENT, //< Tone of dit or dah is playing
+    KEYER_SPACE, //< Gap between elements
+    KEYER_LETTER_GAP, //< Gap between letters (letter was not finished yet)
+    KEYER_WORD_GAP, //< Gap between words (letter is finished, word was not)
+} keyer_state_t;
+
+
+/**
+ * @brief Indexes of paddles
+ *
+ */
+enum paddles {
+    DIT_PADDLE,
+    DAH_PADDLE,
+    PADDLE_NUM,
+};
+
+
+static const gpio_num_t paddle_gpio[PADDLE_NUM] = { KEYER_DIT_GPIO, KEYER_DAH_GPIO };
+
+static portMUX_TYPE keyer_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+static keyer_state_t state = KEYER_IDLE;
+static bool paddle_pressed[PADDLE_NUM]; //< Debounced states of paddles
+static bool paddle_memory[PADDLE_NUM]; //< Paddles pressed while element was playing
+static int64_t last_edge_us[PADDLE_NUM]; //< Timestamps of the last accepted edges (for debouncing)
+static bool last_dah = false; //< Last keyed element (for alternating when paddles are squeezed)
+static bool squeezed = false; //< Both paddles were pressed during the current element
+static int64_t tone_start_us = 0; //< Start of the current tone (straight key)
+static int64_t tone_end_us = 0; //< End of the last tone (straight key)
+static int64_t unit_us = BASE_TIME_INT_MS * 1000; //< Length of the dit, it is read from the output when the element starts
+
+static unsigned symbol_idx = MORSE_TREE_ROOT; //< Currently keyed symbol (index to the morse code tree)
+
+static QueueHandle_t keyer_queue = NULL; //< Finished symbols (indexes to the morse tree, 0 means the end of the word)
+static TaskHandle_t keyer_handle = NULL;
+
+#ifdef POWER_MANAGEMENT
+static bool wakeup_enabled = false; //< Paddles have level interrupts, that wake up the chip from light sleep
+#endif
+
+
+#ifdef POWER_MANAGEMENT
+/**
+ * @brief Switches paddles between level interrupts (they wake up the chip from light sleep while the keyer is idle)
+ * and interrupts on both edges (while the key is used)
+ *
+ * @param enable true if paddles should wake up the chip
+ */
+static void keyer_set_wakeup(bool enable) {
+    if(enable == wakeup_enabled) {
+        return;
+    }
+
+    for(int i = 0; i < PADDLE_NUM; i++) {
+        if(KEYER_MODE == KEYER_STRAIGHT && i == DAH_PADDLE) { //Only one paddle is used by the straight key
+            continue;
+        }
+
+        if(enable) {
+            gpio_wakeup_enable(paddle_gpio[i], KEYER_ACTIVE_LEVEL ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+        }
+        else {
+            gpio_wakeup_disable(paddle_gpio[i]);
+            gpio_set_intr_type(paddle_gpio[i], GPIO_INTR_ANYEDGE);
+        }
+    }
+
+    wakeup_enabled = enable;
+}
+#endif
+
+
+/**
+ * @brief Takes the outputs from the out control routine or returns them (the keyer holds power locks meanwhile)
+ *
+ * @param active true if the keyer drives the outputs
+ */
+static void keyer_set_override(bool active) {
+    output_override = active;
+
+#ifdef POWER_MANAGEMENT
+    if(active) {
+        power_acquire(POWER_KEYER);
+    }
+    else {
+        power_release(POWER_KEYER);
+    }
+
+    keyer_set_wakeup(!active);
+#endif
+}
+
+
+/**
+ * @brief Arms the keyer timer, so it fires after given time
+ *
+ * @param delay_us Time from now in microseconds (it is negative, if the ISR is later than the end of the interval)
+ */
+static void keyer_timer_arm(int64_t delay_us) {
+    uint64_t now = timer_group_get_counter_value_in_isr(KEYER_TIMER_GROUP, KEYER_TIMER);
+
+    if(delay_us < KEYER_MIN_DELAY_US) {
+        delay_us = KEYER_MIN_DELAY_US;
+    }
+
+    timer_group_set_alarm_value_in_isr(KEYER_TIMER_GROUP, KEYER_TIMER, now + delay_us * KEYER_TIMER_SCALE);
+    timer_group_enable_alarm_in_isr(KEYER_TIMER_GROUP, KEYER_TIMER);
+    timer_group_set_counter_enable_in_isr(KEYER_TIMER_GROUP, KEYER_TIMER, TIMER_START);
+}
+
+
+/**
+ * @brief Stops the keyer timer (until it is armed again)
+ *
+ */
+static void keyer_timer_stop() {
+    timer_group_set_counter_enable_in_isr(KEYER_TIMER_GROUP, KEYER_TIMER, TIMER_PAUSE);
+}
+
+
+/**
+ * @brief Passes finished symbol to the task, that notifies the client
+ *
+ * @param idx Index of the symbol in the morse tree (0 for the end of the word)
+ * @param higher_priority_task_woken
+ */
+static void keyer_emit(unsigned idx, BaseType_t *higher_priority_task_woken) {
+    #ifdef KEYER_DECODE
+        uint8_t item = (uint8_t)idx;
+        xQueueSendFromISR(keyer_queue, &item, higher_priority_task_woken);
+    #endif
+}
+
+
+/**
+ * @brief Starts dit or dah (iambic modes)
+ *
+ * @param dah true if dah should be keyed
+ */
+static void keyer_start_element(bool dah) {
+    keyer_set_override(true); //Take the outputs from the out control routine
+    output_key_set(true);
+
+    unit_us = (int64_t)output_unit_ms() * 1000; //Keyer plays at the current speed of messages
+
+    state = KEYER_ELEMENT;
+    last_dah = dah;
+    paddle_memory[dah ? DAH_PADDLE : DIT_PADDLE] = false;
+    squeezed = paddle_pressed[DIT_PADDLE] && paddle_pressed[DAH_PADDLE];
+
+    if(symbol_idx < MORSE_TREE_SIZE) {
+        symbol_idx = MORSE_TREE_NEXT(symbol_idx, dah);
+    }
+
+    keyer_timer_arm(dah ? DASH_BUZZER_INT * unit_us : DOT_BUZZER_INT * unit_us);
+}
+
+
+/**
+ * @brief Decides which element should follow (iambic modes)
+ *
+ * @param dah output argument, true if the next element is dah
+ * @return true if some element should follow
+ */
+static bool keyer_next_element(bool *dah) {
+    bool want_dit = paddle_pressed[DIT_PADDLE] || paddle_memory[DIT_PADDLE];
+    bool want_dah = paddle_pressed[DAH_PADDLE] || paddle_memory[DAH_PADDLE];
+
+    if(want_dit && want_dah) { //Squeeze -> alternate elements
+        *dah = !last_dah;
+    }
+    else if(want_dit || want_dah) {
+        *dah = want_dah;
+    }
+    else {
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Processes the debounced edge of straight key
+ *
+ * @param pressed New state of the key
+ * @param now Timestamp of the edge
+ */
+static void keyer_straight_edge(bool pressed, int64_t now) {
+    paddle_pressed[DIT_PADDLE] = pressed;
+    last_edge_us[DIT_PADDLE] = now;
+
+    if(pressed) {
+        keyer_set_override(true);
+        output_key_set(true);
+
+        state = KEYER_ELEMENT;
+        tone_start_us = now;
+        unit_us = (int64_t)output_unit_ms() * 1000; //Dah and gaps are classified by the current speed of messages
+    }
+    else {
+        output_key_set(false);
+
+        //Tone longer than two units is considered as dah
+        if(symbol_idx < MORSE_TREE_SIZE) {
+            symbol_idx = MORSE_TREE_NEXT(symbol_idx, now - tone_start_us > 2 * unit_us);
+        }
+
+        state = KEYER_SPACE;
+        tone_end_us = now;
+    }
+
+    keyer_timer_arm(KEYER_DEBOUNCE_US); //Check the state of the key again after bouncing
+}
+
+
+/**
+ * @brief Handles edges on paddle pins
+ *
+ * @param arg Index of the paddle
+ */
+static void keyer_gpio_isr(void *arg) {
+    enum paddles paddle = (enum paddles)(uintptr_t)arg;
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL_ISR(&keyer_spinlock);
+
+#ifdef POWER_MANAGEMENT
+    keyer_set_wakeup(false); //Level interrupt would come again and again while the paddle is pressed
+#endif
+
+    bool pressed = gpio_get_level(paddle_gpio[paddle]) == KEYER_ACTIVE_LEVEL;
+
+    //Ignore bounces and edges that does not change the state (the state is checked again by the timer)
+    if(now - last_edge_us[paddle] < KEYER_DEBOUNCE_US || pressed == paddle_pressed[paddle]) {
+#ifdef POWER_MANAGEMENT
+        keyer_set_wakeup(!output_override); //Glitch did not start keying, so the keyer is still idle
+#endif
+        portEXIT_CRITICAL_ISR(&keyer_spinlock);
+        return;
+    }
+
+    if(KEYER_MODE == KEYER_STRAIGHT) {
+        if(paddle == DIT_PADDLE) {
+            keyer_straight_edge(pressed, now);
+        }
+    }
+    else {
+        paddle_pressed[paddle] = pressed;
+        last_edge_us[paddle] = now;
+
+        if(pressed) {
+            if(state == KEYER_ELEMENT || state == KEYER_SPACE) { //Remember the paddle for the next element
+                paddle_memory[paddle] = true;
+
+                if(KEYER_MODE == KEYER_IAMBIC_B && paddle_pressed[DIT_PADDLE] && paddle_pressed[DAH_PADDLE]) {
+                    squeezed = true;
+                }
+            }
+            else { //Nothing is playing, start the element immediately
+                keyer_start_element(paddle == DAH_PADDLE);
+            }
+        }
+    }
+
+#ifdef POWER_MANAGEMENT
+    keyer_set_wakeup(!output_override);
+#endif
+
+    portEXIT_CRITICAL_ISR(&keyer_spinlock);
+
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    output_notify_tone(&higher_priority_task_woken);
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+}
+
+
+/**
+ * @brief Handles the timer of straight key (debouncing and detection of gaps between letters and words)
+ *
+ * @param now Current timestamp
+ * @param higher_priority_task_woken
+ */
+static void keyer_straight_timer(int64_t now, BaseType_t *higher_priority_task_woken) {
+    bool pressed = gpio_get_level(paddle_gpio[DIT_PADDLE]) == KEYER_ACTIVE_LEVEL;
+    if(pressed != paddle_pressed[DIT_PADDLE]) { //Edge was hidden by bouncing
+        keyer_straight_edge(pressed, now);
+        return;
+    }
+
+    int64_t gap_us = now - tone_end_us;
+
+    switch(state)
+    {
+    case KEYER_SPACE:
+        if(gap_us >= 2 * unit_us) { //Gap is closer to the letter gap than to the element gap
+            keyer_emit(symbol_idx, higher_priority_task_woken);
+            symbol_idx = MORSE_TREE_ROOT;
+
+            state = KEYER_WORD_GAP;
+            keyer_timer_arm(5 * unit_us - gap_us);
+        }
+        else {
+            keyer_timer_arm(2 * unit_us - gap_us);
+        }
+        break;
+
+    case KEYER_WORD_GAP:
+        keyer_emit(0, higher_priority_task_woken);
+
+        state = KEYER_IDLE;
+        keyer_set_override(false); //Return outputs to the out control routine
+        keyer_timer_stop();
+        break;
+
+    default:
+        keyer_timer_stop();
+        break;
+    }
+}
+
+
+/**
+ * @brief Handles the timer of iambic keyer (ends of elements and gaps)
+ *
+ * @param higher_priority_task_woken
+ */
+static void keyer_iambic_timer(BaseType_t *higher_priority_task_woken) {
+    bool dah;
+
+    //Paddles could be released during the bouncing
+    for(int i = 0; i < PADDLE_NUM; i++) {
+        paddle_pressed[i] = gpio_get_level(paddle_gpio[i]) == KEYER_ACTIVE_LEVEL;
+    }
+
+    switch(state)
+    {
+    case KEYER_ELEMENT:
+        output_key_set(false);
+
+        if(KEYER_MODE == KEYER_IAMBIC_B && squeezed) { //Squeeze released during the element -> one more opposite element
+            paddle_memory[last_dah ? DIT_PADDLE : DAH_PADDLE] = true;
+        }
+
+        state = KEYER_SPACE;
+        keyer_timer_arm(unit_us);
+        break;
+
+    case KEYER_SPACE:
+        if(keyer_next_element(&dah)) {
+            keyer_start_element(dah);
+        }
+        else {
+            state = KEYER_LETTER_GAP; //Together with the space it gives the gap between letters
+            keyer_timer_arm(GAP_BETWEEN_LETTERS * unit_us);
+        }
+        break;
+
+    case KEYER_LETTER_GAP:
+        keyer_emit(symbol_idx, higher_priority_task_woken);
+        symbol_idx = MORSE_TREE_ROOT;
+
+        state = KEYER_WORD_GAP;
+        keyer_timer_arm(4 * unit_us);
+        break;
+
+    case KEYER_WORD_GAP:
+        keyer_emit(0, higher_priority_task_woken);
+
+        state = KEYER_IDLE;
+        keyer_set_override(false); //Return outputs to the out control routine
+        keyer_timer_stop();
+        break;
+
+    default:
+        keyer_timer_stop();
+        break;
+    }
+}
+
+
+/**
+ * @brief ISR of the keyer timer
+ *
+ * @param args
+ * @return true if higher priority task was woken
+ */
+static bool keyer_timer_routine(void *args) {
+    BaseType_t higher_priority_task_woken = pdFALSE;
+
+    portENTER_CRITICAL_ISR(&keyer_spinlock);
+
+    if(KEYER_MODE == KEYER_STRAIGHT) {
+        keyer_straight_timer(esp_timer_get_time(), &higher_priority_task_woken);
+    }
+    else {
+        keyer_iambic_timer(&higher_priority_task_woken);
+    }
+
+    portEXIT_CRITICAL_ISR(&keyer_spinlock);
+
+    output_notify_tone(&higher_priority_task_woken);
+
+    return higher_priority_task_woken == pdTRUE;
+}
+
+
+/**
+ * @brief Task that translates keyed symbols back to the text and notifies it to the client
+ *
+ * @param arg
+ */
+static void keyer_decode(void *arg) {
+    uint8_t idx;
+
+    while(1) {
+        if(xQueueReceive(keyer_queue, &idx, portMAX_DELAY)) {
+            char ch = idx ? morse_tree_lookup(idx) : ' ';
+            if(!ch) {
+                DLOGI(KEYER_TAG, "Unknown symbol was keyed (%d)", idx);
+                continue;
+            }
+
+            DLOGI(KEYER_TAG, "Keyed '%c'", ch);
+
+            ble_set_char_value(DECODED_CHAR, (uint8_t *)&ch, 1);
+            ble_notify(DECODED_CHAR, (uint8_t *)&ch, 1);
+        }
+    }
+}
+
+
+/**
+ * @brief Initialization of the timer for timing of elements
+ *
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+static esp_err_t keyer_timer_init() {
+    esp_err_t err;
+
+    timer_config_t config = {
+        .divider = KEYER_TIMER_DIVIDER,
+        .counter_dir = TIMER_COUNT_UP,
+        .counter_en = TIMER_PAUSE,
+        .alarm_en = TIMER_ALARM_EN,
+        .auto_reload = true, //< Counter starts from zero after every alarm, so alarms can be set relatively
+    };
+
+    err = timer_init(KEYER_TIMER_GROUP, KEYER_TIMER, &config);
+    if(err != ESP_OK) {
+        ESP_LOGE(KEYER_TAG, "timer_init failed!");
+        return err;
+    }
+
+    err = timer_set_counter_value(KEYER_TIMER_GROUP, KEYER_TIMER, 0);
+    if(err != ESP_OK) {
+        ESP_LOGE(KEYER_TAG, "timer_set_counter_value failed!");
+        return err;
+    }
+
+    err = timer_enable_intr(KEYER_TIMER_GROUP, KEYER_TIMER);
+    if(err != ESP_OK) {
+        ESP_LOGE(KEYER_TAG, "timer_enable_intr failed!");
+        return err;
+    }
+
+    err = timer_isr_callback_add(KEYER_TIMER_GROUP, KEYER_TIMER, keyer_timer_routine, NULL, 0);
+    if(err != ESP_OK) {
+        ESP_LOGE(KEYER_TAG, "timer_isr_callback_add failed!");
+        return err;
+    }
+
+    return ESP_OK;
+}
+
+
+esp_err_t keyer_init() {
+    esp_err_t err;
+
+    keyer_queue = xQueueCreate(KEYER_QUEUE_LEN, sizeof(uint8_t));
+    if(!keyer_queue) {
+        ESP_LOGE(KEYER_TAG, "Unable to create queue for keyed symbols!");
+        return ESP_ERR_NO_MEM;
+    }
+
+    err = keyer_timer_init();
+    if(err != ESP_OK) {
+        return err;
+    }
+
+    gpio_config_t paddle_config = {
+        .pin_bit_mask = (1ULL << KEYER_DIT_GPIO) | (1ULL << KEYER_DAH_GPIO),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = KEYER_ACTIVE_LEVEL ? GPIO_PULLUP_DISABLE : GPIO_PULLUP_ENABLE,
+        .pull_down_en = KEYER_ACTIVE_LEVEL ? GPIO_PULLDOWN_ENABLE : GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_ANYEDGE,
+    };
+
+    err = gpio_config(&paddle_config);
+    if(err != ESP_OK) {
+        ESP_LOGE(KEYER_TAG, "gpio_config failed!");
+        return err;
+    }
+
+    err = gpio_install_isr_service(0);
+    if(err != ESP_OK && err != ESP_ERR_INVALID_STATE) { //ESP_ERR_INVALID_STATE means, that service is already installed
+        ESP_LOGE(KEYER_TAG, "gpio_install_isr_service failed!");
+        return err;
+    }
+
+    for(int i = 0; i < PADDLE_NUM; i++) {
+        paddle_pressed[i] = gpio_get_level(paddle_gpio[i]) == KEYER_ACTIVE_LEVEL;
+
+        err = gpio_isr_handler_add(paddle_gpio[i], keyer_gpio_isr, (void *)(uintptr_t)i);
+        if(err != ESP_OK) {
+            ESP_LOGE(KEYER_TAG, "gpio_isr_handler_add failed!");
+            return err;
+        }
+    }
+
+#ifdef POWER_MANAGEMENT
+    keyer_set_wakeup(true);
+#endif
+
+    #ifdef KEYER_DECODE
+        xTaskCreatePinnedToCore(keyer_decode, "keyer", 2048, NULL, 5, &keyer_handle, 0);
+    #endif
+
+    return ESP_OK;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file keyer.h
+ *
+ * @brief Local keying input (straight key or iambic paddle) that drives the same outputs as received messages
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __KEYER__
+#define __KEYER__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "driver/gpio.h"
+#include "driver/timer.h"
+
+#include "output.h"
+#include "translator.h"
+#include "ble_receiver.h"
+
+
+#define KEYER_TAG "KEYER" //< Module name
+
+
+/**
+ * @brief Modes of the keyer
+ *
+ */
+enum keyer_modes {
+    KEYER_STRAIGHT, //< Straight key connected to dit pin, tone follows the key
+    KEYER_IAMBIC_A, //< Iambic keyer, stops after the current element when paddles are released
+    KEYER_IAMBIC_B, //< Iambic keyer, adds one opposite element when squeeze is released
+};
+
+#define KEYER_MODE KEYER_IAMBIC_B //< Mode of the keyer
+
+#define KEYER_DIT_GPIO GPIO_NUM_32 //< Dit paddle (or straight key)
+#define KEYER_DAH_GPIO GPIO_NUM_33 //< Dah paddle
+#define KEYER_ACTIVE_LEVEL 0 //< Paddles connect pins to the ground (internal pull-ups are used)
+
+#define KEYER_DEBOUNCE_US 3000 //< Edges that come sooner after the accepted edge are considered as bounces
+
+#define KEYER_MIN_DELAY_US 100 //< The shortest delay of the timer (alarm must not be set to the past, when the ISR is late)
+
+#define KEYER_DECODE //< Decode keyed symbols and notify them to the client
+
+//Hardware timer used for timing of elements (TIMER_0 of the same group is used by out control routine)
+#define KEYER_TIMER_GROUP TIMER_GROUP_0
+#define KEYER_TIMER TIMER_1
+#define KEYER_TIMER_DIVIDER 80 //< Timer counts microseconds
+#define KEYER_TIMER_SCALE (TIMER_BASE_CLK / KEYER_TIMER_DIVIDER / 1000000) //< Timer ticks per microsecond
+
+#define KEYER_QUEUE_LEN 32 //< Maximum number of decoded symbols waiting for notification
+
+
+/**
+ * @brief Initializes GPIOs of the key, the timer of the keyer and the task for notifying decoded text
+ *
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t keyer_init();
+
+#endif
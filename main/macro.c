@@ -0,0 +1,250 @@
+/**
+ * @file macro.c
+ *
+ * @brief Stored messages (macros) that are compiled to out controls in advance and played by id
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "macro.h"
+#include "dlog.h"
+
+
+/**
+ * @brief Header of the compiled macro in NVS (macros compiled by other firmware are rejected)
+ *
+ */
+typedef struct macro_header {
+    uint8_t version; //< MACRO_FORMAT_VERSION
+    uint8_t record_size; //< Size of out_control_t
+    uint16_t records; //< Number of out controls
+} macro_header_t;
+
+
+/**
+ * @brief Compiled macro as it is stored in NVS
+ *
+ */
+typedef struct macro_blob {
+    macro_header_t header;
+    out_control_t records[MACRO_MAX_RECORDS];
+} macro_blob_t;
+
+
+static nvs_handle_t macro_nvs;
+static SemaphoreHandle_t macro_mutex = NULL; //< Protects compile buffer and NVS writes
+
+static volatile uint32_t macro_mask = 0; //< Bit for every stored macro
+
+static macro_blob_t compile_buffer; //< Buffer for compiling of macros
+static macro_blob_t play_buffer; //< Buffer for playing of macros (used only by translator)
+static uint8_t cached_id = MACRO_NUM; //< Macro that is loaded in play buffer (MACRO_NUM if there is none)
+static size_t cached_records = 0; //< Number of out controls of the cached macro
+
+
+/**
+ * @brief Creates NVS key of the macro
+ *
+ * @param key Output buffer (at least NVS_KEY_NAME_MAX_SIZE)
+ * @param id Id of the macro
+ */
+static void macro_key(char *key, uint8_t id) {
+    snprintf(key, NVS_KEY_NAME_MAX_SIZE, MACRO_NVS_KEY_PREFIX "%u", id);
+}
+
+
+/**
+ * @brief Checks the compiled macro loaded from NVS
+ *
+ * @param blob Loaded macro
+ * @param size Size of the loaded blob
+ * @return true if the macro was compiled by this firmware and it is complete
+ */
+static bool macro_blob_valid(const macro_blob_t *blob, size_t size) {
+    return size >= sizeof(macro_header_t) &&
+        blob->header.version == MACRO_FORMAT_VERSION &&
+        blob->header.record_size == sizeof(out_control_t) &&
+        blob->header.records > 0 && blob->header.records <= MACRO_MAX_RECORDS &&
+        size == sizeof(macro_header_t) + blob->header.records * sizeof(out_control_t);
+}
+
+
+esp_err_t macro_store(uint8_t id, const uint8_t *text, uint16_t len) {
+    esp_err_t err;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    size_t records = 0;
+
+    if(id >= MACRO_NUM) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(macro_mutex, portMAX_DELAY);
+
+    utf8_decoder_t decoder;
+    translator_decoder_reset(&decoder);
+
+    while(len > 0) { //Text is decoded in parts
+        char codes[MACRO_DECODE_LEN];
+        size_t consumed;
+        size_t codes_len = translator_decode(&decoder, text, len, &consumed, codes, sizeof(codes));
+
+        text += consumed;
+        len -= consumed;
+
+        for(size_t i = 0; i < codes_len; i++) {
+            size_t letter_len = compile_letter(codes[i], &compile_buffer.records[records], MACRO_MAX_RECORDS - records);
+            if(!letter_len) { //Decoded letters are known, so there is no space
+                xSemaphoreGive(macro_mutex);
+                ESP_LOGE(MACRO_TAG, "Macro %u is too long!", id);
+                return ESP_ERR_INVALID_SIZE;
+            }
+
+            records += letter_len;
+        }
+    }
+
+    if(!records) {
+        xSemaphoreGive(macro_mutex);
+        ESP_LOGE(MACRO_TAG, "Macro %u is empty!", id);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if(cached_id == id) { //Play buffer contains the old version
+        cached_id = MACRO_NUM;
+    }
+
+    compile_buffer.header = (macro_header_t){
+        .version = MACRO_FORMAT_VERSION, .record_size = sizeof(out_control_t), .records = records,
+    };
+
+    macro_key(key, id);
+    err = nvs_set_blob(macro_nvs, key, &compile_buffer, sizeof(macro_header_t) + records * sizeof(out_control_t));
+    if(err == ESP_OK) {
+        err = nvs_commit(macro_nvs);
+    }
+
+    xSemaphoreGive(macro_mutex);
+
+    if(err != ESP_OK) {
+        ESP_LOGE(MACRO_TAG, "Storing macro %u failed! (0x%x)", id, err);
+        return err;
+    }
+
+    macro_mask |= 1UL << id;
+
+    ESP_LOGI(MACRO_TAG, "Macro %u stored (%u out controls)", id, (unsigned)records);
+
+    return ESP_OK;
+}
+
+
+esp_err_t macro_delete(uint8_t id) {
+    esp_err_t err;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+
+    if(id >= MACRO_NUM) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(macro_mutex, portMAX_DELAY);
+
+    macro_mask &= ~(1UL << id);
+    if(cached_id == id) {
+        cached_id = MACRO_NUM;
+    }
+
+    macro_key(key, id);
+    err = nvs_erase_key(macro_nvs, key);
+    if(err == ESP_OK) {
+        err = nvs_commit(macro_nvs);
+    }
+
+    xSemaphoreGive(macro_mutex);
+
+    return err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : err;
+}
+
+
+bool macro_exists(uint8_t id) {
+    return id < MACRO_NUM && (macro_mask & (1UL << id));
+}
+
+
+esp_err_t macro_play(uint8_t id) {
+    esp_err_t err = ESP_OK;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    size_t size = sizeof(play_buffer);
+
+    if(!macro_exists(id)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    xSemaphoreTake(macro_mutex, portMAX_DELAY);
+
+    if(cached_id != id) { //Repeated macros (e. g. beacon) are played directly from RAM
+        macro_key(key, id);
+        err = nvs_get_blob(macro_nvs, key, &play_buffer, &size);
+        if(err == ESP_OK && !macro_blob_valid(&play_buffer, size)) {
+            err = ESP_ERR_INVALID_VERSION;
+        }
+
+        cached_id = err == ESP_OK ? id : MACRO_NUM;
+        cached_records = err == ESP_OK ? play_buffer.header.records : 0;
+    }
+
+    size_t records = cached_records;
+
+    xSemaphoreGive(macro_mutex);
+
+    if(err != ESP_OK) {
+        return err;
+    }
+
+    if(!records) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    play_buffer.records[records - 1].flags |= OUT_ITEM_END; //The whole macro is one item of the letter queue
+
+    send_compiled(play_buffer.records, records);
+
+    DLOGD(MACRO_TAG, "Macro %u played (%u out controls)", id, records);
+
+    return ESP_OK;
+}
+
+
+esp_err_t macro_init(nvs_handle_t nvs) {
+    macro_nvs = nvs;
+
+    macro_mutex = xSemaphoreCreateMutex();
+    if(!macro_mutex) {
+        ESP_LOGE(MACRO_TAG, "Unable to create mutex for macros!");
+        return ESP_ERR_NO_MEM;
+    }
+
+    for(uint8_t id = 0; id < MACRO_NUM; id++) {
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        size_t size = sizeof(compile_buffer);
+
+        macro_key(key, id);
+        esp_err_t err = nvs_get_blob(macro_nvs, key, &compile_buffer, &size);
+        if(err == ESP_ERR_NVS_NOT_FOUND) {
+            continue;
+        }
+
+        if(err == ESP_OK && macro_blob_valid(&compile_buffer, size)) {
+            macro_mask |= 1UL << id;
+        }
+        else { //Macro compiled by other version of firmware would be played with wrong timing, so it must be stored again
+            ESP_LOGW(MACRO_TAG, "Macro %u has incompatible format, it is deleted!", id);
+            nvs_erase_key(macro_nvs, key);
+            nvs_commit(macro_nvs);
+        }
+    }
+
+    ESP_LOGI(MACRO_TAG, "Stored macros: 0x%04lx", (unsigned long)macro_mask);
+
+    return ESP_OK;
+}
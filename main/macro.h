@@ -0,0 +1,101 @@
+/**
+ * @file macro.h
+ *
+ * @brief Stored messages (macros) that are compiled to out controls in advance and played by id
+ *
+ * Macro is played by one item in the letter queue (control character MACRO_ITEM(id)), so it keeps its place among
+ * other messages and its start does not depend on its length.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __MACRO__
+#define __MACRO__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "translator.h"
+
+
+#define MACRO_TAG "MACRO" //< Module name
+
+#define MACRO_NUM 16 //< Number of macros (ids are 0 - MACRO_NUM-1)
+#define MACRO_MAX_RECORDS 512 //< Maximum number of out controls in one macro
+#define MACRO_NVS_KEY_PREFIX "macro" //< Macros are stored in settings NVS under keys macro0, macro1...
+#define MACRO_DECODE_LEN 64 //< Size of the buffer for decoded letters of the stored text
+#define MACRO_FORMAT_VERSION 1 //< Version of compiled macros in NVS (raise it when out_control_t or its compilation changes)
+
+#define MACRO_ITEM_BASE 0x10 //< Items 0x10 - 0x1f in the letter queue are macros (control characters are never translated)
+#define MACRO_ITEM(id) ((char)(MACRO_ITEM_BASE + (id)))
+#define MACRO_IS_ITEM(ch) ((uint8_t)(ch) >= MACRO_ITEM_BASE && (uint8_t)(ch) < MACRO_ITEM_BASE + MACRO_NUM)
+#define MACRO_ITEM_ID(ch) ((uint8_t)(ch) - MACRO_ITEM_BASE)
+
+
+/**
+ * @brief Operations with macros (the first byte of the macro command, the second byte is id of the macro)
+ *
+ */
+enum macro_ops {
+    MACRO_STORE_OP = 0x01, //< Store the text (rest of the command) as the macro
+    MACRO_PLAY_OP = 0x02, //< Play the macro
+    MACRO_DELETE_OP = 0x03, //< Delete the macro
+    MACRO_BEACON_OP = 0x04, //< Repeat the macro as beacon (interval in s and count follow as LE16, id 0xff turns beacon off)
+};
+
+
+/**
+ * @brief Compiles the text and stores it as macro
+ *
+ * @param id Id of the macro
+ * @param text Text of the macro
+ * @param len Length of the text
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t macro_store(uint8_t id, const uint8_t *text, uint16_t len);
+
+
+/**
+ * @brief Deletes the macro
+ *
+ * @param id Id of the macro
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t macro_delete(uint8_t id);
+
+
+/**
+ * @brief Checks if the macro is stored
+ *
+ * @param id Id of the macro
+ * @return true if it is stored
+ */
+bool macro_exists(uint8_t id);
+
+
+/**
+ * @brief Passes out controls of the macro to the out control queue (it should be called only by translator)
+ *
+ * @param id Id of the macro
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t macro_play(uint8_t id);
+
+
+/**
+ * @brief Finds stored macros
+ *
+ * @param nvs Handle of NVS, where macros are stored
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t macro_init(nvs_handle_t nvs);
+
+#endif
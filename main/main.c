@@ -15,31 +15,30 @@
 #include "freertos/queue.h"
 #include "freertos/semphr.h"
 #include "esp_log.h"
-#include "driver/gpio.h"
-#include "driver/ledc.h"
-#include "driver/timer.h"
 #include "nvs.h"
 #include "esp_rom_sys.h"
 
+#include "dlog.h"
 #include "ble_receiver.h"
 #include "translator.h"
+#include "output.h"
+#include "keyer.h"
+#include "decoder.h"
+#include "transport.h"
+#include "uart_receiver.h"
+#include "spool.h"
+#include "macro.h"
+#include "beacon.h"
+#include "cache.h"
+#include "ttl.h"
+#include "strip.h"
+#include "bench.h"
+#include "power.h"
+#include "radio.h"
 
 
 #define APP_NAME "MORSE_CODE" //App name (for logs)
 
-#define DEBUG
-
-
-#define LEDC_TIMER_RESOLUTION LEDC_TIMER_13_BIT //< Timer resolution for buzzer PWM
-#define LEDC_SPEED_MODE LEDC_LOW_SPEED_MODE //< Speed mode for buzzer PWM
-#define BUZZER_CHANNEL LEDC_CHANNEL_0 //< Channel for buzzer PWM
-#define BUZZER_LEDC_TIMER LEDC_TIMER_0 //< Timer for buzzer PWM
-#define LEDC_TIMER_FREQ 5000 //< Timer frequency for buzzer PWM
-
-#define BUZZER_GPIO GPIO_NUM_12
-#define BUZZER_LED_GPIO GPIO_NUM_14
-#define LED_GPIO GPIO_NUM_27
-
 
 nvs_handle_t settings_nvs; //< Handle for storing settings (like volume)
 
@@ -47,15 +46,8 @@ nvs_handle_t settings_nvs; //< Handle for storing settings (like volume)
 #define VOLUME_NVS_KEY "volume"
 #define SETTINGS_NVS_KEY "m_c_settings"
 
-//Timer settings
-#define TIMER_BASE_CLK 80000000
-#define TIMER_DIVIDER (16)
-#define TIMER_SCALE (TIMER_BASE_CLK / TIMER_DIVIDER)
-
-
-//Base time interval (dettermines the length of one out_control interval)
-#define BASE_TIME_INT_MS 200
-
+#define LETTER_DECODE_LEN 256 //< Size of the buffer for decoded letters (longer messages are passed to the pipeline in more parts)
+#define LETTER_QUEUE_WAIT_MS 500 //< Maximum time, for which BLE is blocked when the write does not fit to the letter queue
 
 /**
  * @brief Updates volume level of the morse receiver
@@ -71,300 +63,539 @@ void update_volume(uint8_t new_volume) {
     err = nvs_commit(settings_nvs);
     ESP_ERROR_CHECK(err);
 
-    uint8_t val;
-    err = nvs_get_u8(settings_nvs, VOLUME_NVS_KEY, &val);
-    ESP_LOGI(APP_NAME, "val %d", val);
-    ESP_ERROR_CHECK(err);
-
     //Update characteristic value
-    uint16_t vol_handle = profile_tab[MORSE_CODE_RECEIVER_ID].char_handle_tab[VOLUME_CHAR];
-    err = esp_ble_gatts_set_attr_value(vol_handle, 1, &new_volume);
+    err = ble_set_char_value(VOLUME_CHAR, &new_volume, 1);
     ESP_ERROR_CHECK(err);
 
-    float perc = (float)new_volume/255.0;
+    output_set_volume(new_volume);
+}
 
-    unsigned new_duty = (unsigned)((1 << LEDC_TIMER_RESOLUTION)*perc);
 
-    //Update duty of PWM
-    ledc_set_duty(LEDC_SPEED_MODE, BUZZER_CHANNEL, new_duty);
-}
+/**
+ * @brief State of BLE transport (writes of characteristics), UART and benchmark have their own
+ *
+ */
+static transport_t ble_transport = { .queue_wait = pdMS_TO_TICKS(LETTER_QUEUE_WAIT_MS) };
 
 
 /**
  * @brief Abort message translation
  *
+ * @param transport Transport, that aborted the message (its partially decoded character is dropped)
  */
-void abort_message() {
-    if(queue)
+void abort_message(transport_t *transport) {
+    output_cancel_all(); //Everything that was accepted before is marked as cancelled (even if it is just processed)
+
+    translator_decoder_reset(&transport->decoder);
+
+    if(queue) {
         xQueueReset(queue);
-    if(out_queue)
-        xQueueReset(out_queue);
+        translator_space_freed(); //Writers waiting for the space can continue
+    }
+    for(int ch = 0; ch < OUTPUT_CHANNEL_NUM; ch++) {
+        if(out_queues[ch])
+            xQueueReset(out_queues[ch]);
+    }
+
+    output_backlog_reset();
+
+#ifdef MESSAGE_SPOOL
+    spool_abort();
+#endif
+
+#ifdef MESSAGE_CACHE
+    cache_abort();
+#endif
+
+#ifdef MESSAGE_TTL
+    ttl_abort();
+#endif
 }
 
 
 /**
- * @brief Write event handler for bluetooth module
+ * @brief Passes the item (letter or macro) to the letter queue (through the spool, if it is enabled)
  *
- * @param params
+ * @param item Item of the letter queue
+ * @return true if item was accepted
  */
-void write_event_handler(esp_ble_gatts_cb_param_t *params) {
-    char buffer[MAXIMUM_MESSAGE_LEN + 1];
+static bool push_item(const char *item) {
+#ifdef MESSAGE_SPOOL
+    return spool_push(item);
+#else
+    return queue_letter(item, (TickType_t)0);
+#endif
+}
+
 
-    if(params->write.handle == profile_tab[MORSE_CODE_RECEIVER_ID].char_handle_tab[VOLUME_CHAR]) { //Volume write
-        ESP_LOGI(MODULE_TAG, "Writing to volume characteristic");
+#ifdef MESSAGE_CACHE
+/**
+ * @brief Passes the whole message as one item to the letter queue (the message is compiled only if it is not cached)
+ *
+ * @param value Message (decoded letters, they all can be played)
+ * @param len Length of the message
+ * @param msg_id Id of the message
+ * @return true if message was accepted, false if it must be passed letter by letter
+ */
+static bool push_message(const uint8_t *value, uint16_t len, uint8_t msg_id) {
+    const char *letters = (const char *)value;
+    char item[LETTER_ITEM_SIZE] = { 0 };
+    size_t n = len;
 
-        update_volume(params->write.value[0]);
+    if(len > CACHE_MAX_LEN) {
+        return false;
     }
-    else if(params->write.handle == profile_tab[MORSE_CODE_RECEIVER_ID].char_handle_tab[BEEP_CHAR]) { //Beep
-        ESP_LOGI(MODULE_TAG, "Writing to beep characteristic");
 
-        abort_message();
+    int slot = cache_acquire(letters, n);
+    if(slot < 0) {
+        return false;
+    }
 
-        esp_err_t err = ledc_update_duty(LEDC_SPEED_MODE, BUZZER_CHANNEL);
-        ESP_ERROR_CHECK(err);
+    item[0] = CACHE_ITEM(slot);
+    item[MAXIMUM_MESSAGE_LEN + 1] = (char)msg_id;
 
-        err = gpio_set_level(BUZZER_LED_GPIO, 1);
-        ESP_ERROR_CHECK(err);
+#ifdef MESSAGE_SPOOL
+    bool pushed = spool_push_message(item, letters, n);
+#else
+    bool pushed = queue_letter(item, (TickType_t)0);
+#endif
+
+    if(!pushed) {
+        cache_release(slot);
     }
-    else if(params->write.handle == profile_tab[MORSE_CODE_RECEIVER_ID].char_handle_tab[LETTER_CHAR]) { //Letter (meesage) write
-        ESP_LOGI(MODULE_TAG, "Writing to letter characteristic");
 
-        int i = 0, j = 0;
-        while(i < params->write.len) {
-            size_t remaining_len = params->write.len - i;
-            size_t size_to_be_writen = remaining_len > MAXIMUM_MESSAGE_LEN ? MAXIMUM_MESSAGE_LEN : remaining_len;
+    return pushed;
+}
+#endif
 
-            memcpy(buffer, &(params->write.value[i]), size_to_be_writen);
-            memset(&(buffer[size_to_be_writen]), '\0', 1);
 
-            if(xQueueSend(queue, buffer, (TickType_t)0) != pdPASS) {
-                ESP_LOGE(MODULE_TAG, "Writing letter to the queue failed!");
-            }
+#ifdef MESSAGE_TTL
+/**
+ * @brief Passes letters of the message with deadline to the letter queue (they are not stored in the spool)
+ *
+ * @param value Message (without header)
+ * @param len Length of the message
+ * @param ttl_ms Time to live of the message
+ * @param msg_id Id of the message
+ * @return true if message was processed (passed to the queue or dropped), false if it must be passed as message without deadline
+ */
+static bool push_ttl_message(const uint8_t *value, uint16_t len, uint32_t ttl_ms, uint8_t msg_id) {
+    char item[LETTER_ITEM_SIZE] = { 0 };
+    uint16_t letters = 0;
+    uint8_t slot;
+
+    for(uint16_t i = 0; i < len; i++) {
+        if(char_lookup(do_char_correction((char)value[i]))) {
+            letters++;
+        }
+    }
 
-            i += size_to_be_writen;
-            j++;
+    if(!letters) {
+        return true;
+    }
 
-            if(j >= MAXIMUM_MESSAGE_NUM) {
-                break;
-            }
+    esp_err_t err = ttl_open(ttl_ms, letters, &slot);
+    if(err == ESP_ERR_TIMEOUT) { //Message would start after its deadline
+        ttl_drop_message(letters);
+        return true;
+    }
+    else if(err != ESP_OK) {
+        DLOGW(APP_NAME, "No free slot for deadline, message will be played without it");
+        return false;
+    }
+
+    for(uint16_t i = 0; i < len; i++) {
+        if(!char_lookup(do_char_correction((char)value[i]))) {
+            continue;
+        }
+
+        item[0] = (char)value[i];
+        item[MAXIMUM_MESSAGE_LEN] = (char)slot;
+        item[MAXIMUM_MESSAGE_LEN + 1] = (char)msg_id;
+        if(!queue_letter(item, (TickType_t)0)) {
+            ttl_letter(slot, true);
         }
     }
-    else if(params->write.handle == profile_tab[MORSE_CODE_RECEIVER_ID].char_handle_tab[ABORT_CHAR]) { //Abort char
-        ESP_LOGI(MODULE_TAG, "Writing to abort characteristic");
 
-        abort_message();
+    return true;
+}
+#endif
 
-        esp_err_t err = ledc_stop(LEDC_SPEED_MODE, BUZZER_CHANNEL, 0);
-        ESP_ERROR_CHECK(err);
 
-        err = gpio_set_level(BUZZER_LED_GPIO, 0);
-        ESP_ERROR_CHECK(err);
+#ifdef MULTI_CHANNEL
+/**
+ * @brief Passes letters of the message for other than primary channel to the letter queue (they are not stored
+ * in the spool nor in the cache)
+ *
+ * @param value Message (without header)
+ * @param len Length of the message
+ * @param channel Output channel
+ * @param msg_id Id of the message
+ */
+static void push_channel_message(const uint8_t *value, uint16_t len, uint8_t channel, uint8_t msg_id) {
+    char item[LETTER_ITEM_SIZE] = { 0 };
 
-        err = gpio_set_level(LED_GPIO, 0);
-        ESP_ERROR_CHECK(err);
-    }
-    else { //Unrecognized char
-        ESP_LOGE(MODULE_TAG, "Unrecognized handle!, handle=%d", params->write.handle);
+    for(uint16_t i = 0; i < len; i++) {
+        if(!char_lookup(do_char_correction((char)value[i]))) {
+            DLOGE(APP_NAME, "Unable to find character in lookup table!");
+            continue;
+        }
+
+        item[0] = (char)value[i];
+        item[MAXIMUM_MESSAGE_LEN + 1] = (char)msg_id;
+        item[MAXIMUM_MESSAGE_LEN + 3] = (char)channel;
+        if(!queue_letter(item, (TickType_t)0)) {
+            DLOGE(APP_NAME, "Writing letter to the queue failed!");
+            break;
+        }
     }
 }
+#endif
 
 
 /**
- * @brief Sets the outputs due to given out control structure, also decrements counters in this structure
- * and determines if there is something more to do
+ * @brief Performs operation with macro
  *
- * @param control Control structure for controlling outputs
- * @param should_be_returned output argument, sets it to true if there is something more to do in control structure
+ * @param value Data of the macro command (operation, id and text)
+ * @param len Length of the data
  */
-void set_outputs(out_control_t *control, bool *should_be_returned) {
-    esp_err_t err;
-    *should_be_returned = false; //Presume, that there is nothing to do
+static void macro_command(const uint8_t *value, uint16_t len) {
+    char item[LETTER_ITEM_SIZE] = { 0 };
 
-    if(control->buzz_state > 0) { //Beep if related out control is greater than zero
-        control->buzz_state--;
+    if(len < 2) {
+        DLOGE(APP_NAME, "Invalid macro command!");
+        return;
+    }
 
-        *should_be_returned = true;
+    uint8_t id = value[1];
 
-        err = ledc_update_duty(LEDC_SPEED_MODE, BUZZER_CHANNEL);
-        ESP_ERROR_CHECK(err);
+    switch(value[0]) {
+        case MACRO_STORE_OP:
+            macro_store(id, &value[2], len - 2);
+            break;
 
-        // Turning on LED as well as buzzer
-        err = gpio_set_level(BUZZER_LED_GPIO, 1);
-        ESP_ERROR_CHECK(err);
+        case MACRO_PLAY_OP:
+            if(!macro_exists(id)) {
+                DLOGE(APP_NAME, "Macro %d does not exist!", id);
+                break;
+            }
+
+            item[0] = MACRO_ITEM(id);
+            if(!push_item(item)) {
+                DLOGE(APP_NAME, "Writing letter to the queue failed!");
+            }
+            break;
+
+        case MACRO_DELETE_OP:
+            if(macro_delete(id) == ESP_OK) {
+                beacon_macro_deleted(id);
+            }
+            break;
+
+        case MACRO_BEACON_OP:
+            if(len < 6) {
+                DLOGE(APP_NAME, "Invalid beacon command!");
+                break;
+            }
+
+            beacon_configure(id, value[2] | (value[3] << 8), value[4] | (value[5] << 8));
+            break;
+
+        default:
+            DLOGE(APP_NAME, "Unknown macro operation %d!", value[0]);
+            break;
     }
-    else {
-        err = ledc_stop(LEDC_SPEED_MODE, BUZZER_CHANNEL, 0);
-        ESP_ERROR_CHECK(err);
+}
 
-        // Turning off LED as well as buzzer
-        err = gpio_set_level(BUZZER_LED_GPIO, 0);
-        ESP_ERROR_CHECK(err);
+
+/**
+ * @brief Counts letters of the text of the letter command (so the space for the whole write can be reserved)
+ *
+ * @param decoder Copy of the decoder of the transport (after the call it is in the state after the whole text)
+ * @param value Text of the message
+ * @param len Length of the text
+ * @param packed true if the text is compressed
+ * @param codes Buffer for decoded letters (LETTER_DECODE_LEN)
+ * @return size_t Number of letters
+ */
+static size_t count_letters(utf8_decoder_t *decoder, const uint8_t *value, uint16_t len, bool packed, char *codes) {
+    size_t letters = 0;
+
+    while(len > 0) {
+        size_t consumed;
+        letters += packed ?
+            translator_decode_packed(decoder, value, len, &consumed, codes, LETTER_DECODE_LEN) :
+            translator_decode(decoder, value, len, &consumed, codes, LETTER_DECODE_LEN);
+
+        value += consumed;
+        len -= consumed;
     }
 
-    if(control->led_state > 0) { //Turn led on if related out control is greater than zero
-        control->led_state--;
+    return letters;
+}
 
-        *should_be_returned = true;
 
-        #ifdef DEBUG
-            esp_rom_printf("turning led on");
-        #endif
+/**
+ * @brief Passes decoded letters of the message to the letter queue (through the deadlines, cache or spool), space
+ * for them must be reserved
+ *
+ * @param value Codes of letters
+ * @param len Number of codes
+ * @param msg_id Id of the message
+ * @param channel Output channel
+ * @param ttl_ms Time to live of the message (0 if it has no deadline)
+ */
+static void push_letters(const uint8_t *value, uint16_t len, uint8_t msg_id, uint8_t channel, uint32_t ttl_ms) {
+    char buffer[LETTER_ITEM_SIZE];
 
-        err = gpio_set_level(LED_GPIO, 1);
-        ESP_ERROR_CHECK(err);
+#ifdef MULTI_CHANNEL
+    if(channel) { //Deadlines, spool and cache are used only by the primary channel
+        if(ttl_ms) {
+            DLOGW(APP_NAME, "Deadline is ignored in channel %d", channel);
+        }
+
+        push_channel_message(value, len, channel, msg_id);
+        return;
     }
-    else {
-        err = gpio_set_level(LED_GPIO, 0);
-        ESP_ERROR_CHECK(err);
+#else
+    (void)channel; //Only the primary channel exists
+#endif
+
+#ifdef MESSAGE_TTL
+    if(ttl_ms && push_ttl_message(value, len, ttl_ms, msg_id)) {
+        return;
+    }
+#endif
+
+#ifdef MESSAGE_CACHE
+    if(push_message(value, len, msg_id)) {
+        return;
     }
+#endif
+
+    int i = 0, j = 0;
+    while(i < len) {
+        size_t remaining_len = len - i;
+        size_t size_to_be_writen = remaining_len > MAXIMUM_MESSAGE_LEN ? MAXIMUM_MESSAGE_LEN : remaining_len;
+
+        memset(buffer, '\0', sizeof(buffer));
+        memcpy(buffer, &(value[i]), size_to_be_writen);
+        buffer[MAXIMUM_MESSAGE_LEN + 1] = (char)msg_id;
+
+        //Only letters that will be played are accepted (control characters are reserved for macros)
+        if(!char_lookup(do_char_correction(buffer[0]))) {
+            DLOGE(APP_NAME, "Unable to find character in lookup table!");
+        }
+        else if(!push_item(buffer)) {
+            DLOGE(APP_NAME, "Writing letter to the queue failed!");
+        }
+
+        i += size_to_be_writen;
+        j++;
 
-    if(!*should_be_returned) { //After everything is done in out control start decrementing gap counter
-        if(control->gap > 0) {
-            control->gap--;
-            *should_be_returned = true;
+        if(j >= MAXIMUM_MESSAGE_NUM) {
+            break;
         }
     }
 }
 
 
 /**
- * @brief ISR for interrupts from timer (they comes every BASE_TIME_INT_MS), translates out control sequence to beeping and blinking
+ * @brief Handler of commands from all transports (BLE, UART), it can be called by more tasks at once
  *
- * @param args
- * @return true
- * @return false
+ * @param transport Transport, from which the command came
+ * @param cmd Command
+ * @param value Data of the command
+ * @param len Length of the data
  */
-static bool IRAM_ATTR out_control_routine(void *args) {
-    BaseType_t higher_priority_task_woken = pdFALSE;
-    out_control_t out_control;
-    bool will_be_returned = false;
+void command_handler(transport_t *transport, enum transport_cmds cmd, const uint8_t *value, uint16_t len) {
+#ifdef POWER_MANAGEMENT
+    if(cmd == BEEP_CMD) { //Beep lasts until the next command and it is not driven by the output timer
+        power_acquire(POWER_BEEP);
+    }
+    else {
+        power_release(POWER_BEEP);
+    }
+#endif
 
-    if(xSemaphoreTakeFromISR(out_queue_sem, &higher_priority_task_woken) == pdTRUE) {
-        if(xQueueReceiveFromISR(out_queue, &out_control, &higher_priority_task_woken)) {
-            #ifdef DEBUG
-                esp_rom_printf("Picked BUZZ %d LED %d GAP %d\n", out_control.buzz_state, out_control.led_state, out_control.gap);
-            #endif
+    switch(cmd) {
+        case VOLUME_CMD:
+            DLOGI(APP_NAME, "Volume command");
+
+            if(len < 1) {
+                DLOGE(APP_NAME, "Missing volume level!");
+                break;
+            }
 
-            set_outputs(&out_control, &will_be_returned);
+            update_volume(value[0]);
+            break;
 
-            if(will_be_returned == true) { //Return the outcontrol to out control queue if there is still something to do in it
-                xQueueSendToFrontFromISR(out_queue, &out_control, &higher_priority_task_woken);
+        case PITCH_CMD:
+            DLOGI(APP_NAME, "Pitch command");
+
+            if(len < 3) {
+                DLOGE(APP_NAME, "Missing channel or pitch!");
+                break;
             }
-        }
 
-        xSemaphoreGiveFromISR(out_queue_sem, &higher_priority_task_woken);
-    }
+            if(output_set_channel_pitch(value[0], value[1] | (value[2] << 8)) != ESP_OK) {
+                DLOGE(APP_NAME, "Invalid pitch of channel %u!", value[0]);
+            }
+            break;
+
+        case BEEP_CMD:
+            DLOGI(APP_NAME, "Beep command");
+
+            abort_message(transport);
+
+            output_buzzer_set(true);
+            break;
+
+        case LETTER_CMD: { //Letter (meesage) write
+            DLOGD(APP_NAME, "Letter command, len=%d", len);
+
+            char codes[LETTER_DECODE_LEN];
+
+            uint8_t msg_id = 0;
+            uint8_t channel = 0;
+            uint32_t ttl_ms = 0;
+            bool packed = false;
+
+            //Optional headers (in any order) before the text of the message
+            while(len > 0) {
+                if(value[0] == MSG_ID_PREFIX && len >= MSG_ID_HEADER_LEN) {
+                    msg_id = value[1];
+
+                    value += MSG_ID_HEADER_LEN;
+                    len -= MSG_ID_HEADER_LEN;
+                }
+                else if(value[0] == CHANNEL_PREFIX && len >= CHANNEL_HEADER_LEN) { //Message for other output channel
+                    channel = value[1];
+                    if(value[2] && output_set_channel_wpm(channel, value[2]) != ESP_OK) {
+                        DLOGE(APP_NAME, "Invalid speed of channel %d!", channel);
+                    }
+
+                    value += CHANNEL_HEADER_LEN;
+                    len -= CHANNEL_HEADER_LEN;
+                }
+#ifdef MESSAGE_TTL
+                else if(value[0] == TTL_PREFIX && len >= TTL_HEADER_LEN) { //Message with deadline
+                    ttl_ms = (uint32_t)(value[1] | (value[2] << 8)) * 1000;
+
+                    value += TTL_HEADER_LEN;
+                    len -= TTL_HEADER_LEN;
+                }
+#endif
+#ifdef PACKED_TEXT
+                else if(value[0] == PACKED_PREFIX) { //Compressed text (the rest of the write are codes, not headers)
+                    packed = true;
+
+                    value++;
+                    len--;
+                    break;
+                }
+#endif
+                else {
+                    break;
+                }
+            }
 
-    return higher_priority_task_woken == pdTRUE;
-}
+            if(channel >= OUTPUT_CHANNEL_NUM) {
+                DLOGE(APP_NAME, "Channel %d does not exist!", channel);
+                break;
+            }
 
+            output_accept_message(msg_id); //Id can be reused after the message was aborted
+
+            //Space for the whole write is reserved before any letter is passed to the queue, so the transport is
+            //slowed down (BLE stack stops receiving, the client is slowed down by the flow control) and the write
+            //is never accepted only partially
+            utf8_decoder_t counted = transport->decoder;
+            size_t letters = count_letters(&counted, value, len, packed, codes);
+            if(!letters || !translator_reserve(letters, transport->queue_wait)) {
+                if(letters) {
+                    DLOGE(APP_NAME, "Letter queue is full, %u letters were rejected!", (unsigned)letters);
+                }
+
+                transport->decoder = counted; //The whole text is skipped
+                if(packed) {
+                    translator_packed_end(&transport->decoder);
+                }
+                break;
+            }
 
+            //Text is decoded in parts (every part is passed to the pipeline as one message)
+            while(len > 0) {
+                size_t consumed;
+                size_t codes_len = packed ?
+                    translator_decode_packed(&transport->decoder, value, len, &consumed, codes, sizeof(codes)) :
+                    translator_decode(&transport->decoder, value, len, &consumed, codes, sizeof(codes));
 
+                push_letters((const uint8_t *)codes, codes_len, msg_id, channel, ttl_ms);
 
-/**
- * @brief Initialization of PWM (ledc) for buzzer
- *
- * @return esp_err_t ESP_OK if everyhing went ok
- */
-esp_err_t ledc_init() {
-    esp_err_t err;
+                value += consumed;
+                len -= consumed;
+            }
 
-    ledc_timer_config_t ledc_timer = {
-        .duty_resolution = LEDC_TIMER_RESOLUTION,
-        .freq_hz = LEDC_TIMER_FREQ,
-        .speed_mode = LEDC_SPEED_MODE,
-        .timer_num = BUZZER_LEDC_TIMER,
-        .clk_cfg = LEDC_AUTO_CLK,
-    };
+            if(packed) { //Every write contains whole codes (the padding is dropped)
+                translator_packed_end(&transport->decoder);
+            }
 
-    err = ledc_timer_config(&ledc_timer);
-    if(err != ESP_OK) {
-        ESP_LOGE(APP_NAME, "ledc_stop failed!");
-        return err;
-    }
+            translator_unreserve(); //Letters that were not passed to the queue (e. g. cached message) free their space
+            break;
+        }
 
-    ledc_channel_config_t ledc_channel = {
-        .speed_mode = LEDC_SPEED_MODE,
-        .channel = BUZZER_CHANNEL,
-        .timer_sel = BUZZER_LEDC_TIMER,
-        .intr_type = LEDC_INTR_DISABLE,
-        .gpio_num = BUZZER_GPIO,
-        .duty = 0,
-        .hpoint = 0,
-    };
+        case MACRO_CMD:
+            DLOGI(APP_NAME, "Macro command");
 
-    err = ledc_channel_config(&ledc_channel);
-    if(err != ESP_OK) {
-        ESP_LOGE(APP_NAME, "ledc_channel_config failed!");
-        return err;
-    }
+            macro_command(value, len);
+            break;
 
-    //Initial level of PWM
-    err = ledc_stop(LEDC_SPEED_MODE, BUZZER_CHANNEL, 0);
-    if(err) {
-        ESP_LOGE(APP_NAME, "ledc_stop failed!");
-        return err;
-    }
+        case ABORT_CMD:
+            DLOGI(APP_NAME, "Abort command");
 
-    return ESP_OK;
+            if(len == 2 && value[0] == ABORT_MESSAGE_OP) { //Only one message is aborted
+                output_cancel_message(value[1]);
+                break;
+            }
+
+            abort_message(transport);
+
+            output_buzzer_set(false);
+            output_led_set(false);
+            break;
+    }
 }
 
 
 /**
- * @brief Initilization of timer for beeping and blinking
+ * @brief Write event handler for bluetooth module (translates writes of characteristics to commands)
  *
- * @return esp_err_t ESP_OK if everyhing went ok
+ * @param params
  */
-esp_err_t out_control_timer_init() {
-    esp_err_t err;
-
-    timer_config_t config = {
-        .divider = TIMER_DIVIDER,
-        .counter_dir = TIMER_COUNT_UP,
-        .counter_en = TIMER_PAUSE,
-        .alarm_en = TIMER_ALARM_EN,
-        .auto_reload = true,
-    };
+void write_event_handler(ble_write_evt_t *params) {
+    if(params->handle == morse_code_char_handle_tab[VOLUME_CHAR]) { //Volume write
+        command_handler(&ble_transport, VOLUME_CMD, params->value, params->len);
 
-    err = timer_init(TIMER_GROUP_0, TIMER_0, &config);
-    if(err != ESP_OK) {
-        ESP_LOGE(APP_NAME, "timer_init failed!");
-        return err;
+        if(params->len > 1) { //Volume can be followed by the pitch of the channel [volume, channel, pitch]
+            command_handler(&ble_transport, PITCH_CMD, &params->value[1], params->len - 1);
+        }
     }
-
-    err = timer_set_counter_value(TIMER_GROUP_0, TIMER_0, 0);
-    if(err != ESP_OK) {
-        ESP_LOGE(APP_NAME, "timer_set_counter_value failed!");
-        return err;
+    else if(params->handle == morse_code_char_handle_tab[BEEP_CHAR]) { //Beep
+        command_handler(&ble_transport, BEEP_CMD, params->value, params->len);
     }
-
-    //Interupts should come every BASE_TIME_INT_MS
-    err = timer_set_alarm_value(TIMER_GROUP_0, TIMER_0, (int)((BASE_TIME_INT_MS * 1e-3) * TIMER_SCALE)); //Time in secs * scale
-    if(err != ESP_OK) {
-        ESP_LOGE(APP_NAME, "timer_set_alarm_value failed!");
-        return err;
+    else if(params->handle == morse_code_char_handle_tab[LETTER_CHAR]) { //Letter (meesage) write
+        command_handler(&ble_transport, LETTER_CMD, params->value, params->len);
     }
-
-    err = timer_enable_intr(TIMER_GROUP_0, TIMER_0);
-    if(err != ESP_OK) {
-        ESP_LOGE(APP_NAME, "timer_enable_intr failed!");
-        return err;
+    else if(params->handle == morse_code_char_handle_tab[ABORT_CHAR]) { //Abort char
+        command_handler(&ble_transport, ABORT_CMD, params->value, params->len);
     }
-
-    //Register ISR
-    err = timer_isr_callback_add(TIMER_GROUP_0, TIMER_0, out_control_routine, NULL,  0);
-    if(err != ESP_OK) {
-        ESP_LOGE(APP_NAME, "timer_isr_callback_add failed!");
-        return err;
+    else if(params->handle == morse_code_char_handle_tab[MACRO_CHAR]) { //Macro char
+        command_handler(&ble_transport, MACRO_CMD, params->value, params->len);
     }
-
-    err = timer_start(TIMER_GROUP_0, TIMER_0);
-    if(err != ESP_OK) {
-        ESP_LOGE(APP_NAME, "timer_start failed!");
-        return err;
+    else { //Unrecognized char
+        DLOGE(MODULE_TAG, "Unrecognized handle!, handle=%d", params->handle);
     }
-
-    return ESP_OK;
 }
 
 
@@ -403,9 +634,20 @@ esp_err_t restore_volume() {
  * @param char_handle
  */
 void char_added_cb(uint16_t char_handle) {
-    if(profile_tab[MORSE_CODE_RECEIVER_ID].char_handle_tab[VOLUME_CHAR] == char_handle) {
+    if(morse_code_char_handle_tab[VOLUME_CHAR] == char_handle) {
         ESP_ERROR_CHECK(restore_volume());
     }
+    else if(morse_code_char_handle_tab[LETTER_CHAR] == char_handle) {
+        uint8_t caps = 0;
+#ifdef PACKED_TEXT
+        caps |= LETTER_CAP_PACKED;
+#endif
+        ble_set_char_value(LETTER_CHAR, &caps, 1); //Client reads capabilities of the receiver
+    }
+    else if(morse_code_char_handle_tab[SPEED_CHAR] == char_handle) {
+        uint8_t wpm = output_get_wpm();
+        ble_set_char_value(SPEED_CHAR, &wpm, 1);
+    }
 }
 
 
@@ -418,6 +660,14 @@ TaskHandle_t translator_handle = NULL;
 void app_main(void) {
     esp_err_t err;
 
+    err = dlog_init();
+    ESP_ERROR_CHECK(err);
+
+#ifdef POWER_MANAGEMENT
+    err = power_init(); //Locks must exist before the pipeline starts
+    ESP_ERROR_CHECK(err);
+#endif
+
     err = translator_init();
     ESP_ERROR_CHECK(err);
 
@@ -432,7 +682,20 @@ void app_main(void) {
     err = nvs_open(SETTINGS_NVS_KEY, NVS_READWRITE, &settings_nvs);
     ESP_ERROR_CHECK(err);
 
-    err = ledc_init();
+#ifdef MESSAGE_CACHE
+    err = cache_init();
+    ESP_ERROR_CHECK(err);
+#endif
+
+    err = macro_init(settings_nvs);
+    ESP_ERROR_CHECK(err);
+
+#ifdef MESSAGE_SPOOL
+    err = spool_init();
+    ESP_ERROR_CHECK(err);
+#endif
+
+    err = output_init();
     ESP_ERROR_CHECK(err);
 
     err = bluetooth_init(write_event_handler, char_added_cb);
@@ -442,21 +705,36 @@ void app_main(void) {
     err = out_control_timer_init();
     ESP_ERROR_CHECK(err);
 
-    esp_rom_gpio_pad_select_gpio(LED_GPIO);
-    err = gpio_set_direction(LED_GPIO, GPIO_MODE_OUTPUT);
+#ifdef RADIO_KEYING
+    err = radio_init();
     ESP_ERROR_CHECK(err);
+#endif
 
-    err = gpio_set_level(LED_GPIO, 0);
+    err = keyer_init();
     ESP_ERROR_CHECK(err);
 
+    err = beacon_init(settings_nvs, push_item);
+    ESP_ERROR_CHECK(err);
 
-    esp_rom_gpio_pad_select_gpio(BUZZER_LED_GPIO);
-    err = gpio_set_direction(BUZZER_LED_GPIO, GPIO_MODE_OUTPUT);
+#ifdef LED_STRIP
+    err = strip_init();
     ESP_ERROR_CHECK(err);
+#endif
 
-    err = gpio_set_level(BUZZER_LED_GPIO, 0);
+#ifdef AUDIO_DECODER
+    err = decoder_init();
     ESP_ERROR_CHECK(err);
+#endif
 
+#ifdef UART_RECEIVER
+    err = uart_receiver_init(command_handler);
+    ESP_ERROR_CHECK(err);
+#endif
+
+#ifdef TIMING_BENCH
+    err = bench_init(command_handler);
+    ESP_ERROR_CHECK(err);
+#endif
 
-    xTaskCreatePinnedToCore(translate, "translator", 4096, NULL, 10, &translator_handle, 1);
+    xTaskCreatePinnedToCore(translate, "translator", 4096, NULL, 10, &translator_handle, OUTPUT_CORE);
 }
\ No newline at end of file
@@ -0,0 +1,793 @@
+/**
+ * @file output.c
+ *
+ * @brief Output engine of morse code receiver (buzzer, LEDs and timer that plays out control queue)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "output.h"
+#include "esp_rom_sys.h"
+#include "spool.h"
+#include "esp_timer.h"
+#include "strip.h"
+#include "bench.h"
+#include "stats.h"
+#include "power.h"
+#include "esp_ipc.h"
+#include "radio.h"
+
+
+#define DEBUG
+
+
+volatile bool output_override = false;
+volatile uint8_t output_generation = 0;
+volatile TaskHandle_t output_idle_waiter = NULL;
+
+static volatile bool timer_running = false; //< Out control timer runs only while there is something to play
+static portMUX_TYPE timer_lock = portMUX_INITIALIZER_UNLOCKED; //< Protects the state of the timer and the backlog
+
+static volatile uint32_t cancelled_ids[256 / 32]; //< Bit for every cancelled message id
+static int64_t abort_latency_max_us = 0; //< The longest measured time between abort and silence
+
+
+#define UNIT_TICKS(ms) ((ms) > OUTPUT_TICK_MS ? ((ms) + OUTPUT_TICK_MS / 2) / OUTPUT_TICK_MS : 1) //< Length of the dot in timer ticks
+
+#ifdef TONE_OUTPUT
+#define CHANNEL_HAS_TONE(ch) ((ch) == 0) //< Buzzer of the primary channel is replaced by the sidetone
+#else
+#define CHANNEL_HAS_TONE(ch) false
+#endif
+
+
+/**
+ * @brief Output channels (the first one is the primary channel, that is used by the keyer, beep, macros etc.)
+ *
+ */
+static output_channel_t channels[OUTPUT_CHANNEL_NUM] = {
+    {
+        .ledc_channel = BUZZER_CHANNEL, .ledc_timer = BUZZER_LEDC_TIMER, .freq = LEDC_TIMER_FREQ,
+        .buzzer_gpio = BUZZER_GPIO, .buzzer_led_gpio = BUZZER_LED_GPIO, .led_gpio = LED_GPIO,
+        .unit_ms = BASE_TIME_INT_MS, .base_unit_ms = BASE_TIME_INT_MS, .unit_ticks = UNIT_TICKS(BASE_TIME_INT_MS),
+    },
+#ifdef MULTI_CHANNEL
+    {
+        .ledc_channel = CHANNEL_1_LEDC_CHANNEL, .ledc_timer = CHANNEL_1_LEDC_TIMER, .freq = CHANNEL_1_FREQ,
+        .buzzer_gpio = CHANNEL_1_BUZZER_GPIO, .buzzer_led_gpio = CHANNEL_1_BUZZER_LED_GPIO, .led_gpio = CHANNEL_1_LED_GPIO,
+        .unit_ms = BASE_TIME_INT_MS, .base_unit_ms = BASE_TIME_INT_MS, .unit_ticks = UNIT_TICKS(BASE_TIME_INT_MS),
+    },
+    {
+        .ledc_channel = CHANNEL_2_LEDC_CHANNEL, .ledc_timer = CHANNEL_2_LEDC_TIMER, .freq = CHANNEL_2_FREQ,
+        .buzzer_gpio = CHANNEL_2_BUZZER_GPIO, .buzzer_led_gpio = CHANNEL_2_BUZZER_LED_GPIO, .led_gpio = CHANNEL_2_LED_GPIO,
+        .unit_ms = BASE_TIME_INT_MS, .base_unit_ms = BASE_TIME_INT_MS, .unit_ticks = UNIT_TICKS(BASE_TIME_INT_MS),
+    },
+#endif
+};
+
+
+void output_channel_buzzer_set(uint8_t ch, bool on) {
+    esp_err_t err;
+
+    if(CHANNEL_HAS_TONE(ch)) {
+        tone_key(on);
+    }
+    else if(on) {
+        err = ledc_update_duty(LEDC_SPEED_MODE, channels[ch].ledc_channel);
+        ESP_ERROR_CHECK(err);
+    }
+    else {
+        err = ledc_stop(LEDC_SPEED_MODE, channels[ch].ledc_channel, 0);
+        ESP_ERROR_CHECK(err);
+    }
+
+    // Turning on/off LED as well as buzzer
+    err = gpio_set_level(channels[ch].buzzer_led_gpio, on);
+    ESP_ERROR_CHECK(err);
+}
+
+
+/**
+ * @brief Keys the channel, edges of the primary channel are scheduled by the keying output if RADIO_KEYING is defined
+ *
+ * @param ch Index of the channel
+ * @param on true if the channel should beep
+ * @param late_us Time elapsed since the nominal time of the edge
+ */
+static void output_channel_key(uint8_t ch, bool on, uint32_t late_us) {
+#ifdef RADIO_KEYING
+    if(ch == 0) {
+        radio_key(on, channels[0].unit_ms * 1000, late_us);
+        return;
+    }
+#endif
+
+    output_channel_buzzer_set(ch, on);
+}
+
+
+void output_key_set(bool on) {
+    output_channel_key(0, on, 0);
+}
+
+
+void output_channel_led_set(uint8_t ch, bool on) {
+    esp_err_t err = gpio_set_level(channels[ch].led_gpio, on);
+    ESP_ERROR_CHECK(err);
+}
+
+
+void output_buzzer_set(bool on) {
+    output_channel_buzzer_set(0, on);
+    output_notify_tone(NULL);
+}
+
+
+void IRAM_ATTR output_notify_tone(BaseType_t *higher_priority_task_woken) {
+#ifdef TONE_OUTPUT
+    tone_notify(higher_priority_task_woken);
+#endif
+}
+
+
+void output_led_set(bool on) {
+    output_channel_led_set(0, on);
+}
+
+
+void output_set_volume(uint8_t volume) {
+#ifdef TONE_OUTPUT
+    tone_set_volume(volume);
+#endif
+
+    float perc = (float)volume/255.0;
+
+    unsigned new_duty = (unsigned)((1 << LEDC_TIMER_RESOLUTION)*perc);
+
+    //Update duty of PWM (all channels have the same volume)
+    for(int ch = 0; ch < OUTPUT_CHANNEL_NUM; ch++) {
+        if(!CHANNEL_HAS_TONE(ch)) {
+            ledc_set_duty(LEDC_SPEED_MODE, channels[ch].ledc_channel, new_duty);
+        }
+    }
+}
+
+
+/**
+ * @brief Sets the outputs of the channel due to given out control structure, also decrements counters in this structure
+ * and determines if there is something more to do
+ *
+ * @param ch Index of the channel
+ * @param control Control structure for controlling outputs
+ * @param should_be_returned output argument, sets it to true if there is something more to do in control structure
+ */
+void set_outputs(uint8_t ch, out_control_t *control, bool *should_be_returned) {
+    *should_be_returned = false; //Presume, that there is nothing to do
+
+    //Time from the alarm of the output timer (edges of the keying output are scheduled from the alarm)
+    uint32_t late_us = (uint32_t)(timer_group_get_counter_value_in_isr(TIMER_GROUP_0, TIMER_0) / (TIMER_SCALE / 1000000));
+
+#ifdef TIMING_BENCH
+    bench_edge(ch, control->buzz_state > 0); //Edge is timestamped before the output is switched
+#endif
+
+    if(control->buzz_state > 0) { //Beep if related out control is greater than zero
+        control->buzz_state--;
+
+        *should_be_returned = true;
+
+        output_channel_key(ch, true, late_us);
+    }
+    else {
+        output_channel_key(ch, false, late_us);
+    }
+
+    if(control->led_state > 0) { //Turn led on if related out control is greater than zero
+        control->led_state--;
+
+        *should_be_returned = true;
+
+        #ifdef DEBUG
+            DLOGD(OUTPUT_TAG, "turning led on");
+        #endif
+
+        output_channel_led_set(ch, true);
+    }
+    else {
+        output_channel_led_set(ch, false);
+    }
+
+    if(!*should_be_returned) { //After everything is done in out control start decrementing gap counter
+        if(control->gap > 0) {
+            control->gap--;
+            *should_be_returned = true;
+        }
+    }
+}
+
+
+/**
+ * @brief Plays one out control interval of the channel (it must be called in the critical section)
+ *
+ * @param ch Index of the channel
+ * @param higher_priority_task_woken Set to pdTRUE if some task was woken
+ * @return true if the channel is busy (something was played or there is still something to play)
+ */
+static bool IRAM_ATTR channel_tick(uint8_t ch, BaseType_t *higher_priority_task_woken) {
+    output_channel_t *c = &channels[ch];
+    out_control_t out_control;
+    bool will_be_returned = false;
+    bool letter_end = false;
+
+    if(xSemaphoreTakeFromISR(out_queue_sems[ch], higher_priority_task_woken) != pdTRUE) {
+        return true; //Letter is just being written to the queue, so it is played in the next tick
+    }
+
+    //Skip cancelled out controls (at most OUTPUT_DROP_BURST of them to keep the ISR short)
+    bool received = false;
+    int dropped = 0;
+    while(dropped < OUTPUT_DROP_BURST && xQueueReceiveFromISR(out_queues[ch], &out_control, higher_priority_task_woken)) {
+        if(!output_is_cancelled(out_control.gen, out_control.msg_id)) {
+            received = true;
+            break;
+        }
+
+        uint32_t ticks = OUT_CONTROL_TICKS(out_control);
+        c->backlog = c->backlog > ticks ? c->backlog - ticks : 0;
+
+        output_drop(&out_control, 1);
+        dropped++;
+    }
+
+    if(received) {
+        if(c->backlog > 0) {
+            c->backlog--;
+        }
+
+        #ifdef DEBUG
+            DLOGD(OUTPUT_TAG, "Channel %u picked BUZZ %d LED %d GAP %d", ch, out_control.buzz_state, out_control.led_state, out_control.gap);
+        #endif
+
+        #ifdef LED_STRIP
+        if(ch == 0) {
+            strip_sample(out_control.buzz_state ? STRIP_SAMPLE_BUZZ : out_control.led_state ? STRIP_SAMPLE_LED : STRIP_SAMPLE_OFF);
+        }
+        #endif
+
+        letter_end = out_control.flags & OUT_ITEM_END;
+        c->playing_id = out_control.msg_id;
+        c->countdown = c->unit_ticks;
+
+        set_outputs(ch, &out_control, &will_be_returned);
+
+        if(will_be_returned == true) { //Return the outcontrol to out control queue if there is still something to do in it
+            xQueueSendToFrontFromISR(out_queues[ch], &out_control, higher_priority_task_woken);
+        }
+        #ifdef MESSAGE_SPOOL
+        else if(letter_end && !(out_control.flags & OUT_ITEM_UNSPOOLED)) { //Gap after the letter ended, so the whole letter was played
+            spool_letter_played(out_control.gen);
+        }
+        #endif
+    }
+    else if(dropped) { //Only cancelled out controls were in the queue
+        output_channel_key(ch, false, 0);
+        output_channel_led_set(ch, false);
+    }
+
+    TaskHandle_t waiter = out_space_waiter;
+    if(waiter && (dropped || (received && !will_be_returned))) { //Some space in the queue was freed
+        vTaskNotifyGiveFromISR(waiter, higher_priority_task_woken);
+    }
+
+    bool busy = received || uxQueueMessagesWaitingFromISR(out_queues[ch]) > 0;
+
+    xSemaphoreGiveFromISR(out_queue_sems[ch], higher_priority_task_woken);
+
+    return busy;
+}
+
+
+/**
+ * @brief ISR for interrupts from timer (they comes every OUTPUT_TICK_MS), it schedules all channels, every channel
+ * translates its out control sequence to beeping and blinking with its own length of the dot
+ *
+ * @param args
+ * @return true
+ * @return false
+ */
+static bool IRAM_ATTR out_control_routine(void *args) {
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    bool busy = false;
+    TaskHandle_t idle_waiter = NULL;
+
+#ifdef RUNTIME_STATS
+    stats_count(STATS_OUTPUT_TICKS);
+#endif
+
+    portENTER_CRITICAL_ISR(&timer_lock); //The whole tick is atomic with respect to cancellation
+    for(uint8_t ch = 0; ch < OUTPUT_CHANNEL_NUM; ch++) {
+        if(channels[ch].countdown > 1) { //The current out control interval of the channel continues
+            channels[ch].countdown--;
+            busy = true;
+        }
+        else if(ch == 0 && output_override) { //Somebody else (local keyer) drives the outputs, so the queue waits
+            busy = true;
+        }
+        else {
+            channels[ch].countdown = 0;
+            busy |= channel_tick(ch, &higher_priority_task_woken);
+        }
+    }
+
+    if(!busy) { //Nothing to play, the timer is started again by output_wake
+        timer_group_set_counter_enable_in_isr(TIMER_GROUP_0, TIMER_0, TIMER_PAUSE);
+        timer_running = false;
+        idle_waiter = output_idle_waiter;
+
+#ifdef POWER_MANAGEMENT
+        power_release(POWER_OUTPUT);
+#endif
+    }
+    portEXIT_CRITICAL_ISR(&timer_lock);
+
+    output_notify_tone(&higher_priority_task_woken);
+
+    if(idle_waiter) {
+        vTaskNotifyGiveFromISR(idle_waiter, &higher_priority_task_woken);
+    }
+
+    return higher_priority_task_woken == pdTRUE;
+}
+
+
+
+
+bool IRAM_ATTR output_is_cancelled(uint8_t gen, uint8_t msg_id) {
+    return gen != output_generation || (msg_id && (cancelled_ids[msg_id / 32] & (1UL << (msg_id % 32))));
+}
+
+
+void IRAM_ATTR output_drop(const out_control_t *out_c, size_t len) {
+#ifdef MESSAGE_SPOOL
+    for(size_t i = 0; i < len; i++) {
+        if((out_c[i].flags & OUT_ITEM_END) && !(out_c[i].flags & OUT_ITEM_UNSPOOLED)) {
+            spool_letter_played(out_c[i].gen);
+        }
+    }
+#endif
+}
+
+
+/**
+ * @brief Wakes up the translator waiting for space in the out control queue (so it can drop the cancelled letter)
+ *
+ */
+static void output_notify_waiter() {
+    TaskHandle_t waiter = out_space_waiter;
+    if(waiter) {
+        xTaskNotifyGive(waiter);
+    }
+}
+
+
+void output_cancel_all() {
+    int64_t start = esp_timer_get_time();
+
+    portENTER_CRITICAL(&timer_lock); //The ISR cannot be in the middle of the tick
+    output_generation++;
+    for(size_t i = 0; i < sizeof(cancelled_ids) / sizeof(cancelled_ids[0]); i++) {
+        cancelled_ids[i] = 0;
+    }
+
+    for(int ch = 0; ch < OUTPUT_CHANNEL_NUM; ch++) {
+        output_channel_buzzer_set(ch, false);
+        output_channel_led_set(ch, false);
+        channels[ch].playing_id = 0;
+    }
+
+#ifdef RADIO_KEYING
+    radio_abort();
+#endif
+    portEXIT_CRITICAL(&timer_lock);
+
+    output_notify_tone(NULL);
+    output_notify_waiter();
+
+    int64_t latency = esp_timer_get_time() - start;
+    if(latency > abort_latency_max_us) {
+        abort_latency_max_us = latency;
+    }
+
+    //Deferred log records only 32-bit arguments (latencies are far below the limit)
+    DLOGI(OUTPUT_TAG, "Abort to silence %lu us (max %lu us)", (unsigned long)(uint32_t)latency,
+        (unsigned long)(uint32_t)abort_latency_max_us);
+}
+
+
+void output_cancel_message(uint8_t msg_id) {
+    if(!msg_id) {
+        return;
+    }
+
+    portENTER_CRITICAL(&timer_lock);
+    cancelled_ids[msg_id / 32] |= 1UL << (msg_id % 32);
+
+    for(int ch = 0; ch < OUTPUT_CHANNEL_NUM; ch++) {
+        if(channels[ch].playing_id == msg_id) { //The rest of the current symbol is dropped by the next tick
+            output_channel_buzzer_set(ch, false);
+            output_channel_led_set(ch, false);
+            channels[ch].playing_id = 0;
+
+#ifdef RADIO_KEYING
+            if(ch == 0) {
+                radio_abort();
+            }
+#endif
+        }
+    }
+    portEXIT_CRITICAL(&timer_lock);
+
+    output_notify_tone(NULL);
+    output_notify_waiter();
+
+    DLOGI(OUTPUT_TAG, "Message %u cancelled", msg_id);
+}
+
+
+void output_accept_message(uint8_t msg_id) {
+    if(!msg_id) {
+        return;
+    }
+
+    portENTER_CRITICAL(&timer_lock);
+    cancelled_ids[msg_id / 32] &= ~(1UL << (msg_id % 32));
+    portEXIT_CRITICAL(&timer_lock);
+}
+
+
+void output_wake() {
+    portENTER_CRITICAL(&timer_lock);
+    if(!timer_running) {
+        timer_running = true;
+
+#ifdef POWER_MANAGEMENT
+        power_acquire(POWER_OUTPUT); //Timer needs stable APB clock and it does not run in light sleep
+#endif
+
+        timer_start(TIMER_GROUP_0, TIMER_0);
+    }
+    portEXIT_CRITICAL(&timer_lock);
+}
+
+
+bool output_is_idle() {
+    return !timer_running;
+}
+
+
+void output_backlog_add(uint8_t ch, const out_control_t *out_c, size_t len) {
+    uint32_t ticks = 0;
+    for(size_t i = 0; i < len; i++) {
+        ticks += OUT_CONTROL_TICKS(out_c[i]);
+    }
+
+    portENTER_CRITICAL(&timer_lock);
+    channels[ch].backlog += ticks;
+    portEXIT_CRITICAL(&timer_lock);
+}
+
+
+void output_backlog_reset() {
+    portENTER_CRITICAL(&timer_lock);
+    for(int ch = 0; ch < OUTPUT_CHANNEL_NUM; ch++) {
+        channels[ch].backlog = 0;
+    }
+    portEXIT_CRITICAL(&timer_lock);
+}
+
+
+uint32_t output_backlog_ms() {
+    return channels[0].backlog * channels[0].unit_ms;
+}
+
+
+uint32_t output_unit_ms() {
+    return channels[0].unit_ms;
+}
+
+
+uint8_t output_get_wpm() {
+    return UNIT_TO_WPM(channels[0].unit_ms);
+}
+
+
+/**
+ * @brief Changes the length of the dot of the channel (it is applied from the next out control interval)
+ *
+ * @param ch Index of the channel
+ * @param new_unit_ms New length of the dot
+ */
+static void output_channel_set_unit(uint8_t ch, uint32_t new_unit_ms) {
+    portENTER_CRITICAL(&timer_lock);
+    channels[ch].unit_ms = new_unit_ms;
+    channels[ch].unit_ticks = UNIT_TICKS(new_unit_ms);
+    portEXIT_CRITICAL(&timer_lock);
+}
+
+
+esp_err_t output_set_channel_wpm(uint8_t ch, uint8_t wpm) {
+    if(ch >= OUTPUT_CHANNEL_NUM || !wpm) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&timer_lock);
+    channels[ch].base_unit_ms = 1200 / wpm;
+    portEXIT_CRITICAL(&timer_lock);
+
+    output_channel_set_unit(ch, 1200 / wpm);
+
+    DLOGI(OUTPUT_TAG, "Speed of channel %u set to %u WPM", ch, wpm);
+
+    return ESP_OK;
+}
+
+
+esp_err_t output_set_channel_pitch(uint8_t ch, uint16_t pitch) {
+    if(ch >= OUTPUT_CHANNEL_NUM || !pitch) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if(CHANNEL_HAS_TONE(ch)) {
+#ifdef TONE_OUTPUT
+        if(pitch >= TONE_SAMPLE_RATE / 2) {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        tone_set_pitch(pitch);
+#endif
+    }
+    else if(ledc_set_freq(LEDC_SPEED_MODE, channels[ch].ledc_timer, pitch) != ESP_OK) { //Duty (volume) is kept
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    channels[ch].freq = pitch;
+
+    DLOGI(OUTPUT_TAG, "Pitch of channel %u set to %u Hz", ch, pitch);
+
+    return ESP_OK;
+}
+
+
+#ifdef ADAPTIVE_SPEED
+/**
+ * @brief Changes the length of the dot of the primary channel and notifies the client about the new speed
+ *
+ * @param new_unit_ms New length of the dot
+ */
+static void output_set_unit(uint32_t new_unit_ms) {
+    uint8_t old_wpm = output_get_wpm();
+
+    output_channel_set_unit(0, new_unit_ms);
+
+    uint8_t wpm = output_get_wpm();
+    if(wpm != old_wpm) {
+        DLOGI(OUTPUT_TAG, "Speed changed to %u WPM", wpm);
+
+        ble_set_char_value(SPEED_CHAR, &wpm, 1);
+        ble_notify(SPEED_CHAR, &wpm, 1);
+    }
+}
+
+
+/**
+ * @brief Task that periodically measures the backlog and adapts the speed so the backlog can be played
+ * in ADAPTIVE_MAX_BACKLOG_MS (speed is changed smoothly, so it returns to the speed set by the client when the backlog
+ * is drained)
+ *
+ * @param arg
+ */
+static void speed_task(void *arg) {
+    const uint32_t min_unit_ms = 1200 / ADAPTIVE_MAX_WPM;
+
+    while(1) {
+        vTaskDelay(pdMS_TO_TICKS(ADAPTIVE_PERIOD_MS));
+
+        portENTER_CRITICAL(&timer_lock);
+        uint32_t backlog = channels[0].backlog;
+        uint32_t unit_ms = channels[0].unit_ms;
+        uint32_t base_unit_ms = channels[0].base_unit_ms;
+        portEXIT_CRITICAL(&timer_lock);
+
+        //The longest dot, with which the backlog is played in time (never slower than the speed set by the client)
+        uint32_t required_ms = backlog ? ADAPTIVE_MAX_BACKLOG_MS / backlog : base_unit_ms;
+        if(required_ms > base_unit_ms) {
+            required_ms = base_unit_ms;
+        }
+        else if(required_ms < min_unit_ms) { //Client speed above ADAPTIVE_MAX_WPM is kept
+            required_ms = base_unit_ms < min_unit_ms ? base_unit_ms : min_unit_ms;
+        }
+
+        uint32_t new_unit_ms = (3 * unit_ms + required_ms) / 4;
+        if(new_unit_ms == unit_ms && required_ms != unit_ms) { //Make at least the smallest step
+            new_unit_ms += required_ms > unit_ms ? 1 : -1;
+        }
+
+        if(new_unit_ms != unit_ms) {
+            output_set_unit(new_unit_ms);
+        }
+    }
+}
+#endif
+
+
+/**
+ * @brief Initialization of PWM (ledc) for buzzers of channels
+ *
+ * @return esp_err_t ESP_OK if everyhing went ok
+ */
+static esp_err_t ledc_init() {
+    esp_err_t err;
+
+    for(int ch = 0; ch < OUTPUT_CHANNEL_NUM; ch++) {
+        if(CHANNEL_HAS_TONE(ch)) {
+            continue;
+        }
+
+        ledc_timer_config_t ledc_timer = {
+            .duty_resolution = LEDC_TIMER_RESOLUTION,
+            .freq_hz = channels[ch].freq,
+            .speed_mode = LEDC_SPEED_MODE,
+            .timer_num = channels[ch].ledc_timer,
+            .clk_cfg = LEDC_AUTO_CLK,
+        };
+
+        err = ledc_timer_config(&ledc_timer);
+        if(err != ESP_OK) {
+            ESP_LOGE(OUTPUT_TAG, "ledc_timer_config failed!");
+            return err;
+        }
+
+        ledc_channel_config_t ledc_channel = {
+            .speed_mode = LEDC_SPEED_MODE,
+            .channel = channels[ch].ledc_channel,
+            .timer_sel = channels[ch].ledc_timer,
+            .intr_type = LEDC_INTR_DISABLE,
+            .gpio_num = channels[ch].buzzer_gpio,
+            .duty = 0,
+            .hpoint = 0,
+        };
+
+        err = ledc_channel_config(&ledc_channel);
+        if(err != ESP_OK) {
+            ESP_LOGE(OUTPUT_TAG, "ledc_channel_config failed!");
+            return err;
+        }
+
+        //Initial level of PWM
+        err = ledc_stop(LEDC_SPEED_MODE, channels[ch].ledc_channel, 0);
+        if(err) {
+            ESP_LOGE(OUTPUT_TAG, "ledc_stop failed!");
+            return err;
+        }
+    }
+
+    return ESP_OK;
+}
+
+
+esp_err_t output_init() {
+    esp_err_t err;
+
+#ifdef TONE_OUTPUT
+    err = tone_init();
+    if(err != ESP_OK) {
+        return err;
+    }
+#endif
+
+    err = ledc_init();
+    if(err != ESP_OK) {
+        return err;
+    }
+
+    for(uint8_t ch = 0; ch < OUTPUT_CHANNEL_NUM; ch++) {
+        esp_rom_gpio_pad_select_gpio(channels[ch].led_gpio);
+        err = gpio_set_direction(channels[ch].led_gpio, GPIO_MODE_OUTPUT);
+        if(err != ESP_OK) {
+            ESP_LOGE(OUTPUT_TAG, "gpio_set_direction failed!");
+            return err;
+        }
+
+        output_channel_led_set(ch, false);
+
+        esp_rom_gpio_pad_select_gpio(channels[ch].buzzer_led_gpio);
+        err = gpio_set_direction(channels[ch].buzzer_led_gpio, GPIO_MODE_OUTPUT);
+        if(err != ESP_OK) {
+            ESP_LOGE(OUTPUT_TAG, "gpio_set_direction failed!");
+            return err;
+        }
+
+        output_channel_buzzer_set(ch, false);
+    }
+
+    return ESP_OK;
+}
+
+
+/**
+ * @brief Registers ISR of the output timer (it is called by IPC on OUTPUT_CORE)
+ *
+ * @param arg Output argument with the result (esp_err_t)
+ */
+static void output_isr_register(void *arg) {
+    *(esp_err_t *)arg = timer_isr_callback_add(TIMER_GROUP_0, TIMER_0, out_control_routine, NULL,  0);
+}
+
+
+/**
+ * @brief Initilization of timer for beeping and blinking
+ *
+ * @return esp_err_t ESP_OK if everyhing went ok
+ */
+esp_err_t out_control_timer_init() {
+    esp_err_t err;
+
+    timer_config_t config = {
+        .divider = TIMER_DIVIDER,
+        .counter_dir = TIMER_COUNT_UP,
+        .counter_en = TIMER_PAUSE,
+        .alarm_en = TIMER_ALARM_EN,
+        .auto_reload = true,
+    };
+
+    err = timer_init(TIMER_GROUP_0, TIMER_0, &config);
+    if(err != ESP_OK) {
+        ESP_LOGE(OUTPUT_TAG, "timer_init failed!");
+        return err;
+    }
+
+    err = timer_set_counter_value(TIMER_GROUP_0, TIMER_0, 0);
+    if(err != ESP_OK) {
+        ESP_LOGE(OUTPUT_TAG, "timer_set_counter_value failed!");
+        return err;
+    }
+
+    //Interupts should come every OUTPUT_TICK_MS (channels count ticks to the end of their out control intervals)
+    err = timer_set_alarm_value(TIMER_GROUP_0, TIMER_0, (int)((OUTPUT_TICK_MS * 1e-3) * TIMER_SCALE)); //Time in secs * scale
+    if(err != ESP_OK) {
+        ESP_LOGE(OUTPUT_TAG, "timer_set_alarm_value failed!");
+        return err;
+    }
+
+    err = timer_enable_intr(TIMER_GROUP_0, TIMER_0);
+    if(err != ESP_OK) {
+        ESP_LOGE(OUTPUT_TAG, "timer_enable_intr failed!");
+        return err;
+    }
+
+    //Register ISR on the core of the output engine (interrupt is allocated on the core, that registers it)
+    esp_err_t isr_err = ESP_FAIL;
+    err = esp_ipc_call_blocking(OUTPUT_CORE, output_isr_register, &isr_err);
+    if(err != ESP_OK || isr_err != ESP_OK) {
+        ESP_LOGE(OUTPUT_TAG, "timer_isr_callback_add failed!");
+        return err != ESP_OK ? err : isr_err;
+    }
+
+    timer_running = true; //It is paused by the first interrupt if there is nothing to play
+
+#ifdef POWER_MANAGEMENT
+    power_acquire(POWER_OUTPUT);
+#endif
+    err = timer_start(TIMER_GROUP_0, TIMER_0);
+    if(err != ESP_OK) {
+        ESP_LOGE(OUTPUT_TAG, "timer_start failed!");
+        return err;
+    }
+
+#ifdef ADAPTIVE_SPEED
+    xTaskCreatePinnedToCore(speed_task, "speed", 2048, NULL, 3, NULL, 0);
+#endif
+
+    return ESP_OK;
+}
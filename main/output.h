@@ -0,0 +1,333 @@
+/**
+ * @file output.h
+ *
+ * @brief Output engine of morse code receiver (buzzer, LEDs and timer that plays out control queue)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __OUTPUT__
+#define __OUTPUT__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "driver/timer.h"
+
+#include "translator.h"
+#include "tone.h"
+
+
+#define OUTPUT_TAG "OUTPUT" //< Module name
+
+
+#define LEDC_TIMER_RESOLUTION LEDC_TIMER_13_BIT //< Timer resolution for buzzer PWM
+#define LEDC_SPEED_MODE LEDC_LOW_SPEED_MODE //< Speed mode for buzzer PWM
+#define BUZZER_CHANNEL LEDC_CHANNEL_0 //< Channel for buzzer PWM
+#define BUZZER_LEDC_TIMER LEDC_TIMER_0 //< Timer for buzzer PWM
+#define LEDC_TIMER_FREQ 5000 //< Timer frequency for buzzer PWM
+
+#define BUZZER_GPIO GPIO_NUM_12
+#define BUZZER_LED_GPIO GPIO_NUM_14
+#define LED_GPIO GPIO_NUM_27
+
+
+//Additional output channels (MULTI_CHANNEL in translator.h), every channel has its own LEDC timer (so its own pitch)
+#define CHANNEL_1_LEDC_CHANNEL LEDC_CHANNEL_1
+#define CHANNEL_1_LEDC_TIMER LEDC_TIMER_1
+#define CHANNEL_1_FREQ 4000
+#define CHANNEL_1_BUZZER_GPIO GPIO_NUM_18
+#define CHANNEL_1_BUZZER_LED_GPIO GPIO_NUM_19
+#define CHANNEL_1_LED_GPIO GPIO_NUM_21
+
+#define CHANNEL_2_LEDC_CHANNEL LEDC_CHANNEL_2
+#define CHANNEL_2_LEDC_TIMER LEDC_TIMER_2
+#define CHANNEL_2_FREQ 3000
+#define CHANNEL_2_BUZZER_GPIO GPIO_NUM_23
+#define CHANNEL_2_BUZZER_LED_GPIO GPIO_NUM_4
+#define CHANNEL_2_LED_GPIO GPIO_NUM_5
+
+
+//Timer settings
+#define TIMER_BASE_CLK 80000000
+#define TIMER_DIVIDER (16)
+#define TIMER_SCALE (TIMER_BASE_CLK / TIMER_DIVIDER)
+
+
+//Base time interval (dettermines the length of one out_control interval)
+#define BASE_TIME_INT_MS 200
+
+#define OUTPUT_TICK_MS 5 //< Period of the timer, that schedules all channels (length of the dot is rounded to it)
+
+#define OUTPUT_CORE 1 //< Core of the translator and the output timer ISR (BLE is pinned to the core 0 by sdkconfig.defaults)
+
+#define UNIT_TO_WPM(unit_ms) (1200 / (unit_ms)) //< Speed in words (PARIS) per minute for given length of the dot
+
+
+// #define ADAPTIVE_SPEED //< Speed of playback is raised when the out control queue contains too long backlog
+
+#define ADAPTIVE_MAX_BACKLOG_MS 20000 //< Target maximum duration of the backlog in the out control queue
+#define ADAPTIVE_MAX_WPM 30 //< The highest speed used for draining of the backlog (the lowest is the speed set for the channel)
+#define ADAPTIVE_PERIOD_MS 500 //< Period of the speed adaptation
+
+#define OUTPUT_DROP_BURST 64 //< Maximum number of cancelled out controls dropped in one timer tick (in one channel)
+
+
+/**
+ * @brief State of one output channel (it plays its own out control queue with its own speed)
+ *
+ */
+typedef struct output_channel {
+    ledc_channel_t ledc_channel; //< PWM channel of the buzzer
+    ledc_timer_t ledc_timer; //< PWM timer of the buzzer (it determines the pitch)
+    uint32_t freq; //< Frequency of the buzzer PWM (pitch of the channel)
+    gpio_num_t buzzer_gpio;
+    gpio_num_t buzzer_led_gpio;
+    gpio_num_t led_gpio;
+    uint32_t unit_ms; //< Length of the dot
+    uint32_t base_unit_ms; //< Length of the dot set by the client (adaptive speed returns to it)
+    uint32_t unit_ticks; //< Length of the dot in timer ticks
+    uint32_t countdown; //< Timer ticks remaining to the next out control interval
+    uint32_t backlog; //< Number of out control intervals needed to play the out control queue
+    uint8_t playing_id; //< Id of the message that drives outputs of the channel now
+} output_channel_t;
+
+
+/**
+ * @brief If it is true, outputs are driven by somebody else (e. g. local keyer) and the out control queue is not played
+ *
+ */
+extern volatile bool output_override;
+
+
+/**
+ * @brief Generation of the pipeline, it is incremented by abort (items and out controls of older generations are dropped)
+ *
+ */
+extern volatile uint8_t output_generation;
+
+
+/**
+ * @brief Task waiting for the end of playing, it is notified (by task notification) whenever the out control timer
+ * is paused, because there is nothing to play in any channel
+ *
+ */
+extern volatile TaskHandle_t output_idle_waiter;
+
+
+/**
+ * @brief Turns buzzer (and the LED next to it) of the primary channel on or off (only in task context, outside
+ * of critical sections)
+ *
+ * @param on true if buzzer should beep
+ */
+void output_buzzer_set(bool on);
+
+
+/**
+ * @brief Keys the primary channel (with RADIO_KEYING the edge of the buzzer and the transmitter is scheduled
+ * by the keying output, otherwise the buzzer is switched immediately), caller must call output_notify_tone
+ * after it leaves its critical section
+ *
+ * @param on true if the channel should beep
+ */
+void output_key_set(bool on);
+
+
+/**
+ * @brief Turns buzzer (and the LED next to it) of the channel on or off, caller must call output_notify_tone
+ * after it leaves its critical section
+ *
+ * @param ch Index of the channel
+ * @param on true if buzzer should beep
+ */
+void output_channel_buzzer_set(uint8_t ch, bool on);
+
+
+/**
+ * @brief Wakes up the sidetone if the buzzer of the primary channel was switched (with TONE_OUTPUT, the sidetone
+ * is fed by the task, that must not be notified in critical section)
+ *
+ * @param higher_priority_task_woken Set to pdTRUE if some task was woken (in ISR), NULL in task context
+ */
+void output_notify_tone(BaseType_t *higher_priority_task_woken);
+
+
+/**
+ * @brief Turns LED (for gaps between words) of the channel on or off
+ *
+ * @param ch Index of the channel
+ * @param on true if LED should shine
+ */
+void output_channel_led_set(uint8_t ch, bool on);
+
+
+/**
+ * @brief Turns LED (for gaps between words) of the primary channel on or off
+ *
+ * @param on true if LED should shine
+ */
+void output_led_set(bool on);
+
+
+/**
+ * @brief Sets the volume of buzzers of all channels
+ *
+ * @param volume Volume level (0-255)
+ */
+void output_set_volume(uint8_t volume);
+
+
+/**
+ * @brief Starts the out control timer if it was paused (it is paused when out control queue is empty),
+ * it must be called after out controls are sent to the queue
+ *
+ */
+void output_wake();
+
+
+/**
+ * @brief Cancels everything in the pipeline (letter queue, translated letter and out control queue) and turns outputs off
+ *
+ */
+void output_cancel_all();
+
+
+/**
+ * @brief Cancels the message with given id in every stage of the pipeline
+ *
+ * @param msg_id Id of the message
+ */
+void output_cancel_message(uint8_t msg_id);
+
+
+/**
+ * @brief Clears the cancellation of the id (when the new message with this id is accepted)
+ *
+ * @param msg_id Id of the message
+ */
+void output_accept_message(uint8_t msg_id);
+
+
+/**
+ * @brief Checks if the item with given generation and id was cancelled
+ *
+ * @param gen Generation of the item
+ * @param msg_id Id of the message (0 if message has no id)
+ * @return true if item is cancelled
+ */
+bool output_is_cancelled(uint8_t gen, uint8_t msg_id);
+
+
+/**
+ * @brief Counts letters in dropped out controls as played (for the spool)
+ *
+ * @param out_c Out controls
+ * @param len Number of out controls
+ */
+void output_drop(const out_control_t *out_c, size_t len);
+
+
+/**
+ * @brief Adds out controls to the backlog of the channel (duration of its out control queue), it must be called
+ * for every out control sent to the queue
+ *
+ * @param ch Index of the channel
+ * @param out_c Out controls
+ * @param len Number of out controls
+ */
+void output_backlog_add(uint8_t ch, const out_control_t *out_c, size_t len);
+
+
+/**
+ * @brief Clears backlogs of all channels (when out control queues are reset)
+ *
+ */
+void output_backlog_reset();
+
+
+/**
+ * @brief Returns the duration of the backlog of the primary channel (time needed to play its out control queue)
+ *
+ * @return uint32_t Duration in ms
+ */
+uint32_t output_backlog_ms();
+
+
+/**
+ * @brief Returns the current length of the dot of the primary channel
+ *
+ * @return uint32_t Length of the dot in ms
+ */
+uint32_t output_unit_ms();
+
+
+/**
+ * @brief Returns the current speed of playback of the primary channel
+ *
+ * @return uint8_t Speed in WPM
+ */
+uint8_t output_get_wpm();
+
+
+/**
+ * @brief Sets the speed of the channel
+ *
+ * @param ch Index of the channel
+ * @param wpm Speed in WPM (it is rounded due to OUTPUT_TICK_MS)
+ * @return esp_err_t ESP_OK if everything went OK, ESP_ERR_INVALID_ARG if channel does not exist or speed is 0
+ */
+esp_err_t output_set_channel_wpm(uint8_t ch, uint8_t wpm);
+
+
+/**
+ * @brief Sets the pitch of the channel (frequency of its buzzer PWM or the pitch of the sidetone)
+ *
+ * @param ch Index of the channel
+ * @param pitch Pitch in Hz
+ * @return esp_err_t ESP_OK if everything went OK, ESP_ERR_INVALID_ARG if channel does not exist or pitch is out of range
+ */
+esp_err_t output_set_channel_pitch(uint8_t ch, uint16_t pitch);
+
+
+/**
+ * @brief Checks if the out control timer is paused (there is nothing to play in any channel)
+ *
+ * @return true if nothing is played
+ */
+bool output_is_idle();
+
+
+/**
+ * @brief Sets the outputs of the channel due to given out control structure, also decrements counters in this structure
+ * and determines if there is something more to do
+ *
+ * @param ch Index of the channel
+ * @param control Control structure for controlling outputs
+ * @param should_be_returned output argument, sets it to true if there is something more to do in control structure
+ */
+void set_outputs(uint8_t ch, out_control_t *control, bool *should_be_returned);
+
+
+/**
+ * @brief Initialization of PWM (ledc) for buzzers (or I2S sidetone of the primary channel if TONE_OUTPUT is defined)
+ * and GPIOs of LEDs of all channels
+ *
+ * @return esp_err_t ESP_OK if everyhing went ok
+ */
+esp_err_t output_init();
+
+
+/**
+ * @brief Initilization of timer for beeping and blinking (one timer schedules all channels)
+ *
+ * @return esp_err_t ESP_OK if everyhing went ok
+ */
+esp_err_t out_control_timer_init();
+
+#endif
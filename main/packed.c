@@ -0,0 +1,94 @@
+/**
+ * @file packed.c
+ *
+ * @brief Tables of the compressed text of the letter command (GENERATED by gen_packed.py, do not edit it manually!)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "packed.h"
+#include <stddef.h>
+
+
+const uint8_t packed_count[PACKED_MAX_CODE_LEN + 1] = {
+    0, 0, 0, 1, 4, 8, 15, 12, 7, 3, 14,
+};
+
+
+const uint16_t packed_first[PACKED_MAX_CODE_LEN + 1] = {
+    0, 0, 0, 0, 2, 12, 40, 110, 244, 502, 1010,
+};
+
+
+const uint8_t packed_offset[PACKED_MAX_CODE_LEN + 1] = {
+    0, 0, 0, 0, 1, 5, 13, 28, 40, 47, 50,
+};
+
+
+const char *const packed_symbols[PACKED_SYMBOL_NUM] = {
+    " ", //< 000
+    "e", //< 0010
+    "t", //< 0011
+    "a", //< 0100
+    "n", //< 0101
+    "o", //< 01100
+    "i", //< 01101
+    "s", //< 01110
+    "r", //< 01111
+    "l", //< 10000
+    "c", //< 10001
+    "b", //< 10010
+    "k", //< 10011
+    "h", //< 101000
+    "d", //< 101001
+    "u", //< 101010
+    "m", //< 101011
+    "w", //< 101100
+    "f", //< 101101
+    "g", //< 101110
+    "y", //< 101111
+    "x", //< 110000
+    "q", //< 110001
+    "1", //< 110010
+    ".", //< 110011
+    "the ", //< 110100
+    "is ", //< 110101
+    NULL, //< 110110
+    "p", //< 1101110
+    "v", //< 1101111
+    "z", //< 1110000
+    "0", //< 1110001
+    "2", //< 1110010
+    "3", //< 1110011
+    "5", //< 1110100
+    "7", //< 1110101
+    "9", //< 1110110
+    ",", //< 1110111
+    "de ", //< 1111000
+    "on ", //< 1111001
+    "j", //< 11110100
+    "?", //< 11110101
+    ":", //< 11110110
+    "<", //< 11110111
+    ">", //< 11111000
+    "and ", //< 11111001
+    "test ", //< 11111010
+    "4", //< 111110110
+    "6", //< 111110111
+    "8", //< 111111000
+    "/", //< 1111110010
+    "=", //< 1111110011
+    "+", //< 1111110100
+    "-", //< 1111110101
+    "'", //< 1111110110
+    "(", //< 1111110111
+    ")", //< 1111111000
+    "\"", //< 1111111001
+    ";", //< 1111111010
+    "@", //< 1111111011
+    "!", //< 1111111100
+    "&", //< 1111111101
+    "_", //< 1111111110
+    "$", //< 1111111111
+};
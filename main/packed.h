@@ -0,0 +1,28 @@
+/**
+ * @file packed.h
+ *
+ * @brief Tables of the compressed text of the letter command (GENERATED by gen_packed.py, do not edit it manually!)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __PACKED__
+#define __PACKED__
+
+#include <stdint.h>
+
+
+#define PACKED_SYMBOL_NUM 64 //< Number of symbols (characters, words of the dictionary and the escape)
+#define PACKED_MAX_CODE_LEN 10 //< Maximum length of the code in bits
+#define PACKED_MAX_SYMBOL_LEN 5 //< Maximum number of characters of one symbol
+#define PACKED_ESCAPE 27 //< Index of the escape in sorted symbols (it is followed by one raw byte)
+#define PACKED_RAW_BITS 8 //< Length of the escaped byte
+
+
+extern const uint8_t packed_count[PACKED_MAX_CODE_LEN + 1]; //< Number of codes of every length
+extern const uint16_t packed_first[PACKED_MAX_CODE_LEN + 1]; //< The first code of every length
+extern const uint8_t packed_offset[PACKED_MAX_CODE_LEN + 1]; //< Index of the first symbol of every length in packed_symbols
+extern const char *const packed_symbols[PACKED_SYMBOL_NUM]; //< Symbols sorted by codes (NULL is the escape)
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * @file power.c
+ *
+ * @brief Power management (dynamic frequency scaling and automatic light sleep while the pipeline is idle)
+ *
+ * Every holder (stage of the pipeline) only marks, that it is busy, both locks are acquired when the first holder
+ * becomes busy and released when the last one is done, so the cost of the lock is paid once per busy period.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "power.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+
+
+static esp_pm_lock_handle_t cpu_lock = NULL; //< Maximal CPU (and APB) frequency, so timers and LEDC are accurate
+static esp_pm_lock_handle_t sleep_lock = NULL; //< Timers of the output and the keyer stop in light sleep
+
+static portMUX_TYPE power_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t busy_holders = 0; //< Bit for every busy holder
+
+static int64_t busy_since_us = 0;
+static int64_t busy_total_us = 0; //< Time, when locks were held by the pipeline
+static uint32_t busy_periods = 0;
+
+
+void IRAM_ATTR power_acquire(enum power_holders holder) {
+    portENTER_CRITICAL_SAFE(&power_spinlock);
+    if(!busy_holders && cpu_lock) {
+        esp_pm_lock_acquire(cpu_lock);
+        esp_pm_lock_acquire(sleep_lock);
+
+        busy_since_us = esp_timer_get_time();
+        busy_periods++;
+    }
+
+    busy_holders |= 1UL << holder;
+    portEXIT_CRITICAL_SAFE(&power_spinlock);
+}
+
+
+void IRAM_ATTR power_release(enum power_holders holder) {
+    portENTER_CRITICAL_SAFE(&power_spinlock);
+    if(busy_holders == (1UL << holder) && cpu_lock) {
+        esp_pm_lock_release(sleep_lock);
+        esp_pm_lock_release(cpu_lock);
+
+        busy_total_us += esp_timer_get_time() - busy_since_us;
+    }
+
+    busy_holders &= ~(1UL << holder);
+    portEXIT_CRITICAL_SAFE(&power_spinlock);
+}
+
+
+void power_log() {
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&power_spinlock);
+    int64_t busy_us = busy_total_us + (busy_holders ? now - busy_since_us : 0);
+    uint32_t periods = busy_periods;
+    portEXIT_CRITICAL(&power_spinlock);
+
+    ESP_LOGI(POWER_TAG, "Pipeline was busy %lld ms of %lld ms (%lld %%) in %lu periods",
+        busy_us / 1000, now / 1000, now ? busy_us * 100 / now : 0, (unsigned long)periods);
+
+    esp_pm_dump_locks(stdout); //Time spent in every power mode and statistics of all locks (with CONFIG_PM_PROFILING)
+}
+
+
+esp_err_t power_init() {
+    esp_err_t err;
+
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = POWER_MIN_FREQ_MHZ,
+        .light_sleep_enable = true,
+    };
+
+    err = esp_pm_configure(&pm_config);
+    if(err != ESP_OK) {
+        ESP_LOGE(POWER_TAG, "esp_pm_configure failed!");
+        return err;
+    }
+
+    err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "pipeline_cpu", &cpu_lock);
+    if(err != ESP_OK) {
+        ESP_LOGE(POWER_TAG, "esp_pm_lock_create failed!");
+        return err;
+    }
+
+    err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "pipeline_sleep", &sleep_lock);
+    if(err != ESP_OK) {
+        ESP_LOGE(POWER_TAG, "esp_pm_lock_create failed!");
+        return err;
+    }
+
+    err = esp_sleep_enable_gpio_wakeup(); //Pins of the key are configured by the keyer
+    if(err != ESP_OK) {
+        ESP_LOGE(POWER_TAG, "esp_sleep_enable_gpio_wakeup failed!");
+        return err;
+    }
+
+    ESP_LOGI(POWER_TAG, "DFS %d-%d MHz and automatic light sleep enabled", POWER_MIN_FREQ_MHZ, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+
+    return ESP_OK;
+}
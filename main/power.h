@@ -0,0 +1,81 @@
+/**
+ * @file power.h
+ *
+ * @brief Power management (dynamic frequency scaling and automatic light sleep while the pipeline is idle)
+ *
+ * The pipeline holds locks of the maximal CPU frequency and of the light sleep only while the translator works,
+ * the output timer runs or the local key is used, otherwise the frequency is lowered and the chip enters light sleep
+ * in idle (BLE controller uses modem sleep).
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __POWER__
+#define __POWER__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+
+
+#define POWER_TAG "POWER" //< Module name
+
+#ifdef CONFIG_PM_ENABLE
+#define POWER_MANAGEMENT //< Enabled by sdkconfig.pm (it needs power management and tickless idle)
+#endif
+
+#define POWER_MIN_FREQ_MHZ 40 //< CPU frequency while the pipeline is idle (XTAL frequency)
+
+
+/**
+ * @brief Holders of pipeline locks
+ *
+ */
+enum power_holders {
+    POWER_TRANSLATOR, //< Translator processes letters
+    POWER_OUTPUT, //< Output timer runs
+    POWER_KEYER, //< Local key drives outputs
+    POWER_BEEP, //< Buzzer beeps until the next command
+    POWER_RADIO, //< Edges of the keying output are scheduled or PTT is asserted
+    POWER_HOLDER_NUM,
+};
+
+
+/**
+ * @brief Acquires locks for the holder (if it does not hold them already), it can be called also from ISR
+ *
+ * @param holder Holder of locks
+ */
+void power_acquire(enum power_holders holder);
+
+
+/**
+ * @brief Releases locks of the holder (if it holds them), it can be called also from ISR
+ *
+ * @param holder Holder of locks
+ */
+void power_release(enum power_holders holder);
+
+
+/**
+ * @brief Logs the time, when the pipeline held locks, and time spent in every power mode
+ *
+ */
+void power_log();
+
+
+/**
+ * @brief Configures DFS and automatic light sleep, creates locks of the pipeline and enables GPIO wakeup (for the key)
+ *
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t power_init();
+
+#endif
@@ -0,0 +1,376 @@
+/**
+ * @file radio.c
+ *
+ * @brief Keying output of the transmitter (key and PTT lines driven through optocouplers or relays)
+ *
+ * Requested edges are converted to events of lines (sidetone, key and PTT) with absolute times of the free running
+ * timer. Events are kept sorted by time and the timer alarm is always armed to the first of them. Weighting moves
+ * the end of the element later (heavier) or its start later (lighter), so no edge has to be scheduled before
+ * the request, and edges of one line are never reordered.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "radio.h"
+#include "output.h"
+#include "power.h"
+#include "esp_ipc.h"
+
+
+#define RADIO_TIMER_SCALE (TIMER_BASE_CLK / RADIO_TIMER_DIVIDER / 1000000) //< Timer ticks per microsecond
+
+
+/**
+ * @brief Lines driven by the keying output
+ *
+ */
+enum radio_lines {
+    RADIO_SIDETONE, //< Buzzer (or sidetone) of the primary channel
+    RADIO_KEY,
+    RADIO_PTT,
+    RADIO_LINE_NUM,
+};
+
+
+/**
+ * @brief Scheduled edge of one line
+ *
+ */
+typedef struct radio_event {
+    uint64_t time; //< Time of the edge in microseconds (value of the counter of the radio timer)
+    uint8_t line;
+    bool on;
+} radio_event_t;
+
+
+static portMUX_TYPE radio_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static radio_event_t events[RADIO_EVENT_NUM]; //< Scheduled edges sorted by time
+static size_t event_num = 0;
+static uint64_t line_last[RADIO_LINE_NUM]; //< Time of the last scheduled edge of every line
+
+static bool key_requested = false; //< The last state requested by the output engine (or the keyer)
+static bool ptt_on = false;
+static uint32_t late_max_us = 0; //< The latest edge since PTT was asserted
+
+
+/**
+ * @brief Returns the current time of the radio timer
+ *
+ * @return uint64_t Time in microseconds
+ */
+static inline uint64_t radio_now() {
+    return timer_group_get_counter_value_in_isr(RADIO_TIMER_GROUP, RADIO_TIMER) / RADIO_TIMER_SCALE;
+}
+
+
+/**
+ * @brief Switches the line
+ *
+ * @param line Line
+ * @param on New state of the line
+ */
+static void IRAM_ATTR radio_apply(uint8_t line, bool on) {
+    switch(line)
+    {
+    case RADIO_SIDETONE:
+        output_channel_buzzer_set(0, on);
+        break;
+
+    case RADIO_KEY:
+        gpio_set_level(RADIO_KEY_GPIO, on ? RADIO_ACTIVE_LEVEL : !RADIO_ACTIVE_LEVEL);
+        break;
+
+    case RADIO_PTT:
+        gpio_set_level(RADIO_PTT_GPIO, on ? RADIO_ACTIVE_LEVEL : !RADIO_ACTIVE_LEVEL);
+        ptt_on = on;
+
+        if(on) {
+            late_max_us = 0;
+        }
+        else {
+            DLOGI(RADIO_TAG, "PTT released (edges were late by %lu us at most)", (unsigned long)late_max_us);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+/**
+ * @brief Removes the first scheduled edge
+ *
+ */
+static void IRAM_ATTR radio_pop() {
+    event_num--;
+    for(size_t i = 0; i < event_num; i++) {
+        events[i] = events[i + 1];
+    }
+}
+
+
+/**
+ * @brief Switches lines, whose edges are due, and arms the timer to the next edge (it must be called in the critical
+ * section)
+ *
+ */
+static void IRAM_ATTR radio_run() {
+    while(event_num) {
+        uint64_t now = radio_now();
+
+        if(events[0].time > now) {
+            timer_group_set_alarm_value_in_isr(RADIO_TIMER_GROUP, RADIO_TIMER, events[0].time * RADIO_TIMER_SCALE);
+            timer_group_enable_alarm_in_isr(RADIO_TIMER_GROUP, RADIO_TIMER);
+
+            if(radio_now() < events[0].time) { //Alarm was armed in time (otherwise the edge is switched now)
+                break;
+            }
+        }
+
+        radio_event_t event = events[0];
+        radio_pop();
+
+        uint32_t late = now > event.time ? (uint32_t)(now - event.time) : 0;
+        if(late > late_max_us) {
+            late_max_us = late;
+        }
+
+        radio_apply(event.line, event.on);
+    }
+
+#ifdef POWER_MANAGEMENT
+    if(!event_num && !ptt_on) { //Key is up and nothing is scheduled
+        power_release(POWER_RADIO);
+    }
+#endif
+}
+
+
+/**
+ * @brief Schedules the edge of the line (the edge is never scheduled before the previous edge of the same line)
+ *
+ * @param line Line
+ * @param on New state of the line
+ * @param time Time of the edge in microseconds
+ */
+static void IRAM_ATTR radio_schedule(uint8_t line, bool on, uint64_t time) {
+    if(time < line_last[line]) {
+        time = line_last[line];
+    }
+
+    line_last[line] = time;
+
+    if(event_num == RADIO_EVENT_NUM) { //Edges come faster than they are switched, so the first one is switched now
+        radio_event_t first = events[0];
+        radio_pop();
+        radio_apply(first.line, first.on);
+    }
+
+    size_t i = event_num++;
+    for(; i > 0 && events[i - 1].time > time; i--) { //Events with the same time keep the order of scheduling
+        events[i] = events[i - 1];
+    }
+
+    events[i] = (radio_event_t){ .time = time, .line = line, .on = on };
+}
+
+
+/**
+ * @brief Removes scheduled edges of the line
+ *
+ * @param line Line
+ */
+static void IRAM_ATTR radio_drop(uint8_t line) {
+    size_t kept = 0;
+    for(size_t i = 0; i < event_num; i++) {
+        if(events[i].line != line) {
+            events[kept++] = events[i];
+        }
+    }
+
+    event_num = kept;
+    line_last[line] = 0;
+}
+
+
+void IRAM_ATTR radio_key(bool on, uint32_t unit_us, uint32_t late_us) {
+    portENTER_CRITICAL_SAFE(&radio_lock);
+    if(on == key_requested) {
+        portEXIT_CRITICAL_SAFE(&radio_lock);
+        return;
+    }
+
+    key_requested = on;
+
+#ifdef POWER_MANAGEMENT
+    power_acquire(POWER_RADIO); //Timer needs stable APB clock
+#endif
+
+    uint64_t now = radio_now();
+    uint64_t edge = (now > late_us ? now - late_us : 0) + RADIO_DELAY_US; //Edge of the sidetone
+    int32_t weight_us = (int32_t)unit_us * (RADIO_WEIGHT_PERCENT - 50) / 50;
+
+    if(on) {
+        edge += weight_us < 0 ? -weight_us : 0; //Lighter weighting starts the element later
+
+        uint64_t key_edge = edge - RADIO_MAKE_LATENCY_US;
+
+        radio_drop(RADIO_PTT); //Release of PTT after the previous element is cancelled
+        if(!ptt_on) {
+            radio_apply(RADIO_PTT, true);
+
+            if(key_edge < now + RADIO_PTT_LEAD_MS * 1000) { //Late request must not shorten the lead time
+                key_edge = now + RADIO_PTT_LEAD_MS * 1000;
+            }
+        }
+
+        radio_schedule(RADIO_KEY, true, key_edge);
+        radio_schedule(RADIO_SIDETONE, true, edge);
+    }
+    else {
+        edge += weight_us > 0 ? weight_us : 0; //Heavier weighting ends the element later
+
+        radio_schedule(RADIO_KEY, false, edge - RADIO_BREAK_LATENCY_US);
+        radio_schedule(RADIO_SIDETONE, false, edge);
+        radio_schedule(RADIO_PTT, false, edge + RADIO_PTT_TAIL_MS * 1000);
+    }
+
+    radio_run();
+    portEXIT_CRITICAL_SAFE(&radio_lock);
+}
+
+
+void radio_abort() {
+    portENTER_CRITICAL_SAFE(&radio_lock);
+    event_num = 0;
+    for(int i = 0; i < RADIO_LINE_NUM; i++) {
+        line_last[i] = 0;
+    }
+
+    key_requested = false;
+    radio_apply(RADIO_KEY, false);
+
+    if(ptt_on) { //PTT is held until the relay of the key opens
+        radio_schedule(RADIO_PTT, false, radio_now() + RADIO_BREAK_LATENCY_US);
+    }
+
+    radio_run();
+    portEXIT_CRITICAL_SAFE(&radio_lock);
+}
+
+
+/**
+ * @brief ISR of the radio timer (the alarm comes at the time of the first scheduled edge)
+ *
+ * @param args
+ * @return true if higher priority task was woken
+ */
+static bool IRAM_ATTR radio_timer_routine(void *args) {
+    BaseType_t higher_priority_task_woken = pdFALSE;
+
+    portENTER_CRITICAL_ISR(&radio_lock);
+    radio_run();
+    portEXIT_CRITICAL_ISR(&radio_lock);
+
+    output_notify_tone(&higher_priority_task_woken); //Edge of the sidetone could be applied
+
+    return higher_priority_task_woken == pdTRUE;
+}
+
+
+/**
+ * @brief Registers ISR of the radio timer (it is called by IPC on OUTPUT_CORE, so edges are switched on the same
+ * core as the output engine)
+ *
+ * @param arg Output argument with the result (esp_err_t)
+ */
+static void radio_isr_register(void *arg) {
+    *(esp_err_t *)arg = timer_isr_callback_add(RADIO_TIMER_GROUP, RADIO_TIMER, radio_timer_routine, NULL, 0);
+}
+
+
+/**
+ * @brief Initialization of the free running timer of the keying output
+ *
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+static esp_err_t radio_timer_init() {
+    esp_err_t err;
+
+    timer_config_t config = {
+        .divider = RADIO_TIMER_DIVIDER,
+        .counter_dir = TIMER_COUNT_UP,
+        .counter_en = TIMER_PAUSE,
+        .alarm_en = TIMER_ALARM_DIS, //< Alarm is enabled, when some edge is scheduled
+        .auto_reload = false, //< Counter is never reset, so edges have absolute times
+    };
+
+    err = timer_init(RADIO_TIMER_GROUP, RADIO_TIMER, &config);
+    if(err != ESP_OK) {
+        ESP_LOGE(RADIO_TAG, "timer_init failed!");
+        return err;
+    }
+
+    err = timer_set_counter_value(RADIO_TIMER_GROUP, RADIO_TIMER, 0);
+    if(err != ESP_OK) {
+        ESP_LOGE(RADIO_TAG, "timer_set_counter_value failed!");
+        return err;
+    }
+
+    err = timer_enable_intr(RADIO_TIMER_GROUP, RADIO_TIMER);
+    if(err != ESP_OK) {
+        ESP_LOGE(RADIO_TAG, "timer_enable_intr failed!");
+        return err;
+    }
+
+    esp_err_t isr_err = ESP_FAIL;
+    err = esp_ipc_call_blocking(OUTPUT_CORE, radio_isr_register, &isr_err);
+    if(err != ESP_OK || isr_err != ESP_OK) {
+        ESP_LOGE(RADIO_TAG, "timer_isr_callback_add failed!");
+        return err != ESP_OK ? err : isr_err;
+    }
+
+    err = timer_start(RADIO_TIMER_GROUP, RADIO_TIMER);
+    if(err != ESP_OK) {
+        ESP_LOGE(RADIO_TAG, "timer_start failed!");
+        return err;
+    }
+
+    return ESP_OK;
+}
+
+
+esp_err_t radio_init() {
+    esp_err_t err;
+
+    gpio_config_t line_config = {
+        .pin_bit_mask = (1ULL << RADIO_KEY_GPIO) | (1ULL << RADIO_PTT_GPIO),
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+
+    //Lines are released before they become outputs
+    gpio_set_level(RADIO_KEY_GPIO, !RADIO_ACTIVE_LEVEL);
+    gpio_set_level(RADIO_PTT_GPIO, !RADIO_ACTIVE_LEVEL);
+
+    err = gpio_config(&line_config);
+    if(err != ESP_OK) {
+        ESP_LOGE(RADIO_TAG, "gpio_config failed!");
+        return err;
+    }
+
+    err = radio_timer_init();
+    if(err != ESP_OK) {
+        return err;
+    }
+
+    ESP_LOGI(RADIO_TAG, "Keying output initialized (delay %d us, PTT lead %d ms, tail %d ms, weight %d %%)",
+        RADIO_DELAY_US, RADIO_PTT_LEAD_MS, RADIO_PTT_TAIL_MS, RADIO_WEIGHT_PERCENT);
+
+    return ESP_OK;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file radio.h
+ *
+ * @brief Keying output of the transmitter (key and PTT lines driven through optocouplers or relays)
+ *
+ * Edges of the primary channel are not switched immediately, they are scheduled by the one-shot timer with
+ * microsecond resolution RADIO_DELAY_US after the tick of the output engine. The delay makes room for the lead time
+ * of PTT and for the latency of relays, so the sidetone (buzzer of the primary channel) and the key line are switched
+ * from the same timeline and the sidetone follows the weighted keying of the transmitter.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __RADIO__
+#define __RADIO__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "driver/gpio.h"
+#include "driver/timer.h"
+
+#include "dlog.h"
+
+
+#define RADIO_TAG "RADIO" //< Module name
+
+// #define RADIO_KEYING //< Primary channel (messages and the local key) keys the transmitter
+
+#define RADIO_KEY_GPIO GPIO_NUM_16 //< Key line of the transmitter
+#define RADIO_PTT_GPIO GPIO_NUM_17 //< PTT line of the transmitter
+#define RADIO_ACTIVE_LEVEL 1 //< Level, that closes the optocoupler (or relay)
+
+#define RADIO_PTT_LEAD_MS 20 //< PTT is asserted at least this time before the first key down
+#define RADIO_PTT_TAIL_MS 300 //< PTT is released this time after the last key up (0 for full break-in)
+
+#define RADIO_WEIGHT_PERCENT 50 //< Key down part of the dot period (50 is the standard 1:1 dot to space and 1:3 dot to dash ratio)
+
+#define RADIO_MAKE_LATENCY_US 0 //< Time needed by the relay to close (key line is switched sooner by this time)
+#define RADIO_BREAK_LATENCY_US 0 //< Time needed by the relay to open (key line is switched sooner by this time)
+
+//Delay of all edges of the primary channel after the tick of the output engine
+#define RADIO_DELAY_US (RADIO_PTT_LEAD_MS * 1000 + RADIO_MAKE_LATENCY_US > RADIO_BREAK_LATENCY_US ? \
+    RADIO_PTT_LEAD_MS * 1000 + RADIO_MAKE_LATENCY_US : RADIO_BREAK_LATENCY_US)
+
+#define RADIO_EVENT_NUM 16 //< Maximum number of scheduled edges
+
+//Hardware timer of the keying output (timers of the group 0 are used by the output engine and the keyer)
+#define RADIO_TIMER_GROUP TIMER_GROUP_1
+#define RADIO_TIMER TIMER_0
+#define RADIO_TIMER_DIVIDER 80 //< Timer counts microseconds
+
+#if RADIO_WEIGHT_PERCENT < 25 || RADIO_WEIGHT_PERCENT > 75
+#error "RADIO_WEIGHT_PERCENT must be between 25 and 75 (elements or gaps would disappear)"
+#endif
+
+
+/**
+ * @brief Requests the new state of the key, edges of the sidetone, key and PTT lines are scheduled RADIO_DELAY_US
+ * after the nominal time of the request (it can be called also from ISR)
+ *
+ * @param on true if the transmitter should be keyed
+ * @param unit_us Length of the dot (for weighting)
+ * @param late_us Time elapsed since the nominal time of the edge (latency of the caller)
+ */
+void radio_key(bool on, uint32_t unit_us, uint32_t late_us);
+
+
+/**
+ * @brief Drops all scheduled edges, releases the key immediately and PTT after the relay opens
+ *
+ */
+void radio_abort();
+
+
+/**
+ * @brief Initializes GPIOs of key and PTT lines and the timer of the keying output
+ *
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t radio_init();
+
+#endif
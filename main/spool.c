@@ -0,0 +1,381 @@
+/**
+ * @file spool.c
+ *
+ * @brief Persistent spool of accepted letters in NVS, so the playback continues after reset
+ *
+ * Letters are written to the chunk in RAM and the chunk is written to NVS when it is full. Counters are written when
+ * they cross the boundary of the chunk (so the full chunk is reachable and played chunks can be erased), the partial
+ * chunk and counters inside of the chunk only at the checkpoint (every SPOOL_CHECKPOINT_MS and after abort), so
+ * the flash is not written for every letter nor every second of the playback. Chunks with played letters are erased. After reset, unplayed letters are passed to the letter queue by the spool task, letters
+ * accepted during the replay are passed to the queue by the replay too (to keep the order).
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "spool.h"
+#include "esp_timer.h"
+#include "output.h"
+#include "dlog.h"
+
+
+static nvs_handle_t spool_nvs;
+static SemaphoreHandle_t spool_mutex = NULL; //< Protects everything except counter of played letters
+static portMUX_TYPE done_lock = portMUX_INITIALIZER_UNLOCKED; //< Protects counter of played letters (it is updated from ISR)
+
+static volatile uint32_t head = 0; //< Sequence number of the next accepted letter
+static volatile uint32_t done = 0; //< Sequence number of the first unplayed letter
+static uint32_t stored_head = 0, stored_done = 0; //< Values of counters in NVS
+
+static char chunk[SPOOL_CHUNK_LEN]; //< Chunk with the letter at head
+static bool chunk_dirty = false; //< Chunk contains letters that are not in NVS
+
+static char replay_chunk[SPOOL_CHUNK_LEN]; //< Chunk read from NVS during replay
+static uint32_t replay_chunk_idx = UINT32_MAX;
+static uint32_t replay_seq = 0; //< Sequence number of the next replayed letter
+static bool replaying = false;
+
+static uint32_t erased_below = 0; //< Chunks with lower index were already erased
+
+static int64_t last_checkpoint = 0; //< Time of the last checkpoint
+static bool checkpoint_requested = false; //< Everything is written by the next flush (e. g. after abort)
+
+static TaskHandle_t spool_handle = NULL;
+
+
+/**
+ * @brief Creates NVS key for the chunk
+ *
+ * @param key Output buffer (at least NVS_KEY_NAME_MAX_SIZE)
+ * @param idx Index of the chunk
+ */
+static void spool_chunk_key(char *key, uint32_t idx) {
+    snprintf(key, NVS_KEY_NAME_MAX_SIZE, "c%lx", (unsigned long)idx);
+}
+
+
+/**
+ * @brief Writes letters of the chunk at head to NVS (mutex must be taken)
+ *
+ * @param idx Index of the chunk
+ * @param len Number of letters in the chunk
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+static esp_err_t spool_write_chunk(uint32_t idx, size_t len) {
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    spool_chunk_key(key, idx);
+
+    esp_err_t err = nvs_set_blob(spool_nvs, key, chunk, len);
+    if(err != ESP_OK) {
+        DLOGE(SPOOL_TAG, "nvs_set_blob failed! (0x%x)", err);
+        return err;
+    }
+
+    chunk_dirty = false;
+
+    return ESP_OK;
+}
+
+
+/**
+ * @brief Writes counters that crossed the boundary of the chunk to NVS and erases chunks with played letters,
+ * at the checkpoint it writes also the partial chunk and counters inside of the chunk
+ *
+ */
+static void spool_flush() {
+    esp_err_t err;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+
+    xSemaphoreTake(spool_mutex, portMAX_DELAY);
+
+    portENTER_CRITICAL(&done_lock);
+    uint32_t cur_done = done;
+    portEXIT_CRITICAL(&done_lock);
+
+    int64_t now = esp_timer_get_time();
+    bool checkpoint = checkpoint_requested || now - last_checkpoint >= SPOOL_CHECKPOINT_MS * 1000LL;
+
+    bool store_chunk = checkpoint && chunk_dirty;
+    bool store_head = head != stored_head && (checkpoint || head / SPOOL_CHUNK_LEN != stored_head / SPOOL_CHUNK_LEN);
+    bool store_done = cur_done != stored_done &&
+        (checkpoint || cur_done / SPOOL_CHUNK_LEN != stored_done / SPOOL_CHUNK_LEN);
+
+    if(checkpoint) {
+        checkpoint_requested = false;
+        last_checkpoint = now;
+    }
+
+    if(store_chunk) {
+        spool_write_chunk(head / SPOOL_CHUNK_LEN, head % SPOOL_CHUNK_LEN);
+    }
+
+    if(store_head) {
+        err = nvs_set_u32(spool_nvs, SPOOL_HEAD_NVS_KEY, head);
+        if(err == ESP_OK) {
+            stored_head = head;
+        }
+    }
+
+    if(store_done) {
+        err = nvs_set_u32(spool_nvs, SPOOL_DONE_NVS_KEY, cur_done);
+        if(err == ESP_OK) {
+            stored_done = cur_done;
+        }
+
+        //All letters in chunks below the first unplayed letter were played
+        for(; erased_below < cur_done / SPOOL_CHUNK_LEN; erased_below++) {
+            spool_chunk_key(key, erased_below);
+            nvs_erase_key(spool_nvs, key);
+        }
+    }
+
+    if(store_chunk || store_head || store_done) {
+        err = nvs_commit(spool_nvs);
+        if(err != ESP_OK) {
+            DLOGE(SPOOL_TAG, "nvs_commit failed! (0x%x)", err);
+        }
+    }
+
+    xSemaphoreGive(spool_mutex);
+}
+
+
+bool spool_push(const char *letter) {
+    xSemaphoreTake(spool_mutex, portMAX_DELAY);
+
+    if(head - done >= SPOOL_MAX_LETTERS) {
+        xSemaphoreGive(spool_mutex);
+        DLOGE(SPOOL_TAG, "Spool is full!");
+        return false;
+    }
+
+    if(!replaying && !queue_letter(letter, (TickType_t)0)) {
+        xSemaphoreGive(spool_mutex);
+        return false;
+    }
+
+    chunk[head % SPOOL_CHUNK_LEN] = letter[0];
+    chunk_dirty = true;
+    head++;
+
+    if(head % SPOOL_CHUNK_LEN == 0) { //Chunk is full, so it must be written before it is reused
+        spool_write_chunk((head - 1) / SPOOL_CHUNK_LEN, SPOOL_CHUNK_LEN);
+    }
+
+    xSemaphoreGive(spool_mutex);
+
+    return true;
+}
+
+
+bool spool_push_message(const char *item, const char *letters, size_t len) {
+    xSemaphoreTake(spool_mutex, portMAX_DELAY);
+
+    //Replay passes letters to the queue one by one, so the item cannot be used
+    if(replaying || head - done + len > SPOOL_MAX_LETTERS) {
+        xSemaphoreGive(spool_mutex);
+        return false;
+    }
+
+    if(!queue_letter(item, (TickType_t)0)) {
+        xSemaphoreGive(spool_mutex);
+        return false;
+    }
+
+    for(size_t i = 0; i < len; i++) {
+        chunk[head % SPOOL_CHUNK_LEN] = letters[i];
+        chunk_dirty = true;
+        head++;
+
+        if(head % SPOOL_CHUNK_LEN == 0) {
+            spool_write_chunk((head - 1) / SPOOL_CHUNK_LEN, SPOOL_CHUNK_LEN);
+        }
+    }
+
+    xSemaphoreGive(spool_mutex);
+
+    return true;
+}
+
+
+void IRAM_ATTR spool_letter_played(uint8_t gen) {
+    portENTER_CRITICAL_SAFE(&done_lock);
+
+    //Letters of older generations were marked as played by abort (they can be still played or dropped after it)
+    if(gen == output_generation && done < head) {
+        done++;
+    }
+
+    portEXIT_CRITICAL_SAFE(&done_lock);
+}
+
+
+void spool_abort() {
+    xSemaphoreTake(spool_mutex, portMAX_DELAY);
+
+    replay_seq = head;
+
+    portENTER_CRITICAL(&done_lock);
+    done = head;
+    portEXIT_CRITICAL(&done_lock);
+
+    checkpoint_requested = true; //Aborted letters must not be replayed after reset
+
+    xSemaphoreGive(spool_mutex);
+}
+
+
+/**
+ * @brief Reads the letter from the spool (mutex must be taken)
+ *
+ * @param seq Sequence number of the letter
+ * @param letter Output buffer for the letter (item of the letter queue)
+ * @return true if letter was read
+ */
+static bool spool_read(uint32_t seq, char *letter) {
+    uint32_t idx = seq / SPOOL_CHUNK_LEN;
+
+    memset(letter, 0, LETTER_ITEM_SIZE);
+
+    if(idx == head / SPOOL_CHUNK_LEN) { //Chunk at head is in RAM
+        letter[0] = chunk[seq % SPOOL_CHUNK_LEN];
+        return true;
+    }
+
+    if(idx != replay_chunk_idx) {
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        size_t len = sizeof(replay_chunk);
+
+        spool_chunk_key(key, idx);
+        if(nvs_get_blob(spool_nvs, key, replay_chunk, &len) != ESP_OK || len <= seq % SPOOL_CHUNK_LEN) {
+            return false;
+        }
+
+        replay_chunk_idx = idx;
+    }
+
+    letter[0] = replay_chunk[seq % SPOOL_CHUNK_LEN];
+
+    return true;
+}
+
+
+/**
+ * @brief Passes unplayed letters from the spool to the letter queue (the mutex is not held while waiting for the queue)
+ *
+ */
+static void spool_replay() {
+    char buffer[LETTER_ITEM_SIZE];
+    int64_t last_flush = esp_timer_get_time();
+
+    ESP_LOGI(SPOOL_TAG, "Replaying %lu letters", (unsigned long)(head - replay_seq));
+
+    while(1) {
+        xSemaphoreTake(spool_mutex, portMAX_DELAY);
+
+        if(replay_seq >= head) { //Replay caught up, new letters can go directly to the queue
+            replaying = false;
+            xSemaphoreGive(spool_mutex);
+            break;
+        }
+
+        if(!spool_read(replay_seq, buffer)) {
+            xSemaphoreGive(spool_mutex);
+
+            ESP_LOGE(SPOOL_TAG, "Unable to read letter %lu, the rest of the spool is dropped!", (unsigned long)replay_seq);
+            spool_abort();
+            continue;
+        }
+
+        bool sent = queue_letter(buffer, (TickType_t)0);
+        if(sent) {
+            replay_seq++;
+        }
+
+        xSemaphoreGive(spool_mutex);
+
+        if(!sent) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+
+        if(esp_timer_get_time() - last_flush > SPOOL_FLUSH_PERIOD_MS * 1000) { //Letters accepted during replay must be stored too
+            spool_flush();
+            last_flush = esp_timer_get_time();
+        }
+    }
+
+    ESP_LOGI(SPOOL_TAG, "Replay done");
+}
+
+
+/**
+ * @brief Task that replays the spool after reset and then periodically flushes it
+ *
+ * @param arg
+ */
+static void spool_task(void *arg) {
+    if(replaying) {
+        spool_replay();
+    }
+
+    while(1) {
+        spool_flush();
+
+        vTaskDelay(pdMS_TO_TICKS(SPOOL_FLUSH_PERIOD_MS));
+    }
+}
+
+
+esp_err_t spool_init() {
+    esp_err_t err;
+
+    err = nvs_open(SPOOL_NVS_NAMESPACE, NVS_READWRITE, &spool_nvs);
+    if(err != ESP_OK) {
+        ESP_LOGE(SPOOL_TAG, "nvs_open failed!");
+        return err;
+    }
+
+    spool_mutex = xSemaphoreCreateMutex();
+    if(!spool_mutex) {
+        ESP_LOGE(SPOOL_TAG, "Unable to create mutex for spool!");
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint32_t stored;
+    if(nvs_get_u32(spool_nvs, SPOOL_HEAD_NVS_KEY, &stored) == ESP_OK) {
+        head = stored_head = stored;
+    }
+
+    if(nvs_get_u32(spool_nvs, SPOOL_DONE_NVS_KEY, &stored) == ESP_OK) {
+        done = stored_done = stored;
+    }
+
+    if(done > head) {
+        done = head;
+    }
+
+    //Restore the chunk at head (it can contain letters from the last flush)
+    if(head % SPOOL_CHUNK_LEN) {
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        size_t len = sizeof(chunk);
+
+        spool_chunk_key(key, head / SPOOL_CHUNK_LEN);
+        if(nvs_get_blob(spool_nvs, key, chunk, &len) != ESP_OK || len < head % SPOOL_CHUNK_LEN) {
+            ESP_LOGE(SPOOL_TAG, "Unable to restore the last chunk, its letters are dropped!");
+
+            head -= head % SPOOL_CHUNK_LEN;
+            if(done > head) {
+                done = head;
+            }
+        }
+    }
+
+    erased_below = done / SPOOL_CHUNK_LEN;
+    last_checkpoint = esp_timer_get_time();
+    replay_seq = done;
+    replaying = done < head;
+
+    xTaskCreatePinnedToCore(spool_task, "spool", 3072, NULL, 4, &spool_handle, 0);
+
+    return ESP_OK;
+}
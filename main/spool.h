@@ -0,0 +1,87 @@
+/**
+ * @file spool.h
+ *
+ * @brief Persistent spool of accepted letters in NVS, so the playback continues after reset
+ *
+ * Every accepted letter gets a sequence number and it is stored to chunks (NVS blobs) in batches.
+ * The number of played letters is stored too, so after reset the letters from the first unplayed one are replayed.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __SPOOL__
+#define __SPOOL__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "translator.h"
+
+
+#define SPOOL_TAG "SPOOL" //< Module name
+
+#define MESSAGE_SPOOL //< Enables persistent spool of messages
+
+#define SPOOL_NVS_NAMESPACE "m_c_spool"
+#define SPOOL_HEAD_NVS_KEY "head" //< Sequence number of the next accepted letter
+#define SPOOL_DONE_NVS_KEY "done" //< Sequence number of the first unplayed letter
+
+#define SPOOL_CHUNK_LEN 256 //< Letters in one NVS blob
+#define SPOOL_MAX_LETTERS (2 * MAXIMUM_MESSAGE_NUM) //< Maximum number of unplayed letters in the spool
+#define SPOOL_FLUSH_PERIOD_MS 1000 //< Period of checking, if counters crossed the boundary of the chunk
+#define SPOOL_CHECKPOINT_MS 30000 //< Period of writing of the partial chunk and counters inside of the chunk to NVS
+
+
+/**
+ * @brief Stores the letter to the spool and passes it to the letter queue (or to the replay, if it is in progress)
+ *
+ * @param letter Buffer with the letter (item of the letter queue)
+ * @return true if letter was accepted
+ */
+bool spool_push(const char *letter);
+
+
+/**
+ * @brief Stores letters of the message to the spool and passes one item (e. g. cached message) to the letter queue
+ * instead of them
+ *
+ * @param item Item of the letter queue that plays the whole message (it must mark every letter as played)
+ * @param letters Letters of the message
+ * @param len Number of letters
+ * @return true if message was accepted, false if it was not (e. g. during replay), then letters can be pushed separately
+ */
+bool spool_push_message(const char *item, const char *letters, size_t len);
+
+
+/**
+ * @brief Marks the letter as played (it can be called from ISR)
+ *
+ * @param gen Generation of the played letter (letters cancelled by abort are ignored)
+ */
+void spool_letter_played(uint8_t gen);
+
+
+/**
+ * @brief Marks all letters in the spool as played (when message is aborted)
+ *
+ */
+void spool_abort();
+
+
+/**
+ * @brief Restores the state of the spool from NVS and starts the task that replays unplayed letters and flushes the spool
+ *
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t spool_init();
+
+#endif
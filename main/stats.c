@@ -0,0 +1,111 @@
+/**
+ * @file stats.c
+ *
+ * @brief Runtime statistics of tasks (CPU load per task, stack high-water marks and wakeups of the pipeline)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "stats.h"
+#include "esp_timer.h"
+
+
+#if defined(RUNTIME_STATS) && !(CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_USE_TRACE_FACILITY)
+#error "RUNTIME_STATS needs CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS and CONFIG_FREERTOS_USE_TRACE_FACILITY"
+#endif
+
+
+static volatile uint32_t counters[STATS_COUNTER_NUM];
+static uint32_t last_counters[STATS_COUNTER_NUM];
+static int64_t last_log_us = 0;
+
+static TaskStatus_t tasks[STATS_TASK_NUM];
+
+/**
+ * @brief Run time of tasks from the previous call of stats_log
+ *
+ */
+static struct {
+    UBaseType_t number; //< Number of the task (it is unique)
+    configRUN_TIME_COUNTER_TYPE run_time;
+} last_tasks[STATS_TASK_NUM];
+static UBaseType_t last_task_num = 0;
+static configRUN_TIME_COUNTER_TYPE last_total = 0;
+
+static const char *counter_names[STATS_COUNTER_NUM] = {
+    [STATS_TRANSLATOR_WAKEUPS] = "translator",
+    [STATS_OUTPUT_TICKS] = "output_tick",
+    [STATS_DLOG_WAKEUPS] = "dlog",
+};
+
+
+void IRAM_ATTR stats_count(enum stats_counters counter) {
+    counters[counter]++; //Counters are only read by stats_log, so the lost increment does not matter
+}
+
+
+/**
+ * @brief Returns run time of the task from the previous call of stats_log
+ *
+ * @param number Number of the task
+ * @return configRUN_TIME_COUNTER_TYPE Run time or 0 if the task did not exist
+ */
+static configRUN_TIME_COUNTER_TYPE stats_last_run_time(UBaseType_t number) {
+    for(UBaseType_t i = 0; i < last_task_num; i++) {
+        if(last_tasks[i].number == number) {
+            return last_tasks[i].run_time;
+        }
+    }
+
+    return 0;
+}
+
+
+void stats_log() {
+    configRUN_TIME_COUNTER_TYPE total;
+    int64_t now = esp_timer_get_time();
+
+    UBaseType_t task_num = uxTaskGetSystemState(tasks, STATS_TASK_NUM, &total);
+
+    if(!task_num) {
+        ESP_LOGE(STATS_TAG, "More than %d tasks!", STATS_TASK_NUM);
+        return;
+    }
+
+    uint32_t period_ms = (uint32_t)((now - last_log_us) / 1000);
+    configRUN_TIME_COUNTER_TYPE total_delta = total - last_total; //Time of one core
+
+    ESP_LOGI(STATS_TAG, "Statistics of the last %lu ms:", (unsigned long)period_ms);
+
+    for(UBaseType_t i = 0; i < task_num; i++) {
+        configRUN_TIME_COUNTER_TYPE delta = tasks[i].ulRunTimeCounter - stats_last_run_time(tasks[i].xTaskNumber);
+        BaseType_t core = xTaskGetCoreID(tasks[i].xHandle);
+
+        ESP_LOGI(STATS_TAG, "%-16s core %c prio %2u cpu %3lu.%lu %% stack free %5lu B",
+            tasks[i].pcTaskName,
+            core == tskNO_AFFINITY ? '*' : '0' + (char)core,
+            (unsigned)tasks[i].uxCurrentPriority,
+            total_delta ? (unsigned long)(delta * 100 / total_delta) : 0,
+            total_delta ? (unsigned long)(delta * 1000 / total_delta % 10) : 0,
+            (unsigned long)tasks[i].usStackHighWaterMark
+        );
+
+        last_tasks[i].number = tasks[i].xTaskNumber;
+        last_tasks[i].run_time = tasks[i].ulRunTimeCounter;
+    }
+
+    for(int i = 0; i < STATS_COUNTER_NUM; i++) {
+        uint32_t count = counters[i];
+        uint32_t delta = count - last_counters[i];
+
+        ESP_LOGI(STATS_TAG, "Wakeups of %s: %lu (%lu/s)", counter_names[i], (unsigned long)delta,
+            period_ms ? (unsigned long)((uint64_t)delta * 1000 / period_ms) : 0);
+
+        last_counters[i] = count;
+    }
+
+    last_task_num = task_num;
+    last_total = total;
+    last_log_us = now;
+}
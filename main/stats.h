@@ -0,0 +1,58 @@
+/**
+ * @file stats.h
+ *
+ * @brief Runtime statistics of tasks (CPU load per task, stack high-water marks and wakeups of the pipeline)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __STATS__
+#define __STATS__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+
+
+#define STATS_TAG "STATS" //< Module name
+
+#define RUNTIME_STATS //< Enables statistics (needs run time stats and trace facility of FreeRTOS, see sdkconfig.defaults)
+
+#define STATS_TASK_NUM 32 //< Maximum number of reported tasks
+
+
+/**
+ * @brief Counters of wakeups of the pipeline
+ *
+ */
+enum stats_counters {
+    STATS_TRANSLATOR_WAKEUPS, //< Translator received the item from the letter queue
+    STATS_OUTPUT_TICKS, //< Interrupts of the output timer
+    STATS_DLOG_WAKEUPS, //< Deferred log was printed
+    STATS_COUNTER_NUM,
+};
+
+
+/**
+ * @brief Increments the counter (it can be called also from ISR)
+ *
+ * @param counter Counter
+ */
+void stats_count(enum stats_counters counter);
+
+
+/**
+ * @brief Logs CPU load of every task (in percents of one core), its core and stack high-water mark and rates
+ * of wakeups since the previous call (it must be called always from the same task)
+ *
+ */
+void stats_log();
+
+#endif
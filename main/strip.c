@@ -0,0 +1,215 @@
+/**
+ * @file strip.c
+ *
+ * @brief Visualisation of the playback on addressable LED strip (WS2812) driven by RMT
+ *
+ * The output ISR only stores the state of every played interval to the ring (and moves its head), frames are rendered
+ * by the task to the back buffer (it starts as the copy of the displayed frame, so only pixels differing from the strip
+ * are written) and sent by RMT while the next frame is rendered.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "strip.h"
+#include <string.h>
+#include "driver/rmt_tx.h"
+#include "soc/soc_caps.h"
+#include "output.h"
+
+
+#if SOC_RMT_SUPPORT_DMA
+#define STRIP_RMT_DMA true //< Frame is passed to RMT by DMA
+#define STRIP_RMT_MEM_SYMBOLS 1024
+#else
+#define STRIP_RMT_DMA false //< RMT of ESP32 has no DMA, so the frame is refilled to its memory by the driver in ping-pong manner
+#define STRIP_RMT_MEM_SYMBOLS 64
+#endif
+
+#define STRIP_BYTES_PER_LED 3 //< Green, red and blue (WS2812 order)
+
+
+static rmt_channel_handle_t strip_channel = NULL;
+static rmt_encoder_handle_t strip_encoder = NULL;
+
+static uint8_t frames[2][STRIP_LED_NUM * STRIP_BYTES_PER_LED]; //< Double buffer of pixels
+static uint8_t front = 0; //< Index of the frame, that is sent (or was sent) by RMT
+
+static volatile uint8_t samples[STRIP_PATTERN_LEN]; //< Ring with states of played intervals
+static volatile uint32_t samples_head = 0; //< Number of stored samples (the newest one is before the head)
+
+
+void IRAM_ATTR strip_sample(enum strip_samples sample) {
+    samples[samples_head % STRIP_PATTERN_LEN] = sample;
+    samples_head++;
+}
+
+
+/**
+ * @brief Writes the pixel to the frame if it was changed
+ *
+ * @param frame Frame
+ * @param idx Index of the pixel
+ * @param r Red
+ * @param g Green
+ * @param b Blue
+ * @return true if the pixel was changed
+ */
+static bool strip_set_pixel(uint8_t *frame, unsigned idx, uint8_t r, uint8_t g, uint8_t b) {
+    uint8_t *pixel = &frame[idx * STRIP_BYTES_PER_LED];
+
+    if(pixel[0] == g && pixel[1] == r && pixel[2] == b) {
+        return false;
+    }
+
+    pixel[0] = g;
+    pixel[1] = r;
+    pixel[2] = b;
+
+    return true;
+}
+
+
+/**
+ * @brief Renders the pattern and the backlog bar to the frame
+ *
+ * @param frame Frame (it contains the displayed frame, so only differences are written)
+ * @param head Head of the ring with samples
+ * @param bar Number of lit LEDs of the backlog bar
+ * @return unsigned Number of changed pixels
+ */
+static unsigned strip_render(uint8_t *frame, uint32_t head, unsigned bar) {
+    unsigned changed = 0;
+
+    for(unsigned i = 0; i < STRIP_PATTERN_LEN; i++) {
+        uint8_t level = i == 0 ? STRIP_BRIGHTNESS : STRIP_TRAIL_BRIGHTNESS; //The newest interval flashes
+        uint8_t sample = i < head ? samples[(head - 1 - i) % STRIP_PATTERN_LEN] : STRIP_SAMPLE_OFF;
+
+        switch(sample) {
+            case STRIP_SAMPLE_BUZZ:
+                changed += strip_set_pixel(frame, i, level, level / 2, 0);
+                break;
+            case STRIP_SAMPLE_LED:
+                changed += strip_set_pixel(frame, i, 0, 0, level);
+                break;
+            default:
+                changed += strip_set_pixel(frame, i, 0, 0, 0);
+                break;
+        }
+    }
+
+    for(unsigned i = 0; i < STRIP_BAR_LEN; i++) { //Bar goes from green to red
+        uint8_t red = STRIP_TRAIL_BRIGHTNESS * i / STRIP_BAR_LEN;
+
+        if(i < bar) {
+            changed += strip_set_pixel(frame, STRIP_PATTERN_LEN + i, red, STRIP_TRAIL_BRIGHTNESS - red, 0);
+        }
+        else {
+            changed += strip_set_pixel(frame, STRIP_PATTERN_LEN + i, 0, 0, 0);
+        }
+    }
+
+    return changed;
+}
+
+
+/**
+ * @brief Task that renders frames and passes them to RMT (only when something was changed)
+ *
+ * @param arg
+ */
+static void strip_task(void *arg) {
+    rmt_transmit_config_t tx_config = { .loop_count = 0 };
+    uint32_t last_head = UINT32_MAX;
+    unsigned last_bar = UINT32_MAX;
+
+    //Clear the strip (its LEDs can shine after power on)
+    rmt_transmit(strip_channel, strip_encoder, frames[front], sizeof(frames[front]), &tx_config);
+
+    while(1) {
+        vTaskDelay(pdMS_TO_TICKS(STRIP_FRAME_MS));
+
+        uint32_t head = samples_head;
+        uint32_t backlog_ms = output_backlog_ms();
+        unsigned bar = backlog_ms >= STRIP_BAR_FULL_MS ? STRIP_BAR_LEN : backlog_ms * STRIP_BAR_LEN / STRIP_BAR_FULL_MS;
+        if(head == last_head && bar == last_bar) {
+            continue;
+        }
+
+        last_head = head;
+        last_bar = bar;
+
+        //Back buffer is not used by RMT (the transmission of the front buffer started after it was sent)
+        uint8_t back = !front;
+        memcpy(frames[back], frames[front], sizeof(frames[back])); //Back buffer holds the frame before the displayed one
+        unsigned changed = strip_render(frames[back], head, bar);
+        if(!changed) {
+            continue;
+        }
+
+        rmt_tx_wait_all_done(strip_channel, portMAX_DELAY);
+
+        esp_err_t err = rmt_transmit(strip_channel, strip_encoder, frames[back], sizeof(frames[back]), &tx_config);
+        if(err != ESP_OK) {
+            DLOGE(STRIP_TAG, "rmt_transmit failed!");
+            continue;
+        }
+
+        front = back;
+
+        DLOGD(STRIP_TAG, "Frame with %u changed pixels sent", changed);
+    }
+}
+
+
+esp_err_t strip_init() {
+    esp_err_t err;
+
+    rmt_tx_channel_config_t channel_config = {
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .gpio_num = STRIP_GPIO,
+        .mem_block_symbols = STRIP_RMT_MEM_SYMBOLS,
+        .resolution_hz = STRIP_RMT_RESOLUTION,
+        .trans_queue_depth = 2,
+        .flags.with_dma = STRIP_RMT_DMA,
+    };
+
+    err = rmt_new_tx_channel(&channel_config, &strip_channel);
+    if(err != ESP_OK) {
+        ESP_LOGE(STRIP_TAG, "rmt_new_tx_channel failed!");
+        return err;
+    }
+
+    //WS2812 bits (0: 0.3 us high and 0.9 us low, 1: 0.9 us high and 0.3 us low)
+    rmt_bytes_encoder_config_t encoder_config = {
+        .bit0 = {
+            .level0 = 1,
+            .duration0 = 3 * STRIP_RMT_RESOLUTION / 10000000,
+            .level1 = 0,
+            .duration1 = 9 * STRIP_RMT_RESOLUTION / 10000000,
+        },
+        .bit1 = {
+            .level0 = 1,
+            .duration0 = 9 * STRIP_RMT_RESOLUTION / 10000000,
+            .level1 = 0,
+            .duration1 = 3 * STRIP_RMT_RESOLUTION / 10000000,
+        },
+        .flags.msb_first = 1,
+    };
+
+    err = rmt_new_bytes_encoder(&encoder_config, &strip_encoder);
+    if(err != ESP_OK) {
+        ESP_LOGE(STRIP_TAG, "rmt_new_bytes_encoder failed!");
+        return err;
+    }
+
+    err = rmt_enable(strip_channel);
+    if(err != ESP_OK) {
+        ESP_LOGE(STRIP_TAG, "rmt_enable failed!");
+        return err;
+    }
+
+    xTaskCreatePinnedToCore(strip_task, "strip", 2048, NULL, 2, NULL, 0);
+
+    return ESP_OK;
+}
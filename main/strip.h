@@ -0,0 +1,72 @@
+/**
+ * @file strip.h
+ *
+ * @brief Visualisation of the playback on addressable LED strip (WS2812) driven by RMT
+ *
+ * The output ISR only stores the state of every played interval to the ring (and moves its head), frames are rendered
+ * by the task to the back buffer (only changed pixels are written) and sent by RMT while the next frame is rendered.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __STRIP__
+#define __STRIP__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "driver/gpio.h"
+
+#include "dlog.h"
+
+
+#define STRIP_TAG "STRIP" //< Module name
+
+// #define LED_STRIP //< Enables visualisation on WS2812 strip
+
+#define STRIP_GPIO GPIO_NUM_13
+#define STRIP_RMT_RESOLUTION 10000000 //< Resolution of RMT in Hz (one tick is 0.1 us)
+
+#define STRIP_LED_NUM 120 //< Number of LEDs of the strip
+#define STRIP_BAR_LEN 20 //< LEDs at the end of the strip show the duration of the backlog
+#define STRIP_PATTERN_LEN (STRIP_LED_NUM - STRIP_BAR_LEN) //< LEDs with scrolling pattern (the newest interval is the first one)
+#define STRIP_BAR_FULL_MS 20000 //< Backlog, that lights the whole bar
+
+#define STRIP_FRAME_MS 20 //< Period of rendering (frame is sent only if some pixel was changed)
+#define STRIP_BRIGHTNESS 64 //< Brightness of the newest interval (0-255)
+#define STRIP_TRAIL_BRIGHTNESS 8 //< Brightness of older intervals in the pattern
+
+
+/**
+ * @brief States of the interval, that are shown in the pattern
+ *
+ */
+enum strip_samples {
+    STRIP_SAMPLE_OFF, //< Gap
+    STRIP_SAMPLE_BUZZ, //< Dot or dash
+    STRIP_SAMPLE_LED, //< Space between words
+};
+
+
+/**
+ * @brief Stores the state of the played interval to the pattern (it is called from the output ISR)
+ *
+ * @param sample State of the interval
+ */
+void strip_sample(enum strip_samples sample);
+
+
+/**
+ * @brief Initializes RMT channel with the encoder of WS2812 bits and starts the rendering task
+ *
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t strip_init();
+
+#endif
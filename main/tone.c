@@ -0,0 +1,200 @@
+/**
+ * @file tone.c
+ *
+ * @brief Sidetone synthesized from precomputed blocks and played by I2S DMA (alternative to the PWM buzzer)
+ *
+ * Tone is composed from envelope segments (attack, steady, decay) that contain whole number of periods,
+ * so they can be concatenated without any discontinuity. All segments are precomputed, the feeding task only
+ * passes them to DMA and when there is nothing to play, DMA sends zeros by itself (auto clear) and the task sleeps.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "tone.h"
+#include <math.h>
+
+
+/**
+ * @brief Precomputed envelope segments
+ *
+ */
+enum tone_segments {
+    ATTACK_SEG,
+    STEADY_SEG,
+    DECAY_SEG,
+    TONE_SEG_NUM,
+};
+
+static int16_t segments[TONE_SEG_NUM][TONE_BLOCK_LEN]; //< Samples of envelope segments
+static int16_t ramp[TONE_RAMP_LEN]; //< Raised cosine (Q15)
+
+static i2s_chan_handle_t tx_handle = NULL;
+static TaskHandle_t tone_handle = NULL;
+
+static volatile bool tone_on = false; //< Requested state of the tone
+static volatile bool tone_pending = false; //< State of the tone changed and the feeding task was not notified yet
+static volatile uint16_t tone_pitch = TONE_DEFAULT_PITCH;
+static volatile uint8_t tone_volume = 255;
+static volatile bool tone_changed = true; //< Pitch or volume was changed and segments must be recomputed
+
+
+/**
+ * @brief Computes envelope segments with current pitch and volume (it must not be called while the tone is played)
+ *
+ */
+static void tone_compute_segments() {
+    //Whole number of periods must fit into one segment
+    unsigned periods = (tone_pitch * TONE_BLOCK_LEN + TONE_SAMPLE_RATE / 2) / TONE_SAMPLE_RATE;
+    float amplitude = (float)TONE_MAX_AMPLITUDE * tone_volume / 255;
+
+    for(unsigned i = 0; i < TONE_BLOCK_LEN; i++) {
+        int32_t s = (int32_t)(amplitude * sinf(2.0f * (float)M_PI * periods * i / TONE_BLOCK_LEN));
+
+        segments[STEADY_SEG][i] = s;
+        segments[ATTACK_SEG][i] = i < TONE_RAMP_LEN ? (s * ramp[i]) >> 15 : s;
+        segments[DECAY_SEG][i] = i < TONE_RAMP_LEN ? (s * ramp[TONE_RAMP_LEN - 1 - i]) >> 15 : 0;
+    }
+
+    ESP_LOGI(TONE_TAG, "Pitch set to %u Hz", periods * TONE_SAMPLE_RATE / TONE_BLOCK_LEN);
+}
+
+
+/**
+ * @brief Passes one envelope segment to DMA (blocks until there is free DMA buffer)
+ *
+ * @param seg Segment to be played
+ */
+static void tone_write(enum tone_segments seg) {
+    size_t written;
+
+    i2s_channel_write(tx_handle, segments[seg], sizeof(segments[seg]), &written, portMAX_DELAY);
+}
+
+
+/**
+ * @brief Task that feeds DMA by envelope segments due to requested state of the tone
+ *
+ * @param arg
+ */
+static void tone_feed(void *arg) {
+    bool playing = false;
+
+    while(1) {
+        if(!playing) { //DMA sends zeros, so wait for the start of the tone
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+            if(tone_changed) {
+                tone_changed = false;
+                tone_compute_segments();
+            }
+
+            if(tone_on) {
+                tone_write(ATTACK_SEG);
+                playing = true;
+            }
+        }
+        else if(tone_on) {
+            tone_write(STEADY_SEG);
+        }
+        else {
+            tone_write(DECAY_SEG);
+            playing = false;
+        }
+    }
+}
+
+
+void IRAM_ATTR tone_key(bool on) {
+    if(on == tone_on) {
+        return;
+    }
+
+    tone_on = on;
+    tone_pending = true;
+}
+
+
+void IRAM_ATTR tone_notify(BaseType_t *higher_priority_task_woken) {
+    if(!tone_pending || !tone_handle) {
+        return;
+    }
+
+    tone_pending = false;
+
+    if(higher_priority_task_woken) {
+        vTaskNotifyGiveFromISR(tone_handle, higher_priority_task_woken);
+    }
+    else {
+        xTaskNotifyGive(tone_handle);
+    }
+}
+
+
+void tone_set_pitch(uint16_t pitch) {
+    tone_pitch = pitch;
+    tone_changed = true;
+}
+
+
+void tone_set_volume(uint8_t volume) {
+    tone_volume = volume;
+    tone_changed = true;
+}
+
+
+esp_err_t tone_init() {
+    esp_err_t err;
+
+    for(unsigned i = 0; i < TONE_RAMP_LEN; i++) {
+        ramp[i] = (int16_t)(32767 * 0.5f * (1.0f - cosf((float)M_PI * (i + 0.5f) / TONE_RAMP_LEN)));
+    }
+
+    tone_compute_segments();
+    tone_changed = false;
+
+    //I2S_NUM_AUTO, because I2S0 is used by ADC in continuous mode
+    i2s_chan_config_t chan_config = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_AUTO, I2S_ROLE_MASTER);
+    chan_config.dma_desc_num = TONE_DMA_DESC_NUM;
+    chan_config.dma_frame_num = TONE_BLOCK_LEN;
+    chan_config.auto_clear = true;
+
+    err = i2s_new_channel(&chan_config, &tx_handle, NULL);
+    if(err != ESP_OK) {
+        ESP_LOGE(TONE_TAG, "i2s_new_channel failed!");
+        return err;
+    }
+
+    i2s_std_config_t std_config = {
+        .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(TONE_SAMPLE_RATE),
+        .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_MONO),
+        .gpio_cfg = {
+            .mclk = I2S_GPIO_UNUSED,
+            .bclk = TONE_BCLK_GPIO,
+            .ws = TONE_WS_GPIO,
+            .dout = TONE_DOUT_GPIO,
+            .din = I2S_GPIO_UNUSED,
+            .invert_flags = {
+                .mclk_inv = false,
+                .bclk_inv = false,
+                .ws_inv = false,
+            },
+        },
+    };
+
+    err = i2s_channel_init_std_mode(tx_handle, &std_config);
+    if(err != ESP_OK) {
+        ESP_LOGE(TONE_TAG, "i2s_channel_init_std_mode failed!");
+        return err;
+    }
+
+    err = i2s_channel_enable(tx_handle);
+    if(err != ESP_OK) {
+        ESP_LOGE(TONE_TAG, "i2s_channel_enable failed!");
+        return err;
+    }
+
+    xTaskCreatePinnedToCore(tone_feed, "tone", 2048, NULL, 12, &tone_handle, TONE_CORE);
+
+    return ESP_OK;
+}
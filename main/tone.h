@@ -0,0 +1,91 @@
+/**
+ * @file tone.h
+ *
+ * @brief Sidetone synthesized from precomputed blocks and played by I2S DMA (alternative to the PWM buzzer)
+ *
+ * The internal DAC of ESP32 can be fed by DMA only through I2S0, that is occupied by the ADC of the audio decoder,
+ * so the tone is played by external I2S DAC/amplifier (e. g. MAX98357A) on the other I2S controller.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __TONE__
+#define __TONE__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "driver/i2s_std.h"
+
+
+#define TONE_TAG "TONE" //< Module name
+
+// #define TONE_OUTPUT //< Buzzer is replaced by the sidetone on I2S DAC
+
+#if defined(TONE_OUTPUT) && defined(CONFIG_PM_ENABLE)
+#error "TONE_OUTPUT holds the PM lock of I2S all the time, so the chip would never sleep (disable it in the build with sdkconfig.pm)"
+#endif
+
+#define TONE_BCLK_GPIO GPIO_NUM_26
+#define TONE_WS_GPIO GPIO_NUM_25
+#define TONE_DOUT_GPIO GPIO_NUM_22
+
+#define TONE_CORE 1 //< Sidetone is fed on the core of the output engine (OUTPUT_CORE)
+
+#define TONE_SAMPLE_RATE 16000 //< Sample rate of the sidetone in Hz
+#define TONE_BLOCK_LEN 160 //< Samples in one envelope segment (10 ms), pitch is rounded to TONE_SAMPLE_RATE/TONE_BLOCK_LEN
+#define TONE_RAMP_LEN 80 //< Length of raised cosine attack and decay in samples (5 ms)
+#define TONE_DMA_DESC_NUM 3 //< Number of segments buffered by DMA (dettermines the latency of the tone end)
+
+#define TONE_DEFAULT_PITCH 700 //< Pitch of the sidetone in Hz
+#define TONE_MAX_AMPLITUDE 16000 //< Amplitude of the sidetone at maximal volume
+
+
+/**
+ * @brief Starts or stops the tone (it can be called from ISR and critical sections), the tone is ramped by the next
+ * envelope segment after tone_notify is called
+ *
+ * @param on true if tone should be played
+ */
+void tone_key(bool on);
+
+
+/**
+ * @brief Wakes up the feeding task if the state of the tone was changed (it must not be called in critical section)
+ *
+ * @param higher_priority_task_woken Set to pdTRUE if the task was woken (in ISR), NULL in task context
+ */
+void tone_notify(BaseType_t *higher_priority_task_woken);
+
+
+/**
+ * @brief Sets the pitch of the tone, it is applied after the current tone ends
+ *
+ * @param pitch Pitch in Hz
+ */
+void tone_set_pitch(uint16_t pitch);
+
+
+/**
+ * @brief Sets the volume of the tone, it is applied after the current tone ends
+ *
+ * @param volume Volume level (0-255)
+ */
+void tone_set_volume(uint8_t volume);
+
+
+/**
+ * @brief Initializes I2S channel, precomputes the envelope segments and starts the feeding task
+ *
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t tone_init();
+
+#endif
@@ -5,20 +5,55 @@
  */
 
 #include "translator.h"
-
-QueueHandle_t out_queue = NULL; //< Queue of out controls
+#include "macro.h"
+#include "cache.h"
+#include "ttl.h"
+#include "output.h"
+#include "charset.h"
+#include "stats.h"
+#include "power.h"
+#include <ctype.h>
+
+QueueHandle_t out_queues[OUTPUT_CHANNEL_NUM]; //< Queues of out controls (one for every output channel)
 QueueHandle_t queue = NULL; //< Queue of letters
 
 
 /**
- * @brief Handle for semaphore that should be checked before reading from the out control queue
- * (to letter consistency)
+ * @brief Handles for semaphores that should be checked before reading from the out control queue
+ * of the channel (to letter consistency)
  *
  */
-SemaphoreHandle_t out_queue_sem = NULL;
+SemaphoreHandle_t out_queue_sems[OUTPUT_CHANNEL_NUM];
+
+
+volatile TaskHandle_t out_space_waiter = NULL; //< Translator waiting for space in the out control queue (it is notified by the output ISR)
+
+static volatile bool translator_busy = false; //< Translator holds an item (it is set before the item leaves the letter queue)
+
+
+#define SPACE_FREED_BIT 0x01 //< Translator took the item from the letter queue (or the queue was reset)
+
+static SemaphoreHandle_t space_mutex = NULL; //< Protects the reservation and writes to the letter queue
+static EventGroupHandle_t space_events = NULL; //< Writers waiting for space in the letter queue wait for SPACE_FREED_BIT
+static volatile UBaseType_t space_waiters = 0; //< Number of writers waiting for space in the letter queue
+static TaskHandle_t reserve_owner = NULL; //< Task, that holds the reservation (there is at most one at once)
+static UBaseType_t reserved = 0; //< Number of items reserved for reserve_owner
+
+
+static uint8_t item_gen = 0; //< Generation of the currently translated item
+static uint8_t item_id = 0; //< Message id of the currently translated item
+static uint8_t item_channel = 0; //< Output channel of the currently translated item
 
 
 
+/**
+ * @brief Morse code tree stored in the array (root is at index 1, dot goes to 2*i, dash to 2*i + 1),
+ * used for translation of morse code back to characters
+ *
+ */
+static char morse_tree[MORSE_TREE_SIZE];
+
+
 /**
  * @brief Performs translation of character to the sequence of . and - (or /)
  *
@@ -26,37 +61,7 @@ SemaphoreHandle_t out_queue_sem = NULL;
  * @return const char* translated sequence or NULL if letter was not found
  */
 const char *char_lookup(char tb_tr) {
-    static translation_t tr_tab[] = {
-        { .ch = 0, .mc = NULL},
-        { .ch = ' ', .mc = "/"},       { .ch = '.', .mc = "//"},        { .ch = '1', .mc = ".----"},
-        { .ch = '2', .mc = "..---"},    { .ch = '3', .mc = "...--"},    { .ch = '4', .mc = "....-"},
-        { .ch = '5', .mc = "....."},    { .ch = '6', .mc = "-...."},    { .ch = '7', .mc = "--..."},
-        { .ch = '8', .mc = "---.."},    { .ch = '9', .mc = "----."},    { .ch = '0', .mc = "-----"},
-        { .ch = 'a', .mc = ".-"},       { .ch = 'b', .mc = "-..."},     { .ch = 'c', .mc = "-.-."},
-        { .ch = 'd', .mc = "-.."},      { .ch = 'e', .mc = "."},        { .ch = 'f', .mc = "..-."},
-        { .ch = 'g', .mc = "--."},      { .ch = 'h', .mc = "...."},     { .ch = 'i', .mc = ".."},
-        { .ch = 'j', .mc = ".---"},     { .ch = 'k', .mc = "-.-"},      { .ch = 'l', .mc = ".-.."},
-        { .ch = 'm', .mc = "--"},       { .ch = 'n', .mc = "-."},       { .ch = 'o', .mc = "---"},
-        { .ch = 'p', .mc = ".--."},     { .ch = 'q', .mc = "--.-"},     { .ch = 'r', .mc = ".-."},
-        { .ch = 's', .mc = "..."},      { .ch = 't', .mc = "-"},        { .ch = 'u', .mc = "..-"},
-        { .ch = 'v', .mc = "...-"},     { .ch = 'w', .mc = ".--"},      { .ch = 'x', .mc = "-..-"},
-        { .ch = 'y', .mc = "-.--"},     { .ch = 'z', .mc = "--.."},     { .ch = 0, .mc = NULL},
-    };
-
-    static const size_t approx_middle_i = 19; //Aproximately middle of the tab (just optimization, TABLE MUST BE CORRECTLY ORDERED BY ASCII codes!)
-    static translation_t * approx_middle = &(tr_tab[approx_middle_i]); //Ptr to the approx middle of the tab
-
-    int i = approx_middle_i;
-
-    //Perform seraching from the middle in the right direction until the stop is found (THERE MUST BE STOPS IN THE TABLE)
-    for(; tr_tab[i].ch && tr_tab[i].mc && tr_tab[i].ch != tb_tr; tb_tr < approx_middle->ch ? i-- : i++);
-
-    if(tr_tab[i].ch && tr_tab[i].mc) { //Letter was found in the table
-        return tr_tab[i].mc;
-    }
-    else {
-        return NULL;
-    }
+    return charset_morse[(uint8_t)tb_tr]; //Table is directly indexed by codes (see gen_charset.py)
 }
 
 
@@ -66,32 +71,68 @@ const char *char_lookup(char tb_tr) {
  * @return esp_err_t ESP_OK if everthing went OK
  */
 esp_err_t translator_init() {
-    queue = xQueueCreate(MAXIMUM_MESSAGE_NUM, MAXIMUM_MESSAGE_LEN + 1);
+    queue = xQueueCreate(MAXIMUM_MESSAGE_NUM, LETTER_ITEM_SIZE);
     if(!queue) {
         ESP_LOGE(TRANSLATOR_TAG, "Unable to create queue for letters!");
 
         return ESP_ERR_NO_MEM;
     }
 
-    out_queue = xQueueCreate(MAXIMUM_OUT_CONTROL_NUM, sizeof(out_control_t));
-    if(!out_queue) {
-        ESP_LOGE(TRANSLATOR_TAG, "Unable to create queue for out control!");
+    space_mutex = xSemaphoreCreateMutex();
+    space_events = xEventGroupCreate();
+    if(!space_mutex || !space_events) {
+        ESP_LOGE(TRANSLATOR_TAG, "Unable to create reservation of the letter queue!");
 
         return ESP_ERR_NO_MEM;
     }
 
-    out_queue_sem = xSemaphoreCreateBinary();
-    if(!out_queue_sem) {
-        ESP_LOGE(TRANSLATOR_TAG, "Unable to create semaphore for out queue!");
+    for(int ch = 0; ch < OUTPUT_CHANNEL_NUM; ch++) {
+        out_queues[ch] = xQueueCreate(ch ? CHANNEL_OUT_CONTROL_NUM : MAXIMUM_OUT_CONTROL_NUM, sizeof(out_control_t));
+        if(!out_queues[ch]) {
+            ESP_LOGE(TRANSLATOR_TAG, "Unable to create queue for out control!");
 
-        return ESP_ERR_NO_MEM;
+            return ESP_ERR_NO_MEM;
+        }
+
+        out_queue_sems[ch] = xSemaphoreCreateBinary();
+        if(!out_queue_sems[ch]) {
+            ESP_LOGE(TRANSLATOR_TAG, "Unable to create semaphore for out queue!");
+
+            return ESP_ERR_NO_MEM;
+        }
+        xSemaphoreGive(out_queue_sems[ch]);
+    }
+
+    //Build morse tree from the lookup table (so both directions are always consistent), only ASCII is decoded
+    for(int i = 0; i < CHARSET_EXT_BASE; i++) {
+        const char *mc = charset_morse[i];
+        if(!mc || mc[0] == '/') {
+            continue;
+        }
+
+        unsigned idx = MORSE_TREE_ROOT;
+        for(int j = 0; mc[j]; j++) {
+            idx = MORSE_TREE_NEXT(idx, mc[j] == '-');
+        }
+
+        if(idx < MORSE_TREE_SIZE) {
+            morse_tree[idx] = (char)i;
+        }
     }
-    xSemaphoreGive(out_queue_sem);
 
     return ESP_OK;
 }
 
 
+char morse_tree_lookup(unsigned idx) {
+    if(idx >= MORSE_TREE_SIZE) {
+        return 0;
+    }
+
+    return morse_tree[idx];
+}
+
+
 /**
  * @brief Converts uppercase letters to lowe case equivalent
  *
@@ -100,7 +141,7 @@ esp_err_t translator_init() {
 char do_char_correction(char ch) {
     char ret = ch;
 
-    if(ch > 'A' && ch < 'Z') {
+    if(ch >= 'A' && ch <= 'Z') {
         ret = ch + ('a' - 'A');
     }
 
@@ -109,67 +150,595 @@ char do_char_correction(char ch) {
 
 
 
+/**
+ * @brief Maps the code point to codes (up to two codes)
+ *
+ * @param cp Code point
+ * @return uint16_t Codes (the first one is in the lower byte) or 0 if code point cannot be played
+ */
+static uint16_t translator_map(uint32_t cp) {
+    if(cp < CHARSET_EXT_BASE) {
+        char ch = do_char_correction((char)cp);
+        return char_lookup(ch) ? (uint8_t)ch : 0;
+    }
+    else if(cp >= CHARSET_LATIN_FIRST && cp <= CHARSET_LATIN_LAST) {
+        return charset_latin[cp - CHARSET_LATIN_FIRST];
+    }
+    else if(cp >= CHARSET_CYRILLIC_FIRST && cp <= CHARSET_CYRILLIC_LAST) {
+        return charset_cyrillic[cp - CHARSET_CYRILLIC_FIRST];
+    }
+    else if(cp >= CHARSET_PUNCTUATION_FIRST && cp <= CHARSET_PUNCTUATION_LAST) {
+        return charset_punctuation[cp - CHARSET_PUNCTUATION_FIRST];
+    }
+    else if(cp >= CHARSET_KANA_FIRST && cp <= CHARSET_KANA_LAST) {
+        return charset_kana[cp - CHARSET_KANA_FIRST];
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Passes codes of the code point to the output (Wabun code is switched on and off by prosigns DO and SN)
+ *
+ * @param d Decoder
+ * @param cp Code point
+ * @param out Output buffer (it must have space for TRANSLATOR_DECODE_MAX_EMIT codes)
+ * @return size_t Number of written codes
+ */
+static size_t translator_emit(utf8_decoder_t *d, uint32_t cp, char *out) {
+    size_t n = 0;
+    uint16_t codes = translator_map(cp);
+    if(!codes) {
+        DLOGE(TRANSLATOR_TAG, "Unable to find character U+%04lx in lookup table!", (unsigned long)cp);
+        return 0;
+    }
+
+    bool kana = cp >= CHARSET_KANA_FIRST && cp <= CHARSET_KANA_LAST;
+    bool letter = (cp < CHARSET_EXT_BASE && isalnum((int)cp)) || (cp >= CHARSET_LATIN_FIRST && cp <= CHARSET_CYRILLIC_LAST);
+    if(kana && !d->wabun) {
+        out[n++] = (char)CHARSET_CODE_DO;
+        d->wabun = true;
+    }
+    else if(letter && d->wabun) {
+        out[n++] = (char)CHARSET_CODE_SN;
+        d->wabun = false;
+    }
+
+    out[n++] = (char)(codes & 0xff);
+    if(codes >> 8) {
+        out[n++] = (char)(codes >> 8);
+    }
+
+    return n;
+}
+
+
+/**
+ * @brief Ends the prosign escape, the name is looked up in the table of prosigns (if the escape was not terminated
+ * by '>', its letters are passed as they are)
+ *
+ * @param d Decoder
+ * @param terminated true if escape was terminated by '>'
+ * @param out Output buffer
+ * @return size_t Number of written codes
+ */
+static size_t translator_end_escape(utf8_decoder_t *d, bool terminated, char *out) {
+    size_t n = 0;
+
+    d->in_escape = false;
+    d->escape[d->escape_len] = '\0';
+
+    if(terminated) {
+        for(unsigned i = 0; i < charset_prosign_num; i++) {
+            if(!strcmp(d->escape, charset_prosigns[i].name)) {
+                out[n++] = (char)charset_prosigns[i].code;
+                return n;
+            }
+        }
+
+        DLOGE(TRANSLATOR_TAG, "Unknown prosign (%u letters)!", d->escape_len); //Name is not logged, the deferred log keeps only the pointer
+    }
+
+    for(uint8_t i = 0; i < d->escape_len; i++) {
+        n += translator_emit(d, (uint8_t)d->escape[i], &out[n]);
+    }
+
+    return n;
+}
+
+
+/**
+ * @brief Processes the decoded code point (prosign escapes are resolved here)
+ *
+ * @param d Decoder
+ * @param cp Code point
+ * @param out Output buffer
+ * @return size_t Number of written codes
+ */
+static size_t translator_code_point(utf8_decoder_t *d, uint32_t cp, char *out) {
+    size_t n = 0;
+
+    if(d->in_escape) {
+        if(cp == '>') {
+            return translator_end_escape(d, true, out);
+        }
+        else if(cp < CHARSET_EXT_BASE && isalpha((int)cp) && d->escape_len < CHARSET_PROSIGN_MAX_LEN) {
+            d->escape[d->escape_len++] = (char)toupper((int)cp);
+            return 0;
+        }
+
+        n += translator_end_escape(d, false, out);
+    }
+
+    if(cp == '<') {
+        d->in_escape = true;
+        d->escape_len = 0;
+        return n;
+    }
+
+    return n + translator_emit(d, cp, &out[n]);
+}
+
+
+void translator_decoder_reset(utf8_decoder_t *d) {
+    memset(d, 0, sizeof(*d));
+}
+
+
+/**
+ * @brief Processes one byte of UTF-8 text
+ *
+ * @param d Decoder
+ * @param byte Input byte
+ * @param out Output buffer (it must have space for TRANSLATOR_DECODE_MAX_EMIT codes)
+ * @return size_t Number of written codes
+ */
+static size_t translator_byte(utf8_decoder_t *d, uint8_t byte, char *out) {
+    if(d->pending) {
+        if((byte & 0xc0) == 0x80) { //Continuation byte
+            d->cp = (d->cp << 6) | (byte & 0x3f);
+            if(--d->pending > 0) {
+                return 0;
+            }
+
+            //Overlong sequences (e. g. hidden '<'), surrogates and too big code points are not accepted
+            if(d->cp < d->min_cp || (d->cp >= 0xd800 && d->cp <= 0xdfff) || d->cp > 0x10ffff) {
+                DLOGE(TRANSLATOR_TAG, "Invalid UTF-8 sequence!");
+                return 0;
+            }
+
+            return translator_code_point(d, d->cp, out);
+        }
+
+        d->pending = 0; //Sequence was broken, so the byte is processed as the first one
+        DLOGE(TRANSLATOR_TAG, "Invalid UTF-8 sequence!");
+    }
+
+    if(byte < 0x80) {
+        return translator_code_point(d, byte, out);
+    }
+    else if((byte & 0xe0) == 0xc0) {
+        d->cp = byte & 0x1f;
+        d->pending = 1;
+        d->min_cp = 0x80;
+    }
+    else if((byte & 0xf0) == 0xe0) {
+        d->cp = byte & 0x0f;
+        d->pending = 2;
+        d->min_cp = 0x800;
+    }
+    else if((byte & 0xf8) == 0xf0) {
+        d->cp = byte & 0x07;
+        d->pending = 3;
+        d->min_cp = 0x10000;
+    }
+    else {
+        DLOGE(TRANSLATOR_TAG, "Invalid UTF-8 sequence!");
+    }
+
+    return 0;
+}
+
+
+size_t translator_decode(utf8_decoder_t *d, const uint8_t *in, size_t len, size_t *consumed, char *out, size_t max_len) {
+    size_t n = 0, i = 0;
+
+    for(; i < len && max_len - n >= TRANSLATOR_DECODE_MAX_EMIT; i++) {
+        n += translator_byte(d, in[i], &out[n]);
+    }
+
+    if(consumed) {
+        *consumed = i;
+    }
+
+    return n;
+}
+
+
+/**
+ * @brief Processes one bit of compressed text (codes are canonical, so the symbol is found by the first code
+ * of the length, see gen_packed.py)
+ *
+ * @param d Decoder
+ * @param bit Input bit
+ * @param out Output buffer (it must have space for TRANSLATOR_PACKED_MAX_EMIT codes)
+ * @return size_t Number of written codes
+ */
+static size_t translator_packed_bit(utf8_decoder_t *d, bool bit, char *out) {
+    d->packed_code = (uint16_t)((d->packed_code << 1) | (bit ? 1 : 0));
+    d->packed_len++;
+
+    if(d->packed_raw) { //Bits of the escaped byte
+        if(d->packed_len < PACKED_RAW_BITS) {
+            return 0;
+        }
+
+        uint8_t byte = (uint8_t)d->packed_code;
+        d->packed_raw = false;
+        d->packed_code = 0;
+        d->packed_len = 0;
+
+        return translator_byte(d, byte, out);
+    }
+
+    if(d->packed_len > PACKED_MAX_CODE_LEN) { //Codes are complete, so it cannot happen (except corrupted state)
+        DLOGE(TRANSLATOR_TAG, "Invalid compressed text!");
+        d->packed_code = 0;
+        d->packed_len = 0;
+        return 0;
+    }
+
+    int idx = (int)d->packed_code - packed_first[d->packed_len];
+    if(idx < 0 || idx >= packed_count[d->packed_len]) { //Code is not complete yet
+        return 0;
+    }
+
+    idx += packed_offset[d->packed_len];
+    d->packed_code = 0;
+    d->packed_len = 0;
+
+    if(idx == PACKED_ESCAPE) {
+        d->packed_raw = true;
+        return 0;
+    }
+
+    size_t n = 0;
+    for(const char *c = packed_symbols[idx]; *c; c++) {
+        n += translator_byte(d, (uint8_t)*c, &out[n]);
+    }
+
+    return n;
+}
+
+
+size_t translator_decode_packed(utf8_decoder_t *d, const uint8_t *in, size_t len, size_t *consumed, char *out, size_t max_len) {
+    size_t n = 0, i = 0;
+
+    for(; i < len; i++) {
+        for(; d->packed_bit < 8; d->packed_bit++) {
+            if(max_len - n < TRANSLATOR_PACKED_MAX_EMIT) { //The rest of the byte is processed by the next call
+                *consumed = i;
+                return n;
+            }
+
+            n += translator_packed_bit(d, (in[i] >> (7 - d->packed_bit)) & 1, &out[n]);
+        }
+
+        d->packed_bit = 0;
+    }
+
+    *consumed = i;
+
+    return n;
+}
+
+
+void translator_packed_end(utf8_decoder_t *d) {
+    d->packed_code = 0;
+    d->packed_len = 0;
+    d->packed_bit = 0;
+    d->packed_raw = false;
+}
+
+
+size_t compile_letter(char ch, out_control_t *out_c, size_t max_len) {
+    const char *morse_code = char_lookup(do_char_correction(ch)); //Find translation for the current letter
+    if(!morse_code || strlen(morse_code) > max_len) {
+        return 0;
+    }
+
+    size_t len = 0;
+    for(int j = 0; morse_code[j]; j++, len++) {
+        out_c[len] = (out_control_t){ .buzz_state = 0, .led_state = 0, .gap = 0, .flags = 0 };
+        switch(morse_code[j]) {
+            case '.':
+                out_c[len].buzz_state = DOT_BUZZER_INT; //Beep interval for .
+                break;
+            case '-' :
+                out_c[len].buzz_state = DASH_BUZZER_INT; //Beep interval for -
+                break;
+            default:
+                out_c[len].led_state = SLASH_LED_INT; //Led interval for other chars (/)
+                break;
+        }
+
+        if(morse_code[j+1] == '\0') { //Add gap if symbol is the last from the letter
+            out_c[len].gap = GAP_BETWEEN_LETTERS;
+        }
+    }
+
+    return len;
+}
+
+
+bool send_out_controls(const out_control_t *out_c, size_t len) {
+    bool ok = true;
+    QueueHandle_t out_queue = out_queues[item_channel];
+
+    //Wait until the whole letter fits to the queue (the semaphore is not held, so the ISR can drain the queue),
+    //translator is the only writer, so the space cannot be taken by anybody else
+    out_space_waiter = xTaskGetCurrentTaskHandle();
+    while(uxQueueSpacesAvailable(out_queue) < len) {
+        if(output_is_cancelled(item_gen, item_id)) {
+            out_space_waiter = NULL;
+            output_drop(out_c, len);
+            return false;
+        }
+
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY); //Output ISR (or cancellation) notifies the translator
+    }
+    out_space_waiter = NULL;
+
+    //Take semaphore (avoid leaking some .,- or / before translating the whole letter)
+    if(xSemaphoreTake(out_queue_sems[item_channel], portMAX_DELAY) != pdTRUE) {
+        return false;
+    }
+
+    for(size_t i = 0; i < len; i++) {
+        if(output_is_cancelled(item_gen, item_id)) { //The rest of the letter is not sent (but it is counted as played)
+            output_drop(&out_c[i], len - i);
+            ok = false;
+            break;
+        }
+
+        out_control_t out_control = out_c[i];
+        out_control.gen = item_gen;
+        out_control.msg_id = item_id;
+
+        //Send translated symbol to the out control queue (the space is reserved, so it cannot fail)
+        if(xQueueSend(out_queue, &out_control, (TickType_t)0) != pdPASS) {
+            DLOGE(TRANSLATOR_TAG, "Writing letter to the queue failed!");
+            ok = false;
+        }
+        else {
+            output_backlog_add(item_channel, &out_control, 1);
+        }
+    }
+
+    //The whole letter is tranlated so release the semaphore
+    xSemaphoreGive(out_queue_sems[item_channel]);
+
+    output_wake();
+
+    return ok;
+}
+
+
+bool translator_is_idle() {
+    return !uxQueueMessagesWaiting(queue) && !translator_busy; //Busy flag is set before the item leaves the queue
+}
+
+
+void translator_space_freed() {
+    if(space_waiters) {
+        xEventGroupSetBits(space_events, SPACE_FREED_BIT);
+    }
+}
+
+
+bool translator_reserve(size_t items, TickType_t ticks_to_wait) {
+    TickType_t start = xTaskGetTickCount();
+    bool ok;
+
+    if(items > MAXIMUM_MESSAGE_NUM) {
+        return false;
+    }
+
+    xSemaphoreTake(space_mutex, portMAX_DELAY);
+    space_waiters++;
+
+    while(1) {
+        //The bit is cleared before the check, so the space freed after the check always wakes up the writer
+        xEventGroupClearBits(space_events, SPACE_FREED_BIT);
+
+        if(!reserve_owner && uxQueueSpacesAvailable(queue) >= items) {
+            ok = true;
+            break;
+        }
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if(ticks_to_wait != portMAX_DELAY && elapsed >= ticks_to_wait) {
+            ok = false;
+            break;
+        }
+
+        xSemaphoreGive(space_mutex);
+
+        xEventGroupWaitBits(space_events, SPACE_FREED_BIT, pdFALSE, pdTRUE,
+            ticks_to_wait == portMAX_DELAY ? portMAX_DELAY : ticks_to_wait - elapsed);
+
+        xSemaphoreTake(space_mutex, portMAX_DELAY);
+    }
+
+    space_waiters--;
+
+    if(ok) {
+        reserve_owner = xTaskGetCurrentTaskHandle();
+        reserved = items;
+    }
+
+    xSemaphoreGive(space_mutex);
+
+    return ok;
+}
+
+
+void translator_unreserve() {
+    xSemaphoreTake(space_mutex, portMAX_DELAY);
+
+    if(reserve_owner == xTaskGetCurrentTaskHandle()) {
+        reserve_owner = NULL;
+        reserved = 0;
+    }
+
+    xSemaphoreGive(space_mutex);
+
+    translator_space_freed(); //Other writers may wait only for the end of the reservation
+}
+
+
+bool queue_letter(const char *item, TickType_t ticks_to_wait) {
+    char marked[LETTER_ITEM_SIZE];
+
+    memcpy(marked, item, LETTER_ITEM_SIZE);
+    marked[MAXIMUM_MESSAGE_LEN + 2] = (char)output_generation;
+
+    xSemaphoreTake(space_mutex, portMAX_DELAY);
+
+    bool owner = reserve_owner == xTaskGetCurrentTaskHandle() && reserved > 0;
+    if(!owner && uxQueueSpacesAvailable(queue) <= reserved) { //Free space is reserved for other writer
+        xSemaphoreGive(space_mutex);
+        return false;
+    }
+
+    bool sent = xQueueSend(queue, marked, ticks_to_wait) == pdPASS;
+    if(sent && owner) {
+        reserved--;
+    }
+
+    xSemaphoreGive(space_mutex);
+
+    return sent;
+}
+
+
+void send_compiled(const out_control_t *out_c, size_t len) {
+    //Letters are sent separately (out control semaphore is released between them as in translator)
+    size_t start = 0;
+    for(size_t i = 0; i < len; i++) {
+        if(output_is_cancelled(item_gen, item_id)) { //Remaining letters are not sent
+            output_drop(&out_c[start], len - start);
+            return;
+        }
+
+        if(out_c[i].gap > 0 || i == len - 1) {
+            send_out_controls(&out_c[start], i - start + 1);
+            start = i + 1;
+        }
+    }
+}
+
+
 /**
  * @brief Translates letters fro queue to the control structures (that can be easily intepreted)
  *
  * @param arg No args are necessary
  */
 void translate(void *arg) {
-    char buffer[MAXIMUM_MESSAGE_LEN + 1];
+    char buffer[LETTER_ITEM_SIZE];
+    out_control_t out_c[LETTER_MAX_OUT_CONTROLS];
 
     while(1) {
-        //Try get letter (buffer) from the queue
-        if(xQueueReceive(queue, buffer, (TickType_t)5)) { //5 ticks block if letter is not currently available
-            ESP_LOGI(MODULE_TAG, "Read %s from letter queue, translating to morse code\n", buffer);
+        if(!uxQueueMessagesWaiting(queue)) { //Translator is idle, output holds its own locks
+#ifdef POWER_MANAGEMENT
+            power_release(POWER_TRANSLATOR);
+#endif
+
+            TaskHandle_t idle_waiter = output_idle_waiter;
+            if(translator_busy && idle_waiter) { //Item could produce nothing to play, so the timer is not paused
+                xTaskNotifyGive(idle_waiter);
+            }
+
+            translator_busy = false;
+        }
+
+        //Translator sleeps until the letter is written, it is marked busy before the item leaves the queue (so the
+        //pipeline does not look idle before the item is played)
+        if(xQueuePeek(queue, buffer, portMAX_DELAY)) {
+            translator_busy = true;
+        }
+
+        //Try get letter (buffer) from the queue (it could be reset by abort meanwhile)
+        if(xQueueReceive(queue, buffer, 0)) {
+            translator_space_freed();
+
+#ifdef POWER_MANAGEMENT
+            power_acquire(POWER_TRANSLATOR);
+#endif
+
+#ifdef RUNTIME_STATS
+            stats_count(STATS_TRANSLATOR_WAKEUPS);
+#endif
+
+            DLOGD(TRANSLATOR_TAG, "Read '%c' from letter queue, translating to morse code", buffer[0]);
+
+            //Out controls of the item are marked, so they can be cancelled in every stage
+            item_gen = LETTER_ITEM_GEN(buffer);
+            item_id = LETTER_ITEM_ID(buffer);
+            item_channel = LETTER_ITEM_CHANNEL(buffer) < OUTPUT_CHANNEL_NUM ? LETTER_ITEM_CHANNEL(buffer) : 0;
 
             //Translate every letter in the buffer
             for(int i = 0; i < MAXIMUM_MESSAGE_LEN; i++) {
                 char cur_char = buffer[i];
 
-                const char *morse_code = char_lookup(do_char_correction(cur_char)); //Find translation for the current letter
-                if(!morse_code) {
-                    ESP_LOGE(TRANSLATOR_TAG, "Unable to find character in lookup table!");
+                if(MACRO_IS_ITEM(cur_char)) { //Macro is already translated
+                    if(macro_play(MACRO_ITEM_ID(cur_char)) != ESP_OK) {
+                        DLOGE(TRANSLATOR_TAG, "Unable to play macro %d!", MACRO_ITEM_ID(cur_char));
+
+                        //Item must be finished anyway (it is counted as played letter)
+                        out_c[0] = (out_control_t){ .buzz_state = 0, .led_state = 0, .gap = 0, .flags = OUT_ITEM_END };
+                        send_out_controls(out_c, 1);
+                    }
+
                     continue;
                 }
-                else {
-                    //Take semaphore (avoid leaking some .,- or / before translating the whole letter)
-                    if(xSemaphoreTake(out_queue_sem, portMAX_DELAY) == pdTRUE) {
-
-                        for(int j = 0; morse_code[j]; j++) {
-                            out_control_t out_c = { .buzz_state = 0, .led_state = 0, .gap = 0};
-                            switch(morse_code[j]) {
-                                case '.':
-                                    out_c.buzz_state = DOT_BUZZER_INT; //Beep interval for .
-                                    break;
-                                case '-' :
-                                    out_c.buzz_state = DASH_BUZZER_INT; //Beep interval for -
-                                    break;
-                                default:
-                                    out_c.led_state = SLASH_LED_INT; //Led interval for other chars (/)
-                                    break;
-                            }
-
-                            if(morse_code[j+1] == '\0') { //Add gap if symbol is the last from the letter
-                                out_c.gap = GAP_BETWEEN_LETTERS;
-                            }
-
-                            //Send translated symbol to the out control queue
-                            if(xQueueSend(out_queue, &out_c, (TickType_t)5) != pdPASS) {
-                                ESP_LOGE(TRANSLATOR_TAG, "Writing letter to the queue failed!");
-                            }
-                        }
-
-                        //The whole letter is tranlated so release the semaphore
-                        xSemaphoreGive(out_queue_sem);
-
-                        ESP_LOGI(TRANSLATOR_TAG, "Translated to %s and written it to out control queue", morse_code);
-                    }
-                    else {
-                        ESP_LOGI(TRANSLATOR_TAG, "Unable to obtain out_queue_sem! Skipping %c...", cur_char);
+
+                if(CACHE_IS_ITEM(cur_char)) { //Message is already translated
+                    if(cache_play(CACHE_ITEM_SLOT(cur_char)) != ESP_OK) {
+                        DLOGE(TRANSLATOR_TAG, "Unable to play cached message %d!", CACHE_ITEM_SLOT(cur_char));
+
+                        out_c[0] = (out_control_t){ .buzz_state = 0, .led_state = 0, .gap = 0, .flags = OUT_ITEM_END };
+                        send_out_controls(out_c, 1);
                     }
+
+                    continue;
+                }
+
+                uint8_t ttl_slot = 0;
+#ifdef MESSAGE_TTL
+                ttl_slot = TTL_ITEM_SLOT(buffer); //Item contains only one letter, so the rest of it is used for the deadline
+                if(ttl_slot && ttl_letter(ttl_slot, false)) {
+                    DLOGD(TRANSLATOR_TAG, "Letter '%c' expired", cur_char);
+                    continue;
+                }
+#endif
+
+                size_t len = compile_letter(cur_char, out_c, LETTER_MAX_OUT_CONTROLS);
+                if(!len) {
+                    DLOGE(TRANSLATOR_TAG, "Unable to find character in lookup table!");
+                    continue;
+                }
+
+                out_c[len - 1].flags |= OUT_ITEM_END;
+                if(ttl_slot || item_channel) { //Letters with deadline and letters of other channels are not in the spool
+                    out_c[len - 1].flags |= OUT_ITEM_UNSPOOLED;
+                }
+
+                if(send_out_controls(out_c, len)) {
+                    DLOGD(TRANSLATOR_TAG, "Translated '%c' and written it to out control queue", cur_char);
                 }
             }
         }
     }
 }
-
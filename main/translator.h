@@ -19,15 +19,36 @@
 #include "esp_log.h"
 
 #include "ble_receiver.h"
+#include "charset.h"
+#include "packed.h"
 #include "translator.h"
 
 
 #define TRANSLATOR_TAG "TRANSLATOR" //< Module name
 
 #define MAXIMUM_MESSAGE_LEN 1 //< Maximum size of one buffer stored in message queue
+#define LETTER_ITEM_SIZE (MAXIMUM_MESSAGE_LEN + 4) //< Item of the letter queue (letters, slot of the deadline, message id, generation, channel)
+
+#define LETTER_ITEM_ID(item) ((uint8_t)(item)[MAXIMUM_MESSAGE_LEN + 1]) //< Id of the message (0 if message has no id)
+#define LETTER_ITEM_GEN(item) ((uint8_t)(item)[MAXIMUM_MESSAGE_LEN + 2]) //< Generation of the pipeline when item was accepted
+#define LETTER_ITEM_CHANNEL(item) ((uint8_t)(item)[MAXIMUM_MESSAGE_LEN + 3]) //< Output channel, which plays the item
+#if CONFIG_BT_NIMBLE_ENABLED
+#define MAXIMUM_MESSAGE_NUM 4096 //< Maximum size of letter queue (NimBLE leaves more free RAM for it)
+#else
 #define MAXIMUM_MESSAGE_NUM 1024 //< Maximum size of letter queue
+#endif
+
+#define MAXIMUM_OUT_CONTROL_NUM 4096 //< Maximum length of the out control queue of the primary channel
+#define CHANNEL_OUT_CONTROL_NUM 1024 //< Maximum length of the out control queues of other channels
 
-#define MAXIMUM_OUT_CONTROL_NUM 4096 //< Maximum length of the out control queue
+
+// #define MULTI_CHANNEL //< Enables additional output channels with their own buzzers, LEDs and speed (see output.h)
+
+#ifdef MULTI_CHANNEL
+#define OUTPUT_CHANNEL_NUM 3 //< Number of output channels (channel 0 is the primary one)
+#else
+#define OUTPUT_CHANNEL_NUM 1
+#endif
 
 
 //Determines the length of control intervals for symbols (the real time depends on timer and ISR that processes out control structures)
@@ -39,6 +60,11 @@
 #define GAP_BETWEEN_LETTERS 2
 
 
+#define MORSE_TREE_SIZE 128 //< Size of morse code tree (symbols with at most 6 dots or dashes)
+#define MORSE_TREE_ROOT 1 //< Index of the root of the morse code tree (empty symbol)
+#define MORSE_TREE_NEXT(idx, is_dash) (((idx) << 1) | ((is_dash) ? 1 : 0)) //< Moves in the morse code tree
+
+
 /**
  * @brief Control structure for controlling buzzer and led (e. g. if buzz_state is > 0,
  * it means that is should be turned on)
@@ -48,29 +74,57 @@ typedef struct out_control {
     uint8_t buzz_state;
     uint8_t led_state;
     uint8_t gap;
+    uint8_t flags; //< See OUT_ITEM_END
+    uint8_t gen; //< Generation of the pipeline (out controls of older generations are dropped)
+    uint8_t msg_id; //< Id of the message (0 if message has no id)
 } out_control_t;
 
+#define OUT_ITEM_END 0x01 //< Out control is the last one of the item from the letter queue (letter or macro)
+#define OUT_ITEM_UNSPOOLED 0x02 //< Letter is not stored in the spool (it is not counted as played)
+
+#define OUT_CONTROL_TICKS(c) (((c).buzz_state > (c).led_state ? (c).buzz_state : (c).led_state) + (c).gap + 1) //< Timer ticks needed to play out control
+
+#define LETTER_MAX_OUT_CONTROLS 10 //< Maximum number of out controls of one letter (the longest prosign has 9 symbols)
+
+#define TRANSLATOR_DECODE_MAX_EMIT 8 //< Maximum number of codes written by the decoder for one input byte
+
+#define PACKED_TEXT //< Letter command can carry compressed text (see PACKED_PREFIX and gen_packed.py)
+
+#define TRANSLATOR_PACKED_MAX_EMIT (PACKED_MAX_SYMBOL_LEN * TRANSLATOR_DECODE_MAX_EMIT) //< Maximum number of codes written for one bit of compressed text
+
 
 /**
- * @brief Translation unit stored in the lookup table
+ * @brief State of the incremental UTF-8 decoder (characters can be split between writes)
  *
  */
-typedef struct translation {
-    char ch; //< Character
-    char *mc; //< Morse code representation
-} translation_t;
+typedef struct utf8_decoder {
+    uint32_t cp; //< Code point, that is being decoded
+    uint32_t min_cp; //< The smallest code point, that can be encoded by the sequence (shorter one must be used otherwise)
+    uint8_t pending; //< Number of expected continuation bytes
+    bool in_escape; //< Name of the prosign is being read (after '<')
+    uint8_t escape_len;
+    char escape[CHARSET_PROSIGN_MAX_LEN + 1]; //< Name of the prosign
+    bool wabun; //< Kana are played (prosign DO was sent)
+    uint16_t packed_code; //< Bits of the code (or of the escaped byte) of the compressed text, that is being read
+    uint8_t packed_len; //< Number of read bits of the code
+    uint8_t packed_bit; //< Number of processed bits of the current input byte (the output was full)
+    bool packed_raw; //< Escaped byte is being read
+} utf8_decoder_t;
 
 
-extern QueueHandle_t out_queue; //< Queue of out controls
+extern QueueHandle_t out_queues[OUTPUT_CHANNEL_NUM]; //< Queues of out controls (one for every output channel)
 extern QueueHandle_t queue; //< Queue of letters
 
 
 /**
- * @brief Handle for semaphore that should be checked before reading from the out control queue
- * (to letter consistency)
+ * @brief Handles for semaphores that should be checked before reading from the out control queue
+ * of the channel (to letter consistency)
  *
  */
-extern SemaphoreHandle_t out_queue_sem;
+extern SemaphoreHandle_t out_queue_sems[OUTPUT_CHANNEL_NUM];
+
+
+extern volatile TaskHandle_t out_space_waiter; //< Translator waiting for space in the out control queue (it is notified by the output ISR)
 
 
 /**
@@ -88,4 +142,155 @@ void translate(void *arg);
  */
 esp_err_t translator_init();
 
+
+/**
+ * @brief Translates morse code back to the character
+ *
+ * @param idx Index in the morse code tree (see MORSE_TREE_NEXT)
+ * @return char Found character or 0 if there is no character with given code
+ */
+char morse_tree_lookup(unsigned idx);
+
+
+/**
+ * @brief Performs translation of character to the sequence of . and - (or /)
+ *
+ * @param tb_tr char to be translated
+ * @return const char* translated sequence or NULL if letter was not found
+ */
+const char *char_lookup(char tb_tr);
+
+
+/**
+ * @brief Converts upper case letters to lower case (translation table contains only lower case letters)
+ *
+ * @param ch Character to be converted
+ * @return char Converted character
+ */
+char do_char_correction(char ch);
+
+
+/**
+ * @brief Resets the state of the decoder (e. g. when the message is aborted)
+ *
+ * @param d Decoder
+ */
+void translator_decoder_reset(utf8_decoder_t *d);
+
+
+/**
+ * @brief Decodes UTF-8 text to codes of the letter queue (every code point is looked up in directly indexed
+ * tables, see gen_charset.py), prosigns can be written as <NAME>, unknown characters are dropped
+ *
+ * @param d Decoder (its state is kept between calls, so characters can be split)
+ * @param in Input bytes
+ * @param len Number of input bytes
+ * @param consumed Output argument, number of processed input bytes (the rest does not fit to the output)
+ * @param out Output buffer for codes
+ * @param max_len Size of the output buffer
+ * @return size_t Number of written codes
+ */
+size_t translator_decode(utf8_decoder_t *d, const uint8_t *in, size_t len, size_t *consumed, char *out, size_t max_len);
+
+
+/**
+ * @brief Decodes compressed text (Huffman codes of characters and words, see gen_packed.py) to codes of the letter
+ * queue, decoded characters are processed as by translator_decode
+ *
+ * @param d Decoder (the unfinished input byte is kept in its state, if the output is full)
+ * @param in Input bytes
+ * @param len Number of input bytes
+ * @param consumed Output argument, number of completely processed input bytes
+ * @param out Output buffer for codes
+ * @param max_len Size of the output buffer
+ * @return size_t Number of written codes
+ */
+size_t translator_decode_packed(utf8_decoder_t *d, const uint8_t *in, size_t len, size_t *consumed, char *out, size_t max_len);
+
+
+/**
+ * @brief Ends the compressed text (unfinished code of the padding at the end of the write is dropped)
+ *
+ * @param d Decoder
+ */
+void translator_packed_end(utf8_decoder_t *d);
+
+
+/**
+ * @brief Translates the character to out control structures
+ *
+ * @param ch Character to be translated
+ * @param out_c Output buffer
+ * @param max_len Size of the output buffer
+ * @return size_t Number of out controls or 0 if character cannot be translated (or it does not fit to the buffer)
+ */
+size_t compile_letter(char ch, out_control_t *out_c, size_t max_len);
+
+
+/**
+ * @brief Reserves space for items of the whole write in the letter queue, so the write is never accepted only
+ * partially (it waits until the translator frees enough space, without polling)
+ *
+ * @param items Number of items
+ * @param ticks_to_wait Maximum time to wait for the space (portMAX_DELAY to wait until it is freed)
+ * @return true if the space was reserved for the calling task, it must be released by translator_unreserve
+ */
+bool translator_reserve(size_t items, TickType_t ticks_to_wait);
+
+
+/**
+ * @brief Releases the rest of the reservation of the calling task
+ *
+ */
+void translator_unreserve();
+
+
+/**
+ * @brief Checks if the letter queue is empty and the translator does not hold any item (the out control timer can
+ * still play the last letters)
+ *
+ * @return true if there is nothing to translate
+ */
+bool translator_is_idle();
+
+
+/**
+ * @brief Wakes up writers waiting for space in the letter queue (it is called by the translator for every taken item
+ * and after the letter queue is reset)
+ *
+ */
+void translator_space_freed();
+
+
+/**
+ * @brief Passes the item to the letter queue (the item is marked by the current generation of the pipeline), space
+ * reserved for other task is not used
+ *
+ * @param item Item of the letter queue (LETTER_ITEM_SIZE bytes)
+ * @param ticks_to_wait Maximum time to wait for the space in the queue (other writers are blocked meanwhile)
+ * @return true if item was passed to the queue
+ */
+bool queue_letter(const char *item, TickType_t ticks_to_wait);
+
+
+/**
+ * @brief Sends out controls of one letter to the out control queue of the channel of the currently translated item
+ * (letter is not interleaved with other letters), out controls are marked by generation and id of the item
+ * and they are dropped if it is cancelled, it blocks until the whole letter fits to the queue
+ *
+ * @param out_c Out controls
+ * @param len Number of out controls
+ * @return true if all out controls were sent
+ */
+bool send_out_controls(const out_control_t *out_c, size_t len);
+
+
+/**
+ * @brief Sends compiled message (or macro) to the out control queue letter by letter (letters are separated by gaps)
+ *
+ * @param out_c Out controls
+ * @param len Number of out controls
+ */
+void send_compiled(const out_control_t *out_c, size_t len);
+
 #endif
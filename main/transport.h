@@ -0,0 +1,63 @@
+/**
+ * @file transport.h
+ *
+ * @brief Commands that can come from any transport (BLE, UART), so the pipeline does not care where bytes come from
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __TRANSPORT__
+#define __TRANSPORT__
+
+#include <stdint.h>
+
+#include "translator.h"
+
+
+/**
+ * @brief Commands for the receiver (they have the same meaning as writes to BLE characteristics)
+ *
+ */
+enum transport_cmds {
+    LETTER_CMD, //< Letters of the message to be played
+    VOLUME_CMD, //< New volume level (one byte)
+    ABORT_CMD, //< Abort the current message
+    BEEP_CMD, //< Abort the current message and beep until the next command
+    MACRO_CMD, //< Operation with stored message (see macro_ops in macro.h)
+    PITCH_CMD, //< Pitch of the output channel [channel, pitch] (pitch in Hz as little endian 16-bit number)
+};
+
+
+#define MSG_ID_PREFIX 0x02 //< Header of the letter command with id of the message [MSG_ID_PREFIX, id] (id 0 means no id)
+#define MSG_ID_HEADER_LEN 2
+
+#define CHANNEL_PREFIX 0x03 //< Header of the letter command with output channel [CHANNEL_PREFIX, channel, wpm] (wpm 0 keeps the speed of the channel)
+#define CHANNEL_HEADER_LEN 3
+
+#define PACKED_PREFIX 0x04 //< Header of the letter command with compressed text [PACKED_PREFIX] (it must be the last header, see gen_packed.py)
+
+#define LETTER_CAP_PACKED 0x01 //< Capability flag of the receiver (value of the letter characteristic), compressed text is supported
+
+#define ABORT_MESSAGE_OP 0x02 //< Abort command [ABORT_MESSAGE_OP, id] aborts only the message with given id (other values abort everything)
+
+
+/**
+ * @brief State of the stream of commands of one transport (every transport owns one, so transports running in
+ * different tasks do not share it)
+ *
+ */
+typedef struct transport {
+    utf8_decoder_t decoder; //< Decoder of the text (characters can be split between writes of the transport)
+    TickType_t queue_wait; //< Maximum time for which the write waits for space in the letter queue
+} transport_t;
+
+
+/**
+ * @brief Handler of commands that is passed to transports
+ *
+ */
+typedef void (*transport_cmd_handler_t)(transport_t *transport, enum transport_cmds cmd, const uint8_t *value,
+    uint16_t len);
+
+#endif
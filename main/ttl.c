@@ -0,0 +1,132 @@
+/**
+ * @file ttl.c
+ *
+ * @brief Deadlines of messages (time-sensitive message is dropped if it would be played too late)
+ *
+ * Letters with deadline are not stored in the spool (they would be expired after reset anyway), so their out controls
+ * are marked by OUT_ITEM_UNSPOOLED.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "ttl.h"
+#include "esp_timer.h"
+#include "output.h"
+#include "dlog.h"
+
+
+/**
+ * @brief Deadline of one message
+ *
+ */
+typedef struct ttl_slot {
+    int64_t deadline_us; //< The latest time when the letter can start to play
+    uint16_t pending; //< Letters of the message in the letter queue (slot is free if it is 0)
+    uint16_t dropped; //< Already dropped letters of the message
+} ttl_slot_t;
+
+
+static ttl_slot_t slots[TTL_SLOTS + 1]; //< Slot 0 means no deadline
+static portMUX_TYPE ttl_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static ttl_stats_t stats = { 0 };
+
+
+/**
+ * @brief Counts dropped letters and reports them to the client
+ *
+ * @param letters Number of dropped letters
+ */
+static void ttl_report(uint16_t letters) {
+    portENTER_CRITICAL(&ttl_lock);
+    stats.dropped_messages++;
+    stats.dropped_letters += letters;
+    ttl_stats_t cur = stats;
+    portEXIT_CRITICAL(&ttl_lock);
+
+    DLOGW(TTL_TAG, "Expired message dropped (%u letters), dropped %u messages in total", letters, cur.dropped_messages);
+
+    uint8_t value[4] = {
+        cur.dropped_messages & 0xff, cur.dropped_messages >> 8,
+        cur.dropped_letters & 0xff, cur.dropped_letters >> 8,
+    };
+
+    ble_set_char_value(DROPPED_CHAR, value, sizeof(value));
+    ble_notify(DROPPED_CHAR, value, sizeof(value));
+}
+
+
+uint32_t ttl_estimate_start_ms() {
+    return output_backlog_ms() + uxQueueMessagesWaiting(queue) * TTL_AVG_LETTER_TICKS * output_unit_ms();
+}
+
+
+esp_err_t ttl_open(uint32_t ttl_ms, uint16_t letters, uint8_t *slot) {
+    if(ttl_estimate_start_ms() > ttl_ms) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)ttl_ms * 1000;
+
+    portENTER_CRITICAL(&ttl_lock);
+    for(uint8_t i = 1; i <= TTL_SLOTS; i++) {
+        if(!slots[i].pending) {
+            slots[i] = (ttl_slot_t){ .deadline_us = deadline_us, .pending = letters, .dropped = 0 };
+            portEXIT_CRITICAL(&ttl_lock);
+
+            *slot = i;
+            return ESP_OK;
+        }
+    }
+    portEXIT_CRITICAL(&ttl_lock);
+
+    return ESP_ERR_NO_MEM;
+}
+
+
+bool ttl_letter(uint8_t slot, bool drop) {
+    int64_t start_us = esp_timer_get_time() + (int64_t)output_backlog_ms() * 1000;
+    uint16_t report = 0;
+    bool expired = false;
+
+    if(slot == 0 || slot > TTL_SLOTS) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&ttl_lock);
+
+    ttl_slot_t *s = &slots[slot];
+    if(s->pending) { //Slot is released by abort
+        expired = drop || start_us > s->deadline_us;
+        if(expired) {
+            s->dropped++;
+        }
+
+        if(--s->pending == 0) {
+            report = s->dropped;
+        }
+    }
+
+    portEXIT_CRITICAL(&ttl_lock);
+
+    if(report) {
+        ttl_report(report);
+    }
+
+    return expired;
+}
+
+
+void ttl_drop_message(uint16_t letters) {
+    ttl_report(letters);
+}
+
+
+void ttl_abort() {
+    portENTER_CRITICAL(&ttl_lock);
+    for(int i = 0; i <= TTL_SLOTS; i++) {
+        slots[i].pending = 0;
+    }
+    portEXIT_CRITICAL(&ttl_lock);
+}
@@ -0,0 +1,96 @@
+/**
+ * @file ttl.h
+ *
+ * @brief Deadlines of messages (time-sensitive message is dropped if it would be played too late)
+ *
+ * Message with deadline is written with header [TTL_PREFIX, ttl in seconds (LE16)] before the text. Every its letter
+ * carries the slot of the deadline in the second byte of the letter queue item, so translator can drop letters
+ * that would start after the deadline (the start is estimated from the backlog of the output engine).
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __TTL__
+#define __TTL__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "esp_log.h"
+
+#include "translator.h"
+
+
+#define TTL_TAG "TTL" //< Module name
+
+#define MESSAGE_TTL //< Enables deadlines of messages
+
+#define TTL_PREFIX 0x01 //< The first byte of the letter write with deadline (control characters are never played)
+#define TTL_HEADER_LEN 3 //< Prefix and TTL in seconds (LE16)
+
+#define TTL_SLOTS 16 //< Maximum number of messages with deadline in the letter queue
+#define TTL_AVG_LETTER_TICKS 10 //< Estimated duration of one letter in the letter queue (in timer ticks)
+
+#define TTL_ITEM_SLOT(item) ((uint8_t)(item)[MAXIMUM_MESSAGE_LEN]) //< Slot of the deadline (0 if letter has no deadline)
+
+
+/**
+ * @brief Statistics of dropped messages (value of the dropped characteristic)
+ *
+ */
+typedef struct ttl_stats {
+    uint16_t dropped_messages; //< Messages with at least one dropped letter
+    uint16_t dropped_letters; //< All dropped letters
+} ttl_stats_t;
+
+
+/**
+ * @brief Estimates after how long the message accepted now starts to play
+ *
+ * @return uint32_t Estimated delay in ms
+ */
+uint32_t ttl_estimate_start_ms();
+
+
+/**
+ * @brief Reserves slot for the message with deadline
+ *
+ * @param ttl_ms Time to live of the message
+ * @param letters Number of letters of the message
+ * @param slot Output argument, slot of the deadline (it is stored in letter queue items)
+ * @return esp_err_t ESP_OK if slot was reserved, ESP_ERR_TIMEOUT if message would start too late,
+ * ESP_ERR_NO_MEM if there is no free slot
+ */
+esp_err_t ttl_open(uint32_t ttl_ms, uint16_t letters, uint8_t *slot);
+
+
+/**
+ * @brief Processes the letter with deadline (it should be called by translator for every such letter or by producer
+ * if the letter was not passed to the queue)
+ *
+ * @param slot Slot of the deadline
+ * @param drop Letter is dropped anyway (it was not passed to the queue)
+ * @return true if letter is expired and should be dropped
+ */
+bool ttl_letter(uint8_t slot, bool drop);
+
+
+/**
+ * @brief Counts the whole message as dropped (it was expired before it was passed to the queue)
+ *
+ * @param letters Number of letters of the message
+ */
+void ttl_drop_message(uint16_t letters);
+
+
+/**
+ * @brief Releases all slots (when the letter queue is reset)
+ *
+ */
+void ttl_abort();
+
+#endif
@@ -0,0 +1,391 @@
+/**
+ * @file uart_receiver.c
+ *
+ * @brief UART transport with simple line protocol (alternative to BLE, e. g. for driving receivers from PC)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "uart_receiver.h"
+#include <string.h>
+#include "esp_sleep.h"
+
+
+static transport_cmd_handler_t handler = NULL;
+static transport_t uart_transport = { .queue_wait = portMAX_DELAY }; //< State of the stream of commands from UART
+static TaskHandle_t uart_receiver_handle = NULL;
+static QueueHandle_t uart_event_queue = NULL; //< Events of the UART driver (data, overflows)
+
+static uint8_t rx_buffer[UART_REC_LINE_LEN]; //< Bytes read from the driver
+static char line[UART_REC_LINE_LEN + 1]; //< Currently assembled line
+static size_t line_len = 0;
+static bool discarding = false; //< Rest of too long command line is ignored
+static bool continuing = false; //< Rest of too long text line is read (it is neither a command nor headers)
+
+
+/**
+ * @brief Parses the macro command ("store <id> <text>", "play <id>", "delete <id>", "beacon <id> <interval> <count>"
+ * or "beacon off") and passes it to the handler
+ *
+ * @param cmd Macro command without "macro " (null terminated)
+ */
+static void uart_process_macro_cmd(char *cmd) {
+    static uint8_t macro_cmd[UART_REC_LINE_LEN];
+    char *rest;
+    uint8_t op;
+
+    if(!strncmp(cmd, "store ", strlen("store "))) {
+        op = MACRO_STORE_OP;
+        rest = &cmd[strlen("store ")];
+    }
+    else if(!strncmp(cmd, "play ", strlen("play "))) {
+        op = MACRO_PLAY_OP;
+        rest = &cmd[strlen("play ")];
+    }
+    else if(!strncmp(cmd, "delete ", strlen("delete "))) {
+        op = MACRO_DELETE_OP;
+        rest = &cmd[strlen("delete ")];
+    }
+    else if(!strcmp(cmd, "beacon off")) {
+        op = MACRO_BEACON_OP;
+        rest = "255 0 0";
+    }
+    else if(!strncmp(cmd, "beacon ", strlen("beacon "))) {
+        op = MACRO_BEACON_OP;
+        rest = &cmd[strlen("beacon ")];
+    }
+    else {
+        ESP_LOGE(UART_REC_TAG, "Unrecognized macro command!");
+        return;
+    }
+
+    char *end;
+    long id = strtol(rest, &end, 10);
+    if(end == rest || id < 0 || id > 255 || (*end != '\0' && *end != ' ')) {
+        ESP_LOGE(UART_REC_TAG, "Invalid macro id!");
+        return;
+    }
+
+    size_t text_len = 0;
+    if(op == MACRO_STORE_OP && *end == ' ') {
+        text_len = strlen(end + 1);
+        memcpy(&macro_cmd[2], end + 1, text_len);
+    }
+    else if(op == MACRO_BEACON_OP) { //Interval and count are passed as LE16
+        long interval = strtol(end, &end, 10);
+        long count = strtol(end, &end, 10);
+        if(interval < 0 || interval > UINT16_MAX || count < 0 || count > UINT16_MAX || *end != '\0') {
+            ESP_LOGE(UART_REC_TAG, "Invalid beacon parameters!");
+            return;
+        }
+
+        macro_cmd[2] = interval & 0xff;
+        macro_cmd[3] = interval >> 8;
+        macro_cmd[4] = count & 0xff;
+        macro_cmd[5] = count >> 8;
+        text_len = 4;
+    }
+
+    macro_cmd[0] = op;
+    macro_cmd[1] = (uint8_t)id;
+    handler(&uart_transport, MACRO_CMD, macro_cmd, text_len + 2);
+}
+
+
+/**
+ * @brief Parses the command line and passes the command to the handler
+ *
+ * @param cmd Command without prefix (null terminated)
+ */
+static void uart_process_cmd(char *cmd) {
+    if(!strcmp(cmd, "abort")) {
+        handler(&uart_transport, ABORT_CMD, NULL, 0);
+    }
+    else if(!strncmp(cmd, "abort ", strlen("abort "))) { //Abort of one message ("abort <id>")
+        char *end;
+        long id = strtol(&cmd[strlen("abort ")], &end, 10);
+        if(*end != '\0' || id < 1 || id > 255) {
+            ESP_LOGE(UART_REC_TAG, "Invalid message id!");
+            return;
+        }
+
+        uint8_t value[2] = { ABORT_MESSAGE_OP, (uint8_t)id };
+        handler(&uart_transport, ABORT_CMD, value, sizeof(value));
+    }
+    else if(!strncmp(cmd, "msg ", strlen("msg "))) { //Message with id ("msg <id> <text>")
+        static uint8_t id_msg[UART_REC_LINE_LEN + MSG_ID_HEADER_LEN];
+        char *end;
+        long id = strtol(&cmd[strlen("msg ")], &end, 10);
+        if(*end != ' ' || id < 1 || id > 255) {
+            ESP_LOGE(UART_REC_TAG, "Invalid message id!");
+            return;
+        }
+
+        size_t text_len = strlen(end + 1);
+        id_msg[0] = MSG_ID_PREFIX;
+        id_msg[1] = (uint8_t)id;
+        memcpy(&id_msg[MSG_ID_HEADER_LEN], end + 1, text_len);
+
+        handler(&uart_transport, LETTER_CMD, id_msg, text_len + MSG_ID_HEADER_LEN);
+    }
+    else if(!strncmp(cmd, "ch ", strlen("ch "))) { //Message for output channel ("ch <channel> <wpm> <text>", wpm 0 keeps the speed)
+        static uint8_t ch_msg[UART_REC_LINE_LEN + CHANNEL_HEADER_LEN];
+        char *end;
+        long channel = strtol(&cmd[strlen("ch ")], &end, 10);
+        long wpm = strtol(end, &end, 10);
+        if(*end != ' ' || channel < 0 || channel > 255 || wpm < 0 || wpm > 255) {
+            ESP_LOGE(UART_REC_TAG, "Invalid channel parameters!");
+            return;
+        }
+
+        size_t text_len = strlen(end + 1);
+        ch_msg[0] = CHANNEL_PREFIX;
+        ch_msg[1] = (uint8_t)channel;
+        ch_msg[2] = (uint8_t)wpm;
+        memcpy(&ch_msg[CHANNEL_HEADER_LEN], end + 1, text_len);
+
+        handler(&uart_transport, LETTER_CMD, ch_msg, text_len + CHANNEL_HEADER_LEN);
+    }
+    else if(!strcmp(cmd, "beep")) {
+        handler(&uart_transport, BEEP_CMD, NULL, 0);
+    }
+    else if(!strcmp(cmd, "power")) {
+#ifdef POWER_MANAGEMENT
+        power_log();
+#else
+        ESP_LOGE(UART_REC_TAG, "Power management is disabled!");
+#endif
+    }
+    else if(!strcmp(cmd, "stats")) {
+#ifdef MESSAGE_CACHE
+        cache_stats_t cache_stats;
+        cache_get_stats(&cache_stats);
+        ESP_LOGI(UART_REC_TAG, "Cache: hits %lu, misses %lu, evictions %lu, %lu bytes",
+            (unsigned long)cache_stats.hits, (unsigned long)cache_stats.misses,
+            (unsigned long)cache_stats.evictions, (unsigned long)cache_stats.bytes);
+#endif
+#ifdef RUNTIME_STATS
+        stats_log();
+#else
+        ESP_LOGE(UART_REC_TAG, "Runtime statistics are disabled!");
+#endif
+    }
+    else if(!strncmp(cmd, "volume ", strlen("volume "))) {
+        char *end;
+        long volume = strtol(&cmd[strlen("volume ")], &end, 10);
+        if(*end != '\0' || volume < 0 || volume > 255) {
+            ESP_LOGE(UART_REC_TAG, "Invalid volume level!");
+            return;
+        }
+
+        uint8_t value = (uint8_t)volume;
+        handler(&uart_transport, VOLUME_CMD, &value, 1);
+    }
+    else if(!strncmp(cmd, "pitch ", strlen("pitch "))) { //Pitch of output channel ("pitch <channel> <Hz>")
+        char *end;
+        long channel = strtol(&cmd[strlen("pitch ")], &end, 10);
+        long pitch = strtol(end, &end, 10);
+        if(*end != '\0' || channel < 0 || channel > 255 || pitch < 1 || pitch > UINT16_MAX) {
+            ESP_LOGE(UART_REC_TAG, "Invalid pitch parameters!");
+            return;
+        }
+
+        uint8_t value[3] = { (uint8_t)channel, pitch & 0xff, pitch >> 8 };
+        handler(&uart_transport, PITCH_CMD, value, sizeof(value));
+    }
+    else if(!strncmp(cmd, "macro ", strlen("macro "))) {
+        uart_process_macro_cmd(&cmd[strlen("macro ")]);
+    }
+    else if(!strncmp(cmd, "ttl ", strlen("ttl "))) { //Message with deadline ("ttl <seconds> <text>")
+        static uint8_t ttl_msg[UART_REC_LINE_LEN + TTL_HEADER_LEN];
+        char *end;
+        long ttl = strtol(&cmd[strlen("ttl ")], &end, 10);
+        if(*end != ' ' || ttl < 0 || ttl > UINT16_MAX) {
+            ESP_LOGE(UART_REC_TAG, "Invalid TTL!");
+            return;
+        }
+
+        size_t text_len = strlen(end + 1);
+        ttl_msg[0] = TTL_PREFIX;
+        ttl_msg[1] = ttl & 0xff;
+        ttl_msg[2] = ttl >> 8;
+        memcpy(&ttl_msg[TTL_HEADER_LEN], end + 1, text_len);
+
+        handler(&uart_transport, LETTER_CMD, ttl_msg, text_len + TTL_HEADER_LEN);
+    }
+    else {
+        ESP_LOGE(UART_REC_TAG, "Unrecognized command!");
+    }
+}
+
+
+/**
+ * @brief Passes the assembled line (or its part) to the handler
+ *
+ * @param complete true if the line was terminated, false if the buffer is full
+ */
+static void uart_process_line(bool complete) {
+    if(complete && line_len > 0 && line[line_len - 1] == '\r') {
+        line_len--;
+    }
+
+    if(discarding) {
+        discarding = !complete;
+    }
+    else if(continuing) {
+        //Only the start of the line can have headers, control characters cannot be played anyway
+        size_t start = 0;
+        while(start < line_len && (uint8_t)line[start] < ' ') {
+            start++;
+        }
+
+        if(start < line_len) {
+            handler(&uart_transport, LETTER_CMD, (uint8_t *)&line[start], line_len - start);
+        }
+
+        continuing = !complete;
+    }
+    else if(line_len > 0 && line[0] == UART_REC_CMD_PREFIX) {
+        if(complete) {
+            line[line_len] = '\0';
+            uart_process_cmd(&line[1]);
+        }
+        else {
+            ESP_LOGE(UART_REC_TAG, "Too long command!");
+            discarding = true;
+        }
+    }
+    else if(line_len > 0) { //Handler waits until the whole part fits to the letter queue
+        handler(&uart_transport, LETTER_CMD, (uint8_t *)line, line_len);
+        continuing = !complete;
+    }
+
+    line_len = 0;
+}
+
+
+/**
+ * @brief Reads all bytes buffered by the driver and assembles lines
+ *
+ */
+static void uart_read_buffered() {
+    size_t buffered = 0;
+    uart_get_buffered_data_len(UART_REC_PORT, &buffered);
+
+    while(buffered > 0) {
+        int len = uart_read_bytes(UART_REC_PORT, rx_buffer, buffered < sizeof(rx_buffer) ? buffered : sizeof(rx_buffer), 0);
+        if(len <= 0) {
+            break;
+        }
+
+        buffered -= len;
+
+        for(int i = 0; i < len; i++) {
+            if(rx_buffer[i] == '\n') {
+                uart_process_line(true);
+                continue;
+            }
+
+            line[line_len++] = (char)rx_buffer[i];
+            if(line_len == UART_REC_LINE_LEN) {
+                uart_process_line(false);
+            }
+        }
+    }
+}
+
+
+/**
+ * @brief Task that waits for events of the UART driver (it sleeps while nothing is received)
+ *
+ * @param arg
+ */
+static void uart_receive(void *arg) {
+    uart_event_t event;
+
+    while(1) {
+        if(xQueueReceive(uart_event_queue, &event, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        switch(event.type)
+        {
+        case UART_DATA: //Driver sends it when RX FIFO is full or the line is idle for a while (RX timeout)
+            uart_read_buffered();
+            break;
+
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL: //Bytes were lost, so the current line is broken
+            ESP_LOGE(UART_REC_TAG, "RX overflow, input was flushed!");
+
+            uart_flush_input(UART_REC_PORT);
+            xQueueReset(uart_event_queue);
+
+            line_len = 0;
+            discarding = true; //Rest of the broken line is not interpreted
+            continuing = false;
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+
+esp_err_t uart_receiver_init(transport_cmd_handler_t cmd_handler) {
+    esp_err_t err;
+
+    handler = cmd_handler;
+
+    uart_config_t uart_config = {
+        .baud_rate = UART_REC_BAUD,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+#ifdef POWER_MANAGEMENT
+        .source_clk = UART_SCLK_REF_TICK, //Baud rate does not change with APB frequency
+#else
+        .source_clk = UART_SCLK_DEFAULT,
+#endif
+    };
+
+    err = uart_driver_install(UART_REC_PORT, UART_REC_RX_BUF_LEN, 0, UART_REC_EVENT_QUEUE_LEN, &uart_event_queue, 0);
+    if(err != ESP_OK) {
+        ESP_LOGE(UART_REC_TAG, "uart_driver_install failed!");
+        return err;
+    }
+
+    err = uart_param_config(UART_REC_PORT, &uart_config);
+    if(err != ESP_OK) {
+        ESP_LOGE(UART_REC_TAG, "uart_param_config failed!");
+        return err;
+    }
+
+    err = uart_set_pin(UART_REC_PORT, UART_REC_TX_GPIO, UART_REC_RX_GPIO, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    if(err != ESP_OK) {
+        ESP_LOGE(UART_REC_TAG, "uart_set_pin failed!");
+        return err;
+    }
+
+#ifdef POWER_MANAGEMENT
+    //RX wakes up the chip from light sleep (characters, that woke it up, are lost)
+    err = uart_set_wakeup_threshold(UART_REC_PORT, UART_REC_WAKEUP_THRESHOLD);
+    if(err != ESP_OK) {
+        ESP_LOGE(UART_REC_TAG, "uart_set_wakeup_threshold failed!");
+        return err;
+    }
+
+    err = esp_sleep_enable_uart_wakeup(UART_REC_PORT);
+    if(err != ESP_OK) {
+        ESP_LOGE(UART_REC_TAG, "esp_sleep_enable_uart_wakeup failed!");
+        return err;
+    }
+#endif
+
+    xTaskCreatePinnedToCore(uart_receive, "uart_receiver", 3072, NULL, 5, &uart_receiver_handle, 0);
+
+    return ESP_OK;
+}
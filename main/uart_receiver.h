@@ -0,0 +1,63 @@
+/**
+ * @file uart_receiver.h
+ *
+ * @brief UART transport with simple line protocol (alternative to BLE, e. g. for driving receivers from PC)
+ *
+ * Every line (terminated by \n) is a message, lines starting with '!' are commands:
+ * "!abort", "!beep", "!volume <0-255>" and "!macro store <id> <text>", "!macro play <id>", "!macro delete <id>",
+ * "!stats" logs runtime statistics of tasks and "!power" time spent in power modes.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __UART_RECEIVER__
+#define __UART_RECEIVER__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "driver/uart.h"
+
+#include "transport.h"
+#include "translator.h"
+#include "macro.h"
+#include "ttl.h"
+#include "stats.h"
+#include "cache.h"
+#include "power.h"
+
+
+#define UART_REC_TAG "UART_REC" //< Module name
+
+#define UART_RECEIVER //< Enables UART transport
+
+//UART0 is the console (it is available also in QEMU), use UART1 and its pins for high baud rates without logs
+#define UART_REC_PORT UART_NUM_0
+#define UART_REC_BAUD 115200
+#define UART_REC_TX_GPIO UART_PIN_NO_CHANGE
+#define UART_REC_RX_GPIO UART_PIN_NO_CHANGE
+
+#define UART_REC_RX_BUF_LEN 4096 //< Size of RX ring buffer of the driver (filled by UART ISR from HW FIFO)
+#define UART_REC_LINE_LEN 256 //< Longer lines are passed to the pipeline in more parts
+#define UART_REC_EVENT_QUEUE_LEN 16 //< Length of the queue with events of the UART driver
+
+#define UART_REC_WAKEUP_THRESHOLD 3 //< Edges on RX, that wake up the chip from light sleep (with power management)
+
+#define UART_REC_CMD_PREFIX '!' //< Lines starting with this character are commands (it cannot be translated anyway)
+
+
+/**
+ * @brief Installs UART driver and starts the task that reads lines and passes them to the handler
+ *
+ * @param cmd_handler Handler of commands
+ * @return esp_err_t ESP_OK if everything went OK
+ */
+esp_err_t uart_receiver_init(transport_cmd_handler_t cmd_handler);
+
+#endif
@@ -1,3 +1,3 @@
 #!/usr/bin/bash
 
-zip xdvora3o.zip sdkconfig.defaults README.md CMakeLists.txt transmitter/* main/* doc/* doc.pdf
+zip xdvora3o.zip sdkconfig.defaults sdkconfig.nimble README.md CMakeLists.txt gen_charset.py gen_packed.py transmitter/* main/* doc/* doc.pdf
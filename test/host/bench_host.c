@@ -0,0 +1,55 @@
+/**
+ * @file bench_host.c
+ *
+ * @brief Runs the timing benchmark of the output engine (TIMING_BENCH) on the host
+ *
+ * The firmware is started by app_main and both phases of the benchmark are played in virtual time, so reports
+ * ("BENCH_REPORT {...}" lines) are printed in a few seconds. Output timer ticks exactly in virtual time, so every
+ * deviation is caused by the output engine itself (e. g. by rounding of the dot to ticks or by dropped out controls),
+ * not by interrupt latency. The write storm of the load phase runs, CPU hogs do not (BENCH_HOG_CORES is 0).
+ *
+ * Usage: bench_host
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include "host.h"
+#include "bench.h"
+
+
+#define HARNESS_PHASE_NUM 2 //< Phases of the benchmark (idle and load)
+#define HARNESS_MARGIN_MS 1000 //< Time after the last phase (its report is printed after the abort)
+
+
+void app_main(void);
+
+
+/**
+ * @brief Task, that runs app_main (initialization blocks on semaphores)
+ *
+ */
+static void harness_app_main(void *arg) {
+    app_main();
+}
+
+
+int main() {
+    TaskHandle_t task;
+
+    xTaskCreatePinnedToCore(harness_app_main, "main", 4096, NULL, 1, &task, 0);
+    host_run_until(host_now_us() + 1000000);
+    if(!host_task_finished(task)) {
+        host_fatal("app_main did not finish!");
+    }
+
+    //Audio decoder is not measured, idle input would only slow down the scheduler
+    TaskHandle_t decoder = host_task_find("decoder");
+    if(decoder) {
+        vTaskDelete(decoder);
+    }
+
+    host_run_until(host_now_us() + (uint64_t)(HARNESS_PHASE_NUM * BENCH_PHASE_MS + HARNESS_MARGIN_MS) * 1000);
+
+    return 0;
+}
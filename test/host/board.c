@@ -0,0 +1,147 @@
+/**
+ * @file board.c
+ *
+ * @brief Modules, that are not built for the host (BLE stack, keyer, beacon, UART transport, deferred log and
+ * statistics), they are replaced by stubs, that only pass data to the harness
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include <stdarg.h>
+
+#include "host.h"
+#include "dlog.h"
+#include "stats.h"
+#include "keyer.h"
+#include "beacon.h"
+#include "uart_receiver.h"
+
+
+uint16_t morse_code_char_handle_tab[MORSE_CODE_REC_CHAR_NUM];
+
+static void (*write_handler)(ble_write_evt_t *) = NULL;
+static host_notify_cb_t notify_cb = NULL;
+static transport_cmd_handler_t uart_handler = NULL;
+static transport_t uart_transport = { .queue_wait = portMAX_DELAY }; //< As in uart_receiver.c
+static bool dlog_enabled = false;
+
+
+esp_err_t bluetooth_init(void (*write_event_handler_func)(ble_write_evt_t *), void (*add_char_cb_func)(uint16_t)) {
+    write_handler = write_event_handler_func;
+
+    //Handles are assigned as by the GATT database (value handle follows the declaration of the characteristic)
+    for(int i = 0; i < MORSE_CODE_REC_CHAR_NUM; i++) {
+        morse_code_char_handle_tab[i] = 42 + 2 * i;
+    }
+
+    for(int i = 0; i < MORSE_CODE_REC_CHAR_NUM; i++) {
+        add_char_cb_func(morse_code_char_handle_tab[i]);
+    }
+
+    return ESP_OK;
+}
+
+
+esp_err_t ble_set_char_value(enum morse_code_rec_chars char_idx, const uint8_t *value, uint16_t len) {
+    return char_idx < MORSE_CODE_REC_CHAR_NUM ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+
+esp_err_t ble_notify(enum morse_code_rec_chars char_idx, const uint8_t *value, uint16_t len) {
+    if(char_idx >= MORSE_CODE_REC_CHAR_NUM) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if(notify_cb) {
+        notify_cb(char_idx, value, len);
+    }
+
+    return ESP_OK;
+}
+
+
+void host_ble_observe(host_notify_cb_t cb) {
+    notify_cb = cb;
+}
+
+
+void host_ble_write(enum morse_code_rec_chars char_idx, const uint8_t *value, uint16_t len) {
+    if(!write_handler) {
+        host_fatal("Bluetooth is not initialized!");
+    }
+
+    ble_write_evt_t evt = { .handle = morse_code_char_handle_tab[char_idx], .len = len, .value = value };
+    write_handler(&evt);
+}
+
+
+esp_err_t keyer_init() {
+    return ESP_OK;
+}
+
+
+esp_err_t beacon_configure(uint8_t macro_id, uint16_t interval_s, uint16_t count) {
+    return ESP_OK;
+}
+
+
+void beacon_macro_deleted(uint8_t macro_id) {
+}
+
+
+esp_err_t beacon_init(nvs_handle_t nvs, bool (*push)(const char *)) {
+    return ESP_OK;
+}
+
+
+esp_err_t uart_receiver_init(transport_cmd_handler_t cmd_handler) {
+    uart_handler = cmd_handler;
+
+    return ESP_OK;
+}
+
+
+void host_uart_command(enum transport_cmds cmd, const uint8_t *value, uint16_t len) {
+    if(!uart_handler) {
+        host_fatal("UART receiver is not initialized!");
+    }
+
+    uart_handler(&uart_transport, cmd, value, len);
+}
+
+
+void stats_count(enum stats_counters counter) {
+}
+
+
+esp_err_t dlog_init() {
+    dlog_enabled = getenv("HOST_DLOG") != NULL;
+
+    return ESP_OK;
+}
+
+
+void dlog_write(dlog_site_t *site, esp_log_level_t level, const char *tag, const char *format, unsigned argc, ...) {
+    uint32_t args[DLOG_MAX_ARGS] = { 0 };
+    va_list list;
+
+    if(argc > DLOG_MAX_ARGS) {
+        host_fatal("Too many arguments of the deferred log (%s)!", format);
+    }
+
+    //Arguments are read as the deferred log reads them (they must not be wider than 32 bits)
+    va_start(list, argc);
+    for(unsigned i = 0; i < argc; i++) {
+        args[i] = va_arg(list, uint32_t);
+    }
+    va_end(list);
+
+    if(!dlog_enabled) {
+        return;
+    }
+
+    fprintf(stderr, "%c (%s) ", "NEWIDV"[level], tag);
+    fprintf(stderr, format, args[0], args[1], args[2], args[3]);
+    fprintf(stderr, "\n");
+}
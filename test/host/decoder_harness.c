@@ -0,0 +1,316 @@
+/**
+ * @file decoder_harness.c
+ *
+ * @brief Harness of the audio decoder, it feeds the WAV file through the Goertzel filter, the tone detector
+ * and the timing decoder and reports the accuracy of decoding and the CPU time
+ *
+ * Usage: decoder_harness <file.wav> <expected text> [minimal accuracy in %]
+ *
+ * The file is resampled to DECODER_SAMPLE_FREQ and scaled to the range of ADC, so blocks and thresholds are the same
+ * as on ESP32. Cycles are counted by the timestamp counter of the host, so they are comparable only between runs on
+ * the same machine (the decoder prints cycles of ESP32 every DECODER_STATS_PERIOD_S).
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "host.h"
+#include "decoder.c" //Static functions of the decoder are driven directly
+
+
+#define HARNESS_ADC_MID 2048 //< Middle of the range of 12-bit ADC (silence)
+#define HARNESS_ADC_AMPLITUDE 1500 //< Full scale of the WAV file in ADC units (about 1 V peak at 12 dB attenuation)
+#define HARNESS_TAIL_S 2 //< Silence after the file, so the last letter and word are finished
+#define HARNESS_MAX_TEXT 1024 //< Maximum length of the decoded text
+
+
+static char decoded[HARNESS_MAX_TEXT];
+static size_t decoded_len = 0;
+
+
+/**
+ * @brief Collects decoded characters
+ *
+ */
+static void harness_notify(enum morse_code_rec_chars char_idx, const uint8_t *value, uint16_t len) {
+    if(char_idx != DECODED_CHAR) {
+        return;
+    }
+
+    for(uint16_t i = 0; i < len && decoded_len < HARNESS_MAX_TEXT - 1; i++) {
+        decoded[decoded_len++] = (char)value[i];
+    }
+}
+
+
+/**
+ * @brief Reads little endian integer from the buffer
+ *
+ */
+static uint32_t harness_le(const uint8_t *p, int bytes) {
+    uint32_t value = 0;
+    for(int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+
+    return value;
+}
+
+
+/**
+ * @brief Loads PCM WAV file (8-bit unsigned or 16-bit signed, only the first channel is used)
+ *
+ * @param path Path to the file
+ * @param rate Output argument, sample rate of the file
+ * @param len Output argument, number of samples
+ * @return float* Samples in range -1..1 (allocated) or NULL if the file is not valid
+ */
+static float *harness_load_wav(const char *path, uint32_t *rate, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if(!f) {
+        fprintf(stderr, "Unable to open %s!\n", path);
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t *data = malloc(size > 0 ? size : 1);
+    bool ok = size >= 12 && data && fread(data, 1, size, f) == (size_t)size;
+    fclose(f);
+
+    if(!ok || memcmp(data, "RIFF", 4) || memcmp(data + 8, "WAVE", 4)) {
+        fprintf(stderr, "%s is not a WAV file!\n", path);
+        free(data);
+        return NULL;
+    }
+
+    uint16_t channels = 0, bits = 0;
+    const uint8_t *pcm = NULL;
+    size_t pcm_len = 0;
+
+    for(long pos = 12; pos + 8 <= size;) { //Chunks
+        uint32_t chunk_len = harness_le(data + pos + 4, 4);
+        const uint8_t *chunk = data + pos + 8;
+
+        if(chunk_len > (uint64_t)(size - pos - 8)) {
+            chunk_len = size - pos - 8;
+        }
+
+        if(!memcmp(data + pos, "fmt ", 4) && chunk_len >= 16) {
+            if(harness_le(chunk, 2) != 1) {
+                fprintf(stderr, "%s is not PCM!\n", path);
+                free(data);
+                return NULL;
+            }
+
+            channels = harness_le(chunk + 2, 2);
+            *rate = harness_le(chunk + 4, 4);
+            bits = harness_le(chunk + 14, 2);
+        }
+        else if(!memcmp(data + pos, "data", 4)) {
+            pcm = chunk;
+            pcm_len = chunk_len;
+        }
+
+        pos += 8 + chunk_len + (chunk_len & 1);
+    }
+
+    if(!pcm || !channels || !*rate || (bits != 8 && bits != 16)) {
+        fprintf(stderr, "%s has unsupported format (8-bit or 16-bit PCM is expected)!\n", path);
+        free(data);
+        return NULL;
+    }
+
+    size_t stride = channels * bits / 8;
+    *len = pcm_len / stride;
+
+    float *samples = malloc((*len ? *len : 1) * sizeof(float));
+    for(size_t i = 0; samples && i < *len; i++) {
+        const uint8_t *p = pcm + i * stride;
+        samples[i] = bits == 8 ? (p[0] - 128) / 128.0f : (int16_t)harness_le(p, 2) / 32768.0f;
+    }
+
+    free(data);
+    return samples;
+}
+
+
+/**
+ * @brief Resamples the audio to the sample rate of the decoder and converts it to raw samples of ADC
+ *
+ * @param in Samples in range -1..1
+ * @param in_len Number of input samples
+ * @param rate Sample rate of the input
+ * @param out_len Output argument, number of raw samples (including the silence after the file)
+ * @return uint16_t* Raw samples (allocated)
+ */
+static uint16_t *harness_to_adc(const float *in, size_t in_len, uint32_t rate, size_t *out_len) {
+    size_t len = (size_t)((uint64_t)in_len * DECODER_SAMPLE_FREQ / rate);
+    *out_len = len + HARNESS_TAIL_S * DECODER_SAMPLE_FREQ;
+
+    uint16_t *out = malloc(*out_len * sizeof(uint16_t));
+    if(!out) {
+        return NULL;
+    }
+
+    for(size_t i = 0; i < *out_len; i++) {
+        float value = 0.0f;
+
+        if(i < len) { //Linear interpolation
+            double pos = (double)i * rate / DECODER_SAMPLE_FREQ;
+            size_t idx = (size_t)pos;
+            float frac = (float)(pos - idx);
+            value = in[idx] * (1.0f - frac) + (idx + 1 < in_len ? in[idx + 1] : 0.0f) * frac;
+        }
+
+        int32_t raw = HARNESS_ADC_MID + (int32_t)lrintf(value * HARNESS_ADC_AMPLITUDE);
+        out[i] = raw < 0 ? 0 : raw > 4095 ? 4095 : raw;
+    }
+
+    return out;
+}
+
+
+/**
+ * @brief Normalizes the text for comparison (upper case, single spaces, without leading and trailing spaces)
+ *
+ */
+static size_t harness_normalize(const char *in, char *out, size_t size) {
+    size_t len = 0;
+
+    for(; *in && len < size - 1; in++) {
+        if(isspace((unsigned char)*in)) {
+            if(len && out[len - 1] != ' ') {
+                out[len++] = ' ';
+            }
+        }
+        else {
+            out[len++] = toupper((unsigned char)*in);
+        }
+    }
+
+    if(len && out[len - 1] == ' ') {
+        len--;
+    }
+
+    out[len] = '\0';
+    return len;
+}
+
+
+/**
+ * @brief Computes edit distance (Levenshtein) of two strings
+ *
+ */
+static size_t harness_distance(const char *a, size_t a_len, const char *b, size_t b_len) {
+    size_t *row = malloc((b_len + 1) * sizeof(size_t));
+
+    for(size_t j = 0; j <= b_len; j++) {
+        row[j] = j;
+    }
+
+    for(size_t i = 1; i <= a_len; i++) {
+        size_t diag = row[0];
+        row[0] = i;
+
+        for(size_t j = 1; j <= b_len; j++) {
+            size_t up = row[j];
+            size_t best = diag + (a[i - 1] != b[j - 1]);
+
+            if(up + 1 < best) {
+                best = up + 1;
+            }
+
+            if(row[j - 1] + 1 < best) {
+                best = row[j - 1] + 1;
+            }
+
+            row[j] = best;
+            diag = up;
+        }
+    }
+
+    size_t distance = row[b_len];
+    free(row);
+
+    return distance;
+}
+
+
+int main(int argc, char **argv) {
+    if(argc < 3) {
+        fprintf(stderr, "Usage: %s <file.wav> <expected text> [minimal accuracy in %%]\n", argv[0]);
+        return 2;
+    }
+
+    double min_accuracy = argc > 3 ? atof(argv[3]) : 0.0;
+
+    uint32_t rate = 0;
+    size_t wav_len = 0;
+    float *wav = harness_load_wav(argv[1], &rate, &wav_len);
+    if(!wav) {
+        return 2;
+    }
+
+    size_t len = 0;
+    uint16_t *samples = harness_to_adc(wav, wav_len, rate, &len);
+    free(wav);
+    if(!samples) {
+        return 2;
+    }
+
+    host_ble_observe(harness_notify);
+
+    ESP_ERROR_CHECK(translator_init()); //Morse code tree
+    ESP_ERROR_CHECK(decoder_init()); //Decoder task is created, but it is never run (samples are passed directly)
+
+    struct timespec wall_start, wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+    uint64_t cycles = 0;
+
+    for(size_t i = 0; i < len; i += DECODER_FRAME_LEN) { //Frames are processed as they come from ADC
+        size_t end = i + DECODER_FRAME_LEN < len ? i + DECODER_FRAME_LEN : len;
+        uint32_t power;
+
+        uint32_t start = esp_cpu_get_cycle_count();
+        for(size_t j = i; j < end; j++) {
+            if(goertzel_sample(&goertzel, samples[j], &power)) {
+                timing_block(&timing, goertzel_detect(&goertzel, power, timing.key_down));
+            }
+        }
+        cycles += esp_cpu_get_cycle_count() - start;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    free(samples);
+
+    char expected[HARNESS_MAX_TEXT], result[HARNESS_MAX_TEXT];
+    size_t expected_len = harness_normalize(argv[2], expected, sizeof(expected));
+    size_t result_len = harness_normalize(decoded, result, sizeof(result));
+
+    size_t errors = harness_distance(expected, expected_len, result, result_len);
+    double accuracy = errors >= expected_len ? 0.0 : 100.0 * (expected_len - errors) / (expected_len ? expected_len : 1);
+
+    double audio_s = (double)len / DECODER_SAMPLE_FREQ;
+    double wall_ns = (wall_end.tv_sec - wall_start.tv_sec) * 1e9 + (wall_end.tv_nsec - wall_start.tv_nsec);
+
+    printf("%s: %.1f s of audio (%u Hz), speed estimation %lu WPM\n",
+        argv[1], audio_s, (unsigned)rate, (unsigned long)(1200000 / timing.dot_us));
+    printf("expected: \"%s\"\n", expected);
+    printf("decoded:  \"%s\"\n", result);
+    printf("accuracy %.1f %% (%zu errors in %zu characters), %.0f cycles and %.0f ns per second of audio\n",
+        accuracy, errors, expected_len, cycles / audio_s, wall_ns / audio_s);
+
+    if(accuracy < min_accuracy) {
+        printf("FAILED: accuracy is lower than %.1f %%\n", min_accuracy);
+        return 1;
+    }
+
+    return 0;
+}
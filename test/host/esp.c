@@ -0,0 +1,642 @@
+/**
+ * @file esp.c
+ *
+ * @brief Drivers of ESP-IDF for the host build (timers fire alarms in the virtual time, outputs are reported
+ * to the harness, NVS is kept in memory and ADC returns samples fed by the harness)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "host.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_ipc.h"
+#include "nvs_flash.h"
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "driver/timer.h"
+#include "esp_adc/adc_continuous.h"
+
+
+#define HOST_NVS_NAMESPACES 8 //< Maximum number of opened namespaces
+#define HOST_NVS_ENTRIES 256 //< Maximum number of stored keys
+
+#define HOST_ADC_IDLE 2048 //< Sample returned by ADC after the fed samples (the middle of the range)
+
+
+/**
+ * @brief State of the hardware timer
+ *
+ */
+typedef struct host_timer {
+    bool running;
+    bool alarm_en;
+    bool auto_reload;
+    uint32_t divider;
+    uint64_t base; //< Value of the counter at start_us
+    uint64_t start_us; //< Time, when the counter was started (or set)
+    uint64_t alarm;
+    timer_isr_t isr;
+    void *arg;
+} host_timer_t;
+
+
+/**
+ * @brief Entry of NVS
+ *
+ */
+typedef struct host_nvs_entry {
+    nvs_handle_t handle; //< Namespace
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    char type; //< 'b' for u8, 'w' for u32 and 'B' for blob
+    uint8_t *data;
+    size_t len;
+} host_nvs_entry_t;
+
+
+static host_timer_t timers[TIMER_GROUP_MAX][TIMER_MAX];
+
+static host_gpio_cb_t gpio_cb = NULL;
+static bool gpio_levels[GPIO_NUM_MAX];
+static int ledc_gpios[LEDC_CHANNEL_MAX];
+static bool ledc_running[LEDC_CHANNEL_MAX];
+
+static char nvs_namespaces[HOST_NVS_NAMESPACES][NVS_KEY_NAME_MAX_SIZE];
+static host_nvs_entry_t nvs_entries[HOST_NVS_ENTRIES];
+
+static const uint16_t *adc_samples = NULL;
+static size_t adc_len = 0;
+static uint64_t adc_read = 0; //< Number of samples read since the start of ADC
+static uint64_t adc_start_us = 0;
+static uint32_t adc_freq = 0;
+static bool adc_started = false;
+
+
+void host_error_check_failed(esp_err_t rc, const char *file, int line, const char *expression) {
+    host_fatal("ESP_ERROR_CHECK failed: 0x%x at %s:%d (%s)", rc, file, line, expression);
+}
+
+
+int64_t esp_timer_get_time(void) {
+    return (int64_t)host_now_us();
+}
+
+
+uint32_t esp_cpu_get_cycle_count(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__rdtsc(); //Time stamp counter of the host (it counts at the nominal frequency)
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec); //Nanoseconds, when there is no cycle counter
+#endif
+}
+
+
+esp_err_t esp_ipc_call_blocking(uint32_t cpu_id, esp_ipc_func_t func, void *arg) {
+    func(arg);
+
+    return ESP_OK;
+}
+
+
+/**
+ * @brief Returns the value of the counter of the timer at the time
+ *
+ * @param t Timer
+ * @param time_us Time
+ * @return uint64_t Value of the counter
+ */
+static uint64_t host_timer_value(const host_timer_t *t, uint64_t time_us) {
+    if(!t->running) {
+        return t->base;
+    }
+
+    return t->base + (time_us - t->start_us) * (TIMER_BASE_CLK / 1000000) / t->divider;
+}
+
+
+/**
+ * @brief Returns the time of the alarm of the timer
+ *
+ * @param t Timer
+ * @return uint64_t Time in microseconds or HOST_NEVER
+ */
+static uint64_t host_timer_alarm_us(const host_timer_t *t) {
+    if(!t->running || !t->alarm_en || !t->isr || t->alarm < t->base) {
+        return HOST_NEVER;
+    }
+
+    uint64_t ticks_per_us = (TIMER_BASE_CLK / 1000000) / t->divider;
+
+    return t->start_us + (t->alarm - t->base + ticks_per_us - 1) / ticks_per_us;
+}
+
+
+uint64_t host_timer_next_us() {
+    uint64_t next = HOST_NEVER;
+
+    for(int g = 0; g < TIMER_GROUP_MAX; g++) {
+        for(int i = 0; i < TIMER_MAX; i++) {
+            uint64_t alarm_us = host_timer_alarm_us(&timers[g][i]);
+            if(alarm_us < next) {
+                next = alarm_us;
+            }
+        }
+    }
+
+    return next;
+}
+
+
+void host_timer_fire(uint64_t now_us) {
+    for(int g = 0; g < TIMER_GROUP_MAX; g++) {
+        for(int i = 0; i < TIMER_MAX; i++) {
+            host_timer_t *t = &timers[g][i];
+            if(host_timer_alarm_us(t) > now_us) {
+                continue;
+            }
+
+            if(t->auto_reload) { //Counter starts again from zero
+                t->base = 0;
+                t->start_us = now_us;
+            }
+            else { //Alarm must be enabled again by the ISR
+                t->alarm_en = false;
+            }
+
+            t->isr(t->arg);
+        }
+    }
+}
+
+
+esp_err_t timer_init(timer_group_t group_num, timer_idx_t timer_num, const timer_config_t *config) {
+    host_timer_t *t = &timers[group_num][timer_num];
+
+    if(config->divider < 2 || (TIMER_BASE_CLK / 1000000) % config->divider) {
+        return ESP_ERR_NOT_SUPPORTED; //Only dividers, that give whole ticks per microsecond, are simulated
+    }
+
+    *t = (host_timer_t){
+        .running = config->counter_en == TIMER_START,
+        .alarm_en = config->alarm_en == TIMER_ALARM_EN,
+        .auto_reload = config->auto_reload,
+        .divider = config->divider,
+        .start_us = host_now_us(),
+    };
+
+    return ESP_OK;
+}
+
+
+esp_err_t timer_set_counter_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t load_val) {
+    timers[group_num][timer_num].base = load_val;
+    timers[group_num][timer_num].start_us = host_now_us();
+
+    return ESP_OK;
+}
+
+
+esp_err_t timer_set_alarm_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t alarm_value) {
+    timers[group_num][timer_num].alarm = alarm_value;
+
+    return ESP_OK;
+}
+
+
+esp_err_t timer_enable_intr(timer_group_t group_num, timer_idx_t timer_num) {
+    return ESP_OK;
+}
+
+
+esp_err_t timer_isr_callback_add(timer_group_t group_num, timer_idx_t timer_num, timer_isr_t isr_handler, void *arg,
+    int intr_alloc_flags) {
+
+    timers[group_num][timer_num].isr = isr_handler;
+    timers[group_num][timer_num].arg = arg;
+
+    return ESP_OK;
+}
+
+
+esp_err_t timer_start(timer_group_t group_num, timer_idx_t timer_num) {
+    host_timer_t *t = &timers[group_num][timer_num];
+
+    if(!t->running) {
+        t->running = true;
+        t->start_us = host_now_us();
+    }
+
+    return ESP_OK;
+}
+
+
+esp_err_t timer_pause(timer_group_t group_num, timer_idx_t timer_num) {
+    host_timer_t *t = &timers[group_num][timer_num];
+
+    t->base = host_timer_value(t, host_now_us());
+    t->running = false;
+
+    return ESP_OK;
+}
+
+
+uint64_t timer_group_get_counter_value_in_isr(timer_group_t group_num, timer_idx_t timer_num) {
+    return host_timer_value(&timers[group_num][timer_num], host_now_us());
+}
+
+
+void timer_group_set_alarm_value_in_isr(timer_group_t group_num, timer_idx_t timer_num, uint64_t alarm_val) {
+    timers[group_num][timer_num].alarm = alarm_val;
+}
+
+
+void timer_group_enable_alarm_in_isr(timer_group_t group_num, timer_idx_t timer_num) {
+    timers[group_num][timer_num].alarm_en = true;
+}
+
+
+void timer_group_set_counter_enable_in_isr(timer_group_t group_num, timer_idx_t timer_num, timer_start_t counter_en) {
+    if(counter_en == TIMER_START) {
+        timer_start(group_num, timer_num);
+    }
+    else {
+        timer_pause(group_num, timer_num);
+    }
+}
+
+
+void host_gpio_observe(host_gpio_cb_t cb) {
+    gpio_cb = cb;
+}
+
+
+/**
+ * @brief Changes the level of the output and reports the change
+ *
+ * @param gpio_num GPIO
+ * @param level New level
+ */
+static void host_gpio_level(int gpio_num, bool level) {
+    if(gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        host_fatal("Invalid GPIO %d!", gpio_num);
+    }
+
+    if(gpio_levels[gpio_num] == level) {
+        return;
+    }
+
+    gpio_levels[gpio_num] = level;
+    if(gpio_cb) {
+        gpio_cb(gpio_num, level);
+    }
+}
+
+
+esp_err_t gpio_config(const gpio_config_t *config) {
+    return ESP_OK;
+}
+
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode) {
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    host_gpio_level(gpio_num, level != 0);
+
+    return ESP_OK;
+}
+
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    return gpio_levels[gpio_num];
+}
+
+
+void esp_rom_gpio_pad_select_gpio(uint32_t gpio_num) {
+}
+
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *timer_conf) {
+    return ESP_OK;
+}
+
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t *ledc_conf) {
+    if(ledc_conf->channel >= LEDC_CHANNEL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ledc_gpios[ledc_conf->channel] = ledc_conf->gpio_num;
+
+    return ESP_OK;
+}
+
+
+esp_err_t ledc_set_duty(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty) {
+    return channel < LEDC_CHANNEL_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+
+esp_err_t ledc_update_duty(ledc_mode_t speed_mode, ledc_channel_t channel) {
+    if(channel >= LEDC_CHANNEL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    //Running channel is reported as the high level (regardless of the duty, so the keying is visible at any volume)
+    ledc_running[channel] = true;
+    host_gpio_level(ledc_gpios[channel], true);
+
+    return ESP_OK;
+}
+
+
+esp_err_t ledc_stop(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t idle_level) {
+    if(channel >= LEDC_CHANNEL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ledc_running[channel] = false;
+    host_gpio_level(ledc_gpios[channel], idle_level != 0);
+
+    return ESP_OK;
+}
+
+
+esp_err_t ledc_set_freq(ledc_mode_t speed_mode, ledc_timer_t timer_num, uint32_t freq_hz) {
+    if(timer_num >= LEDC_TIMER_MAX || freq_hz < 1 || freq_hz > 40000000 / 8192) { //13-bit duty needs 8192 clocks per period
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+
+esp_err_t nvs_flash_init(void) {
+    return ESP_OK;
+}
+
+
+esp_err_t nvs_flash_erase(void) {
+    for(int i = 0; i < HOST_NVS_ENTRIES; i++) {
+        free(nvs_entries[i].data);
+    }
+
+    memset(nvs_entries, 0, sizeof(nvs_entries));
+
+    return ESP_OK;
+}
+
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+    if(strlen(namespace_name) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for(int i = 0; i < HOST_NVS_NAMESPACES; i++) {
+        if(!nvs_namespaces[i][0]) {
+            strcpy(nvs_namespaces[i], namespace_name);
+        }
+
+        if(!strcmp(nvs_namespaces[i], namespace_name)) {
+            *out_handle = i + 1;
+            return ESP_OK;
+        }
+    }
+
+    return ESP_ERR_NO_MEM;
+}
+
+
+void nvs_close(nvs_handle_t handle) {
+}
+
+
+/**
+ * @brief Finds the entry of the key
+ *
+ * @param handle Namespace
+ * @param key Key
+ * @param create true if the free entry should be returned when the key does not exist
+ * @return host_nvs_entry_t* Entry or NULL
+ */
+static host_nvs_entry_t *host_nvs_find(nvs_handle_t handle, const char *key, bool create) {
+    host_nvs_entry_t *free_entry = NULL;
+
+    if(!handle || handle > HOST_NVS_NAMESPACES || strlen(key) >= NVS_KEY_NAME_MAX_SIZE) {
+        host_fatal("Invalid NVS handle or key!");
+    }
+
+    for(int i = 0; i < HOST_NVS_ENTRIES; i++) {
+        host_nvs_entry_t *e = &nvs_entries[i];
+        if(!e->handle) {
+            free_entry = free_entry ? free_entry : e;
+        }
+        else if(e->handle == handle && !strcmp(e->key, key)) {
+            return e;
+        }
+    }
+
+    if(!create) {
+        return NULL;
+    }
+
+    if(!free_entry) {
+        host_fatal("NVS is full!");
+    }
+
+    free_entry->handle = handle;
+    strcpy(free_entry->key, key);
+
+    return free_entry;
+}
+
+
+/**
+ * @brief Stores the value of the key
+ *
+ * @param handle Namespace
+ * @param key Key
+ * @param type Type of the value
+ * @param value Value
+ * @param len Length of the value
+ * @return esp_err_t ESP_OK if value was stored
+ */
+static esp_err_t host_nvs_set(nvs_handle_t handle, const char *key, char type, const void *value, size_t len) {
+    host_nvs_entry_t *e = host_nvs_find(handle, key, true);
+
+    uint8_t *data = malloc(len ? len : 1);
+    if(!data) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memcpy(data, value, len);
+
+    free(e->data);
+    e->data = data;
+    e->len = len;
+    e->type = type;
+
+    return ESP_OK;
+}
+
+
+/**
+ * @brief Reads the value of the key
+ *
+ * @param handle Namespace
+ * @param key Key
+ * @param type Type of the value
+ * @param value Output buffer (or NULL if only the length is read)
+ * @param len Size of the buffer, it is set to the length of the value
+ * @return esp_err_t ESP_OK if value was read
+ */
+static esp_err_t host_nvs_get(nvs_handle_t handle, const char *key, char type, void *value, size_t *len) {
+    host_nvs_entry_t *e = host_nvs_find(handle, key, false);
+    if(!e || e->type != type) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    if(value && *len < e->len) {
+        *len = e->len;
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+
+    if(value) {
+        memcpy(value, e->data, e->len);
+    }
+
+    *len = e->len;
+
+    return ESP_OK;
+}
+
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value) {
+    return host_nvs_set(handle, key, 'b', &value, sizeof(value));
+}
+
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value) {
+    size_t len = sizeof(*out_value);
+    return host_nvs_get(handle, key, 'b', out_value, &len);
+}
+
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value) {
+    return host_nvs_set(handle, key, 'w', &value, sizeof(value));
+}
+
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value) {
+    size_t len = sizeof(*out_value);
+    return host_nvs_get(handle, key, 'w', out_value, &len);
+}
+
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    return host_nvs_set(handle, key, 'B', value, length);
+}
+
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+    return host_nvs_get(handle, key, 'B', out_value, length);
+}
+
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+    host_nvs_entry_t *e = host_nvs_find(handle, key, false);
+    if(!e) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    free(e->data);
+    memset(e, 0, sizeof(*e));
+
+    return ESP_OK;
+}
+
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    return ESP_OK;
+}
+
+
+void host_adc_feed(const uint16_t *samples, size_t len) {
+    adc_samples = samples;
+    adc_len = len;
+    adc_read = 0;
+    adc_start_us = host_now_us();
+}
+
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t *hdl_config, adc_continuous_handle_t *ret_handle) {
+    static int handle; //< Only one unit is simulated
+
+    if(hdl_config->conv_frame_size % SOC_ADC_DIGI_RESULT_BYTES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *ret_handle = (adc_continuous_handle_t)&handle;
+
+    return ESP_OK;
+}
+
+
+esp_err_t adc_continuous_config(adc_continuous_handle_t handle, const adc_continuous_config_t *config) {
+    if(config->pattern_num != 1 || config->format != ADC_DIGI_OUTPUT_FORMAT_TYPE1) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    adc_freq = config->sample_freq_hz;
+
+    return ESP_OK;
+}
+
+
+esp_err_t adc_continuous_start(adc_continuous_handle_t handle) {
+    if(!adc_freq) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    adc_started = true;
+    adc_read = 0;
+    adc_start_us = host_now_us();
+
+    return ESP_OK;
+}
+
+
+esp_err_t adc_continuous_read(adc_continuous_handle_t handle, uint8_t *buf, uint32_t length_max, uint32_t *out_length,
+    uint32_t timeout_ms) {
+
+    if(!adc_started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint32_t n = length_max / SOC_ADC_DIGI_RESULT_BYTES;
+
+    //Samples are returned, when the whole frame was converted
+    host_sleep_until(adc_start_us + ((adc_read + n) * 1000000 + adc_freq - 1) / adc_freq);
+
+    for(uint32_t i = 0; i < n; i++, adc_read++) {
+        adc_digi_output_data_t d = { 0 };
+        d.type1.data = adc_read < adc_len ? adc_samples[adc_read] & 0xfff : HOST_ADC_IDLE;
+        memcpy(&buf[i * SOC_ADC_DIGI_RESULT_BYTES], &d, SOC_ADC_DIGI_RESULT_BYTES);
+    }
+
+    *out_length = n * SOC_ADC_DIGI_RESULT_BYTES;
+
+    return ESP_OK;
+}
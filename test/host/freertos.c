@@ -0,0 +1,886 @@
+/**
+ * @file freertos.c
+ *
+ * @brief FreeRTOS for the host build (tasks are coroutines switched by ucontext, queues, semaphores, event groups
+ * and notifications are implemented over them, see host.h)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdarg.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include "host.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+#if defined(__SANITIZE_ADDRESS__)
+#define HOST_ASAN
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define HOST_ASAN
+#endif
+#endif
+
+#ifdef HOST_ASAN //ASan must know about switches of stacks, otherwise it reports false positives
+#include <sanitizer/common_interface_defs.h>
+#define HOST_FIBER_START(save, bottom, size) __sanitizer_start_switch_fiber(save, bottom, size)
+#define HOST_FIBER_FINISH(save, bottom, size) __sanitizer_finish_switch_fiber(save, bottom, size)
+#else
+#define HOST_FIBER_START(save, bottom, size) do { } while(0)
+#define HOST_FIBER_FINISH(save, bottom, size) do { } while(0)
+#endif
+
+
+/**
+ * @brief Task (coroutine with its own stack)
+ *
+ */
+struct host_task {
+    ucontext_t ctx;
+    void *stack;
+    TaskFunction_t code;
+    void *arg;
+    char name[16];
+    bool finished; //< Task returned from its function (or it was deleted)
+    uint64_t wake_us; //< Timeout of the current wait (HOST_NEVER if it waits without timeout)
+    uint32_t notify_value;
+    bool notify_pending;
+    void *fake_stack; //< Fake stack of ASan saved while the task is switched out
+};
+
+
+/**
+ * @brief Queue (semaphores and mutexes are queues with items of zero size)
+ *
+ */
+struct QueueDefinition {
+    uint8_t *items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head; //< Index of the first item
+    UBaseType_t count; //< Number of items
+    UBaseType_t high_water; //< The maximum number of items at once
+    bool is_mutex;
+    struct host_task *holder; //< Task, that holds the mutex
+};
+
+
+struct host_event_group {
+    EventBits_t bits;
+};
+
+
+static struct host_task *tasks[HOST_TASK_NUM];
+static int task_num = 0;
+static struct host_task *current = NULL; //< Running task (NULL if scheduler or setup code of the harness runs)
+static ucontext_t scheduler_ctx;
+static const void *scheduler_stack = NULL; //< Stack of the scheduler (for ASan)
+static size_t scheduler_stack_size = 0;
+
+static uint64_t now_us = 0;
+static uint32_t progress = 0; //< Counter of changes, that can unblock some task (items, notifications, bits...)
+
+
+void host_fatal(const char *format, ...) {
+    va_list args;
+
+    fprintf(stderr, "HOST FATAL (%s, %.3f s): ", current ? current->name : "scheduler", now_us / 1e6);
+
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+
+    fprintf(stderr, "\n");
+    abort();
+}
+
+
+uint64_t host_now_us() {
+    return now_us;
+}
+
+
+/**
+ * @brief Converts ticks of FreeRTOS to the absolute time of the timeout
+ *
+ * @param ticks Ticks to wait
+ * @return uint64_t Time in microseconds or HOST_NEVER
+ */
+static uint64_t host_deadline(TickType_t ticks) {
+    if(ticks == portMAX_DELAY) {
+        return HOST_NEVER;
+    }
+
+    return now_us + (uint64_t)ticks * 1000000 / configTICK_RATE_HZ;
+}
+
+
+/**
+ * @brief Switches from the current task to the scheduler (finished task is never resumed)
+ *
+ * @param t Current task
+ */
+static void host_yield(struct host_task *t) {
+    HOST_FIBER_START(t->finished ? NULL : &t->fake_stack, scheduler_stack, scheduler_stack_size);
+    swapcontext(&t->ctx, &scheduler_ctx);
+    HOST_FIBER_FINISH(t->fake_stack, &scheduler_stack, &scheduler_stack_size);
+}
+
+
+/**
+ * @brief Blocks the current task until the condition is true or the time is reached
+ *
+ * @param ready Condition
+ * @param obj Argument of the condition
+ * @param wake_us Timeout (absolute time in microseconds or HOST_NEVER)
+ * @return true if condition became true
+ */
+static bool host_wait(bool (*ready)(void *), void *obj, uint64_t wake_us) {
+    if(ready(obj)) {
+        return true;
+    }
+
+    if(wake_us <= now_us) {
+        return false;
+    }
+
+    struct host_task *t = current;
+    if(!t) {
+        host_fatal("Blocking call outside of a task!");
+    }
+
+    bool ok;
+    t->wake_us = wake_us;
+    while(1) {
+        host_yield(t); //Other tasks run until the scheduler returns here
+
+        if(ready(obj)) {
+            ok = true;
+            break;
+        }
+
+        if(now_us >= t->wake_us) {
+            ok = false;
+            break;
+        }
+    }
+
+    t->wake_us = HOST_NEVER;
+
+    return ok;
+}
+
+
+static bool host_time_reached(void *obj) {
+    return now_us >= *(uint64_t *)obj;
+}
+
+
+void host_sleep_until(uint64_t time_us) {
+    host_wait(host_time_reached, &time_us, time_us);
+}
+
+
+/**
+ * @brief Entry of every task (the context returns to the scheduler, when the function of the task returns)
+ *
+ */
+static void host_task_entry() {
+    struct host_task *t = current;
+
+    HOST_FIBER_FINISH(NULL, &scheduler_stack, &scheduler_stack_size);
+
+    t->code(t->arg);
+    t->finished = true;
+
+    host_yield(t);
+}
+
+
+/**
+ * @brief Runs every task until it blocks (finished tasks are removed)
+ *
+ * @return true if some task made progress
+ */
+static bool host_round() {
+    uint32_t before = progress;
+
+    for(int i = 0; i < task_num; i++) {
+        struct host_task *t = tasks[i];
+        if(t->finished) {
+            continue;
+        }
+
+        void *fake_stack = NULL;
+
+        current = t;
+        HOST_FIBER_START(&fake_stack, t->stack, HOST_STACK_SIZE);
+        swapcontext(&scheduler_ctx, &t->ctx);
+        HOST_FIBER_FINISH(fake_stack, NULL, NULL);
+        current = NULL;
+    }
+
+    int kept = 0;
+    for(int i = 0; i < task_num; i++) {
+        if(!tasks[i]->finished) {
+            tasks[kept++] = tasks[i];
+            continue;
+        }
+
+        free(tasks[i]->stack);
+        free(tasks[i]);
+        progress++;
+    }
+
+    task_num = kept;
+
+    return progress != before;
+}
+
+
+/**
+ * @brief Returns the time of the next event (alarm of the timer or timeout of some task)
+ *
+ * @return uint64_t Time in microseconds or HOST_NEVER
+ */
+static uint64_t host_next_event() {
+    uint64_t next = host_timer_next_us();
+
+    for(int i = 0; i < task_num; i++) {
+        if(tasks[i]->wake_us < next) {
+            next = tasks[i]->wake_us;
+        }
+    }
+
+    return next;
+}
+
+
+/**
+ * @brief Runs tasks until they are all blocked and then advances the time to the next event
+ *
+ * @param end_us Time, that must not be exceeded
+ * @return true if there is no next event (system is idle)
+ */
+static bool host_step(uint64_t end_us) {
+    if(current) {
+        host_fatal("Scheduler cannot be run from a task!");
+    }
+
+    int rounds = 0;
+    while(host_round()) {
+        if(++rounds > HOST_LIVELOCK_ROUNDS) {
+            host_fatal("Tasks do not block (live lock)!");
+        }
+    }
+
+    uint64_t next = host_next_event();
+    if(next == HOST_NEVER) {
+        return true;
+    }
+
+    if(next > end_us) {
+        now_us = end_us;
+        return false;
+    }
+
+    if(next > now_us) {
+        now_us = next;
+    }
+
+    host_timer_fire(now_us);
+
+    return false;
+}
+
+
+void host_run_until(uint64_t time_us) {
+    while(now_us < time_us) {
+        if(host_step(time_us)) { //Nothing happens until the time
+            now_us = time_us;
+        }
+    }
+
+    host_step(time_us); //Tasks woken at the time run too
+}
+
+
+bool host_run_idle(uint64_t max_us) {
+    uint64_t end_us = now_us + max_us;
+
+    while(!host_step(end_us)) {
+        if(now_us >= end_us) {
+            return host_step(end_us);
+        }
+    }
+
+    return true;
+}
+
+
+TaskHandle_t host_task_find(const char *name) {
+    for(int i = 0; i < task_num; i++) {
+        if(!strcmp(tasks[i]->name, name)) {
+            return tasks[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+bool host_task_finished(TaskHandle_t task) {
+    for(int i = 0; i < task_num; i++) {
+        if(tasks[i] == task) {
+            return task->finished;
+        }
+    }
+
+    return true; //Finished tasks are removed by the scheduler
+}
+
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task_code, const char *name, uint32_t stack_depth, void *parameters,
+    UBaseType_t priority, TaskHandle_t *created_task, BaseType_t core_id) {
+
+    if(task_num == HOST_TASK_NUM) {
+        host_fatal("Too many tasks!");
+    }
+
+    struct host_task *t = calloc(1, sizeof(struct host_task));
+    t->stack = malloc(HOST_STACK_SIZE);
+    if(!t || !t->stack) {
+        host_fatal("Unable to allocate the task!");
+    }
+
+    t->code = task_code;
+    t->arg = parameters;
+    t->wake_us = HOST_NEVER;
+    snprintf(t->name, sizeof(t->name), "%s", name);
+
+    getcontext(&t->ctx);
+    t->ctx.uc_stack.ss_sp = t->stack;
+    t->ctx.uc_stack.ss_size = HOST_STACK_SIZE;
+    t->ctx.uc_link = &scheduler_ctx;
+    makecontext(&t->ctx, host_task_entry, 0);
+
+    tasks[task_num++] = t;
+    progress++;
+
+    if(created_task) {
+        *created_task = t;
+    }
+
+    return pdPASS;
+}
+
+
+void vTaskDelete(TaskHandle_t task) {
+    struct host_task *t = task ? task : current;
+    if(!t) {
+        host_fatal("vTaskDelete outside of a task!");
+    }
+
+    t->finished = true;
+    if(t == current) {
+        host_yield(t); //It never returns, finished task is not resumed
+    }
+}
+
+
+void vTaskDelay(TickType_t ticks_to_delay) {
+    host_sleep_until(host_deadline(ticks_to_delay));
+}
+
+
+void taskYIELD(void) {
+    if(!current) {
+        host_fatal("taskYIELD outside of a task!");
+    }
+
+    progress++; //Current task stays ready, so the round is repeated
+    host_yield(current);
+}
+
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(now_us * configTICK_RATE_HZ / 1000000);
+}
+
+
+TickType_t xTaskGetTickCountFromISR(void) {
+    return xTaskGetTickCount();
+}
+
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return current;
+}
+
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    switch(action) {
+        case eSetBits:
+            task->notify_value |= value;
+            break;
+
+        case eIncrement:
+            task->notify_value++;
+            break;
+
+        case eSetValueWithoutOverwrite:
+            if(task->notify_pending) {
+                return pdFAIL;
+            }
+
+            task->notify_value = value;
+            break;
+
+        case eSetValueWithOverwrite:
+            task->notify_value = value;
+            break;
+
+        default:
+            break;
+    }
+
+    task->notify_pending = true;
+    progress++;
+
+    return pdPASS;
+}
+
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t *higher_priority_task_woken) {
+    return xTaskNotify(task, value, action);
+}
+
+
+static bool host_notify_pending(void *obj) {
+    return ((struct host_task *)obj)->notify_pending;
+}
+
+
+BaseType_t xTaskNotifyWait(uint32_t bits_to_clear_on_entry, uint32_t bits_to_clear_on_exit, uint32_t *notification_value,
+    TickType_t ticks_to_wait) {
+
+    struct host_task *t = current;
+    if(!t) {
+        host_fatal("xTaskNotifyWait outside of a task!");
+    }
+
+    if(!t->notify_pending) {
+        t->notify_value &= ~bits_to_clear_on_entry;
+    }
+
+    bool notified = host_wait(host_notify_pending, t, host_deadline(ticks_to_wait));
+
+    if(notification_value) {
+        *notification_value = t->notify_value;
+    }
+
+    if(notified) {
+        t->notify_value &= ~bits_to_clear_on_exit;
+    }
+
+    t->notify_pending = false;
+
+    return notified ? pdTRUE : pdFALSE;
+}
+
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken) {
+    xTaskNotify(task, 0, eIncrement);
+}
+
+
+static bool host_notify_nonzero(void *obj) {
+    return ((struct host_task *)obj)->notify_value != 0;
+}
+
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait) {
+    struct host_task *t = current;
+    if(!t) {
+        host_fatal("ulTaskNotifyTake outside of a task!");
+    }
+
+    host_wait(host_notify_nonzero, t, host_deadline(ticks_to_wait));
+
+    uint32_t value = t->notify_value;
+    if(value) {
+        t->notify_value = clear_count_on_exit ? 0 : value - 1;
+    }
+
+    t->notify_pending = false;
+
+    return value;
+}
+
+
+/**
+ * @brief Creates the queue
+ *
+ * @param length Maximum number of items
+ * @param item_size Size of one item (0 for semaphores)
+ * @param count Initial number of items (only for semaphores)
+ * @return QueueHandle_t The new queue
+ */
+static QueueHandle_t host_queue_create(UBaseType_t length, UBaseType_t item_size, UBaseType_t count) {
+    QueueHandle_t q = calloc(1, sizeof(struct QueueDefinition));
+    if(!q) {
+        return NULL;
+    }
+
+    q->items = calloc(length, item_size ? item_size : 1);
+    if(!q->items) {
+        free(q);
+        return NULL;
+    }
+
+    q->length = length;
+    q->item_size = item_size;
+    q->count = count;
+    q->high_water = count;
+
+    return q;
+}
+
+
+/**
+ * @brief Puts the item to the queue, that is not full
+ *
+ * @param q Queue
+ * @param item Item
+ * @param front true if the item should be the first one
+ */
+static void host_queue_put(QueueHandle_t q, const void *item, bool front) {
+    UBaseType_t idx;
+
+    if(q->count >= q->length) {
+        host_fatal("Item was written to the full queue!");
+    }
+
+    if(front) {
+        q->head = (q->head + q->length - 1) % q->length;
+        idx = q->head;
+    }
+    else {
+        idx = (q->head + q->count) % q->length;
+    }
+
+    memcpy(&q->items[idx * q->item_size], item, q->item_size);
+
+    q->count++;
+    if(q->count > q->high_water) {
+        q->high_water = q->count;
+    }
+
+    progress++;
+}
+
+
+/**
+ * @brief Takes the first item from the queue, that is not empty
+ *
+ * @param q Queue
+ * @param buffer Output buffer for the item
+ */
+static void host_queue_get(QueueHandle_t q, void *buffer) {
+    if(!q->count) {
+        host_fatal("Item was read from the empty queue!");
+    }
+
+    memcpy(buffer, &q->items[q->head * q->item_size], q->item_size);
+
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+
+    progress++;
+}
+
+
+static bool host_queue_has_space(void *obj) {
+    QueueHandle_t q = obj;
+    return q->count < q->length;
+}
+
+
+static bool host_queue_has_item(void *obj) {
+    QueueHandle_t q = obj;
+    return q->count > 0;
+}
+
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    return host_queue_create(length, item_size, 0);
+}
+
+
+/**
+ * @brief Writes the item to the queue (it waits for the space)
+ *
+ * @param q Queue
+ * @param item Item
+ * @param ticks_to_wait Timeout
+ * @param front true if the item should be the first one
+ * @return BaseType_t pdPASS if item was written
+ */
+static BaseType_t host_queue_send(QueueHandle_t q, const void *item, TickType_t ticks_to_wait, bool front) {
+    if(!host_wait(host_queue_has_space, q, host_deadline(ticks_to_wait))) {
+        return errQUEUE_FULL;
+    }
+
+    host_queue_put(q, item, front);
+
+    return pdPASS;
+}
+
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait) {
+    return host_queue_send(queue, item, ticks_to_wait, false);
+}
+
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait) {
+    return host_queue_send(queue, item, ticks_to_wait, false);
+}
+
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait) {
+    return host_queue_send(queue, item, ticks_to_wait, true);
+}
+
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *higher_priority_task_woken) {
+    return host_queue_send(queue, item, 0, false);
+}
+
+
+BaseType_t xQueueSendToBackFromISR(QueueHandle_t queue, const void *item, BaseType_t *higher_priority_task_woken) {
+    return host_queue_send(queue, item, 0, false);
+}
+
+
+BaseType_t xQueueSendToFrontFromISR(QueueHandle_t queue, const void *item, BaseType_t *higher_priority_task_woken) {
+    return host_queue_send(queue, item, 0, true);
+}
+
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait) {
+    if(!host_wait(host_queue_has_item, queue, host_deadline(ticks_to_wait))) {
+        return pdFALSE;
+    }
+
+    host_queue_get(queue, buffer);
+
+    return pdTRUE;
+}
+
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t queue, void *buffer, BaseType_t *higher_priority_task_woken) {
+    return xQueueReceive(queue, buffer, 0);
+}
+
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait) {
+    if(!host_wait(host_queue_has_item, queue, host_deadline(ticks_to_wait))) {
+        return pdFALSE;
+    }
+
+    memcpy(buffer, &queue->items[queue->head * queue->item_size], queue->item_size);
+
+    return pdTRUE;
+}
+
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    queue->head = 0;
+    queue->count = 0;
+    progress++;
+
+    return pdPASS;
+}
+
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    return queue->count;
+}
+
+
+UBaseType_t uxQueueMessagesWaitingFromISR(QueueHandle_t queue) {
+    return queue->count;
+}
+
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    return queue->length - queue->count;
+}
+
+
+UBaseType_t host_queue_high_water(QueueHandle_t queue) {
+    return queue->high_water;
+}
+
+
+UBaseType_t host_queue_length(QueueHandle_t queue) {
+    return queue->length;
+}
+
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return host_queue_create(1, 0, 0);
+}
+
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    SemaphoreHandle_t s = host_queue_create(1, 0, 1);
+    if(s) {
+        s->is_mutex = true;
+    }
+
+    return s;
+}
+
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+    return host_queue_create(max_count, 0, initial_count);
+}
+
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait) {
+    if(semaphore->is_mutex && current && semaphore->holder == current) {
+        host_fatal("Mutex is taken again by its holder (deadlock)!");
+    }
+
+    if(!host_wait(host_queue_has_item, semaphore, host_deadline(ticks_to_wait))) {
+        return pdFALSE;
+    }
+
+    semaphore->count--;
+    semaphore->holder = current;
+    progress++;
+
+    return pdTRUE;
+}
+
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    if(semaphore->is_mutex && semaphore->holder != current) {
+        host_fatal("Mutex is given by the task, that does not hold it!");
+    }
+
+    if(semaphore->count >= semaphore->length) {
+        return pdFALSE;
+    }
+
+    semaphore->count++;
+    semaphore->holder = NULL;
+    progress++;
+
+    return pdTRUE;
+}
+
+
+BaseType_t xSemaphoreTakeFromISR(SemaphoreHandle_t semaphore, BaseType_t *higher_priority_task_woken) {
+    if(!semaphore->count) {
+        return pdFALSE;
+    }
+
+    semaphore->count--;
+    progress++;
+
+    return pdTRUE;
+}
+
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t *higher_priority_task_woken) {
+    if(semaphore->count >= semaphore->length) {
+        return pdFALSE;
+    }
+
+    semaphore->count++;
+    progress++;
+
+    return pdTRUE;
+}
+
+
+EventGroupHandle_t xEventGroupCreate(void) {
+    return calloc(1, sizeof(struct host_event_group));
+}
+
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t event_group, EventBits_t bits_to_set) {
+    event_group->bits |= bits_to_set;
+    progress++;
+
+    return event_group->bits;
+}
+
+
+BaseType_t xEventGroupSetBitsFromISR(EventGroupHandle_t event_group, EventBits_t bits_to_set,
+    BaseType_t *higher_priority_task_woken) {
+
+    xEventGroupSetBits(event_group, bits_to_set);
+
+    return pdPASS;
+}
+
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t event_group, EventBits_t bits_to_clear) {
+    EventBits_t bits = event_group->bits;
+    event_group->bits &= ~bits_to_clear;
+
+    return bits;
+}
+
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t event_group) {
+    return event_group->bits;
+}
+
+
+/**
+ * @brief Condition of waiting for bits of the event group
+ *
+ */
+typedef struct host_bits_wait {
+    EventGroupHandle_t event_group;
+    EventBits_t bits;
+    bool all;
+} host_bits_wait_t;
+
+
+static bool host_bits_set(void *obj) {
+    host_bits_wait_t *w = obj;
+    EventBits_t set = w->event_group->bits & w->bits;
+
+    return w->all ? set == w->bits : set != 0;
+}
+
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t event_group, EventBits_t bits_to_wait_for, BaseType_t clear_on_exit,
+    BaseType_t wait_for_all_bits, TickType_t ticks_to_wait) {
+
+    host_bits_wait_t w = { .event_group = event_group, .bits = bits_to_wait_for, .all = wait_for_all_bits };
+
+    bool set = host_wait(host_bits_set, &w, host_deadline(ticks_to_wait));
+    EventBits_t bits = event_group->bits;
+
+    if(set && clear_on_exit) {
+        event_group->bits &= ~bits_to_wait_for;
+    }
+
+    return bits;
+}
@@ -0,0 +1,621 @@
+/**
+ * @file fuzz_commands.c
+ *
+ * @brief Fuzz target of command handlers (letter, abort, volume, beep and macro commands from BLE and UART)
+ *
+ * The whole firmware is started by app_main and every input is a sequence of commands, that are passed through
+ * the real handlers (BLE writes and the UART transport) by the client task. Every op starts with the header byte:
+ * bit 7 selects the transport (UART or BLE), bits 4-6 the command (0-2 letter, 3 volume, 4 abort, 5 beep, 6 macro,
+ * 7 waits until the pipeline is idle) and bits 0-3 the length of the data (15 means, that the length is in the next
+ * byte). The rest of the input after the last op is ignored.
+ *
+ * When the pipeline becomes idle, queues must be empty, the backlog must be zero and the whole letter queue must be
+ * free for reservation. If nothing could drop or reorder symbols since the last idle state (no abort, beep, macro,
+ * deadline nor other channel), played symbols (edges of the buzzer and the LED) must be exactly the Morse code of
+ * letters decoded from the written text, so no symbol is lost or played twice.
+ *
+ * Without libFuzzer (HOST_FUZZ_DRIVER) the target is run by the driver: fuzz_commands [-n runs] [-s seed] [files...]
+ * runs given inputs and then runs random inputs.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#include <string.h>
+
+#include "host.h"
+#include "freertos/semphr.h"
+#include "translator.h"
+#include "output.h"
+#include "charset.h"
+#include "ttl.h"
+
+
+#define HARNESS_MAX_INPUT 256 //< Longer inputs are rejected (longer sequences of commands do not reach new states)
+#define HARNESS_WPM 240 //< Speed set before every input (one dot is one tick of the output timer)
+#define HARNESS_POLL_MS 50 //< Period of checking of the idle pipeline
+#define HARNESS_DRAIN_MAX_US (24ULL * 3600 * 1000000) //< Longer playing of one input is considered as deadlock
+#define HARNESS_MAX_SYMBOLS (16 * MAXIMUM_MESSAGE_NUM) //< Buffers of expected and played symbols
+#define HARNESS_DECODE_LEN 256 //< Size of the buffer for decoded letters (as LETTER_DECODE_LEN in main.c)
+
+#define HARNESS_UNIT_TICKS(ms) ((ms) > OUTPUT_TICK_MS ? ((ms) + OUTPUT_TICK_MS / 2) / OUTPUT_TICK_MS : 1) //< As in output.c
+
+
+/**
+ * @brief Commands of the input
+ *
+ */
+enum harness_ops {
+    HARNESS_VOLUME = 3, //< 0-2 are letter commands (the most interesting ones)
+    HARNESS_ABORT,
+    HARNESS_BEEP,
+    HARNESS_MACRO,
+    HARNESS_DRAIN,
+};
+
+
+/**
+ * @brief Input passed to the client task
+ *
+ */
+typedef struct harness_input {
+    const uint8_t *data;
+    size_t size;
+} harness_input_t;
+
+
+/**
+ * @brief Played element of the output (buzzer or LED)
+ *
+ */
+typedef struct harness_line {
+    int gpio;
+    bool level;
+    uint64_t on_us; //< Time of the rising edge
+} harness_line_t;
+
+
+void app_main(void);
+
+static bool initialized = false;
+static harness_line_t buzzer = { .gpio = BUZZER_GPIO };
+static harness_line_t led = { .gpio = LED_GPIO };
+
+static utf8_decoder_t shadow[2]; //< Copies of decoders of transports (BLE, UART), they are updated by the same writes
+
+static char expected[HARNESS_MAX_SYMBOLS]; //< Symbols of decoded letters since the last idle state
+static size_t expected_len = 0;
+static char played[HARNESS_MAX_SYMBOLS]; //< Played symbols since the last idle state
+static size_t played_len = 0;
+static size_t window_letters = 0; //< Decoded letters since the last idle state
+static bool window_clean = true; //< Nothing could drop symbols since the last idle state
+
+static unsigned long checked_windows = 0;
+static unsigned long checked_symbols = 0;
+
+
+/**
+ * @brief Records elements played by the primary channel
+ *
+ */
+static void harness_gpio(int gpio_num, bool level) {
+    harness_line_t *line = gpio_num == buzzer.gpio ? &buzzer : gpio_num == led.gpio ? &led : NULL;
+    if(!line) {
+        return;
+    }
+
+    line->level = level;
+    if(level) {
+        line->on_us = host_now_us();
+        return;
+    }
+
+    uint64_t unit_us = (uint64_t)HARNESS_UNIT_TICKS(output_unit_ms()) * OUTPUT_TICK_MS * 1000;
+    uint64_t duration = host_now_us() - line->on_us;
+
+    if(played_len < HARNESS_MAX_SYMBOLS) {
+        played[played_len++] = line == &led ? '/' : duration < 2 * unit_us ? '.' : '-';
+    }
+}
+
+
+/**
+ * @brief Appends symbols of decoded letters to the expected output
+ *
+ * @param codes Codes of letters
+ * @param len Number of codes
+ */
+static void harness_expect(const char *codes, size_t len) {
+    for(size_t i = 0; i < len; i++) {
+        const char *mc = charset_morse[(uint8_t)codes[i]];
+        if(!mc) {
+            host_fatal("Decoder emitted code %u, that cannot be played!", (uint8_t)codes[i]);
+        }
+
+        for(; *mc && expected_len < HARNESS_MAX_SYMBOLS; mc++) {
+            expected[expected_len++] = *mc == '.' || *mc == '-' ? *mc : '/'; //Other elements are played by LED (see compile_letter)
+        }
+    }
+
+    window_letters += len;
+}
+
+
+/**
+ * @brief Processes the letter command as the command handler does (headers are skipped and the text is decoded
+ * by the copy of the decoder of the transport)
+ *
+ * @param d Copy of the decoder of the transport
+ * @param value Data of the command
+ * @param len Length of the data
+ */
+static void harness_letter(utf8_decoder_t *d, const uint8_t *value, size_t len) {
+    char codes[HARNESS_DECODE_LEN];
+    uint8_t channel = 0;
+    bool packed = false;
+
+    while(len > 0) {
+        if(value[0] == MSG_ID_PREFIX && len >= MSG_ID_HEADER_LEN) {
+            value += MSG_ID_HEADER_LEN;
+            len -= MSG_ID_HEADER_LEN;
+        }
+        else if(value[0] == CHANNEL_PREFIX && len >= CHANNEL_HEADER_LEN) { //Speed or channel is changed
+            channel = value[1];
+            window_clean = false;
+
+            value += CHANNEL_HEADER_LEN;
+            len -= CHANNEL_HEADER_LEN;
+        }
+#ifdef MESSAGE_TTL
+        else if(value[0] == TTL_PREFIX && len >= TTL_HEADER_LEN) { //Letters may expire
+            window_clean = false;
+
+            value += TTL_HEADER_LEN;
+            len -= TTL_HEADER_LEN;
+        }
+#endif
+#ifdef PACKED_TEXT
+        else if(value[0] == PACKED_PREFIX) {
+            packed = true;
+
+            value++;
+            len--;
+            break;
+        }
+#endif
+        else {
+            break;
+        }
+    }
+
+    if(channel >= OUTPUT_CHANNEL_NUM) { //Command is rejected before the text is decoded
+        return;
+    }
+
+    while(len > 0) {
+        size_t consumed;
+        size_t n = packed ?
+            translator_decode_packed(d, value, len, &consumed, codes, sizeof(codes)) :
+            translator_decode(d, value, len, &consumed, codes, sizeof(codes));
+
+        harness_expect(codes, n);
+
+        value += consumed;
+        len -= consumed;
+    }
+
+    if(packed) {
+        translator_packed_end(d);
+    }
+}
+
+
+/**
+ * @brief Passes the command through the transport
+ *
+ * @param uart true for UART, false for BLE
+ * @param op Command
+ * @param value Data of the command
+ * @param len Length of the data
+ */
+static void harness_command(bool uart, uint8_t op, const uint8_t *value, uint16_t len) {
+    static const enum morse_code_rec_chars chars[] = { LETTER_CHAR, LETTER_CHAR, LETTER_CHAR, VOLUME_CHAR, ABORT_CHAR, BEEP_CHAR, MACRO_CHAR };
+    static const enum transport_cmds cmds[] = { LETTER_CMD, LETTER_CMD, LETTER_CMD, VOLUME_CMD, ABORT_CMD, BEEP_CMD, MACRO_CMD };
+
+    if(!uart) {
+        host_ble_write(chars[op], value, len);
+        return;
+    }
+
+    host_uart_command(cmds[op], value, len);
+    if(op == HARNESS_VOLUME && len > 1) { //Volume can be followed by the pitch as on BLE
+        host_uart_command(PITCH_CMD, &value[1], len - 1);
+    }
+}
+
+
+/**
+ * @brief Checks if the pipeline has nothing to play
+ *
+ */
+static bool harness_idle() {
+    if(!output_is_idle() || uxQueueMessagesWaiting(queue)) {
+        return false;
+    }
+
+    for(int ch = 0; ch < OUTPUT_CHANNEL_NUM; ch++) {
+        if(uxQueueMessagesWaiting(out_queues[ch])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Checks that the queue never held more items than its capacity
+ *
+ */
+static void harness_check_queue(QueueHandle_t q, const char *name) {
+    if(host_queue_high_water(q) > host_queue_length(q)) {
+        host_fatal("%s held %u items (capacity %u)!", name, (unsigned)host_queue_high_water(q), (unsigned)host_queue_length(q));
+    }
+}
+
+
+/**
+ * @brief Starts the new window of checked symbols
+ *
+ */
+static void harness_window_reset() {
+    expected_len = 0;
+    played_len = 0;
+    window_letters = 0;
+    window_clean = !buzzer.level && !led.level; //Beep may still sound
+}
+
+
+/**
+ * @brief Waits until the pipeline is idle and checks invariants (it must be called from the client task)
+ *
+ */
+static void harness_drain() {
+    uint64_t start = host_now_us();
+
+    while(!harness_idle()) {
+        if(host_now_us() - start > HARNESS_DRAIN_MAX_US) {
+            host_fatal("Pipeline did not become idle!");
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(HARNESS_POLL_MS));
+    }
+
+    harness_check_queue(queue, "Letter queue");
+    for(int ch = 0; ch < OUTPUT_CHANNEL_NUM; ch++) {
+        harness_check_queue(out_queues[ch], "Out control queue");
+    }
+
+    if(output_backlog_ms()) {
+        host_fatal("Backlog is %lu ms, but nothing is played!", (unsigned long)output_backlog_ms());
+    }
+
+    if(!translator_reserve(MAXIMUM_MESSAGE_NUM, 0)) { //Nothing can stay reserved or queued
+        host_fatal("Letter queue cannot be reserved, but it is idle!");
+    }
+    translator_unreserve();
+
+    //The sum of letters fits to the queue, so no write could be rejected
+    if(window_clean && window_letters <= MAXIMUM_MESSAGE_NUM && !buzzer.level && !led.level) {
+        if(played_len != expected_len || memcmp(played, expected, expected_len)) {
+            host_fatal("Played %zu symbols instead of %zu:\n  played:   %.*s\n  expected: %.*s", played_len, expected_len,
+                (int)played_len, played, (int)expected_len, expected);
+        }
+
+        if(expected_len) {
+            checked_windows++;
+            checked_symbols += expected_len;
+        }
+    }
+
+    harness_window_reset();
+}
+
+
+/**
+ * @brief Client task, that passes commands of one input
+ *
+ * @param arg Input (harness_input_t)
+ */
+static void harness_client(void *arg) {
+    const harness_input_t *in = arg;
+    static const uint8_t speed[] = { CHANNEL_PREFIX, 0, HARNESS_WPM };
+
+    //State left by the previous input is dropped (settings and macros are kept as on the device)
+    harness_command(false, HARNESS_ABORT, NULL, 0);
+    harness_command(true, HARNESS_ABORT, NULL, 0);
+    harness_command(true, 0, speed, sizeof(speed));
+    memset(shadow, 0, sizeof(shadow));
+    harness_drain();
+
+    for(size_t pos = 0; pos < in->size;) {
+        uint8_t header = in->data[pos++];
+        bool uart = header & 0x80;
+        uint8_t op = (header >> 4) & 0x07;
+        size_t len = header & 0x0f;
+
+        if(len == 0x0f && pos < in->size) {
+            len = in->data[pos++];
+        }
+
+        if(len > in->size - pos) {
+            len = in->size - pos;
+        }
+
+        const uint8_t *value = &in->data[pos];
+        pos += len;
+
+        switch(op) {
+            case HARNESS_DRAIN:
+                harness_drain();
+                continue;
+
+            case HARNESS_ABORT:
+                if(!(len == 2 && value[0] == ABORT_MESSAGE_OP)) {
+                    translator_decoder_reset(&shadow[uart]);
+                }
+                window_clean = false;
+                break;
+
+            case HARNESS_BEEP:
+                translator_decoder_reset(&shadow[uart]);
+                window_clean = false;
+                break;
+
+            case HARNESS_MACRO:
+                window_clean = false;
+                break;
+
+            case HARNESS_VOLUME:
+                break;
+
+            default:
+                harness_letter(&shadow[uart], value, len);
+                break;
+        }
+
+        harness_command(uart, op, value, len);
+    }
+
+    harness_drain();
+}
+
+
+/**
+ * @brief Runs the scheduler until the task finishes
+ *
+ * @param task Task
+ * @param what Description for the error message
+ */
+static void harness_run_task(TaskHandle_t task, const char *what) {
+    uint64_t start = host_now_us();
+
+    while(!host_task_finished(task)) {
+        if(host_now_us() - start > 2 * HARNESS_DRAIN_MAX_US) {
+            host_fatal("%s did not finish (deadlock)!", what);
+        }
+
+        host_run_until(host_now_us() + 1000000);
+    }
+}
+
+
+/**
+ * @brief Task, that runs app_main (initialization blocks on semaphores)
+ *
+ */
+static void harness_app_main(void *arg) {
+    app_main();
+}
+
+
+/**
+ * @brief Starts the firmware
+ *
+ */
+static void harness_init() {
+    TaskHandle_t task;
+
+    host_gpio_observe(harness_gpio);
+
+    xTaskCreatePinnedToCore(harness_app_main, "main", 4096, NULL, 1, &task, 0);
+    harness_run_task(task, "app_main");
+
+    //Audio decoder has its own harness, idle input would only slow down the scheduler
+    TaskHandle_t decoder = host_task_find("decoder");
+    if(decoder) {
+        vTaskDelete(decoder);
+    }
+}
+
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if(size > HARNESS_MAX_INPUT) {
+        return -1;
+    }
+
+    if(!initialized) {
+        harness_init();
+        initialized = true;
+    }
+
+    harness_input_t in = { .data = data, .size = size };
+    TaskHandle_t task;
+
+    xTaskCreatePinnedToCore(harness_client, "client", 4096, &in, 5, &task, 0);
+    harness_run_task(task, "Client");
+
+    return 0;
+}
+
+
+#ifdef HOST_FUZZ_DRIVER
+
+/**
+ * @brief Runs the target with the copy of the data (so reads out of the input are detected by ASan)
+ *
+ */
+static void driver_run(const uint8_t *data, size_t size) {
+    uint8_t *copy = malloc(size ? size : 1);
+    memcpy(copy, data, size);
+
+    LLVMFuzzerTestOneInput(copy, size);
+
+    free(copy);
+}
+
+
+/**
+ * @brief Runs the input from the file
+ *
+ * @param path Path to the file
+ * @return true if file was read
+ */
+static bool driver_run_file(const char *path) {
+    uint8_t data[HARNESS_MAX_INPUT];
+
+    FILE *f = fopen(path, "rb");
+    if(!f) {
+        fprintf(stderr, "Unable to open %s!\n", path);
+        return false;
+    }
+
+    size_t size = fread(data, 1, sizeof(data), f);
+    fclose(f);
+
+    driver_run(data, size);
+
+    return true;
+}
+
+
+/**
+ * @brief Generates the random op (text of letter commands is mostly playable, so symbols are checked)
+ *
+ * @param out Output buffer
+ * @param max Size of the buffer
+ * @return size_t Length of the op
+ */
+static size_t driver_random_op(uint8_t *out, size_t max) {
+    static const char text[] = "abcdefghijklmnopqrstuvwxyz0123456789 .,?/=+-ABCZ<sk><ar>\xc3\xa1\xd0\xb6\xe3\x82\xa2";
+    uint8_t op = rand() % 10;
+    uint8_t data[32];
+    size_t len = 0;
+
+    op = op < 5 ? 0 : op < 7 ? HARNESS_DRAIN : 3 + rand() % 4;
+
+    if(op == 0) {
+        int kind = rand() % 10;
+        if(kind == 0) {
+            data[len++] = MSG_ID_PREFIX;
+            data[len++] = rand() % 4;
+        }
+        else if(kind == 1) {
+            data[len++] = PACKED_PREFIX;
+        }
+        else if(kind == 2) {
+            data[len++] = rand() % 2 ? TTL_PREFIX : CHANNEL_PREFIX;
+            data[len++] = rand() % 4;
+            data[len++] = 20 + rand() % 200;
+        }
+
+        size_t n = rand() % 24;
+        for(size_t i = 0; i < n; i++) {
+            data[len++] = kind == 1 || kind == 3 ? rand() : text[rand() % (sizeof(text) - 1)];
+        }
+    }
+    else if(op == HARNESS_ABORT) {
+        if(rand() % 2) {
+            data[len++] = ABORT_MESSAGE_OP;
+            data[len++] = rand() % 4;
+        }
+    }
+    else if(op == HARNESS_MACRO) {
+        data[len++] = 1 + rand() % 4;
+        data[len++] = rand() % 20;
+        for(size_t n = rand() % 8; n > 0; n--) {
+            data[len++] = text[rand() % 26];
+        }
+    }
+    else if(op == HARNESS_VOLUME) {
+        len = rand() % 5;
+        for(size_t i = 0; i < len; i++) {
+            data[i] = rand();
+        }
+    }
+
+    if(len + 2 > max) {
+        return 0;
+    }
+
+    size_t pos = 0;
+    out[pos++] = (rand() % 2 ? 0x80 : 0) | op << 4 | (len < 0x0f ? len : 0x0f);
+    if(len >= 0x0f) {
+        out[pos++] = len;
+    }
+
+    memcpy(&out[pos], data, len);
+
+    return pos + len;
+}
+
+
+int main(int argc, char **argv) {
+    unsigned long runs = 0;
+    unsigned seed = 1;
+    int files = 0;
+
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "-n") && i + 1 < argc) {
+            runs = strtoul(argv[++i], NULL, 10);
+        }
+        else if(!strcmp(argv[i], "-s") && i + 1 < argc) {
+            seed = strtoul(argv[++i], NULL, 10);
+        }
+        else if(!driver_run_file(argv[i])) {
+            return 2;
+        }
+        else {
+            files++;
+        }
+    }
+
+    srand(seed);
+    for(unsigned long r = 0; r < runs; r++) {
+        uint8_t data[HARNESS_MAX_INPUT];
+        size_t size = 0;
+
+        for(int ops = 1 + rand() % 12; ops > 0; ops--) {
+            size_t n = driver_random_op(&data[size], sizeof(data) - size);
+            if(!n) {
+                break;
+            }
+
+            size += n;
+        }
+
+        driver_run(data, size);
+    }
+
+    printf("%d files and %lu random inputs (seed %u), %lu idle states checked with %lu symbols, %.1f s of virtual time\n",
+        files, runs, seed, checked_windows, checked_symbols, host_now_us() / 1e6);
+
+    if(!checked_windows) {
+        printf("FAILED: no symbols were checked\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""
+Generates WAV fixtures of the audio decoder harness (test/host/fixtures/*.wav).
+
+Every fixture is keyed text with exact PARIS timing (dot is 1200 / WPM ms), raised cosine edges of elements (5 ms, as
+a typical transmitter shapes them), optional white noise, mains hum and detuning of the tone. Word '#' in the text
+is a burst of interference: a carrier close to the tone, louder than the keyed signal, that fades in and out slowly
+(it is steady, so the detector takes it as the noise floor rather than a tone). Noise is generated
+from the fixed seed, so the files are reproducible. Files are 8 kHz 8-bit mono PCM to keep them small, the harness
+resamples them to the sample rate of the decoder.
+
+Usage: ./gen_wav.py (run it from test/host after changing the fixtures, expected texts are in CMakeLists.txt)
+
+Author: Vojtěch Dvořák (xdvora3o)
+Date: 2022-12-12
+"""
+
+import math
+import random
+import wave
+
+RATE = 8000 #< Sample rate of fixtures in Hz
+EDGE_S = 0.005 #< Length of raised cosine edges of elements
+LEAD_S = 0.5 #< Silence before the first element and after the last one
+BURST_S = 4.0 #< Length of the burst of interference (word '#' in the text)
+BURST_OFFSET_HZ = 20 #< Offset of the interfering carrier from the tone
+BURST_FADE_S = 1.5 #< Length of raised cosine fade in and fade out of the burst
+
+MORSE = {
+    'A': '.-', 'B': '-...', 'C': '-.-.', 'D': '-..', 'E': '.', 'F': '..-.', 'G': '--.', 'H': '....', 'I': '..',
+    'J': '.---', 'K': '-.-', 'L': '.-..', 'M': '--', 'N': '-.', 'O': '---', 'P': '.--.', 'Q': '--.-', 'R': '.-.',
+    'S': '...', 'T': '-', 'U': '..-', 'V': '...-', 'W': '.--', 'X': '-..-', 'Y': '-.--', 'Z': '--..',
+    '0': '-----', '1': '.----', '2': '..---', '3': '...--', '4': '....-', '5': '.....', '6': '-....', '7': '--...',
+    '8': '---..', '9': '----.', '?': '..--..', '/': '-..-.', '=': '-...-',
+}
+
+# File name, text, speed (WPM), tone frequency (Hz), tone amplitude, RMS of noise, amplitude of 50 Hz hum, amplitude
+# of the burst
+FIXTURES = [
+    ('cq_20wpm_clean.wav', 'CQ CQ DE OK1IMP OK1IMP K', 20, 700, 0.6, 0.0, 0.0, 0.0),
+    ('paris_15wpm_noise.wav', 'PARIS PARIS 73 TU', 15, 700, 0.4, 0.12, 0.1, 0.0),
+    ('test_28wpm_detuned.wav', 'TEST DE OK1IMP 599 TU', 28, 740, 0.5, 0.05, 0.0, 0.0),
+    ('burst_20wpm.wav', 'CQ DE OK1IMP # CQ CQ DE OK1IMP K', 20, 700, 0.1, 0.02, 0.0, 0.2),
+]
+
+
+def keying(text, wpm):
+    """Returns the list of (tone, duration in seconds) of the keyed text (tone is None for the burst)."""
+
+    dot = 1.2 / wpm
+    out = [(False, LEAD_S)]
+
+    for word in text.split():
+        if word == '#':
+            out.append((None, BURST_S))
+            out.append((False, 7 * dot))
+            continue
+
+        for letter in word:
+            for element in MORSE[letter]:
+                out.append((True, dot if element == '.' else 3 * dot))
+                out.append((False, dot))
+
+            out[-1] = (False, 3 * dot)
+
+        out[-1] = (False, 7 * dot)
+
+    out[-1] = (False, LEAD_S)
+    return out
+
+
+def raised_cosine(i, n, edge):
+    """Returns the envelope of the i-th sample of the segment of n samples with raised cosine edges."""
+
+    ramp = min(i, n - 1 - i)
+    return 1.0 if ramp >= edge else 0.5 - 0.5 * math.cos(math.pi * ramp / edge)
+
+
+def render(text, wpm, freq, amplitude, noise, hum, burst, rng):
+    """Returns samples of the fixture in range -1..1."""
+
+    samples = []
+    edge = int(EDGE_S * RATE)
+    fade = int(BURST_FADE_S * RATE)
+    t = 0
+
+    for tone, duration in keying(text, wpm):
+        n = int(round(duration * RATE))
+        for i in range(n):
+            envelope = raised_cosine(i, n, edge) if tone else 0.0
+
+            value = envelope * amplitude * math.sin(2 * math.pi * freq * t / RATE)
+            value += hum * math.sin(2 * math.pi * 50 * t / RATE) + rng.gauss(0.0, noise)
+
+            if tone is None:
+                value += raised_cosine(i, n, fade) * burst * math.sin(2 * math.pi * (freq + BURST_OFFSET_HZ) * t / RATE)
+            samples.append(max(-1.0, min(1.0, value)))
+            t += 1
+
+    return samples
+
+
+def write_wav(path, samples):
+    with wave.open(path, 'wb') as wav:
+        wav.setnchannels(1)
+        wav.setsampwidth(1)
+        wav.setframerate(RATE)
+        wav.writeframes(bytes(int(round(128 + 127 * s)) for s in samples))
+
+
+def main():
+    rng = random.Random(73)
+
+    for name, text, wpm, freq, amplitude, noise, hum, burst in FIXTURES:
+        samples = render(text, wpm, freq, amplitude, noise, hum, burst, rng)
+        write_wav('fixtures/' + name, samples)
+        print('%s: %.1f s, %s' % (name, len(samples) / RATE, text))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,191 @@
+/**
+ * @file host.h
+ *
+ * @brief Host build of the firmware (ESP-IDF and FreeRTOS are replaced by stubs, so modules can be tested, measured
+ * and fuzzed on PC)
+ *
+ * Tasks are cooperative coroutines, that are switched only when they block. Time is virtual, it is advanced by
+ * the scheduler only when all tasks are blocked (to the nearest alarm of the hardware timer or timeout of the task),
+ * so results do not depend on the speed of the host.
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 2022-12-12
+ */
+
+#ifndef __HOST__
+#define __HOST__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_err.h"
+
+#include "ble_receiver.h"
+#include "transport.h"
+
+
+#define HOST_TASK_NUM 16 //< Maximum number of tasks
+#define HOST_STACK_SIZE (256 * 1024) //< Stack of every task (sanitizers need much more than FreeRTOS on ESP32)
+#define HOST_LIVELOCK_ROUNDS 100000 //< Maximum number of scheduler rounds in one moment of time (more is considered as live lock)
+
+#define HOST_NEVER UINT64_MAX //< Time of the event, that never comes
+
+
+/**
+ * @brief Aborts the harness with the message (e. g. deadlock or invalid use of the kernel)
+ *
+ * @param format Format of the message
+ */
+void host_fatal(const char *format, ...) __attribute__((noreturn, format(printf, 1, 2)));
+
+
+/**
+ * @brief Returns the virtual time
+ *
+ * @return uint64_t Time in microseconds since the start of the harness
+ */
+uint64_t host_now_us();
+
+
+/**
+ * @brief Blocks the current task until the virtual time (it must be called from the task)
+ *
+ * @param time_us Time in microseconds
+ */
+void host_sleep_until(uint64_t time_us);
+
+
+/**
+ * @brief Runs tasks and ISRs until the virtual time is reached
+ *
+ * @param time_us Time in microseconds
+ */
+void host_run_until(uint64_t time_us);
+
+
+/**
+ * @brief Runs tasks and ISRs until all tasks are blocked without timeout and no timer is running
+ *
+ * @param max_us Maximum duration of the run (virtual time)
+ * @return true if the system became idle, false if it was still busy after max_us
+ */
+bool host_run_idle(uint64_t max_us);
+
+
+/**
+ * @brief Finds the task by its name
+ *
+ * @param name Name of the task (as it was passed to xTaskCreatePinnedToCore)
+ * @return TaskHandle_t Handle of the task or NULL if there is no such task
+ */
+TaskHandle_t host_task_find(const char *name);
+
+
+/**
+ * @brief Checks if the task returned from its function
+ *
+ * @param task Task
+ * @return true if task finished
+ */
+bool host_task_finished(TaskHandle_t task);
+
+
+/**
+ * @brief Returns the maximum number of items, that were in the queue at once
+ *
+ * @param queue Queue
+ * @return UBaseType_t Number of items
+ */
+UBaseType_t host_queue_high_water(QueueHandle_t queue);
+
+
+/**
+ * @brief Returns the capacity of the queue
+ *
+ * @param queue Queue
+ * @return UBaseType_t Number of items
+ */
+UBaseType_t host_queue_length(QueueHandle_t queue);
+
+
+/**
+ * @brief Returns the time of the next alarm of the running hardware timer (implemented by esp.c)
+ *
+ * @return uint64_t Time in microseconds or HOST_NEVER
+ */
+uint64_t host_timer_next_us();
+
+
+/**
+ * @brief Fires alarms of hardware timers, which are due (implemented by esp.c)
+ *
+ * @param now_us The current time
+ */
+void host_timer_fire(uint64_t now_us);
+
+
+/**
+ * @brief Callback for levels of GPIOs and states of PWM channels (every change of the level is reported)
+ *
+ */
+typedef void (*host_gpio_cb_t)(int gpio_num, bool level);
+
+
+/**
+ * @brief Registers the callback for levels of outputs (PWM channels are reported with GPIO numbers, that were
+ * configured by ledc_channel_config)
+ *
+ * @param cb Callback or NULL
+ */
+void host_gpio_observe(host_gpio_cb_t cb);
+
+
+/**
+ * @brief Sets samples, that are returned by ADC in continuous mode (ADC returns the middle of the range after them)
+ *
+ * @param samples Raw 12-bit samples (the buffer must be valid until ADC reads them)
+ * @param len Number of samples
+ */
+void host_adc_feed(const uint16_t *samples, size_t len);
+
+
+/**
+ * @brief Callback for notifications of characteristics
+ *
+ */
+typedef void (*host_notify_cb_t)(enum morse_code_rec_chars char_idx, const uint8_t *value, uint16_t len);
+
+
+/**
+ * @brief Registers the callback for notifications of characteristics
+ *
+ * @param cb Callback or NULL
+ */
+void host_ble_observe(host_notify_cb_t cb);
+
+
+/**
+ * @brief Writes the characteristic as the BLE client (through the handler registered by bluetooth_init)
+ *
+ * @param char_idx Characteristic
+ * @param value Written data
+ * @param len Length of the data
+ */
+void host_ble_write(enum morse_code_rec_chars char_idx, const uint8_t *value, uint16_t len);
+
+
+/**
+ * @brief Passes the command as the UART receiver (through the handler registered by uart_receiver_init, the transport
+ * waits for the space in the letter queue without timeout)
+ *
+ * @param cmd Command
+ * @param value Data of the command
+ * @param len Length of the data
+ */
+void host_uart_command(enum transport_cmds cmd, const uint8_t *value, uint16_t len);
+
+#endif
@@ -0,0 +1,14 @@
+/**
+ * @file i2s_std.h
+ *
+ * @brief I2S driver in standard mode (host build, only the header is needed, the sidetone is not built)
+ *
+ */
+
+#ifndef __HOST_DRIVER_I2S_STD__
+#define __HOST_DRIVER_I2S_STD__
+
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+#endif
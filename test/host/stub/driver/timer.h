@@ -0,0 +1,66 @@
+/**
+ * @file timer.h
+ *
+ * @brief Legacy driver of hardware timers (host build, alarms are fired by the scheduler of the harness)
+ *
+ */
+
+#ifndef __HOST_DRIVER_TIMER__
+#define __HOST_DRIVER_TIMER__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define TIMER_BASE_CLK 80000000 //< APB clock
+
+typedef enum {
+    TIMER_GROUP_0,
+    TIMER_GROUP_1,
+    TIMER_GROUP_MAX,
+} timer_group_t;
+
+typedef enum {
+    TIMER_0,
+    TIMER_1,
+    TIMER_MAX,
+} timer_idx_t;
+
+typedef enum {
+    TIMER_COUNT_DOWN,
+    TIMER_COUNT_UP,
+} timer_count_dir_t;
+
+typedef enum {
+    TIMER_PAUSE,
+    TIMER_START,
+} timer_start_t;
+
+typedef enum {
+    TIMER_ALARM_DIS,
+    TIMER_ALARM_EN,
+} timer_alarm_t;
+
+typedef struct {
+    timer_alarm_t alarm_en;
+    timer_start_t counter_en;
+    timer_count_dir_t counter_dir;
+    bool auto_reload;
+    uint32_t divider;
+} timer_config_t;
+
+typedef bool (*timer_isr_t)(void *arg);
+
+esp_err_t timer_init(timer_group_t group_num, timer_idx_t timer_num, const timer_config_t *config);
+esp_err_t timer_set_counter_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t load_val);
+esp_err_t timer_set_alarm_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t alarm_value);
+esp_err_t timer_enable_intr(timer_group_t group_num, timer_idx_t timer_num);
+esp_err_t timer_isr_callback_add(timer_group_t group_num, timer_idx_t timer_num, timer_isr_t isr_handler, void *arg, int intr_alloc_flags);
+esp_err_t timer_start(timer_group_t group_num, timer_idx_t timer_num);
+esp_err_t timer_pause(timer_group_t group_num, timer_idx_t timer_num);
+uint64_t timer_group_get_counter_value_in_isr(timer_group_t group_num, timer_idx_t timer_num);
+void timer_group_set_alarm_value_in_isr(timer_group_t group_num, timer_idx_t timer_num, uint64_t alarm_val);
+void timer_group_enable_alarm_in_isr(timer_group_t group_num, timer_idx_t timer_num);
+void timer_group_set_counter_enable_in_isr(timer_group_t group_num, timer_idx_t timer_num, timer_start_t counter_en);
+
+#endif
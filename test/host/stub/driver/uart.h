@@ -0,0 +1,20 @@
+/**
+ * @file uart.h
+ *
+ * @brief UART driver (host build, only types are needed, the UART transport is not built)
+ *
+ */
+
+#ifndef __HOST_DRIVER_UART__
+#define __HOST_DRIVER_UART__
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef int uart_port_t;
+
+#define UART_NUM_0 0
+#define UART_NUM_1 1
+#define UART_PIN_NO_CHANGE (-1)
+
+#endif
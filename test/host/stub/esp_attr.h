@@ -0,0 +1,16 @@
+/**
+ * @file esp_attr.h
+ *
+ * @brief Placement attributes (host build, everything is placed by the host linker)
+ *
+ */
+
+#ifndef __HOST_ESP_ATTR__
+#define __HOST_ESP_ATTR__
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+
+#endif
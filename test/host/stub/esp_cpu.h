@@ -0,0 +1,15 @@
+/**
+ * @file esp_cpu.h
+ *
+ * @brief CPU cycle counter (host build, it counts cycles of the host, see esp.c)
+ *
+ */
+
+#ifndef __HOST_ESP_CPU__
+#define __HOST_ESP_CPU__
+
+#include <stdint.h>
+
+uint32_t esp_cpu_get_cycle_count(void);
+
+#endif
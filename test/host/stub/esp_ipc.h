@@ -0,0 +1,18 @@
+/**
+ * @file esp_ipc.h
+ *
+ * @brief Inter-processor calls (host build, the function is called directly)
+ *
+ */
+
+#ifndef __HOST_ESP_IPC__
+#define __HOST_ESP_IPC__
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef void (*esp_ipc_func_t)(void *arg);
+
+esp_err_t esp_ipc_call_blocking(uint32_t cpu_id, esp_ipc_func_t func, void *arg);
+
+#endif
@@ -0,0 +1,31 @@
+/**
+ * @file esp_log.h
+ *
+ * @brief Logging of ESP-IDF (host build, messages go to stderr, so they do not mix with reports of harnesses)
+ *
+ */
+
+#ifndef __HOST_ESP_LOG__
+#define __HOST_ESP_LOG__
+
+#include <stdio.h>
+#include <inttypes.h>
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+#define ESP_LOG_AT(letter, tag, format, ...) fprintf(stderr, letter " (%s) " format "\n", tag, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_AT("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_AT("W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_AT("I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) do { } while(0)
+#define ESP_LOGV(tag, format, ...) do { } while(0)
+
+#endif
@@ -0,0 +1,15 @@
+/**
+ * @file esp_rom_sys.h
+ *
+ * @brief ROM functions (host build)
+ *
+ */
+
+#ifndef __HOST_ESP_ROM_SYS__
+#define __HOST_ESP_ROM_SYS__
+
+#include <stdint.h>
+
+void esp_rom_delay_us(uint32_t us);
+
+#endif
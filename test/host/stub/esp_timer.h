@@ -0,0 +1,15 @@
+/**
+ * @file esp_timer.h
+ *
+ * @brief High resolution timer (host build, it returns the virtual time of the harness)
+ *
+ */
+
+#ifndef __HOST_ESP_TIMER__
+#define __HOST_ESP_TIMER__
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
+
+#endif
@@ -0,0 +1,15 @@
+/**
+ * @file esp_types.h
+ *
+ * @brief Basic types of ESP-IDF (host build)
+ *
+ */
+
+#ifndef __HOST_ESP_TYPES__
+#define __HOST_ESP_TYPES__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#endif
@@ -0,0 +1,57 @@
+/**
+ * @file FreeRTOS.h
+ *
+ * @brief Kernel types of FreeRTOS (host build, tasks are cooperative coroutines of the harness, see freertos.c)
+ *
+ * Tasks are switched only when they block, and ISRs (alarms of timers) are fired only between the tasks, so critical
+ * sections do not have to do anything.
+ *
+ */
+
+#ifndef __HOST_FREERTOS__
+#define __HOST_FREERTOS__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+#define errQUEUE_FULL 0
+
+#define configTICK_RATE_HZ CONFIG_FREERTOS_HZ
+#define configMAX_PRIORITIES 25
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((TickType_t)(ms) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+
+#define portNUM_PROCESSORS 2
+#define tskNO_AFFINITY 0x7fffffff
+
+typedef struct {
+    uint32_t owner;
+    uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { 0, 0 }
+#define portMUX_INITIALIZE(mux) ((void)(mux))
+
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux) ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux) ((void)(mux))
+#define portENTER_CRITICAL_SAFE(mux) ((void)(mux))
+#define portEXIT_CRITICAL_SAFE(mux) ((void)(mux))
+
+#define portYIELD_FROM_ISR(...) do { } while(0)
+
+#endif
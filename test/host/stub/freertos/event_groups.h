@@ -0,0 +1,25 @@
+/**
+ * @file event_groups.h
+ *
+ * @brief Event groups of FreeRTOS (host build)
+ *
+ */
+
+#ifndef __HOST_FREERTOS_EVENT_GROUPS__
+#define __HOST_FREERTOS_EVENT_GROUPS__
+
+#include "FreeRTOS.h"
+
+typedef struct host_event_group *EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t event_group, EventBits_t bits_to_set);
+BaseType_t xEventGroupSetBitsFromISR(EventGroupHandle_t event_group, EventBits_t bits_to_set,
+    BaseType_t *higher_priority_task_woken);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t event_group, EventBits_t bits_to_clear);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t event_group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t event_group, EventBits_t bits_to_wait_for, BaseType_t clear_on_exit,
+    BaseType_t wait_for_all_bits, TickType_t ticks_to_wait);
+
+#endif
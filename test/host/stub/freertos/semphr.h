@@ -0,0 +1,23 @@
+/**
+ * @file semphr.h
+ *
+ * @brief Semaphores and mutexes of FreeRTOS (host build, they are queues without items as in FreeRTOS)
+ *
+ */
+
+#ifndef __HOST_FREERTOS_SEMPHR__
+#define __HOST_FREERTOS_SEMPHR__
+
+#include "queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreTakeFromISR(SemaphoreHandle_t semaphore, BaseType_t *higher_priority_task_woken);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t *higher_priority_task_woken);
+
+#endif
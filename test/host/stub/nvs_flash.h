@@ -0,0 +1,16 @@
+/**
+ * @file nvs_flash.h
+ *
+ * @brief Initialization of the non-volatile storage (host build)
+ *
+ */
+
+#ifndef __HOST_NVS_FLASH__
+#define __HOST_NVS_FLASH__
+
+#include "nvs.h"
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+
+#endif
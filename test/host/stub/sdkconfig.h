@@ -0,0 +1,16 @@
+/**
+ * @file sdkconfig.h
+ *
+ * @brief Configuration of the host build (it replaces the one generated by ESP-IDF from sdkconfig.defaults)
+ *
+ */
+
+#ifndef __HOST_SDKCONFIG__
+#define __HOST_SDKCONFIG__
+
+#define CONFIG_IDF_TARGET_ESP32 1
+#define CONFIG_FREERTOS_HZ 1000
+#define CONFIG_BT_BLUEDROID_ENABLED 1
+#define CONFIG_MORSE_DLOG_LEVEL 4 //< All deferred logs are compiled, so their arguments are checked too
+
+#endif
@@ -0,0 +1,14 @@
+/**
+ * @file soc_caps.h
+ *
+ * @brief Capabilities of ESP32 used by the firmware (host build)
+ *
+ */
+
+#ifndef __HOST_SOC_CAPS__
+#define __HOST_SOC_CAPS__
+
+#define SOC_ADC_DIGI_RESULT_BYTES 2
+#define SOC_ADC_DIGI_MAX_BITWIDTH 12
+
+#endif
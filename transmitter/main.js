@@ -8,14 +8,20 @@ const serviceId = '0000abcd-0000-1000-8000-00805f9b34fb'; //Our custom service U
 
 const minIntervalMs = 500;
 
+const packedPrefix = 0x04; //Header of the letter command with compressed text
+const letterCapPacked = 0x01; //Capability flag of the receiver (value of the letter characteristic)
+
+var BTdevice = null; //BluetoothDevice, that is reconnected when the link drops
 var BTserver = null; //BluetoothRemoteGATTServer
 var letterBTchar = null; //Characteristic of BTserver for writing letters
 var volumeBTchar = null; //Characteristic of BTserver for reading current volume
 var abortBTchar = null; //Characteristic of BTserver for aborting morse beeping
 var beepBTchar = null;
+var decodedBTchar = null; //Characteristic of BTserver with text keyed on the receiver (notifications)
 var jobChain = null; //Chain of promises for BTserver (to avoid sending request when server is busy)
 
 var isBeeping = false;
+var packedSupported = false; //Receiver accepts compressed text
 
 
 function isBtSupported() {
@@ -123,12 +129,89 @@ function setConnectButtonState(newState = false) {
     document.getElementById('connect').disabled = newState;
 }
 
+/**
+ * Returns UUID of the characteristic of our service (characteristics have 16-bit UUIDs with base UUID)
+ * @param {number} id 16-bit UUID of the characteristic
+ */
+function charUuid(id) {
+    return BluetoothUUID.canonicalUUID(id);
+}
+
+
+/**
+ * Connects to the GATT server of already chosen device (it is used also for reconnecting after the link drop, so
+ * characteristics are found by their UUIDs and browser can use its cache of the attribute database)
+ * @param {BluetoothDevice} device
+ */
+function connectDevice(device) {
+    setStatus('Connecting... 25%');
+    setStatusClass('info');
+
+    return device.gatt.connect().then((server) => {
+        console.log(server);
+        setStatus('Connecting... 50%');
+
+        return server.getPrimaryService(serviceId).then((service) => {
+            console.log(service);
+            setStatus('Connecting... 75%');
+
+            return service.getCharacteristics().then(chars => {
+                console.log(chars);
+                setStatus('Connecting... 100%');
+
+                let byUuid = (id) => chars.find((c) => c.uuid == charUuid(id)) || null;
+
+                BTserver = server;
+                letterBTchar = byUuid(0x0000);
+                volumeBTchar = byUuid(0x0001);
+                abortBTchar = byUuid(0x0002);
+                beepBTchar = byUuid(0x0003);
+                decodedBTchar = byUuid(0x0004);
+
+                isBeeping = false;
+
+                readCapabilities();
+                subscribeDecoded();
+
+                connectedBtns();
+                updateVolumeSlider();
+
+                setStatus('Connected!');
+                setStatusClass('success');
+            });
+        });
+    });
+}
+
+
+/**
+ * Reconnects to the device when the link dropped (it was not disconnected by the user)
+ * @param {event} event
+ */
+function deviceDisconnected(event) {
+    if(BTdevice == null || event.target != BTdevice) {
+        return;
+    }
+
+    console.log('Link dropped, reconnecting...');
+
+    connectDevice(BTdevice).catch((error) => {
+        setStatus('Disconnected');
+        setStatusClass('warning');
+
+        disconnectedBtns();
+
+        console.log(error);
+    });
+}
+
+
 /**
  * Connects to the bluetooth device
  */
 async function connect() {
     let options = {
-        filters : [{ name: [deviceName] }], //Change to acceptAllDevices for all BT devices
+        filters : [{ services: [serviceId] }, { name: deviceName }], //Service UUID is advertised, name is for older firmware
         //acceptAllDevices : true,
         optionalServices : [serviceId]
     };
@@ -138,38 +221,13 @@ async function connect() {
     await navigator.bluetooth.requestDevice(options).then(
         (device) => {
             console.log(device);
-            setStatus('Connecting... 25%');
-            setStatusClass('info');
-
-            device.gatt.connect().then((server) => {
-                console.log(server);
-                setStatus('Connecting... 50%');
-
-                server.getPrimaryService(0xabcd).then((service) => {
-                    console.log(service);
-                    setStatus('Connecting... 75%');
-
-                    service.getCharacteristics().then(chars => {
-                        console.log(chars);
-                        setStatus('Connecting... 100%');
 
-                        BTserver = server;
-                        letterBTchar = chars[0];
-                        volumeBTchar = chars[1];
-                        abortBTchar = chars[2];
-                        beepBTchar = chars[3];
+            BTdevice = device;
+            device.addEventListener('gattserverdisconnected', deviceDisconnected);
 
-                        isBeeping = false;
-
-                        connectedBtns();
-                        updateVolumeSlider();
-
-                        setStatus('Connected!');
-                        setStatusClass('success');
-                    });
-                });
-            });
-        },
+            return connectDevice(device);
+        }
+    ).catch(
         (error) => {
             setStatus('Error while conneting to the device!');
             setStatusClass('danger');
@@ -183,6 +241,8 @@ async function connect() {
  * Disconnects fro mthe bluetooth device
  */
 function disconnect() {
+    BTdevice = null; //Disconnected by the user, so it is not reconnected
+
     if(BTserver != null) {
         console.log(BTserver.connected);
         BTserver.disconnect();
@@ -199,6 +259,103 @@ function disconnect() {
         volumeBTchar = null;
         abortBTchar = null;
         beepBTchar = null;
+        decodedBTchar = null;
+    }
+}
+
+
+/**
+ * Appends text keyed on the receiver (by local key) to the page
+ * @param {event} event
+ */
+function decodedChanged(event) {
+    let ch = String.fromCharCode(event.target.value.getUint8(0));
+
+    document.getElementById('decoded').textContent += ch;
+}
+
+
+/**
+ * Reads capability flags of the receiver from the letter characteristic (older receivers do not allow reading it)
+ */
+function readCapabilities() {
+    packedSupported = false;
+
+    letterBTchar.readValue().then(
+        (value) => {
+            packedSupported = value.byteLength > 0 && (value.getUint8(0) & letterCapPacked) != 0;
+        },
+        (error) => {
+            console.log(error);
+        }
+    );
+}
+
+
+/**
+ * Compresses the text of the message to Huffman codes of characters and words (see gen_packed.py)
+ * @param {string} text
+ * @returns {array} Letter command with compressed text
+ */
+function packText(text) {
+    let bytes = [packedPrefix];
+    let bits = 0, bitsLen = 0;
+
+    let put = (code, len) => {
+        bits = (bits << len) | code;
+        bitsLen += len;
+        while(bitsLen >= 8) {
+            bitsLen -= 8;
+            bytes.push((bits >> bitsLen) & 0xff);
+        }
+        bits &= (1 << bitsLen) - 1;
+    };
+
+    text = text.replace(/[A-Z]/g, (c) => c.toLowerCase()); //Receiver plays upper case letters as lower case ones
+
+    for(let i = 0; i < text.length;) {
+        let symbol = null;
+        for(let len = Math.min(packedMaxSymbolLen, text.length - i); len > 0 && symbol == null; len--) {
+            if(packedCodes.has(text.substr(i, len))) {
+                symbol = text.substr(i, len);
+            }
+        }
+
+        if(symbol != null) {
+            put(...packedCodes.get(symbol));
+            i += symbol.length;
+        }
+        else { //Other characters are escaped byte by byte
+            let ch = String.fromCodePoint(text.codePointAt(i));
+            for(let byte of new TextEncoder().encode(ch)) {
+                put(...packedCodes.get(null));
+                put(byte, 8);
+            }
+            i += ch.length;
+        }
+    }
+
+    if(bitsLen > 0) {
+        put((1 << (8 - bitsLen)) - 1, 8 - bitsLen); //Padding by ones is never a complete code
+    }
+
+    return bytes;
+}
+
+
+/**
+ * Subscribes to notifications with text keyed on the receiver
+ */
+function subscribeDecoded() {
+    if(decodedBTchar != null) {
+        decodedBTchar.startNotifications().then(
+            (char) => {
+                char.addEventListener('characteristicvaluechanged', decodedChanged);
+            },
+            (error) => {
+                console.log(error);
+            }
+        );
     }
 }
 
@@ -242,6 +399,7 @@ function addWriteJob(char, bufferToBeSended) {
             volumeBTchar = null;
             abortBTchar = null;
             beepBTchar = null;
+            decodedBTchar = null;
         })
     );
 
@@ -312,7 +470,13 @@ function send() {
         if(message) {
             console.log('Sending message to receiver...');
 
-            let messageArr = message.split('').map(ch => ch.charCodeAt(0));
+            let messageArr = Array.from(new TextEncoder().encode(message)); // Receiver decodes UTF-8
+            if(packedSupported) {
+                let packed = packText(message);
+                if(packed.length < messageArr.length) {
+                    messageArr = packed;
+                }
+            }
             addWriteJob(letterBTchar, messageArr);
         }
     }
@@ -417,11 +581,11 @@ function onKeyDown(event) {
     if(letterBTchar != null && BTserver != null) {
         console.log('Adding to the queue: ' + event.key);
 
-        let charToBeSended = event.key.charCodeAt(0);
+        let charToBeSended = Array.from(new TextEncoder().encode(String.fromCodePoint(event.key.codePointAt(0))));
 
         console.log(charToBeSended);
 
-        addWriteJob(letterBTchar, [charToBeSended]);
+        addWriteJob(letterBTchar, charToBeSended);
     }
     else {
         setStatus('Disconnected');
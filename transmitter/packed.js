@@ -0,0 +1,74 @@
+/**
+ * Tables of the compressed text of the letter command (GENERATED by gen_packed.py, do not edit it manually!)
+ * @author Vojtech Dvorak (xdvora3o)
+ */
+
+const packedMaxSymbolLen = 5; //Words of the dictionary are matched up to this length
+
+//Codes of symbols [code, length in bits], null is the escape (it is followed by one raw byte of UTF-8)
+const packedCodes = new Map([
+    [' ', [0x0000, 3]],
+    ['e', [0x0002, 4]],
+    ['t', [0x0003, 4]],
+    ['a', [0x0004, 4]],
+    ['n', [0x0005, 4]],
+    ['o', [0x000c, 5]],
+    ['i', [0x000d, 5]],
+    ['s', [0x000e, 5]],
+    ['r', [0x000f, 5]],
+    ['l', [0x0010, 5]],
+    ['c', [0x0011, 5]],
+    ['b', [0x0012, 5]],
+    ['k', [0x0013, 5]],
+    ['h', [0x0028, 6]],
+    ['d', [0x0029, 6]],
+    ['u', [0x002a, 6]],
+    ['m', [0x002b, 6]],
+    ['w', [0x002c, 6]],
+    ['f', [0x002d, 6]],
+    ['g', [0x002e, 6]],
+    ['y', [0x002f, 6]],
+    ['x', [0x0030, 6]],
+    ['q', [0x0031, 6]],
+    ['1', [0x0032, 6]],
+    ['.', [0x0033, 6]],
+    ['the ', [0x0034, 6]],
+    ['is ', [0x0035, 6]],
+    [null, [0x0036, 6]],
+    ['p', [0x006e, 7]],
+    ['v', [0x006f, 7]],
+    ['z', [0x0070, 7]],
+    ['0', [0x0071, 7]],
+    ['2', [0x0072, 7]],
+    ['3', [0x0073, 7]],
+    ['5', [0x0074, 7]],
+    ['7', [0x0075, 7]],
+    ['9', [0x0076, 7]],
+    [',', [0x0077, 7]],
+    ['de ', [0x0078, 7]],
+    ['on ', [0x0079, 7]],
+    ['j', [0x00f4, 8]],
+    ['?', [0x00f5, 8]],
+    [':', [0x00f6, 8]],
+    ['<', [0x00f7, 8]],
+    ['>', [0x00f8, 8]],
+    ['and ', [0x00f9, 8]],
+    ['test ', [0x00fa, 8]],
+    ['4', [0x01f6, 9]],
+    ['6', [0x01f7, 9]],
+    ['8', [0x01f8, 9]],
+    ['/', [0x03f2, 10]],
+    ['=', [0x03f3, 10]],
+    ['+', [0x03f4, 10]],
+    ['-', [0x03f5, 10]],
+    ['\'', [0x03f6, 10]],
+    ['(', [0x03f7, 10]],
+    [')', [0x03f8, 10]],
+    ['"', [0x03f9, 10]],
+    [';', [0x03fa, 10]],
+    ['@', [0x03fb, 10]],
+    ['!', [0x03fc, 10]],
+    ['&', [0x03fd, 10]],
+    ['_', [0x03fe, 10]],
+    ['$', [0x03ff, 10]],
+]);